@@ -0,0 +1,149 @@
+//-------------------------------------------------------------------------------------------------
+//
+// O22SIOEM.h
+//
+// Header for the O22SnapIoEmulator C++ class, used by the benchmarks in this directory.
+//
+// The O22SnapIoEmulator C++ class answers memory map requests the way a SNAP Ethernet brain
+// does, on 127.0.0.1, from a thread of its own. It keeps 16 MB of memory map behind the
+// 0xF0000000 - 0xF0FFFFFF range: reads return what was written there, and each analog point of
+// the bank (0xF0600000) and of the point read areas (0xF0A00000) starts at k*1.5, k being the
+// point number. Every request is acknowledged.
+//
+// To make a network visible on the loopback, each response can be held for a fixed latency
+// after its request arrived. Requests keep being read in the meantime, so a client with several
+// requests outstanding gets their responses back one latency later, not one latency each. Over
+// UDP one request in every N can be dropped, to measure retransmissions.
+//
+// The emulator is Linux only, like the benchmarks that use it.
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef __O22SIOEM_H_
+#define __O22SIOEM_H_
+
+
+#ifndef __O22SIOMM_H_
+#include "O22SIOMM.h"
+#endif
+
+
+// Size of the emulated memory map, from 0xF0000000
+#define SIOMM_EMU_MEMMAP_SIZE      0x01000000
+
+// The most responses held back for their latency at once
+#define SIOMM_EMU_MAX_PENDING      64
+
+// The largest request or response frame
+#define SIOMM_EMU_MAX_FRAME        (16 + SIOMM_MAX_BLOCK_LENGTH + 4)
+
+
+// A response waiting for its latency
+typedef struct SIOMM_EmuResponse
+{
+  LONGLONG    nDueNS;         // When to send it, on the O22GetTimeNS() clock
+  sockaddr_in To;             // Who to send it to, over UDP
+  long        nLength;
+  BYTE        byFrame[SIOMM_EMU_MAX_FRAME];
+} O22_SIOMM_EmuResponse;
+
+
+class O22SnapIoEmulator {
+
+  public:
+  // Public data
+
+    // Public Construction/Destruction
+    O22SnapIoEmulator();
+    ~O22SnapIoEmulator();
+
+  // Public Members
+
+    LONG Start(long nPort, long nConnectionType, LONGLONG nLatencyNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Starts answering requests on 127.0.0.1 from a thread.
+    //  Input  : nPort - the port to listen on.
+    //           nConnectionType - SIOMM_TCP or SIOMM_UDP.
+    //           nLatencyNS - how long each response is held after its request arrived.
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    void Stop();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Stops the thread and closes the sockets. The memory map is kept.
+    //---------------------------------------------------------------------------------------------
+
+    void SetLatency(LONGLONG nLatencyNS);
+    void SetDropEvery(long nDropEvery);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Over UDP, drops one request in every nDropEvery without answering it. 0, the
+    //           default, drops none.
+    //---------------------------------------------------------------------------------------------
+
+    long GetRequestCount();
+    long GetDropCount();
+
+  protected:
+  // Protected Data
+
+    SOCKET      m_ListenSocket;    // The TCP listening socket
+    SOCKET      m_Socket;          // The connected TCP socket, or the UDP socket
+    long        m_nConnectionType;
+    pthread_t   m_hThread;
+    BOOL        m_bThreadStarted;
+    volatile BOOL m_bStop;
+
+    volatile LONGLONG m_nLatencyNS;
+    volatile long m_nDropEvery;
+    volatile long m_nRequests;
+    volatile long m_nDrops;
+
+    BYTE      * m_pbyMemMap;       // SIOMM_EMU_MEMMAP_SIZE bytes from 0xF0000000
+
+    // Received TCP bytes that don't make a whole request yet
+    BYTE        m_byRecv[4 * SIOMM_EMU_MAX_FRAME];
+    long        m_nRecvLength;
+
+    // Responses waiting for their latency, in the order they are due
+    SIOMM_EmuResponse m_arrPending[SIOMM_EMU_MAX_PENDING];
+    long        m_nPendingFirst;
+    long        m_nPendingCount;
+
+  // Protected Members
+
+    static void * ThreadFunc(void * pParam);
+    void Serve();
+    void ServeConnection();
+    void ServeDatagrams();
+
+    long RequestLength(BYTE * pbyRequest, long nLength);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Returns the length of the request at the start of pbyRequest, 0 if nLength bytes
+    //           aren't enough to know it yet, or -1 if the request is bad.
+    //---------------------------------------------------------------------------------------------
+
+    BOOL Answer(BYTE * pbyRequest, long nLength, sockaddr_in * pFrom, LONGLONG nRecvTimeNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Carries out a request and queues its response, due nLatencyNS after it arrived.
+    //  Returns: FALSE if the request is bad.
+    //---------------------------------------------------------------------------------------------
+
+    BOOL SendDueResponses(LONGLONG nNowNS);
+    LONGLONG NextDueTime();
+    BYTE * MemMapAt(DWORD dwOffset, long nLength);
+};
+
+
+// Percentiles of the benchmarks: sorts pnValues and returns the value that dPercent % of them
+// don't exceed.
+extern LONGLONG O22BenchPercentile(LONGLONG * pnValues, long nCount, double dPercent);
+
+// The step of the level plant, the same in every benchmark: 9 analog and 3 digital point reads,
+// then 3 analog and 4 digital point writes. Fills SIOMM_BENCH_STEP_LENGTH transactions of pStep,
+// each with its own quadlet of pbyData.
+#define SIOMM_BENCH_STEP_LENGTH  19
+extern void O22BenchBuildPlantStep(SIOMM_Transaction * pStep, BYTE (*pbyData)[4]);
+
+
+#endif // __O22SIOEM_H_
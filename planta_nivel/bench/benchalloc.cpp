@@ -0,0 +1,256 @@
+//-----------------------------------------------------------------------------
+//
+// benchalloc.cpp
+//
+// Counts the heap allocations of O22SnapIoMemMap transactions once the
+// connection is open.
+//
+// operator new and new[] are replaced by versions that count their calls.
+// After opening a connection to an O22SnapIoEmulator and warming up, each
+// kind of transaction is run many times, over TCP and UDP, and the new
+// allocations are reported per transaction. Every count should be 0; the
+// program exits with 1 otherwise.
+//
+//   benchalloc [transactions]
+//
+// Linux only; see the README for the build line.
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOEM.h"
+#include "O22SIOSH.h"
+
+#include <stdlib.h>
+#include <new>
+
+
+#define BENCH_PORT  23102
+
+
+static volatile long g_nAllocations = 0;
+
+
+void * operator new(size_t nSize)
+{
+  void * pMemory;
+
+  g_nAllocations++;
+
+  pMemory = malloc(nSize ? nSize : 1);
+  if (pMemory == NULL)
+    throw std::bad_alloc();
+
+  return pMemory;
+}
+
+void * operator new[](size_t nSize)
+{
+  return operator new(nSize);
+}
+
+void operator delete(void * pMemory) noexcept
+{
+  free(pMemory);
+}
+
+void operator delete[](void * pMemory) noexcept
+{
+  free(pMemory);
+}
+
+void operator delete(void * pMemory, size_t) noexcept
+{
+  free(pMemory);
+}
+
+void operator delete[](void * pMemory, size_t) noexcept
+{
+  free(pMemory);
+}
+
+
+// What one run of a case does; returns SIOMM_OK if every transaction worked
+typedef LONG (*BenchCase)(O22SnapIoMemMap * pBrain, O22SnapIoShadow * pShadow);
+
+static BYTE              g_byBlock[SIOMM_MAX_BLOCK_LENGTH];
+static SIOMM_AnaBank     g_AnaBank;
+static SIOMM_Transaction g_Step[SIOMM_BENCH_STEP_LENGTH];
+static BYTE              g_byStep[SIOMM_BENCH_STEP_LENGTH][4];
+
+
+static LONG ReadQuadCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  DWORD dwQuadlet;
+
+  return pBrain->ReadQuad(SIOMM_APOINT_READ_VALUE_BASE, &dwQuadlet);
+}
+
+static LONG WriteQuadCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  return pBrain->WriteQuad(SIOMM_APOINT_WRITE_VALUE_BASE, 0x3F800000);
+}
+
+static LONG ReadBlockOddCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  // 13 bytes, so that the response carries padding
+  return pBrain->ReadBlock(0xF0D81000, 13, g_byBlock);
+}
+
+static LONG WriteBlockOddCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  return pBrain->WriteBlock(0xF0D81000, 13, g_byBlock);
+}
+
+static LONG ReadBlockMaxCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  return pBrain->ReadBlock(0xF0D80000, SIOMM_MAX_BLOCK_LENGTH, g_byBlock);
+}
+
+static LONG WriteBlockMaxCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  return pBrain->WriteBlock(0xF0D80000, SIOMM_MAX_BLOCK_LENGTH, g_byBlock);
+}
+
+static LONG GetAnaBankCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  return pBrain->GetAnaBankValuesEx(&g_AnaBank);
+}
+
+static LONG SetAnaBankCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  return pBrain->SetAnaBankValuesEx(g_AnaBank);
+}
+
+static LONG SetDigBankCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  return pBrain->SetDigBankPointStates(0, 1 << 20, 0, 1 << 20);
+}
+
+static LONG TransactCase(O22SnapIoMemMap * pBrain, O22SnapIoShadow *)
+{
+  return pBrain->Transact(g_Step, SIOMM_BENCH_STEP_LENGTH, SIOMM_BENCH_STEP_LENGTH);
+}
+
+static LONG ShadowCase(O22SnapIoMemMap *, O22SnapIoShadow * pShadow)
+{
+  LONG nResult;
+
+  nResult = pShadow->Refresh();
+  if (nResult == SIOMM_OK)
+    nResult = pShadow->SetAnaPtValue(16, 42.0);
+  if (nResult == SIOMM_OK)
+    nResult = pShadow->Flush();
+
+  return nResult;
+}
+
+
+typedef struct BenchCaseItem
+{
+  const char * pchName;
+  BenchCase    pfnCase;
+} BenchCaseItem;
+
+static BenchCaseItem g_arrCases[] =
+{
+  { "ReadQuad",                ReadQuadCase },
+  { "WriteQuad",               WriteQuadCase },
+  { "ReadBlock 13 bytes",      ReadBlockOddCase },
+  { "WriteBlock 13 bytes",     WriteBlockOddCase },
+  { "ReadBlock 2048 bytes",    ReadBlockMaxCase },
+  { "WriteBlock 2048 bytes",   WriteBlockMaxCase },
+  { "GetAnaBankValuesEx",      GetAnaBankCase },
+  { "SetAnaBankValuesEx",      SetAnaBankCase },
+  { "SetDigBankPointStates",   SetDigBankCase },
+  { "Transact 19, window 19",  TransactCase },
+  { "Shadow Refresh + Flush",  ShadowCase },
+};
+
+
+static long RunCases(long nConnectionType, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Run every case over one transport. Returns the number of cases that allocated or failed.
+//-------------------------------------------------------------------------------------------------
+{
+  O22SnapIoEmulator Emulator;
+  O22SnapIoMemMap   Brain;
+  O22SnapIoShadow   Shadow(&Brain);
+  long              nAllocations;
+  long              nErrors;
+  long              nBad = 0;
+  long              i, j;
+  LONG              nResult;
+
+  nResult = Emulator.Start(BENCH_PORT, nConnectionType, 0);
+  if (nResult == SIOMM_OK)
+  {
+    nResult = Brain.OpenEnet2((char*)"127.0.0.1", BENCH_PORT, 1000, 0, nConnectionType);
+    if (nResult == SIOMM_OK)
+      nResult = Brain.WaitForOpen();
+  }
+
+  if (nResult != SIOMM_OK)
+  {
+    printf("Can't reach the emulator on port %d: %ld\n", BENCH_PORT, (long)nResult);
+    return 1;
+  }
+
+  Shadow.AddRegion(SIOMM_ABANK_READ_POINT_VALUES, 256, SIOMM_SHADOW_READ);
+  Shadow.AddRegion(SIOMM_ABANK_WRITE_POINT_VALUES, 256, SIOMM_SHADOW_WRITE);
+
+  printf("%s:\n", (nConnectionType == SIOMM_TCP) ? "TCP" : "UDP");
+
+  for (i = 0 ; i < (long)(sizeof(g_arrCases) / sizeof(BenchCaseItem)) ; i++)
+  {
+    // The first calls may set things up; only what comes after counts
+    for (j = 0 ; j < 10 ; j++)
+      g_arrCases[i].pfnCase(&Brain, &Shadow);
+
+    nErrors      = 0;
+    nAllocations = g_nAllocations;
+
+    for (j = 0 ; j < nCount ; j++)
+    {
+      if (g_arrCases[i].pfnCase(&Brain, &Shadow) != SIOMM_OK)
+        nErrors++;
+    }
+
+    nAllocations = g_nAllocations - nAllocations;
+
+    printf("  %-24s %8.3f allocations per call  %ld errors\n", g_arrCases[i].pchName,
+           (double)nAllocations / nCount, nErrors);
+
+    if (nAllocations || nErrors)
+      nBad++;
+  }
+
+  Brain.Close();
+  Emulator.Stop();
+
+  return nBad;
+}
+
+
+int main(int argc, char * argv[])
+//-------------------------------------------------------------------------------------------------
+// Count the allocations over TCP and UDP
+//-------------------------------------------------------------------------------------------------
+{
+  long nCount = 1000;
+  long nBad;
+
+  if (argc > 1)
+    nCount = atol(argv[1]);
+
+  if (nCount < 1)
+    nCount = 1;
+
+  O22BenchBuildPlantStep(g_Step, g_byStep);
+
+  nBad  = RunCases(SIOMM_TCP, nCount);
+  nBad += RunCases(SIOMM_UDP, nCount);
+
+  printf(nBad ? "FAILED: %ld cases allocated or failed\n" : "OK: no allocations\n", nBad);
+
+  return nBad ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+//-----------------------------------------------------------------------------
+//
+// benchdecode.cpp
+//
+// O22UnpackFloats(), O22PackFloats() and O22UnpackLongs() against the
+// O22MAKELONG2() / O22FILL_ARRAY_FROM_LONG() macro loop they replace.
+//
+// Each kernel runs on 8, 64 (an analog bank) and 512 (a whole block)
+// quadlets, repeated until it has run for at least 0.2 s, and the time per
+// call is printed the way Google Benchmark prints it. The results of each
+// kernel are checked against the macro loop first.
+//
+//   benchdecode [min_time_s]
+//
+// Linux only; see the README for the build line.
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOUT.h"
+
+#include <stdlib.h>
+
+
+#define BENCH_MAX_QUADS  (2048 / 4)
+
+
+static BYTE  g_byData[BENCH_MAX_QUADS * 4];
+static BYTE  g_byPacked[BENCH_MAX_QUADS * 4];
+static float g_fValues[BENCH_MAX_QUADS];
+static long  g_nValues[BENCH_MAX_QUADS];
+
+
+// Keeps the compiler from dropping the work of a kernel
+#define BENCH_CLOBBER()  __asm__ __volatile__("" : : : "memory")
+
+
+static void __attribute__((noinline)) MacroUnpackFloats(const BYTE * pbyData, float * pfValues,
+                                                         long nCount)
+//-------------------------------------------------------------------------------------------------
+// The macro path: one quadlet at a time, as the bank decoders did
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD dwQuadlet;
+  long  i;
+
+  for (i = 0 ; i < nCount ; i++)
+  {
+    dwQuadlet = O22MAKELONG2(pbyData, i*4);
+    memcpy(&(pfValues[i]), &dwQuadlet, 4);
+  }
+}
+
+
+static void __attribute__((noinline)) MacroPackFloats(const float * pfValues, BYTE * pbyData,
+                                                       long nCount)
+//-------------------------------------------------------------------------------------------------
+// The macro path of the bank encoders
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD dwQuadlet;
+  long  i;
+
+  for (i = 0 ; i < nCount ; i++)
+  {
+    memcpy(&dwQuadlet, &(pfValues[i]), 4);
+    O22FILL_ARRAY_FROM_LONG(pbyData, i*4, dwQuadlet);
+  }
+}
+
+
+static void __attribute__((noinline)) MacroUnpackLongs(const BYTE * pbyData, long * pnValues,
+                                                        long nCount)
+//-------------------------------------------------------------------------------------------------
+// The macro path of the bank encoders
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  for (i = 0 ; i < nCount ; i++)
+    pnValues[i] = O22MAKELONG2(pbyData, i*4);
+}
+
+
+static void BenchMacroUnpackFloats(long nCount) { MacroUnpackFloats(g_byData, g_fValues, nCount); }
+static void BenchUnpackFloats(long nCount)      { O22UnpackFloats(g_byData, g_fValues, nCount); }
+static void BenchMacroPackFloats(long nCount)   { MacroPackFloats(g_fValues, g_byPacked, nCount); }
+static void BenchPackFloats(long nCount)        { O22PackFloats(g_fValues, g_byPacked, nCount); }
+static void BenchMacroUnpackLongs(long nCount)  { MacroUnpackLongs(g_byData, g_nValues, nCount); }
+static void BenchUnpackLongs(long nCount)       { O22UnpackLongs(g_byData, g_nValues, nCount); }
+
+
+typedef struct BenchKernel
+{
+  const char * pchName;
+  void      (* pfnKernel)(long nCount);
+} BenchKernel;
+
+static BenchKernel g_arrKernels[] =
+{
+  { "BM_MacroUnpackFloats", BenchMacroUnpackFloats },
+  { "BM_O22UnpackFloats",   BenchUnpackFloats },
+  { "BM_MacroPackFloats",   BenchMacroPackFloats },
+  { "BM_O22PackFloats",     BenchPackFloats },
+  { "BM_MacroUnpackLongs",  BenchMacroUnpackLongs },
+  { "BM_O22UnpackLongs",    BenchUnpackLongs },
+};
+
+static long g_arrnCounts[] = { 8, 64, BENCH_MAX_QUADS };
+
+
+static LONGLONG BenchCpuTimeNS()
+//-------------------------------------------------------------------------------------------------
+// The CPU time of this thread, in nanoseconds
+//-------------------------------------------------------------------------------------------------
+{
+  struct timespec tsNow;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tsNow);
+  return (LONGLONG)tsNow.tv_sec * 1000000000 + tsNow.tv_nsec;
+}
+
+
+static BOOL CheckKernels()
+//-------------------------------------------------------------------------------------------------
+// The vector kernels must give what the macros give, for every length up to a block
+//-------------------------------------------------------------------------------------------------
+{
+  float fMacro[BENCH_MAX_QUADS];
+  long  nMacro[BENCH_MAX_QUADS];
+  BYTE  byMacro[BENCH_MAX_QUADS * 4];
+  long  nCount;
+
+  for (nCount = 0 ; nCount <= BENCH_MAX_QUADS ; nCount++)
+  {
+    MacroUnpackFloats(g_byData, fMacro, nCount);
+    O22UnpackFloats(g_byData, g_fValues, nCount);
+    if (memcmp(fMacro, g_fValues, nCount * 4))
+      return FALSE;
+
+    MacroPackFloats(g_fValues, byMacro, nCount);
+    O22PackFloats(g_fValues, g_byPacked, nCount);
+    if (memcmp(byMacro, g_byPacked, nCount * 4))
+      return FALSE;
+
+    MacroUnpackLongs(g_byData, nMacro, nCount);
+    O22UnpackLongs(g_byData, g_nValues, nCount);
+    if (memcmp(nMacro, g_nValues, nCount * sizeof(long)))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+int main(int argc, char * argv[])
+//-------------------------------------------------------------------------------------------------
+// Time every kernel for every length
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nMinTimeNS = 200000000;
+  LONGLONG nStartNS;
+  LONGLONG nElapsedNS;
+  LONGLONG nCpuStartNS;
+  LONGLONG nCpuNS;
+  long     nIterations;
+  long     i, j, k;
+  char     chName[64];
+
+  if (argc > 1)
+    nMinTimeNS = (LONGLONG)(atof(argv[1]) * 1e9);
+
+  srand(1);
+  for (i = 0 ; i < (long)sizeof(g_byData) ; i++)
+    g_byData[i] = (BYTE)rand();
+
+  if (!CheckKernels())
+  {
+    printf("The kernels don't match the macros\n");
+    return 1;
+  }
+
+  printf("%-32s %12s %12s %12s %14s\n", "Benchmark", "Time", "CPU", "Iterations",
+         "bytes_per_second");
+  printf("--------------------------------------------------------------------------------"
+         "---------\n");
+
+  for (i = 0 ; i < (long)(sizeof(g_arrKernels) / sizeof(BenchKernel)) ; i++)
+  {
+    for (j = 0 ; j < (long)(sizeof(g_arrnCounts) / sizeof(long)) ; j++)
+    {
+      // Grow the iterations tenfold until the run is long enough, as Google Benchmark does
+      for (nIterations = 1 ; ; nIterations *= 10)
+      {
+        nCpuStartNS = BenchCpuTimeNS();
+        nStartNS    = O22GetTimeNS();
+        for (k = 0 ; k < nIterations ; k++)
+        {
+          g_arrKernels[i].pfnKernel(g_arrnCounts[j]);
+          BENCH_CLOBBER();
+        }
+        nElapsedNS = O22GetTimeNS() - nStartNS;
+        nCpuNS     = BenchCpuTimeNS() - nCpuStartNS;
+
+        if ((nElapsedNS >= nMinTimeNS) || (nIterations >= 1000000000))
+          break;
+      }
+
+      sprintf(chName, "%s/%ld", g_arrKernels[i].pchName, g_arrnCounts[j]);
+      printf("%-32s %9.1f ns %9.1f ns %12ld %12.2fG/s\n", chName,
+             (double)nElapsedNS / nIterations, (double)nCpuNS / nIterations, nIterations,
+             (double)g_arrnCounts[j] * 4 * nIterations / nCpuNS);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------------
+//
+// benchpipeline.cpp
+//
+// Step latency against the window of O22SnapIoMemMap::Transact().
+//
+// A step of the level plant is 19 quadlet transactions: 9 analog and 3
+// digital point reads, then 3 analog and 4 digital point writes. The step
+// runs against an O22SnapIoEmulator on the loopback, once with its responses
+// held for each latency given, with windows of 1 (stop-and-wait) to 19 (the
+// whole step in flight). With a latency L each step should take about 19 L
+// with a window of 1 and about L once the window covers the step.
+//
+//   benchpipeline [steps [latency_us ...]]
+//
+// Linux only; see the README for the build line.
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOEM.h"
+
+#include <stdlib.h>
+
+
+#define BENCH_PORT  23101
+
+
+static long g_arrnWindows[] = { 1, 2, 4, 8, 16, SIOMM_BENCH_STEP_LENGTH };
+
+
+int main(int argc, char * argv[])
+//-------------------------------------------------------------------------------------------------
+// Run the steps for every latency and window
+//-------------------------------------------------------------------------------------------------
+{
+  O22SnapIoEmulator Emulator;
+  O22SnapIoMemMap   Brain;
+  SIOMM_Transaction Step[SIOMM_BENCH_STEP_LENGTH];
+  BYTE              byData[SIOMM_BENCH_STEP_LENGTH][4];
+  LONGLONG          arrnLatenciesNS[16];
+  LONGLONG        * pnStepNS;
+  LONGLONG          nStartNS;
+  LONGLONG          nTotalNS;
+  LONGLONG          nOneNS = 0;
+  long              nLatencies = 0;
+  long              nSteps     = 2000;
+  long              nErrors;
+  long              nWindow;
+  long              i, j, k;
+  LONG              nResult;
+
+  if (argc > 1)
+    nSteps = atol(argv[1]);
+
+  for (i = 2 ; (i < argc) && (nLatencies < 16) ; i++)
+    arrnLatenciesNS[nLatencies++] = (LONGLONG)(atof(argv[i]) * 1000);
+
+  if (nLatencies == 0)
+  {
+    arrnLatenciesNS[nLatencies++] = 0;
+    arrnLatenciesNS[nLatencies++] = 200000;
+  }
+
+  if (nSteps < 1)
+    nSteps = 1;
+
+  pnStepNS = new LONGLONG[nSteps];
+
+  nResult = Emulator.Start(BENCH_PORT, SIOMM_TCP, 0);
+  if (nResult == SIOMM_OK)
+  {
+    nResult = Brain.OpenEnet((char*)"127.0.0.1", BENCH_PORT, 1000, 0);
+    if (nResult == SIOMM_OK)
+      nResult = Brain.WaitForOpen();
+  }
+
+  if (nResult != SIOMM_OK)
+  {
+    printf("Can't reach the emulator on port %d: %ld\n", BENCH_PORT, (long)nResult);
+    return 1;
+  }
+
+  O22BenchBuildPlantStep(Step, byData);
+
+  printf("%ld steps of %d quadlet transactions over TCP\n\n", nSteps, SIOMM_BENCH_STEP_LENGTH);
+  printf("latency_us  window   mean_us    p50_us    p99_us   speedup  errors\n");
+
+  for (i = 0 ; i < nLatencies ; i++)
+  {
+    Emulator.SetLatency(arrnLatenciesNS[i]);
+
+    for (j = 0 ; j < (long)(sizeof(g_arrnWindows) / sizeof(long)) ; j++)
+    {
+      nWindow = g_arrnWindows[j];
+      nErrors = 0;
+
+      // Warm up the connection and the caches
+      for (k = 0 ; k < 20 ; k++)
+        Brain.Transact(Step, SIOMM_BENCH_STEP_LENGTH, nWindow);
+
+      nTotalNS = 0;
+      for (k = 0 ; k < nSteps ; k++)
+      {
+        nStartNS = O22GetTimeNS();
+        if (Brain.Transact(Step, SIOMM_BENCH_STEP_LENGTH, nWindow) != SIOMM_OK)
+          nErrors++;
+        pnStepNS[k] = O22GetTimeNS() - nStartNS;
+        nTotalNS   += pnStepNS[k];
+      }
+
+      if (nWindow == 1)
+        nOneNS = nTotalNS;
+
+      printf("%10.0f  %6ld  %8.1f  %8.1f  %8.1f  %7.2fx  %6ld\n",
+             arrnLatenciesNS[i] / 1000.0, nWindow, nTotalNS / 1000.0 / nSteps,
+             O22BenchPercentile(pnStepNS, nSteps, 50) / 1000.0,
+             O22BenchPercentile(pnStepNS, nSteps, 99) / 1000.0,
+             (double)nOneNS / nTotalNS, nErrors);
+    }
+  }
+
+  Brain.Close();
+  Emulator.Stop();
+
+  delete [] pnStepNS;
+
+  return 0;
+}
@@ -0,0 +1,205 @@
+//-----------------------------------------------------------------------------
+//
+// benchstream.cpp
+//
+// Cost of finding the I/O unit of a stream packet, and of the timeout scan,
+// as the number of I/O units listened to grows up to SIOMM_STREAM_MAX_UNITS.
+//
+// For each number of units, an O22SnapIoStream listens to that many
+// addresses and the time of FindStreamItem() is measured for the addresses
+// listened to, in a scattered order, and for addresses that aren't. The
+// time of CheckStreamTimeouts() when nothing has timed out is measured too.
+// The same is done on a linked list of items like the one the class used
+// before its table, with the last packet kept in each item, as a baseline.
+//
+//   benchstream [lookups]
+//
+// Linux only; see the README for the build line.
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOST.h"
+
+#include <stdlib.h>
+
+
+#define BENCH_PORT           23104
+#define BENCH_FIRST_ADDRESS  0x7F010001  // 127.1.0.1, as opto22streamgen -s uses
+
+
+// An item of the linked list baseline
+struct BenchListItem
+{
+  DWORD                   nIpAddress;
+  DWORD                   nTimeoutMS;
+  DWORD                   nLastTickMS;
+  SIOMM_StreamCustomBlock LastBlock;
+  BenchListItem         * pNext;
+};
+
+
+// Gives the benchmark the protected lookup of the class
+class O22SnapIoStreamBench : public O22SnapIoStream {
+
+  public:
+    O22StreamItem * Find(DWORD nIpAddress) { return FindStreamItem(nIpAddress); }
+};
+
+
+static DWORD BenchTickMS()
+//-------------------------------------------------------------------------------------------------
+// The millisecond tick of the baseline's timeout scan
+//-------------------------------------------------------------------------------------------------
+{
+  return (DWORD)(O22GetTimeNS() / 1000000);
+}
+
+
+static BenchListItem * ListFind(BenchListItem * pList, DWORD nIpAddress)
+//-------------------------------------------------------------------------------------------------
+// The baseline lookup: walk the list
+//-------------------------------------------------------------------------------------------------
+{
+  while (pList && (pList->nIpAddress != nIpAddress))
+    pList = pList->pNext;
+
+  return pList;
+}
+
+
+static long ListCheckTimeouts(BenchListItem * pList)
+//-------------------------------------------------------------------------------------------------
+// The baseline timeout scan: walk the list again
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD nNow      = BenchTickMS();
+  long  nTimeOuts = 0;
+
+  for ( ; pList ; pList = pList->pNext)
+  {
+    if (nNow - pList->nLastTickMS > pList->nTimeoutMS)
+      nTimeOuts++;
+  }
+
+  return nTimeOuts;
+}
+
+
+int main(int argc, char * argv[])
+//-------------------------------------------------------------------------------------------------
+// Measure for 1 to SIOMM_STREAM_MAX_UNITS I/O units
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD           arrnAddresses[SIOMM_STREAM_MAX_UNITS];
+  DWORD         * pnOrder;
+  BenchListItem * pList;
+  BenchListItem * pItem;
+  char            chAddress[16];
+  LONGLONG        nStartNS;
+  double          dTableNS, dListNS, dTableMissNS, dListMissNS, dTableScanNS, dListScanNS;
+  long            nLookups = 1000000;
+  long            nScans;
+  long            nFound;
+  long            nUnits;
+  long            i;
+  LONG            nResult;
+
+  if (argc > 1)
+    nLookups = atol(argv[1]);
+
+  if (nLookups < 1)
+    nLookups = 1;
+
+  nScans  = nLookups / 10 + 1;
+  pnOrder = new DWORD[nLookups];
+
+  printf("%ld lookups, %ld timeout scans, times in ns\n\n", nLookups, nScans);
+  printf("units  find_table  find_list  miss_table  miss_list  scan_table  scan_list\n");
+
+  for (nUnits = 1 ; nUnits <= SIOMM_STREAM_MAX_UNITS ; nUnits *= 2)
+  {
+    O22SnapIoStreamBench Stream;
+
+    nResult = Stream.OpenStreaming(SIOMM_STREAM_TYPE_STANDARD, 0, BENCH_PORT);
+    if (nResult != SIOMM_OK)
+    {
+      printf("Can't open port %d: %ld\n", BENCH_PORT, (long)nResult);
+      return 1;
+    }
+
+    // The units, with timeouts long enough that none times out, and the baseline list
+    pList = NULL;
+    for (i = 0 ; i < nUnits ; i++)
+    {
+      arrnAddresses[i] = BENCH_FIRST_ADDRESS + i;
+      sprintf(chAddress, "127.1.%ld.%ld", (long)((arrnAddresses[i] >> 8) & 0xFF),
+              (long)(arrnAddresses[i] & 0xFF));
+      Stream.StartStreamListening(chAddress, 3600000);
+
+      pItem = new BenchListItem;
+      memset(pItem, 0, sizeof(BenchListItem));
+      pItem->nIpAddress  = arrnAddresses[i];
+      pItem->nTimeoutMS  = 3600000;
+      pItem->nLastTickMS = BenchTickMS();
+      pItem->pNext       = pList;
+      pList = pItem;
+    }
+
+    // Packets come from the units in no particular order
+    srand(1);
+    for (i = 0 ; i < nLookups ; i++)
+      pnOrder[i] = arrnAddresses[rand() % nUnits];
+
+    nFound   = 0;
+    nStartNS = O22GetTimeNS();
+    for (i = 0 ; i < nLookups ; i++)
+      nFound += (Stream.Find(pnOrder[i]) != NULL);
+    dTableNS = (double)(O22GetTimeNS() - nStartNS) / nLookups;
+
+    nStartNS = O22GetTimeNS();
+    for (i = 0 ; i < nLookups ; i++)
+      nFound += (ListFind(pList, pnOrder[i]) != NULL);
+    dListNS = (double)(O22GetTimeNS() - nStartNS) / nLookups;
+
+    // Packets from addresses nobody listens to
+    for (i = 0 ; i < nLookups ; i++)
+      pnOrder[i] += SIOMM_STREAM_MAX_UNITS;
+
+    nStartNS = O22GetTimeNS();
+    for (i = 0 ; i < nLookups ; i++)
+      nFound -= (Stream.Find(pnOrder[i]) != NULL);
+    dTableMissNS = (double)(O22GetTimeNS() - nStartNS) / nLookups;
+
+    nStartNS = O22GetTimeNS();
+    for (i = 0 ; i < nLookups ; i++)
+      nFound -= (ListFind(pList, pnOrder[i]) != NULL);
+    dListMissNS = (double)(O22GetTimeNS() - nStartNS) / nLookups;
+
+    nStartNS = O22GetTimeNS();
+    for (i = 0 ; i < nScans ; i++)
+      Stream.CheckStreamTimeouts();
+    dTableScanNS = (double)(O22GetTimeNS() - nStartNS) / nScans;
+
+    nStartNS = O22GetTimeNS();
+    for (i = 0 ; i < nScans ; i++)
+      nFound -= ListCheckTimeouts(pList);
+    dListScanNS = (double)(O22GetTimeNS() - nStartNS) / nScans;
+
+    printf("%5ld  %10.1f  %9.1f  %10.1f  %9.1f  %10.1f  %9.1f%s\n", nUnits, dTableNS, dListNS,
+           dTableMissNS, dListMissNS, dTableScanNS, dListScanNS,
+           (nFound == 2 * nLookups) ? "" : "  (lookups went wrong)");
+
+    while (pList)
+    {
+      pItem = pList->pNext;
+      delete pList;
+      pList = pItem;
+    }
+
+    Stream.CloseStreaming();
+  }
+
+  delete [] pnOrder;
+
+  return 0;
+}
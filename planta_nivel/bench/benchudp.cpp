@@ -0,0 +1,186 @@
+//-----------------------------------------------------------------------------
+//
+// benchudp.cpp
+//
+// Latency of O22SnapIoMemMap transactions over TCP and over UDP.
+//
+// Each operation runs many times against an O22SnapIoEmulator on the
+// loopback, first over TCP and then over UDP, and the mean, median and 99th
+// percentile of each call are reported. The emulator can hold its responses
+// for a latency, and over UDP drop one request in every N, to see what the
+// retransmissions cost. Timeouts adapt to the round trip time, with a floor
+// of 5 ms.
+//
+//   benchudp [calls [latency_us [drop_every]]]
+//
+// Linux only; see the README for the build line.
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOEM.h"
+
+#include <stdlib.h>
+
+
+#define BENCH_PORT  23103
+
+
+static SIOMM_AnaBank     g_AnaBank;
+static SIOMM_Transaction g_Step[SIOMM_BENCH_STEP_LENGTH];
+static BYTE              g_byStep[SIOMM_BENCH_STEP_LENGTH][4];
+
+
+// What one call of an operation does
+typedef LONG (*BenchOperation)(O22SnapIoMemMap * pBrain);
+
+static LONG ReadQuadOperation(O22SnapIoMemMap * pBrain)
+{
+  DWORD dwQuadlet;
+
+  return pBrain->ReadQuad(SIOMM_APOINT_READ_VALUE_BASE, &dwQuadlet);
+}
+
+static LONG WriteQuadOperation(O22SnapIoMemMap * pBrain)
+{
+  return pBrain->WriteQuad(SIOMM_APOINT_WRITE_VALUE_BASE, 0x3F800000);
+}
+
+static LONG GetAnaBankOperation(O22SnapIoMemMap * pBrain)
+{
+  return pBrain->GetAnaBankValuesEx(&g_AnaBank);
+}
+
+static LONG StepOneOperation(O22SnapIoMemMap * pBrain)
+{
+  return pBrain->Transact(g_Step, SIOMM_BENCH_STEP_LENGTH, 1);
+}
+
+static LONG StepAllOperation(O22SnapIoMemMap * pBrain)
+{
+  return pBrain->Transact(g_Step, SIOMM_BENCH_STEP_LENGTH, SIOMM_BENCH_STEP_LENGTH);
+}
+
+
+typedef struct BenchOperationItem
+{
+  const char   * pchName;
+  BenchOperation pfnOperation;
+} BenchOperationItem;
+
+static BenchOperationItem g_arrOperations[] =
+{
+  { "ReadQuad",            ReadQuadOperation },
+  { "WriteQuad",           WriteQuadOperation },
+  { "GetAnaBankValuesEx",  GetAnaBankOperation },
+  { "step, window 1",      StepOneOperation },
+  { "step, window 19",     StepAllOperation },
+};
+
+
+static void RunOperations(long nConnectionType, long nCalls, LONGLONG nLatencyNS,
+                          long nDropEvery, LONGLONG * pnCallNS)
+//-------------------------------------------------------------------------------------------------
+// Time every operation over one transport
+//-------------------------------------------------------------------------------------------------
+{
+  O22SnapIoEmulator Emulator;
+  O22SnapIoMemMap   Brain;
+  const char      * pchTransport = (nConnectionType == SIOMM_TCP) ? "TCP" : "UDP";
+  LONGLONG          nStartNS;
+  LONGLONG          nTotalNS;
+  long              nErrors;
+  long              nDrops;
+  long              i, j;
+  LONG              nResult;
+
+  nResult = Emulator.Start(BENCH_PORT, nConnectionType, nLatencyNS);
+  if (nResult == SIOMM_OK)
+  {
+    nResult = Brain.OpenEnet2((char*)"127.0.0.1", BENCH_PORT, 1000, 0, nConnectionType);
+    if (nResult == SIOMM_OK)
+      nResult = Brain.WaitForOpen();
+  }
+
+  if (nResult != SIOMM_OK)
+  {
+    printf("Can't reach the emulator on port %d: %ld\n", BENCH_PORT, (long)nResult);
+    return;
+  }
+
+  Brain.SetCommOptions(100, 0);
+  Brain.SetAdaptiveTimeOut(5000000);
+
+  // Drop nothing while warming up, so the round trip time is known
+  for (i = 0 ; i < (long)(sizeof(g_arrOperations) / sizeof(BenchOperationItem)) ; i++)
+  {
+    for (j = 0 ; j < 20 ; j++)
+      g_arrOperations[i].pfnOperation(&Brain);
+  }
+
+  if (nConnectionType == SIOMM_UDP)
+    Emulator.SetDropEvery(nDropEvery);
+
+  for (i = 0 ; i < (long)(sizeof(g_arrOperations) / sizeof(BenchOperationItem)) ; i++)
+  {
+    nErrors  = 0;
+    nTotalNS = 0;
+    nDrops   = Emulator.GetDropCount();
+
+    for (j = 0 ; j < nCalls ; j++)
+    {
+      nStartNS = O22GetTimeNS();
+      if (g_arrOperations[i].pfnOperation(&Brain) != SIOMM_OK)
+        nErrors++;
+      pnCallNS[j] = O22GetTimeNS() - nStartNS;
+      nTotalNS   += pnCallNS[j];
+    }
+
+    nDrops = Emulator.GetDropCount() - nDrops;
+
+    printf("%-9s %-20s %8.1f  %8.1f  %8.1f  %6ld  %6ld\n", pchTransport,
+           g_arrOperations[i].pchName, nTotalNS / 1000.0 / nCalls,
+           O22BenchPercentile(pnCallNS, nCalls, 50) / 1000.0,
+           O22BenchPercentile(pnCallNS, nCalls, 99) / 1000.0, nDrops, nErrors);
+  }
+
+  Brain.Close();
+  Emulator.Stop();
+}
+
+
+int main(int argc, char * argv[])
+//-------------------------------------------------------------------------------------------------
+// Time the operations over TCP, then over UDP
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG * pnCallNS;
+  LONGLONG   nLatencyNS = 0;
+  long       nCalls     = 5000;
+  long       nDropEvery = 0;
+
+  if (argc > 1)
+    nCalls = atol(argv[1]);
+  if (argc > 2)
+    nLatencyNS = (LONGLONG)(atof(argv[2]) * 1000);
+  if (argc > 3)
+    nDropEvery = atol(argv[3]);
+
+  if (nCalls < 1)
+    nCalls = 1;
+
+  O22BenchBuildPlantStep(g_Step, g_byStep);
+
+  pnCallNS = new LONGLONG[nCalls];
+
+  printf("%ld calls each, emulator latency %.0f us", nCalls, nLatencyNS / 1000.0);
+  if (nDropEvery)
+    printf(", UDP drops 1 request in %ld", nDropEvery);
+  printf("\n\ntransport operation             mean_us    p50_us    p99_us   drops  errors\n");
+
+  RunOperations(SIOMM_TCP, nCalls, nLatencyNS, nDropEvery, pnCallNS);
+  RunOperations(SIOMM_UDP, nCalls, nLatencyNS, nDropEvery, pnCallNS);
+
+  delete [] pnCallNS;
+
+  return 0;
+}
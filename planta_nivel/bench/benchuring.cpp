@@ -0,0 +1,273 @@
+//-----------------------------------------------------------------------------
+//
+// benchuring.cpp
+//
+// System calls and latency of a step, with the sockets and with the
+// io_uring backend of O22SnapIoMemMap, over TCP and UDP.
+//
+// The socket functions the class calls, and syscall(), which the ring uses
+// to enter the kernel, are wrapped here to count the calls made by the main
+// thread; the emulator's own calls aren't counted. Two steps are run
+// against an O22SnapIoEmulator on the loopback: a bank step, an analog bank
+// read and write of 256 bytes each, and the plant step of benchpipeline, 19
+// quadlet transactions, with a window of 19.
+//
+//   benchuring [steps]
+//
+// Linux only, built with -D_IO_URING for the ring; see the README for the
+// build line. Without the ring, or on a kernel without io_uring, its rows
+// say so.
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOEM.h"
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <dlfcn.h>
+#include <sys/select.h>
+
+
+#define BENCH_PORT  23105
+
+
+// System calls of the main thread, by kind
+static __thread BOOL t_bCount = FALSE;
+static long g_nSends    = 0;
+static long g_nReceives = 0;
+static long g_nWaits    = 0;
+static long g_nOptions  = 0;
+static long g_nRing     = 0;
+
+
+// Each wrapper counts the call and passes it on to the C library
+typedef ssize_t (*SendFunc)(int, const void *, size_t, int);
+typedef ssize_t (*SendMsgFunc)(int, const struct msghdr *, int);
+typedef int     (*SendMMsgFunc)(int, struct mmsghdr *, unsigned int, int);
+typedef ssize_t (*RecvFunc)(int, void *, size_t, int);
+typedef ssize_t (*RecvFromFunc)(int, void *, size_t, int, struct sockaddr *, socklen_t *);
+typedef ssize_t (*RecvMsgFunc)(int, struct msghdr *, int);
+typedef int     (*PPollFunc)(struct pollfd *, nfds_t, const struct timespec *, const sigset_t *);
+typedef int     (*SelectFunc)(int, fd_set *, fd_set *, fd_set *, struct timeval *);
+typedef int     (*SetSockOptFunc)(int, int, int, const void *, socklen_t);
+typedef long    (*SyscallFunc)(long, ...);
+
+#define BENCH_NEXT(type, name)  static type pfnNext = (type)dlsym(RTLD_NEXT, name)
+
+extern "C" ssize_t send(int nSocket, const void * pBuffer, size_t nLength, int nFlags)
+{
+  BENCH_NEXT(SendFunc, "send");
+  g_nSends += t_bCount;
+  return pfnNext(nSocket, pBuffer, nLength, nFlags);
+}
+
+extern "C" ssize_t sendmsg(int nSocket, const struct msghdr * pMessage, int nFlags)
+{
+  BENCH_NEXT(SendMsgFunc, "sendmsg");
+  g_nSends += t_bCount;
+  return pfnNext(nSocket, pMessage, nFlags);
+}
+
+extern "C" int sendmmsg(int nSocket, struct mmsghdr * pMessages, unsigned int nCount, int nFlags)
+{
+  BENCH_NEXT(SendMMsgFunc, "sendmmsg");
+  g_nSends += t_bCount;
+  return pfnNext(nSocket, pMessages, nCount, nFlags);
+}
+
+extern "C" ssize_t recv(int nSocket, void * pBuffer, size_t nLength, int nFlags)
+{
+  BENCH_NEXT(RecvFunc, "recv");
+  g_nReceives += t_bCount;
+  return pfnNext(nSocket, pBuffer, nLength, nFlags);
+}
+
+extern "C" ssize_t recvfrom(int nSocket, void * pBuffer, size_t nLength, int nFlags,
+                            struct sockaddr * pFrom, socklen_t * pnFromLength)
+{
+  BENCH_NEXT(RecvFromFunc, "recvfrom");
+  g_nReceives += t_bCount;
+  return pfnNext(nSocket, pBuffer, nLength, nFlags, pFrom, pnFromLength);
+}
+
+extern "C" ssize_t recvmsg(int nSocket, struct msghdr * pMessage, int nFlags)
+{
+  BENCH_NEXT(RecvMsgFunc, "recvmsg");
+  g_nReceives += t_bCount;
+  return pfnNext(nSocket, pMessage, nFlags);
+}
+
+extern "C" int ppoll(struct pollfd * pFds, nfds_t nFds, const struct timespec * pTimeOut,
+                     const sigset_t * pSigMask)
+{
+  BENCH_NEXT(PPollFunc, "ppoll");
+  g_nWaits += t_bCount;
+  return pfnNext(pFds, nFds, pTimeOut, pSigMask);
+}
+
+extern "C" int select(int nFds, fd_set * pRead, fd_set * pWrite, fd_set * pExcept,
+                      struct timeval * pTimeOut)
+{
+  BENCH_NEXT(SelectFunc, "select");
+  g_nWaits += t_bCount;
+  return pfnNext(nFds, pRead, pWrite, pExcept, pTimeOut);
+}
+
+extern "C" int setsockopt(int nSocket, int nLevel, int nOption, const void * pValue,
+                          socklen_t nLength) noexcept
+{
+  BENCH_NEXT(SetSockOptFunc, "setsockopt");
+  g_nOptions += t_bCount;
+  return pfnNext(nSocket, nLevel, nOption, pValue, nLength);
+}
+
+extern "C" long syscall(long nNumber, ...) noexcept
+{
+  BENCH_NEXT(SyscallFunc, "syscall");
+  va_list Args;
+  long    arrnArgs[6];
+  long    i;
+
+  va_start(Args, nNumber);
+  for (i = 0 ; i < 6 ; i++)
+    arrnArgs[i] = va_arg(Args, long);
+  va_end(Args);
+
+  g_nRing += t_bCount;
+  return pfnNext(nNumber, arrnArgs[0], arrnArgs[1], arrnArgs[2], arrnArgs[3], arrnArgs[4],
+                 arrnArgs[5]);
+}
+
+
+static SIOMM_Transaction g_BankStep[2];
+static BYTE              g_byBank[256];
+static SIOMM_Transaction g_PlantStep[SIOMM_BENCH_STEP_LENGTH];
+static BYTE              g_byPlant[SIOMM_BENCH_STEP_LENGTH][4];
+
+
+static void BuildSteps()
+//-------------------------------------------------------------------------------------------------
+// The bank step and the plant step
+//-------------------------------------------------------------------------------------------------
+{
+  memset(g_BankStep, 0, sizeof(g_BankStep));
+  g_BankStep[0].byTransactionCode = SIOMM_TCODE_READ_BLOCK_REQUEST;
+  g_BankStep[0].dwDestOffset      = SIOMM_ABANK_READ_POINT_VALUES;
+  g_BankStep[0].wDataLength       = sizeof(g_byBank);
+  g_BankStep[0].pbyData           = g_byBank;
+  g_BankStep[1].byTransactionCode = SIOMM_TCODE_WRITE_BLOCK_REQUEST;
+  g_BankStep[1].dwDestOffset      = SIOMM_ABANK_WRITE_POINT_VALUES;
+  g_BankStep[1].wDataLength       = sizeof(g_byBank);
+  g_BankStep[1].pbyData           = g_byBank;
+
+  O22BenchBuildPlantStep(g_PlantStep, g_byPlant);
+}
+
+
+static void RunSteps(long nConnectionType, long nBackend, long nSteps, LONGLONG * pnStepNS)
+//-------------------------------------------------------------------------------------------------
+// Count and time both steps over one transport and backend
+//-------------------------------------------------------------------------------------------------
+{
+  O22SnapIoEmulator   Emulator;
+  O22SnapIoMemMap     Brain;
+  SIOMM_Transaction * pStep;
+  const char        * pchTransport = (nConnectionType == SIOMM_TCP) ? "TCP" : "UDP";
+  const char        * pchBackend   = (nBackend == SIOMM_IO_URING) ? "io_uring" : "sockets";
+  const char        * pchStep;
+  LONGLONG            nStartNS;
+  LONGLONG            nTotalNS;
+  long                nCount;
+  long                nErrors;
+  long                i, j;
+  LONG                nResult;
+
+  nResult = Emulator.Start(BENCH_PORT, nConnectionType, 0);
+  if (nResult == SIOMM_OK)
+  {
+    nResult = Brain.OpenEnet2((char*)"127.0.0.1", BENCH_PORT, 1000, 0, nConnectionType);
+    if (nResult == SIOMM_OK)
+      nResult = Brain.WaitForOpen();
+  }
+
+  if (nResult != SIOMM_OK)
+  {
+    printf("Can't reach the emulator on port %d: %ld\n", BENCH_PORT, (long)nResult);
+    return;
+  }
+
+  if (Brain.SetIoBackend(nBackend) != SIOMM_OK)
+  {
+    printf("%-4s %-9s (not available: build with -D_IO_URING on Linux 5.11 or later)\n",
+           pchTransport, pchBackend);
+    return;
+  }
+
+  for (i = 0 ; i < 2 ; i++)
+  {
+    pStep   = (i == 0) ? g_BankStep : g_PlantStep;
+    nCount  = (i == 0) ? 2 : SIOMM_BENCH_STEP_LENGTH;
+    pchStep = (i == 0) ? "bank" : "plant";
+
+    for (j = 0 ; j < 50 ; j++)
+      Brain.Transact(pStep, nCount, nCount);
+
+    g_nSends = g_nReceives = g_nWaits = g_nOptions = g_nRing = 0;
+    nErrors  = 0;
+    nTotalNS = 0;
+
+    for (j = 0 ; j < nSteps ; j++)
+    {
+      nStartNS = O22GetTimeNS();
+      t_bCount = TRUE;
+      if (Brain.Transact(pStep, nCount, nCount) != SIOMM_OK)
+        nErrors++;
+      t_bCount = FALSE;
+      pnStepNS[j] = O22GetTimeNS() - nStartNS;
+      nTotalNS   += pnStepNS[j];
+    }
+
+    printf("%-4s %-9s %-6s %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f  %8.1f %8.1f %8.1f %6ld\n",
+           pchTransport, pchBackend, pchStep,
+           (double)(g_nSends + g_nReceives + g_nWaits + g_nOptions + g_nRing) / nSteps,
+           (double)g_nSends / nSteps, (double)g_nReceives / nSteps, (double)g_nWaits / nSteps,
+           (double)g_nOptions / nSteps, (double)g_nRing / nSteps, nTotalNS / 1000.0 / nSteps,
+           O22BenchPercentile(pnStepNS, nSteps, 50) / 1000.0,
+           O22BenchPercentile(pnStepNS, nSteps, 99) / 1000.0, nErrors);
+  }
+
+  Brain.Close();
+  Emulator.Stop();
+}
+
+
+int main(int argc, char * argv[])
+//-------------------------------------------------------------------------------------------------
+// Every transport with every backend
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG * pnStepNS;
+  long       nSteps = 5000;
+
+  if (argc > 1)
+    nSteps = atol(argv[1]);
+
+  if (nSteps < 1)
+    nSteps = 1;
+
+  BuildSteps();
+  pnStepNS = new LONGLONG[nSteps];
+
+  printf("%ld steps, system calls and microseconds per step\n\n", nSteps);
+  printf("%-22s%7s %7s %7s %7s %7s %7s  %8s %8s %8s %6s\n", "", "total", "send", "recv", "wait",
+         "sockopt", "ring", "mean_us", "p50_us", "p99_us", "errors");
+
+  RunSteps(SIOMM_TCP, SIOMM_IO_SOCKETS, nSteps, pnStepNS);
+  RunSteps(SIOMM_TCP, SIOMM_IO_URING,   nSteps, pnStepNS);
+  RunSteps(SIOMM_UDP, SIOMM_IO_SOCKETS, nSteps, pnStepNS);
+  RunSteps(SIOMM_UDP, SIOMM_IO_URING,   nSteps, pnStepNS);
+
+  delete [] pnStepNS;
+
+  return 0;
+}
@@ -0,0 +1,649 @@
+//-----------------------------------------------------------------------------
+//
+// opto22emu.cpp
+//
+// Source for the O22SnapIoEmulator C++ class, a SNAP Ethernet brain on the
+// loopback for the benchmarks in this directory. See O22SIOEM.h for usage.
+//
+// Linux only.
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOEM.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <poll.h>
+#include <netinet/tcp.h>
+#include <sys/prctl.h>
+
+
+#define EMU_MEMMAP_BASE  0xF0000000
+
+
+O22SnapIoEmulator::O22SnapIoEmulator()
+//-------------------------------------------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------------------------------------------
+{
+  m_ListenSocket    = INVALID_SOCKET;
+  m_Socket          = INVALID_SOCKET;
+  m_nConnectionType = SIOMM_TCP;
+  m_bThreadStarted  = FALSE;
+  m_bStop           = FALSE;
+  m_nLatencyNS      = 0;
+  m_nDropEvery      = 0;
+  m_nRequests       = 0;
+  m_nDrops          = 0;
+  m_pbyMemMap       = NULL;
+  m_nRecvLength     = 0;
+  m_nPendingFirst   = 0;
+  m_nPendingCount   = 0;
+}
+
+
+O22SnapIoEmulator::~O22SnapIoEmulator()
+//-------------------------------------------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------------------------------------------
+{
+  Stop();
+
+  if (m_pbyMemMap)
+    delete [] m_pbyMemMap;
+}
+
+
+LONG O22SnapIoEmulator::Start(long nPort, long nConnectionType, LONGLONG nLatencyNS)
+//-------------------------------------------------------------------------------------------------
+// Start answering requests on 127.0.0.1
+//-------------------------------------------------------------------------------------------------
+{
+  sockaddr_in Address;
+  SOCKET      Socket;
+  int         nOn = 1;
+  float       fValue;
+  DWORD       dwValue;
+  BYTE      * pbyValue;
+  long        k;
+
+  Stop();
+
+  if (m_pbyMemMap == NULL)
+  {
+    m_pbyMemMap = new BYTE[SIOMM_EMU_MEMMAP_SIZE];
+    if (m_pbyMemMap == NULL)
+      return SIOMM_ERROR_OUT_OF_MEMORY;
+
+    memset(m_pbyMemMap, 0, SIOMM_EMU_MEMMAP_SIZE);
+
+    // Analog point k reads k*1.5, in the bank and in its point read area
+    for (k = 0 ; k < 64 ; k++)
+    {
+      fValue = (float)(k * 1.5);
+      memcpy(&dwValue, &fValue, 4);
+      pbyValue = MemMapAt(SIOMM_ABANK_READ_POINT_VALUES + k*4, 4);
+      O22FILL_ARRAY_FROM_LONG(pbyValue, 0, dwValue);
+      pbyValue = MemMapAt(SIOMM_APOINT_READ_VALUE_BASE + k*SIOMM_APOINT_READ_BOUNDARY, 4);
+      O22FILL_ARRAY_FROM_LONG(pbyValue, 0, dwValue);
+    }
+  }
+
+  Socket = socket(AF_INET, nConnectionType, 0);
+  if (Socket < 0)
+    return SIOMM_ERROR_CREATING_SOCKET;
+
+  setsockopt(Socket, SOL_SOCKET, SO_REUSEADDR, &nOn, sizeof(nOn));
+
+  memset(&Address, 0, sizeof(Address));
+  Address.sin_family      = AF_INET;
+  Address.sin_port        = htons((WORD)nPort);
+  Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if ((bind(Socket, (sockaddr*)&Address, sizeof(Address)) != 0) ||
+      ((nConnectionType == SIOMM_TCP) && (listen(Socket, 1) != 0)))
+  {
+    close(Socket);
+    return SIOMM_ERROR_CREATING_SOCKET;
+  }
+
+  if (nConnectionType == SIOMM_TCP)
+    m_ListenSocket = Socket;
+  else
+    m_Socket = Socket;
+
+  m_nConnectionType = nConnectionType;
+  m_nLatencyNS      = nLatencyNS;
+  m_nRequests       = 0;
+  m_nDrops          = 0;
+  m_bStop           = FALSE;
+
+  if (pthread_create(&m_hThread, NULL, ThreadFunc, this) != 0)
+  {
+    Stop();
+    return SIOMM_ERROR;
+  }
+
+  m_bThreadStarted = TRUE;
+
+  return SIOMM_OK;
+}
+
+
+void O22SnapIoEmulator::Stop()
+//-------------------------------------------------------------------------------------------------
+// Stop the thread and close the sockets
+//-------------------------------------------------------------------------------------------------
+{
+  m_bStop = TRUE;
+
+  if (m_bThreadStarted)
+  {
+    pthread_join(m_hThread, NULL);
+    m_bThreadStarted = FALSE;
+  }
+
+  if (m_ListenSocket != INVALID_SOCKET)
+  {
+    close(m_ListenSocket);
+    m_ListenSocket = INVALID_SOCKET;
+  }
+
+  if (m_Socket != INVALID_SOCKET)
+  {
+    close(m_Socket);
+    m_Socket = INVALID_SOCKET;
+  }
+}
+
+
+void O22SnapIoEmulator::SetLatency(LONGLONG nLatencyNS)
+//-------------------------------------------------------------------------------------------------
+// How long each response is held after its request arrived
+//-------------------------------------------------------------------------------------------------
+{
+  m_nLatencyNS = nLatencyNS;
+}
+
+
+void O22SnapIoEmulator::SetDropEvery(long nDropEvery)
+//-------------------------------------------------------------------------------------------------
+// Over UDP, drop one request in every nDropEvery
+//-------------------------------------------------------------------------------------------------
+{
+  m_nDropEvery = nDropEvery;
+}
+
+
+long O22SnapIoEmulator::GetRequestCount()
+//-------------------------------------------------------------------------------------------------
+// How many requests have arrived since Start(), dropped or not
+//-------------------------------------------------------------------------------------------------
+{
+  return m_nRequests;
+}
+
+
+long O22SnapIoEmulator::GetDropCount()
+//-------------------------------------------------------------------------------------------------
+// How many requests have been dropped since Start()
+//-------------------------------------------------------------------------------------------------
+{
+  return m_nDrops;
+}
+
+
+void * O22SnapIoEmulator::ThreadFunc(void * pParam)
+//-------------------------------------------------------------------------------------------------
+// The emulator thread
+//-------------------------------------------------------------------------------------------------
+{
+  // Wake up on time for the responses, not up to 50 us late
+  prctl(PR_SET_TIMERSLACK, 1);
+
+  ((O22SnapIoEmulator*)pParam)->Serve();
+
+  return NULL;
+}
+
+
+void O22SnapIoEmulator::Serve()
+//-------------------------------------------------------------------------------------------------
+// Answer requests until Stop()
+//-------------------------------------------------------------------------------------------------
+{
+  pollfd PollFd;
+  int    nOn = 1;
+
+  if (m_nConnectionType == SIOMM_UDP)
+  {
+    ServeDatagrams();
+    return;
+  }
+
+  // One TCP connection at a time, like a brain with a single client
+  while (!m_bStop)
+  {
+    PollFd.fd      = m_ListenSocket;
+    PollFd.events  = POLLIN;
+    PollFd.revents = 0;
+
+    if (poll(&PollFd, 1, 50) <= 0)
+      continue;
+
+    m_Socket = accept(m_ListenSocket, NULL, NULL);
+    if (m_Socket < 0)
+    {
+      m_Socket = INVALID_SOCKET;
+      continue;
+    }
+
+    setsockopt(m_Socket, IPPROTO_TCP, TCP_NODELAY, &nOn, sizeof(nOn));
+
+    ServeConnection();
+
+    close(m_Socket);
+    m_Socket = INVALID_SOCKET;
+  }
+}
+
+
+void O22SnapIoEmulator::ServeConnection()
+//-------------------------------------------------------------------------------------------------
+// Answer the requests of a TCP connection until it closes or Stop()
+//-------------------------------------------------------------------------------------------------
+{
+  pollfd   PollFd;
+  timespec tsWait;
+  LONGLONG nNowNS;
+  LONGLONG nWaitNS;
+  long     nRequestLength;
+  long     nReceived;
+
+  m_nRecvLength   = 0;
+  m_nPendingFirst = 0;
+  m_nPendingCount = 0;
+
+  while (!m_bStop)
+  {
+    nNowNS = O22GetTimeNS();
+
+    if (!SendDueResponses(nNowNS))
+      return;
+
+    // Answer the whole requests received so far, while there is room for their responses
+    while (m_nPendingCount < SIOMM_EMU_MAX_PENDING)
+    {
+      nRequestLength = RequestLength(m_byRecv, m_nRecvLength);
+
+      if (nRequestLength < 0)
+        return;
+
+      if ((nRequestLength == 0) || (nRequestLength > m_nRecvLength))
+        break;
+
+      m_nRequests++;
+
+      if (!Answer(m_byRecv, nRequestLength, NULL, nNowNS))
+        return;
+
+      m_nRecvLength -= nRequestLength;
+      memmove(m_byRecv, m_byRecv + nRequestLength, m_nRecvLength);
+    }
+
+    if (!SendDueResponses(nNowNS))
+      return;
+
+    // Wait for more requests or for the next response to be due
+    nWaitNS = 50000000;
+    if (m_nPendingCount)
+    {
+      nWaitNS = NextDueTime() - nNowNS;
+      if (nWaitNS < 0)
+        nWaitNS = 0;
+    }
+
+    tsWait.tv_sec  = nWaitNS / 1000000000;
+    tsWait.tv_nsec = nWaitNS % 1000000000;
+
+    PollFd.fd      = m_Socket;
+    PollFd.events  = (m_nPendingCount < SIOMM_EMU_MAX_PENDING) ? POLLIN : 0;
+    PollFd.revents = 0;
+
+    if (ppoll(&PollFd, 1, &tsWait, NULL) <= 0)
+      continue;
+
+    if (PollFd.revents & (POLLERR | POLLHUP))
+      return;
+
+    nReceived = recv(m_Socket, m_byRecv + m_nRecvLength, sizeof(m_byRecv) - m_nRecvLength, 0);
+    if (nReceived <= 0)
+      return;
+
+    m_nRecvLength += nReceived;
+  }
+}
+
+
+void O22SnapIoEmulator::ServeDatagrams()
+//-------------------------------------------------------------------------------------------------
+// Answer the UDP requests until Stop(), one per datagram
+//-------------------------------------------------------------------------------------------------
+{
+  pollfd      PollFd;
+  timespec    tsWait;
+  sockaddr_in From;
+  socklen_t   nFromLength;
+  LONGLONG    nNowNS;
+  LONGLONG    nWaitNS;
+  long        nReceived;
+
+  m_nPendingFirst = 0;
+  m_nPendingCount = 0;
+
+  while (!m_bStop)
+  {
+    nNowNS = O22GetTimeNS();
+
+    SendDueResponses(nNowNS);
+
+    nWaitNS = 50000000;
+    if (m_nPendingCount)
+    {
+      nWaitNS = NextDueTime() - nNowNS;
+      if (nWaitNS < 0)
+        nWaitNS = 0;
+    }
+
+    tsWait.tv_sec  = nWaitNS / 1000000000;
+    tsWait.tv_nsec = nWaitNS % 1000000000;
+
+    PollFd.fd      = m_Socket;
+    PollFd.events  = (m_nPendingCount < SIOMM_EMU_MAX_PENDING) ? POLLIN : 0;
+    PollFd.revents = 0;
+
+    if (ppoll(&PollFd, 1, &tsWait, NULL) <= 0)
+      continue;
+
+    nFromLength = sizeof(From);
+    nReceived   = recvfrom(m_Socket, m_byRecv, sizeof(m_byRecv), 0, (sockaddr*)&From,
+                           &nFromLength);
+    if (nReceived <= 0)
+      continue;
+
+    nNowNS = O22GetTimeNS();
+    m_nRequests++;
+
+    if (m_nDropEvery && ((m_nRequests % m_nDropEvery) == 0))
+    {
+      m_nDrops++;
+      continue;
+    }
+
+    // A datagram holds exactly one request; anything else is ignored, like a brain would
+    if (RequestLength(m_byRecv, nReceived) == nReceived)
+      Answer(m_byRecv, nReceived, &From, nNowNS);
+  }
+}
+
+
+long O22SnapIoEmulator::RequestLength(BYTE * pbyRequest, long nLength)
+//-------------------------------------------------------------------------------------------------
+// The length of the request at the start of pbyRequest
+//-------------------------------------------------------------------------------------------------
+{
+  long nDataLength;
+
+  if (nLength < 4)
+    return 0;
+
+  switch (pbyRequest[3] >> 4)
+  {
+    case SIOMM_TCODE_READ_QUAD_REQUEST:
+      return SIOMM_SIZE_READ_QUAD_REQUEST;
+
+    case SIOMM_TCODE_WRITE_QUAD_REQUEST:
+      return SIOMM_SIZE_WRITE_QUAD_REQUEST;
+
+    case SIOMM_TCODE_READ_BLOCK_REQUEST:
+      return SIOMM_SIZE_READ_BLOCK_REQUEST;
+
+    case SIOMM_TCODE_WRITE_BLOCK_REQUEST:
+      if (nLength < 14)
+        return 0;
+
+      nDataLength = O22MAKEWORD(pbyRequest[12], pbyRequest[13]);
+      if (nDataLength > SIOMM_MAX_BLOCK_LENGTH)
+        return -1;
+
+      return SIOMM_SIZE_WRITE_BLOCK_REQUEST + nDataLength;
+  }
+
+  return -1;
+}
+
+
+BOOL O22SnapIoEmulator::Answer(BYTE * pbyRequest, long nLength, sockaddr_in * pFrom,
+                               LONGLONG nRecvTimeNS)
+//-------------------------------------------------------------------------------------------------
+// Carry out a request and queue its response
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_EmuResponse * pResponse;
+  BYTE              * pbyMemMap;
+  BYTE              * pbyFrame;
+  DWORD               dwOffset;
+  long                nDataLength;
+  long                nIndex;
+
+  if (m_nPendingCount >= SIOMM_EMU_MAX_PENDING)
+    return FALSE;
+
+  nIndex    = (m_nPendingFirst + m_nPendingCount) % SIOMM_EMU_MAX_PENDING;
+  pResponse = &m_arrPending[nIndex];
+  pbyFrame  = pResponse->byFrame;
+  dwOffset  = O22MAKELONG2(pbyRequest, 8);
+
+  // The header of the response: the label of the request, and an acknowledgment
+  memset(pbyFrame, 0, 16);
+  pbyFrame[0] = pbyRequest[4];
+  pbyFrame[1] = pbyRequest[5];
+  pbyFrame[2] = pbyRequest[2];
+  pbyFrame[4] = pbyRequest[0];
+  pbyFrame[5] = pbyRequest[1];
+
+  // Addresses outside the emulated map read as zeros and take no writes
+  switch (pbyRequest[3] >> 4)
+  {
+    case SIOMM_TCODE_READ_QUAD_REQUEST:
+      pbyFrame[3] = SIOMM_TCODE_READ_QUAD_RESPONSE << 4;
+      pbyMemMap = MemMapAt(dwOffset, 4);
+      if (pbyMemMap)
+        memcpy(pbyFrame + 12, pbyMemMap, 4);
+      pResponse->nLength = SIOMM_SIZE_READ_QUAD_RESPONSE;
+      break;
+
+    case SIOMM_TCODE_WRITE_QUAD_REQUEST:
+      pbyFrame[3] = SIOMM_TCODE_WRITE_RESPONSE << 4;
+      pbyMemMap = MemMapAt(dwOffset, 4);
+      if (pbyMemMap)
+        memcpy(pbyMemMap, pbyRequest + 12, 4);
+      pResponse->nLength = SIOMM_SIZE_WRITE_RESPONSE;
+      break;
+
+    case SIOMM_TCODE_READ_BLOCK_REQUEST:
+      nDataLength = O22MAKEWORD(pbyRequest[12], pbyRequest[13]);
+      if (nDataLength > SIOMM_MAX_BLOCK_LENGTH)
+        return FALSE;
+
+      pbyFrame[3]  = SIOMM_TCODE_READ_BLOCK_RESPONSE << 4;
+      pbyFrame[12] = pbyRequest[12];
+      pbyFrame[13] = pbyRequest[13];
+
+      // The data is padded to a whole number of quadlets
+      memset(pbyFrame + 16, 0, (nDataLength + 3) & ~3);
+      pbyMemMap = MemMapAt(dwOffset, nDataLength);
+      if (pbyMemMap)
+        memcpy(pbyFrame + 16, pbyMemMap, nDataLength);
+      pResponse->nLength = SIOMM_SIZE_READ_BLOCK_RESPONSE + ((nDataLength + 3) & ~3);
+      break;
+
+    case SIOMM_TCODE_WRITE_BLOCK_REQUEST:
+      nDataLength = O22MAKEWORD(pbyRequest[12], pbyRequest[13]);
+      if (SIOMM_SIZE_WRITE_BLOCK_REQUEST + nDataLength > nLength)
+        return FALSE;
+
+      pbyFrame[3] = SIOMM_TCODE_WRITE_RESPONSE << 4;
+      pbyMemMap = MemMapAt(dwOffset, nDataLength);
+      if (pbyMemMap)
+        memcpy(pbyMemMap, pbyRequest + SIOMM_SIZE_WRITE_BLOCK_REQUEST, nDataLength);
+      pResponse->nLength = SIOMM_SIZE_WRITE_RESPONSE;
+      break;
+
+    default:
+      return FALSE;
+  }
+
+  pResponse->nDueNS = nRecvTimeNS + m_nLatencyNS;
+  if (pFrom)
+    pResponse->To = *pFrom;
+
+  m_nPendingCount++;
+
+  return TRUE;
+}
+
+
+BOOL O22SnapIoEmulator::SendDueResponses(LONGLONG nNowNS)
+//-------------------------------------------------------------------------------------------------
+// Send the responses whose latency is over. Returns FALSE if the TCP connection failed.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_EmuResponse * pResponse;
+  long                nSent;
+  long                nResult;
+
+  while (m_nPendingCount)
+  {
+    pResponse = &m_arrPending[m_nPendingFirst];
+    if (pResponse->nDueNS > nNowNS)
+      break;
+
+    if (m_nConnectionType == SIOMM_UDP)
+    {
+      sendto(m_Socket, pResponse->byFrame, pResponse->nLength, 0,
+             (sockaddr*)&pResponse->To, sizeof(pResponse->To));
+    }
+    else
+    {
+      for (nSent = 0 ; nSent < pResponse->nLength ; nSent += nResult)
+      {
+        nResult = send(m_Socket, pResponse->byFrame + nSent, pResponse->nLength - nSent,
+                       MSG_NOSIGNAL);
+        if (nResult <= 0)
+          return FALSE;
+      }
+    }
+
+    m_nPendingFirst = (m_nPendingFirst + 1) % SIOMM_EMU_MAX_PENDING;
+    m_nPendingCount--;
+  }
+
+  return TRUE;
+}
+
+
+LONGLONG O22SnapIoEmulator::NextDueTime()
+//-------------------------------------------------------------------------------------------------
+// When the next response is due. Only valid while there are responses pending.
+//-------------------------------------------------------------------------------------------------
+{
+  return m_arrPending[m_nPendingFirst].nDueNS;
+}
+
+
+BYTE * O22SnapIoEmulator::MemMapAt(DWORD dwOffset, long nLength)
+//-------------------------------------------------------------------------------------------------
+// Where the emulated memory map keeps the given range, or NULL if it is outside the map
+//-------------------------------------------------------------------------------------------------
+{
+  if ((dwOffset < EMU_MEMMAP_BASE) ||
+      (dwOffset - EMU_MEMMAP_BASE + nLength > SIOMM_EMU_MEMMAP_SIZE))
+    return NULL;
+
+  return m_pbyMemMap + (dwOffset - EMU_MEMMAP_BASE);
+}
+
+
+static int O22BenchCompare(const void * pA, const void * pB)
+//-------------------------------------------------------------------------------------------------
+// Order for qsort()
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nA = *(const LONGLONG*)pA;
+  LONGLONG nB = *(const LONGLONG*)pB;
+
+  return (nA > nB) - (nA < nB);
+}
+
+
+LONGLONG O22BenchPercentile(LONGLONG * pnValues, long nCount, double dPercent)
+//-------------------------------------------------------------------------------------------------
+// The value that dPercent % of pnValues don't exceed. Sorts pnValues.
+//-------------------------------------------------------------------------------------------------
+{
+  long nIndex;
+
+  if (nCount <= 0)
+    return 0;
+
+  qsort(pnValues, nCount, sizeof(LONGLONG), O22BenchCompare);
+
+  nIndex = (long)(dPercent * nCount / 100.0);
+  if (nIndex >= nCount)
+    nIndex = nCount - 1;
+
+  return pnValues[nIndex];
+}
+
+
+void O22BenchBuildPlantStep(SIOMM_Transaction * pStep, BYTE (*pbyData)[4])
+//-------------------------------------------------------------------------------------------------
+// The plant step: 9 analog and 3 digital point reads, then 3 analog and 4 digital point writes,
+// each with its own quadlet of pbyData
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  memset(pStep, 0, SIOMM_BENCH_STEP_LENGTH * sizeof(SIOMM_Transaction));
+
+  for (i = 0 ; i < SIOMM_BENCH_STEP_LENGTH ; i++)
+  {
+    pStep[i].wDataLength = 4;
+    pStep[i].pbyData     = pbyData[i];
+
+    if (i < 9)
+    {
+      pStep[i].byTransactionCode = SIOMM_TCODE_READ_QUAD_REQUEST;
+      pStep[i].dwDestOffset      = SIOMM_APOINT_READ_VALUE_BASE + i*SIOMM_APOINT_READ_BOUNDARY;
+    }
+    else if (i < 12)
+    {
+      pStep[i].byTransactionCode = SIOMM_TCODE_READ_QUAD_REQUEST;
+      pStep[i].dwDestOffset      = SIOMM_DPOINT_READ_STATE + (i - 9)*SIOMM_DPOINT_READ_BOUNDARY;
+    }
+    else if (i < 15)
+    {
+      pStep[i].byTransactionCode = SIOMM_TCODE_WRITE_QUAD_REQUEST;
+      pStep[i].dwDestOffset      = SIOMM_APOINT_WRITE_VALUE_BASE +
+                                   (i - 12 + 16)*SIOMM_APOINT_WRITE_BOUNDARY;
+    }
+    else
+    {
+      pStep[i].byTransactionCode = SIOMM_TCODE_WRITE_QUAD_REQUEST;
+      pStep[i].dwDestOffset      = SIOMM_DPOINT_WRITE_TURN_ON_BASE +
+                                   (i - 15 + 4)*SIOMM_DPOINT_WRITE_BOUNDARY;
+      O22FILL_ARRAY_FROM_LONG(pbyData[i], 0, 1);
+    }
+  }
+}
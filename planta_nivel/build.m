@@ -1 +1 @@
-mex -lWSock32 -Iinclude src/SPlantaNivel.cpp src/opto22snap.cpp
\ No newline at end of file
+mex -lws2_32 -Iinclude src/SPlantaNivel.cpp src/opto22snap.cpp src/opto22stream.cpp src/opto22shadow.cpp src/opto22plan.cpp src/opto22ring.cpp src/opto22async.cpp
\ No newline at end of file
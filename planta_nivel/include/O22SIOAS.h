@@ -0,0 +1,340 @@
+//-------------------------------------------------------------------------------------------------
+//
+// O22SIOAS.h
+//
+// Header for the O22SnapIoEventLoop, O22SnapIoAsync and O22SnapIoTask C++ classes.
+//
+// These classes let C++20 coroutines read and write Opto 22 SNAP Ethernet I/O units without
+// blocking, so that many transactions, on one I/O unit or several, are in flight at the same
+// time while the code that uses them still reads in order. An O22SnapIoEventLoop waits for the
+// responses of every I/O unit at once, on one thread. An O22SnapIoAsync gives an
+// O22SnapIoMemMap functions that return an O22SnapIoTask instead of waiting; co_await on the
+// task gives the same LONG result as the O22SnapIoMemMap function of the same name.
+//
+// The basic procedure for using these classes is:
+//
+//   1. Create and open an instance of the O22SnapIoMemMap class for each I/O unit.
+//   2. Create an O22SnapIoEventLoop, and an O22SnapIoAsync for each O22SnapIoMemMap.
+//   3. Write the control code as coroutines that return O22SnapIoTask, for example
+//
+//        O22SnapIoTask ReadBoth(O22SnapIoAsync & Unit1, O22SnapIoAsync & Unit2,
+//                               SIOMM_AnaBank * pBank1, SIOMM_AnaBank * pBank2)
+//        {
+//          O22SnapIoTask Read1 = Unit1.GetAnaBankValuesEx(pBank1); // both are sent now
+//          O22SnapIoTask Read2 = Unit2.GetAnaBankValuesEx(pBank2);
+//          LONG nResult1 = co_await Read1;
+//          LONG nResult2 = co_await Read2;
+//          co_return (SIOMM_OK != nResult1) ? nResult1 : nResult2;
+//        }
+//
+//   4. Run a task with O22SnapIoEventLoop::Run(), which returns when it is done.
+//
+// Tasks start as soon as they are created and run until they first wait, so creating several
+// tasks before waiting on any puts all their transactions in flight together. A task can be
+// waited on once. Pointer arguments must stay valid until the task is done.
+//
+// The O22SnapIoMemMap functions still work as before, but they must not be called on an I/O
+// unit while a task has transactions outstanding on it. Transactions are tried again as by
+// O22SnapIoMemMap::Transact(): lost UDP requests are sent again, and reads that time out or find
+// the I/O unit busy are tried again as set with SetCommOptions(). A timeout is only returned
+// once those tries are used up.
+//
+// These classes need a compiler with C++20 coroutines. The rest of the toolkit doesn't.
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef __O22SIOAS_H_
+#define __O22SIOAS_H_
+
+
+#ifndef __O22SIOMM_H_
+#include "O22SIOMM.h"
+#endif
+
+#if !defined(__cpp_impl_coroutine)
+#error O22SIOAS.h needs a compiler with C++20 coroutines
+#endif
+
+#include <coroutine>
+
+
+// The most I/O units an O22SnapIoEventLoop waits on at once. Transactions for others wait
+// until one of these has none outstanding.
+#define SIOMM_LOOP_MAX_CONNECTIONS  64
+
+
+class O22SnapIoEventLoop;
+
+
+class O22SnapIoTask {
+
+  public:
+  // Public data
+
+    // The coroutine side of the task
+    struct promise_type
+    {
+      LONG                    m_nResult = SIOMM_ERROR;
+      std::coroutine_handle<> m_Continuation;  // The coroutine waiting on this one, if any
+
+      struct FinalAwaiter
+      {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> Handle) noexcept;
+        void await_resume() noexcept {}
+      };
+
+      O22SnapIoTask get_return_object();
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      FinalAwaiter final_suspend() noexcept { return {}; }
+      void return_value(LONG nResult) { m_nResult = nResult; }
+      void unhandled_exception() { m_nResult = SIOMM_ERROR; }
+    };
+
+    // Public Construction/Destruction
+    O22SnapIoTask(O22SnapIoTask && Other);
+    ~O22SnapIoTask();
+
+  // Public Members
+
+    BOOL IsDone();
+    LONG GetResult();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Checks whether the task is done, and gets its result once it is.
+    //---------------------------------------------------------------------------------------------
+
+    // For co_await
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> Continuation);
+    LONG await_resume();
+
+
+  protected:
+    // Protected data
+    std::coroutine_handle<promise_type> m_Handle;
+
+    // Protected Members
+    explicit O22SnapIoTask(std::coroutine_handle<promise_type> Handle);
+    O22SnapIoTask(const O22SnapIoTask &) = delete;
+    O22SnapIoTask & operator=(const O22SnapIoTask &) = delete;
+};
+
+
+class O22SnapIoTransactAwaiter {
+  // What co_await waits on for a batch of transactions on one I/O unit. Used by O22SnapIoAsync.
+
+  public:
+  // Public data
+
+    // Public Construction/Destruction
+    O22SnapIoTransactAwaiter(O22SnapIoEventLoop * pLoop, O22SnapIoMemMap * pMemMap,
+                             SIOMM_Transaction * pTransactions, long nCount);
+    ~O22SnapIoTransactAwaiter();
+
+  // Public Members
+
+    // For co_await. The result is the first error of the transactions, which may be
+    // SIOMM_TRANSACTION_NAK, or SIOMM_OK.
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> Handle);
+    LONG await_resume();
+
+
+  protected:
+    // Protected data
+    friend class O22SnapIoEventLoop;
+
+    O22SnapIoEventLoop       * m_pLoop;
+    O22SnapIoMemMap          * m_pMemMap;
+    SIOMM_Transaction        * m_pTransactions;
+    long                       m_nCount;
+    long                       m_nBegun;      // Transactions given to BeginTransact() so far
+    std::coroutine_handle<>    m_Handle;      // The coroutine to resume when they're all done
+    O22SnapIoTransactAwaiter * m_pNext;       // The loop's list of waiting awaiters
+    O22SnapIoTransactAwaiter * m_pPrev;
+    BOOL                       m_bWaiting;    // Set while on the list
+
+    // Protected Members
+    BOOL IsFinished();
+};
+
+
+class O22SnapIoEventLoop {
+
+  public:
+  // Public data
+
+    // Public Construction/Destruction
+    O22SnapIoEventLoop();
+    ~O22SnapIoEventLoop();
+
+  // Public Members
+
+    LONG Run(O22SnapIoTask & Task);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Sends the requests of the waiting tasks and completes them as their responses
+    //           arrive, on every I/O unit at once, until the task is done. Other tasks make
+    //           progress too.
+    //  Input  : Task - the task to run until done.
+    //  Output : none
+    //  Returns: The task's result, or SIOMM_ERROR if it waits on something other than
+    //           transactions of this loop, so that it would never be done.
+    //---------------------------------------------------------------------------------------------
+
+
+  protected:
+    // Protected data
+    friend class O22SnapIoTransactAwaiter;
+
+    // The awaiters with transactions not yet done, in the order they started waiting
+    O22SnapIoTransactAwaiter * m_pFirstWaiter;
+    O22SnapIoTransactAwaiter * m_pLastWaiter;
+
+    // The I/O units with transactions outstanding
+    O22SnapIoMemMap *          m_arrpConnections[SIOMM_LOOP_MAX_CONNECTIONS];
+    long                       m_nConnections;
+
+    // Protected Members
+    void AddWaiter(O22SnapIoTransactAwaiter * pWaiter);
+    void RemoveWaiter(O22SnapIoTransactAwaiter * pWaiter);
+    BOOL AddConnection(O22SnapIoMemMap * pMemMap);
+    void BeginWaiters();
+    void WaitForConnections();
+    BOOL ResumeFinishedWaiter();
+};
+
+
+class O22SnapIoAsync {
+
+  public:
+  // Public data
+
+    // Public Construction/Destruction
+    O22SnapIoAsync(O22SnapIoEventLoop * pLoop, O22SnapIoMemMap * pMemMap);
+    ~O22SnapIoAsync();
+
+  // Public Members
+
+    O22SnapIoTask Transact(SIOMM_Transaction * pTransactions, long nCount);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Performs several transactions, all outstanding at the same time, like
+    //           O22SnapIoMemMap::Transact(). Rejected requests get the I/O unit's error code,
+    //           and reads are tried again the same way.
+    //  Input  : pTransactions - array of transactions to perform, in order.
+    //           nCount - number of items in pTransactions. Batches of more than
+    //                    SIOMM_MAX_TRANSACTION_LABELS are sent in parts.
+    //  Output : pTransactions - nResult is set for every item, as by
+    //                           O22SnapIoMemMap::Transact().
+    //  Returns: A task whose result is SIOMM_OK if every transaction is OK, otherwise the first
+    //           error found.
+    //---------------------------------------------------------------------------------------------
+
+    // The same as the O22SnapIoMemMap functions of the same name
+    O22SnapIoTask ReadQuad(DWORD dwDestOffset, DWORD * pdwQuadlet);
+    O22SnapIoTask WriteQuad(DWORD dwDestOffset, DWORD dwQuadlet);
+    O22SnapIoTask ReadFloat(DWORD dwDestOffset, float * pfValue);
+    O22SnapIoTask WriteFloat(DWORD dwDestOffset, float fValue);
+    O22SnapIoTask ReadBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData);
+    O22SnapIoTask WriteBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData);
+
+    O22SnapIoTask GetAnaPtValue(long nPoint, float *pfValue);
+    O22SnapIoTask SetAnaPtValue(long nPoint, float fValue);
+    O22SnapIoTask GetAnaBankValuesEx(SIOMM_AnaBank * pBankData);
+    O22SnapIoTask SetAnaBankValuesEx(SIOMM_AnaBank BankData);
+    O22SnapIoTask GetDigBankPointStates(long *pnPts63to32, long *pnPts31to0);
+    O22SnapIoTask SetDigBankPointStates(long nPts63to32, long nPts31to0,
+                                        long nMask63to32, long nMask31to0);
+
+    // Typed functions for the fields described in O22SIOMD.h
+    template <class Field> O22SnapIoTask Read(long nPoint, typename Field::Type * pValue);
+    template <class Field> O22SnapIoTask Write(long nPoint, typename Field::Type Value);
+    template <class Field, long nFirst = 0, long nCount = Field::Points>
+    O22SnapIoTask ReadRange(typename Field::Type * pValues);
+    template <class Field, long nFirst = 0, long nCount = Field::Points>
+    O22SnapIoTask WriteRange(const typename Field::Type * pValues);
+
+    O22SnapIoMemMap * GetMemMap();
+
+
+  protected:
+    // Protected data
+    O22SnapIoEventLoop * m_pLoop;
+    O22SnapIoMemMap    * m_pMemMap;
+};
+
+
+template <class Field>
+O22SnapIoTask O22SnapIoAsync::Read(long nPoint, typename Field::Type * pValue)
+//-------------------------------------------------------------------------------------------------
+// Read a field of a point
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_READ, "field can't be read");
+
+  LONG  nResult;   // for checking the return values of functions
+  DWORD dwQuadlet; // the quadlet read
+
+  if ((nPoint < 0) || (nPoint >= Field::Points))
+    co_return SIOMM_ERROR;
+
+  nResult = co_await ReadQuad(Field::Address(nPoint), &dwQuadlet);
+  if (SIOMM_OK == nResult)
+    *pValue = Field::Codec::FromQuad(dwQuadlet);
+
+  co_return nResult;
+}
+
+
+template <class Field>
+O22SnapIoTask O22SnapIoAsync::Write(long nPoint, typename Field::Type Value)
+//-------------------------------------------------------------------------------------------------
+// Write a field of a point
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_WRITE, "field can't be written");
+
+  if ((nPoint < 0) || (nPoint >= Field::Points))
+    co_return SIOMM_ERROR;
+
+  co_return co_await WriteQuad(Field::Address(nPoint), Field::Codec::ToQuad(Value));
+}
+
+
+template <class Field, long nFirst, long nCount>
+O22SnapIoTask O22SnapIoAsync::ReadRange(typename Field::Type * pValues)
+//-------------------------------------------------------------------------------------------------
+// Read a range of points of a packed field with one block
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_READ, "field can't be read");
+  typedef O22MemMapRange<Field, nFirst, nCount> Range;
+
+  LONG nResult;                    // for checking the return values of functions
+  BYTE arrbyData[Range::Length];   // buffer for the data read
+
+  nResult = co_await ReadBlock(Range::Address, Range::Length, arrbyData);
+  if (SIOMM_OK == nResult)
+    Field::Codec::Unpack(arrbyData, pValues, nCount);
+
+  co_return nResult;
+}
+
+
+template <class Field, long nFirst, long nCount>
+O22SnapIoTask O22SnapIoAsync::WriteRange(const typename Field::Type * pValues)
+//-------------------------------------------------------------------------------------------------
+// Write a range of points of a packed field with one block
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_WRITE, "field can't be written");
+  typedef O22MemMapRange<Field, nFirst, nCount> Range;
+
+  BYTE arrbyData[Range::Length];   // buffer for the data to be written
+
+  Field::Codec::Pack(pValues, arrbyData, nCount);
+
+  co_return co_await WriteBlock(Range::Address, Range::Length, arrbyData);
+}
+
+
+#endif // __O22SIOAS_H_
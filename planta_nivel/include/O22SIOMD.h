@@ -0,0 +1,190 @@
+//-------------------------------------------------------------------------------------------------
+//
+// O22SIOMD.h
+//
+// Descriptors of the fields of the memory map of an Opto 22 SNAP Ethernet I/O unit.
+//
+// Each descriptor is a type that knows, at compile time, where a field is, how far apart the
+// quadlets of consecutive points are, what type the quadlet holds and whether it can be read or
+// written. The quadlets of the memory map are always big-endian. O22SnapIoMemMap::Read(),
+// Write(), ReadRange() and WriteRange() take a descriptor as a template argument, for example
+//
+//   Brain.Read<O22AnaPtValue>(nPoint, &fValue);       // point checked when called
+//   Brain.Read<O22AnaPtValue, 3>(&fValue);            // point checked when compiled
+//   Brain.ReadRange<O22AnaBankValues>(arrfValues);    // all 64 points, one block
+//
+// so the address arithmetic and byte packing are written once, here. The descriptors are built
+// from the SIOMM_* addresses in O22SIOMM.h, which remain for the existing functions.
+//
+// This header is included by O22SIOMM.h, after the SIOMM_* addresses. The descriptors need a
+// compiler with C++11 (static_assert and constexpr).
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef __O22SIOMD_H_
+#define __O22SIOMD_H_
+
+
+#ifndef __O22SIOUT_H_
+#include "O22SIOUT.h"
+#endif
+
+
+// Access of a field
+#define SIOMM_FIELD_READ   0x01
+#define SIOMM_FIELD_WRITE  0x02
+
+// Every field has a quadlet for each of the 64 points of an I/O unit
+#define SIOMM_FIELD_POINTS 64
+
+
+// Conversion between a quadlet of the memory map and the type of a field
+template <typename T> struct O22QuadCodec;
+
+template <> struct O22QuadCodec<float>
+{
+  static float FromQuad(DWORD dwQuadlet)
+  {
+    float fValue;
+    memcpy(&fValue, &dwQuadlet, 4);
+    return fValue;
+  }
+
+  static DWORD ToQuad(float fValue)
+  {
+    DWORD dwQuadlet = 0;
+    memcpy(&dwQuadlet, &fValue, 4);
+    return dwQuadlet;
+  }
+
+  static void Unpack(const BYTE * pbyData, float * pfValues, long nCount)
+  {
+    O22UnpackFloats(pbyData, pfValues, nCount);
+  }
+
+  static void Pack(const float * pfValues, BYTE * pbyData, long nCount)
+  {
+    O22PackFloats(pfValues, pbyData, nCount);
+  }
+};
+
+template <> struct O22QuadCodec<long>
+{
+  static long FromQuad(DWORD dwQuadlet)
+  {
+    return (long)dwQuadlet;
+  }
+
+  static DWORD ToQuad(long nValue)
+  {
+    return (DWORD)nValue;
+  }
+
+  static void Unpack(const BYTE * pbyData, long * pnValues, long nCount)
+  {
+    O22UnpackLongs(pbyData, pnValues, nCount);
+  }
+
+  static void Pack(const long * pnValues, BYTE * pbyData, long nCount)
+  {
+    for (long i = 0 ; i < nCount ; i++)
+    {
+      O22FILL_ARRAY_FROM_LONG(pbyData, i*4, pnValues[i]);
+    }
+  }
+};
+
+
+// A field of the memory map: a quadlet of type T for each point, dwStride bytes apart from
+// dwBase. nAccess is SIOMM_FIELD_READ, SIOMM_FIELD_WRITE or both.
+template <DWORD dwBase, DWORD dwStride, typename T, long nAccess>
+struct O22MemMapField
+{
+  typedef T               Type;
+  typedef O22QuadCodec<T> Codec;
+
+  static const DWORD Base   = dwBase;
+  static const DWORD Stride = dwStride;
+  static const long  Access = nAccess;
+  static const long  Points = SIOMM_FIELD_POINTS;
+
+  // TRUE when the quadlets of consecutive points are next to each other, so that a range of
+  // points is one block
+  static const BOOL  Packed = (dwStride == 4);
+
+  static_assert((dwBase % 4) == 0, "memory map fields are quadlet aligned");
+  static_assert(dwStride >= 4,     "the quadlets of a field can't overlap");
+
+  static constexpr DWORD Address(long nPoint) { return dwBase + dwStride * nPoint; }
+};
+
+
+// The address of a point of a field, checked when compiled
+template <class Field, long nPoint>
+struct O22MemMapPoint
+{
+  static_assert((nPoint >= 0) && (nPoint < Field::Points), "point out of range");
+
+  static const DWORD Address = Field::Base + Field::Stride * nPoint;
+};
+
+
+// A range of points of a packed field, checked when compiled. Length is the size of the block
+// that holds it, so batches of ranges can be sized when compiled too.
+template <class Field, long nFirst, long nCount>
+struct O22MemMapRange
+{
+  static_assert(Field::Packed, "only packed fields can be read or written as a range");
+  static_assert((nFirst >= 0) && (nCount > 0) && (nFirst + nCount <= Field::Points),
+                "range out of bounds");
+
+  static const DWORD Address = Field::Base + 4 * nFirst;
+  static const WORD  Length  = (WORD)(4 * nCount);
+};
+
+
+// Analog point read area
+typedef O22MemMapField<SIOMM_APOINT_READ_VALUE_BASE,     SIOMM_APOINT_READ_BOUNDARY,  float, SIOMM_FIELD_READ>  O22AnaPtValue;
+typedef O22MemMapField<SIOMM_APOINT_READ_COUNTS_BASE,    SIOMM_APOINT_READ_BOUNDARY,  float, SIOMM_FIELD_READ>  O22AnaPtCounts;
+typedef O22MemMapField<SIOMM_APOINT_READ_MIN_VALUE_BASE, SIOMM_APOINT_READ_BOUNDARY,  float, SIOMM_FIELD_READ>  O22AnaPtMinValue;
+typedef O22MemMapField<SIOMM_APOINT_READ_MAX_VALUE_BASE, SIOMM_APOINT_READ_BOUNDARY,  float, SIOMM_FIELD_READ>  O22AnaPtMaxValue;
+
+// Analog point write area
+typedef O22MemMapField<SIOMM_APOINT_WRITE_VALUE_BASE,    SIOMM_APOINT_WRITE_BOUNDARY, float, SIOMM_FIELD_WRITE> O22AnaPtWriteValue;
+typedef O22MemMapField<SIOMM_APOINT_WRITE_COUNTS_BASE,   SIOMM_APOINT_WRITE_BOUNDARY, float, SIOMM_FIELD_WRITE> O22AnaPtWriteCounts;
+
+// Digital point read area
+typedef O22MemMapField<SIOMM_DPOINT_READ_STATE,          SIOMM_DPOINT_READ_BOUNDARY,  long,  SIOMM_FIELD_READ>  O22DigPtState;
+typedef O22MemMapField<SIOMM_DPOINT_READ_ONLATCH_STATE,  SIOMM_DPOINT_READ_BOUNDARY,  long,  SIOMM_FIELD_READ>  O22DigPtOnLatch;
+typedef O22MemMapField<SIOMM_DPOINT_READ_OFFLATCH_STATE, SIOMM_DPOINT_READ_BOUNDARY,  long,  SIOMM_FIELD_READ>  O22DigPtOffLatch;
+typedef O22MemMapField<SIOMM_DPOINT_READ_ACTIVE_COUNTER, SIOMM_DPOINT_READ_BOUNDARY,  long,  SIOMM_FIELD_READ>  O22DigPtActiveCounter;
+typedef O22MemMapField<SIOMM_DPOINT_READ_COUNTER_DATA,   SIOMM_DPOINT_READ_BOUNDARY,  long,  SIOMM_FIELD_READ>  O22DigPtCounterData;
+
+// Digital point write area. Writing a non-zero value acts once.
+typedef O22MemMapField<SIOMM_DPOINT_WRITE_TURN_ON_BASE,  SIOMM_DPOINT_WRITE_BOUNDARY, long,  SIOMM_FIELD_WRITE> O22DigPtTurnOn;
+typedef O22MemMapField<SIOMM_DPOINT_WRITE_TURN_OFF_BASE, SIOMM_DPOINT_WRITE_BOUNDARY, long,  SIOMM_FIELD_WRITE> O22DigPtTurnOff;
+
+// Point configuration area
+typedef O22MemMapField<SIOMM_POINT_CONFIG_READ_MOD_TYPE_BASE,     SIOMM_POINT_CONFIG_BOUNDARY, long,  SIOMM_FIELD_READ> O22PtModuleType;
+typedef O22MemMapField<SIOMM_POINT_CONFIG_WRITE_TYPE_BASE,        SIOMM_POINT_CONFIG_BOUNDARY, long,  SIOMM_FIELD_READ | SIOMM_FIELD_WRITE> O22PtType;
+typedef O22MemMapField<SIOMM_POINT_CONFIG_WRITE_FEATURE_BASE,     SIOMM_POINT_CONFIG_BOUNDARY, long,  SIOMM_FIELD_READ | SIOMM_FIELD_WRITE> O22PtFeature;
+typedef O22MemMapField<SIOMM_POINT_CONFIG_WRITE_OFFSET_BASE,      SIOMM_POINT_CONFIG_BOUNDARY, float, SIOMM_FIELD_READ | SIOMM_FIELD_WRITE> O22PtOffset;
+typedef O22MemMapField<SIOMM_POINT_CONFIG_WRITE_GAIN_BASE,        SIOMM_POINT_CONFIG_BOUNDARY, float, SIOMM_FIELD_READ | SIOMM_FIELD_WRITE> O22PtGain;
+typedef O22MemMapField<SIOMM_POINT_CONFIG_WRITE_HISCALE_BASE,     SIOMM_POINT_CONFIG_BOUNDARY, float, SIOMM_FIELD_READ | SIOMM_FIELD_WRITE> O22PtHiScale;
+typedef O22MemMapField<SIOMM_POINT_CONFIG_WRITE_LOSCALE_BASE,     SIOMM_POINT_CONFIG_BOUNDARY, float, SIOMM_FIELD_READ | SIOMM_FIELD_WRITE> O22PtLoScale;
+typedef O22MemMapField<SIOMM_POINT_CONFIG_WRITE_WDOG_VALUE_BASE,  SIOMM_POINT_CONFIG_BOUNDARY, float, SIOMM_FIELD_READ | SIOMM_FIELD_WRITE> O22PtWatchdogValue;
+typedef O22MemMapField<SIOMM_POINT_CONFIG_WRITE_WDOG_ENABLE_BASE, SIOMM_POINT_CONFIG_BOUNDARY, long,  SIOMM_FIELD_READ | SIOMM_FIELD_WRITE> O22PtWatchdogEnable;
+
+// Analog bank areas
+typedef O22MemMapField<SIOMM_ABANK_READ_POINT_VALUES,      4, float, SIOMM_FIELD_READ>  O22AnaBankValues;
+typedef O22MemMapField<SIOMM_ABANK_READ_POINT_COUNTS,      4, float, SIOMM_FIELD_READ>  O22AnaBankCounts;
+typedef O22MemMapField<SIOMM_ABANK_READ_POINT_MIN_VALUES,  4, float, SIOMM_FIELD_READ>  O22AnaBankMinValues;
+typedef O22MemMapField<SIOMM_ABANK_READ_POINT_MAX_VALUES,  4, float, SIOMM_FIELD_READ>  O22AnaBankMaxValues;
+typedef O22MemMapField<SIOMM_ABANK_WRITE_POINT_VALUES,     4, float, SIOMM_FIELD_WRITE> O22AnaBankWriteValues;
+typedef O22MemMapField<SIOMM_ABANK_WRITE_POINT_COUNTS,     4, float, SIOMM_FIELD_WRITE> O22AnaBankWriteCounts;
+
+// Digital bank counter data
+typedef O22MemMapField<SIOMM_DBANK_READ_COUNTER_DATA_BASE, SIOMM_DBANK_READ_COUNTER_DATA_BOUNDARY, long, SIOMM_FIELD_READ> O22DigBankCounterData;
+
+
+#endif // __O22SIOMD_H_
@@ -12,7 +12,7 @@
 //
 //   1. Create an instance of the O22SnapIoMemMap class
 //   2. Call OpenEnet() or OpenEnet2() to start connecting to an I/O unit
-//   3. Call IsOpenDone() to complete the connection  process
+//   3. Call IsOpenDone() or WaitForOpen() to complete the connection  process
 //   4. Call SetCommOptions() to set the desired timeout value
 //   5. Call any of the memory map functions, such as ConfigurePt(),
 //      GetAnaPtValue(), SetDigBankPointStates(), and ReadBlock(), to 
@@ -40,6 +40,11 @@
 #endif
 
 
+#ifndef __O22SIORG_H_
+#include "O22SIORG.h"
+#endif
+
+
 // Transaction code used by the I/O unit
 #define SIOMM_TCODE_WRITE_QUAD_REQUEST   0
 #define SIOMM_TCODE_WRITE_BLOCK_REQUEST  1
@@ -58,10 +63,38 @@
 #define SIOMM_SIZE_READ_BLOCK_REQUEST    16
 #define SIOMM_SIZE_READ_BLOCK_RESPONSE   16
 
+// Largest block that ReadBlock() and WriteBlock() will transfer in one request.  Responses are
+// assembled in a buffer of this size that belongs to the connection.  The data of a block write
+// is sent straight from the caller's buffer by a gather send, so it is never copied.
+#define SIOMM_MAX_BLOCK_LENGTH           2048
+
 // Response codes from the I/O unit
 #define SIOMM_RESPONSE_CODE_ACK          0
 #define SIOMM_RESPONSE_CODE_NAK          7
 
+// Number of distinct transaction labels, and so the maximum number of requests that can be 
+// outstanding at the same time in Transact()
+#define SIOMM_MAX_TRANSACTION_LABELS     64
+
+// Number of times Transact() and ContinueTransact() send a request again, with the same label,
+// when its UDP response doesn't arrive in time
+#define SIOMM_UDP_RETRANSMITS            2
+
+// Maximum number of times the adaptive timeout is doubled after timeouts in a row
+#define SIOMM_MAX_TIMEOUT_BACKOFF        6
+
+// How requests are sent and responses received, for SetIoBackend()
+#define SIOMM_IO_SOCKETS                 0
+#define SIOMM_IO_URING                   1
+
+// Values of SIOMM_Transaction.nResult used internally by Transact().  A transaction is pending
+// while it waits for its response.  A NAK is replaced by the I/O unit's last error code once all 
+// the responses have arrived, and a read that found the I/O unit busy is marked to be begun 
+// again.
+#define SIOMM_TRANSACTION_PENDING        0
+#define SIOMM_TRANSACTION_NAK            2
+#define SIOMM_TRANSACTION_RETRY          3
+
 // Memory Map values
 
 // Status read area of the memory map
@@ -219,6 +252,34 @@
 #define SIOMM_SCRATCHPAD_STRING_MAX_ELEMENTS   0x00000008
 
 
+// Describes one memory map read or write for the Transact() function.
+typedef struct SIOMM_Transaction
+{
+  BYTE    byTransactionCode;  // SIOMM_TCODE_READ_QUAD_REQUEST, SIOMM_TCODE_WRITE_QUAD_REQUEST,
+                              // SIOMM_TCODE_READ_BLOCK_REQUEST or SIOMM_TCODE_WRITE_BLOCK_REQUEST
+  DWORD   dwDestOffset;       // Memory map address
+  DWORD   dwQuadlet;          // Quadlet to write, or quadlet read
+  WORD    wDataLength;        // Length of pbyData, for block transactions
+  BYTE  * pbyData;            // Block to write, or buffer for the block read
+  LONG    nResult;            // SIOMM_OK, or an error, once Transact() returns
+  BYTE    byTransactionLabel; // Set by Transact()
+  LONGLONG nRecvTimeNS;       // Set by Transact() to when the response arrived, on the
+                              // O22GetTimeNS() clock
+  LONGLONG nDeadlineNS;       // Set by Transact() to when the transaction times out, on the
+                              // O22GetTimeNS() clock
+  LONGLONG nSendTimeNS;       // Set by Transact() to when the request was sent, or 0 if it was
+                              // sent more than once
+  long    nRetries;           // Set by Transact() to the number of times a read was tried again
+  long    nRetransmits;       // Set by Transact() to the number of times a UDP request was sent
+                              // again since it was last tried
+} O22_SIOMM_Transaction;
+
+
+#ifndef __O22SIOMD_H_
+#include "O22SIOMD.h"
+#endif
+
+
 class O22SnapIoMemMap {
 
   public:
@@ -236,14 +297,16 @@ class O22SnapIoMemMap {
                    long nConnectionType);
     //---------------------------------------------------------------------------------------------
     //  Usage  : Starts the connection process to a SNAP Ethernet brain. 
-    //           Use the IsOpenDone() method to check if the open connection is completed. 
+    //           Use the IsOpenDone() or WaitForOpen() method to check if the open connection is
+    //           completed. 
     //           OpenEnet() creates a TCP connection while OpenEnet2() allows the connection
     //           type to be specified.
     //
     //  Input  : pchIpAddressArg - IP address of I/O unit in "X.X.X.X" form.
     //           nPort - The Ethernet port to connect to, such as 2001
     //           nOpenTimeOutMS - a timeout value for the open process. Used by IsOpenDone()
-    //                            to determine if the open process has timed out.
+    //                            and WaitForOpen() to determine if the open process has 
+    //                            timed out.
     //           nAutoPUC - used to automatically read and clear the I/O unit's Powerup Clear flag.
     //           nConnectionType - SIOMM_TCP for TCP connection, SIOMM_UDP for UDP connection
     //  Output : none
@@ -266,10 +329,36 @@ class O22SnapIoMemMap {
     //  Output : none
     //  Returns: SIOMM_ERROR_NOT_CONNECTED_YET if the connection process isn't completed yet.
     //           SIOMM_TIME_OUT if the connection process timed out
+    //           SIOMM_ERROR_CONNECTING_SOCKET if the I/O unit refused the connection
     //           SIOMM_OK if the connection process is completed
     //           Or possibly any other error
     //---------------------------------------------------------------------------------------------
 
+    LONG WaitForOpen();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Like IsOpenDone(), but sleeps on the socket until the connection process is
+    //           completed or the open timeout set in OpenEnet() expires, without using the CPU.
+    //
+    //  Input  : none
+    //  Output : none
+    //  Returns: SIOMM_OK if the connection process is completed
+    //           SIOMM_TIME_OUT if the connection process timed out
+    //           SIOMM_ERROR_CONNECTING_SOCKET if the I/O unit refused the connection
+    //           Or possibly any other error
+    //---------------------------------------------------------------------------------------------
+
+    LONG Reopen(long nOpenTimeOutMS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Closes the connection and starts connecting again to the same I/O unit, with the
+    //           same options as the last OpenEnet() or OpenEnet2(), such as after a transaction
+    //           returns SIOMM_ERROR because the connection was lost. Use the IsOpenDone() or 
+    //           WaitForOpen() method to complete the connection, as after OpenEnet().
+    //  Input  : nOpenTimeOutMS - a timeout value for the open process.
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //           SIOMM_ERROR_NOT_CONNECTED if OpenEnet() or OpenEnet2() were never called.
+    //---------------------------------------------------------------------------------------------
+
     LONG Close();
     //---------------------------------------------------------------------------------------------
     //  Usage  : Close the connection to the I/O unit
@@ -278,16 +367,105 @@ class O22SnapIoMemMap {
     //  Returns: SIOMM_OK if everything is OK, an error otherwise.
     //---------------------------------------------------------------------------------------------
 
-    LONG SetCommOptions(LONG nTimeOutMS, LONG nReserved);
+    LONG GetLastResponseTimeNS(LONGLONG * pnRecvTimeNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets when the response to the last successful read or write arrived. On Linux 
+    //           this is the time the kernel received the packet. 
+    //  Input  : none
+    //  Output : pnRecvTimeNS - The arrival time in nanoseconds on the monotonic O22GetTimeNS() 
+    //                          clock. Zero if no response has been received.
+    //  Returns: SIOMM_OK
+    //---------------------------------------------------------------------------------------------
+
+    LONG SetIoBackend(long nBackend);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Chooses how requests are sent and responses received. With SIOMM_IO_URING the 
+    //           requests of Transact() and the receives of all their responses go to the kernel
+    //           through an io_uring, with one system call that also waits for them, instead of a
+    //           send, and a poll and a receive per response. Only on Linux 5.11 or later, built
+    //           with _IO_URING.
+    //  Input  : nBackend - SIOMM_IO_SOCKETS, the default, or SIOMM_IO_URING.
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, SIOMM_ERROR if the io_uring isn't available, in
+    //           which case the sockets are used as before.
+    //---------------------------------------------------------------------------------------------
+
+    LONG GetLocalIpAddress(char * pchIpAddressArg, long nLength);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets the address of this computer on the interface used to reach the I/O unit,
+    //           such as for setting the I/O unit's stream target with SetStreamTarget().
+    //  Input  : nLength - size of the pchIpAddressArg buffer. 16 bytes is always enough.
+    //  Output : pchIpAddressArg - IP address in "X.X.X.X" form.
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    LONG SetCommOptions(LONG nTimeOutMS, LONG nRetries);
     //---------------------------------------------------------------------------------------------
     //  Usage  : Set communication options, such as the timeout period
     //  Input  : nTimeOutMS - The timeout period for normal communications. The connection process
     //           using OpenEnet() has a seperate timeout period
-    //           nReserved   - not used at this time. Set to 0.
+    //           nRetries   - number of times a read that times out or gets 
+    //           SIOMM_BRAIN_ERROR_BUSY is tried again. Writes are never tried again. Set to 0
+    //           to turn this off, which is the default.
+    //           For UDP connections, requests that time out are sent again up to 
+    //           SIOMM_UDP_RETRANSMITS times before SIOMM_TIME_OUT is returned.
     //  Output : none
     //  Returns: SIOMM_OK if everything is OK, an error otherwise.
     //---------------------------------------------------------------------------------------------
 
+    LONG SetCommTimeOutNS(LONGLONG nTimeOutNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Same as the timeout of SetCommOptions(), but in nanoseconds, for timeouts shorter
+    //           than a millisecond or not a whole number of them. Each request times out at an
+    //           absolute deadline on the monotonic O22GetTimeNS() clock, set when it is sent.
+    //  Input  : nTimeOutNS - The timeout period for normal communications
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    LONG SetAdaptiveTimeOut(LONGLONG nMinTimeOutNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Turns on timeouts that adapt to the connection. The round trip time of every 
+    //           response is measured, and each request's timeout is the smoothed round trip time
+    //           plus four times its variation, as TCP does. The timeout doubles after each
+    //           timeout in a row. The timeout of SetCommOptions() or SetCommTimeOutNS() is used
+    //           until the first response, and is always the longest timeout.
+    //  Input  : nMinTimeOutNS - the shortest timeout, in nanoseconds. 0 turns adaptive timeouts
+    //           off, which is the default.
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    LONG GetRoundTripTimeNS(LONGLONG * pnSmoothedRttNS, LONGLONG * pnRttVarNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets the round trip time measured on this connection.
+    //  Input  : none
+    //  Output : pnSmoothedRttNS - smoothed round trip time, in nanoseconds. 0 if no response has
+    //                             been received yet.
+    //           pnRttVarNS      - average variation of the round trip time, in nanoseconds.
+    //  Returns: SIOMM_OK
+    //---------------------------------------------------------------------------------------------
+
+    LONG BeginStepBudget(LONGLONG nBudgetNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Starts a budget of time shared by all the reads and writes until EndStepBudget(),
+    //           such as those of one step of a control loop. No request waits past the end of
+    //           the budget, even if its own timeout is longer, so a slow I/O unit is detected 
+    //           within the step. Calling it again starts a new budget.
+    //  Input  : nBudgetNS - length of the budget, in nanoseconds from now
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    LONG EndStepBudget();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Ends the budget started by BeginStepBudget(). Requests go back to using only the
+    //           timeout of SetCommOptions() or SetCommTimeOutNS().
+    //  Input  : none
+    //  Output : none
+    //  Returns: SIOMM_OK
+    //---------------------------------------------------------------------------------------------
+
 
     // The following functions are for building and unpacking read/write requests for the 
     // 1394-based protocol.
@@ -339,6 +517,105 @@ class O22SnapIoMemMap {
     LONG ReadBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData);
     LONG WriteBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData);
 
+    // Typed functions for reading and writing the fields described in O22SIOMD.h. The point
+    // is checked when called, or when compiled if it's a template argument. The address is
+    // worked out when compiled whenever the point is known then.
+    template <class Field> LONG Read(long nPoint, typename Field::Type * pValue);
+    template <class Field> LONG Write(long nPoint, typename Field::Type Value);
+    template <class Field, long nPoint> LONG Read(typename Field::Type * pValue);
+    template <class Field, long nPoint> LONG Write(typename Field::Type Value);
+
+    // Typed functions for reading and writing a range of points of a packed field, such as
+    // O22AnaBankValues, with one block. pValues holds nCount values.
+    template <class Field, long nFirst = 0, long nCount = Field::Points>
+    LONG ReadRange(typename Field::Type * pValues);
+    template <class Field, long nFirst = 0, long nCount = Field::Points>
+    LONG WriteRange(const typename Field::Type * pValues);
+
+    LONG Transact(SIOMM_Transaction * pTransactions, long nCount, long nWindow);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Performs several quadlet and block reads and writes, keeping up to nWindow 
+    //           requests outstanding on the connection at the same time. Responses are matched
+    //           to their requests by transaction label, so a batch of requests costs about one 
+    //           round trip instead of one per request.
+    //  Input  : pTransactions - array of transactions to perform, in order.
+    //           nCount - number of items in pTransactions.
+    //           nWindow - maximum number of outstanding requests, from 1 (same as calling 
+    //                     ReadQuad(), WriteQuad(), etc. in sequence) to 
+    //                     SIOMM_MAX_TRANSACTION_LABELS.
+    //  Output : pTransactions - nResult is set for every item. dwQuadlet is set for quadlet 
+    //                           reads and pbyData is filled for block reads.
+    //           The transactions are begun with BeginTransact() and completed with 
+    //           ContinueTransact(), waiting on the socket in between, so reads are tried again
+    //           and lost UDP requests are sent again the same way as there.
+    //  Returns: SIOMM_OK if every transaction is OK, otherwise the first error found.
+    //---------------------------------------------------------------------------------------------
+
+    // Transactions that don't wait, for event loops such as O22SnapIoEventLoop in O22SIOAS.h.
+    // No other function should be called on the connection while any are outstanding.
+    LONG BeginTransact(SIOMM_Transaction * pTransactions, long nCount);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Sends the requests of the transactions and returns without waiting for the 
+    //           responses. ContinueTransact() completes them as the responses arrive, trying
+    //           reads again and sending lost UDP requests again as Transact() does. Rejected
+    //           requests are left with SIOMM_TRANSACTION_NAK for the caller to ask 
+    //           GetStatusLastError() about and pass to ResolveNakResults().
+    //  Input  : pTransactions - array of transactions to perform, in order. They must stay 
+    //                           valid until they complete or are abandoned. Only those with 
+    //                           nResult set to SIOMM_TRANSACTION_PENDING, or to
+    //                           SIOMM_TRANSACTION_RETRY by ResolveNakResults(), are begun.
+    //           nCount - number of items in pTransactions. At most 
+    //                    SIOMM_MAX_TRANSACTION_LABELS transactions can be outstanding, counting
+    //                    those of earlier calls; see GetOutstandingCount().
+    //  Output : pTransactions - nResult is SIOMM_TRANSACTION_PENDING until the transaction 
+    //                           completes, and then set as by Transact().
+    //  Returns: SIOMM_OK if the requests were sent, SIOMM_ERROR if there isn't room for them, or
+    //           the error that failed them and every other outstanding transaction.
+    //---------------------------------------------------------------------------------------------
+
+    LONG ContinueTransact();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Completes the outstanding transactions whose responses have arrived, and
+    //           tries again or times out those whose deadline has passed, without waiting. Call
+    //           it when the socket from GetSocket() can be read, or at the deadline from 
+    //           GetOutstandingDeadline().
+    //  Input  : none
+    //  Output : none
+    //  Returns: SIOMM_OK, or the error that failed every outstanding transaction, such as when
+    //           the connection is lost.
+    //---------------------------------------------------------------------------------------------
+
+    BOOL ResolveNakResults(SIOMM_Transaction * pTransactions, long nCount, 
+                           LONG nLastErrorResult);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Sets the result of the rejected transactions once they're all complete. Reads
+    //           that found the I/O unit busy are marked SIOMM_TRANSACTION_RETRY, as set with
+    //           SetCommOptions(), to be given to BeginTransact() again.
+    //  Input  : pTransactions, nCount - the transactions, as given to BeginTransact().
+    //           nLastErrorResult - the error code from GetStatusLastError(), or the error
+    //                              that function returned.
+    //  Output : pTransactions - nResult of those with SIOMM_TRANSACTION_NAK.
+    //  Returns: TRUE if any transaction is marked to be tried again.
+    //---------------------------------------------------------------------------------------------
+
+    void AbandonTransact(SIOMM_Transaction * pTransactions, long nCount);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Forgets outstanding transactions, such as when their owner goes away. Their 
+    //           responses are thrown away when they arrive.
+    //  Input  : pTransactions, nCount - the transactions, as given to BeginTransact().
+    //  Output : none
+    //  Returns: none
+    //---------------------------------------------------------------------------------------------
+
+    long GetOutstandingCount();
+    LONGLONG GetOutstandingDeadline();
+    SOCKET GetSocket();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : For waiting on outstanding transactions: their number, the earliest of their
+    //           deadlines on the O22GetTimeNS() clock (0 if there are none), and the socket 
+    //           their responses arrive on.
+    //---------------------------------------------------------------------------------------------
+
     // Status read
     LONG GetStatusPUC(long *pnPUCFlag);
     LONG GetStatusLastError(long *pnErrorCode);
@@ -473,25 +750,87 @@ class O22SnapIoMemMap {
   protected:
     // Protected data
     SOCKET m_Socket;
+    BOOL   m_bWinSockStarted;    // Set once OpenEnet2() has initialized WinSock, on Windows
     sockaddr_in m_SocketAddress; // for connecting our socket
     long        m_nConnectionType; // TCP or UDP
 
     timeval m_tvTimeOut;      // Timeout structure for sockets
     LONG    m_nTimeOutMS;     // For holding the user's timeout
+    LONGLONG m_nTimeOutNS;      // The user's timeout, in nanoseconds
+    LONGLONG m_nStepDeadlineNS; // End of the budget from BeginStepBudget(), or 0 if none
+    LONGLONG m_nMinTimeOutNS;   // Shortest adaptive timeout, or 0 if it's turned off
+    LONGLONG m_nSmoothedRttNS;  // Smoothed round trip time, or 0 before the first response
+    LONGLONG m_nRttVarNS;       // Average variation of the round trip time
+    long    m_nTimeOutBackoff; // Timeouts in a row, for doubling the adaptive timeout
     DWORD   m_nOpenTimeOutMS; // For holding the open timeout
-    DWORD   m_nOpenTime;      // For testing the open timeout
+    LONGLONG m_nOpenDeadlineNS; // When the open times out, on the O22GetTimeNS() clock
     LONG    m_nRetries;       // For holding the user's retries.
     
     LONG    m_nAutoPUCFlag;   // For holding the AutoPUC flag sent in OpenEnet()
+    char    m_chOpenIpAddress[16]; // The I/O unit's address from OpenEnet(), for Reopen()
+    long    m_nOpenPort;           // The I/O unit's port from OpenEnet(), or 0 if none yet
 
     BYTE    m_byTransactionLabel; // The current transaction label
 
+    // Requests of Transact() waiting to be sent together by SendQueuedRequests().  Each one is
+    // a pair of send buffers: its header, built in m_byRequestHeaders, and the caller's data 
+    // for block writes, which is never copied.
+    BYTE    m_byRequestHeaders[SIOMM_MAX_TRANSACTION_LABELS][SIOMM_SIZE_WRITE_BLOCK_REQUEST];
+    SIOMM_SendBuffer m_arrSendBuffers[2 * SIOMM_MAX_TRANSACTION_LABELS];
+    long    m_nQueuedRequests;
+    LONGLONG m_nQueueDeadlineNS; // The earliest deadline of the queued requests
+
+    O22SnapIoRing m_Ring;      // Used for sending and receiving when open, see SetIoBackend()
+
+    // Transactions begun by BeginTransact() and not yet completed, oldest first
+    SIOMM_Transaction * m_arrpOutstanding[SIOMM_MAX_TRANSACTION_LABELS];
+    long    m_nOutstanding;
+
+    // Buffer for assembling responses that arrive in several segments
+    BYTE    m_byResponseFrame[SIOMM_SIZE_READ_BLOCK_RESPONSE + SIOMM_MAX_BLOCK_LENGTH];
+    long    m_nResponseBytes;  // Number of bytes in m_byResponseFrame
+    BOOL    m_bStaleResponses; // Set after a timeout, when abandoned responses may still arrive
+    LONGLONG m_nResponseTimeNS;     // Arrival time of the bytes last received
+    LONGLONG m_nLastResponseTimeNS; // Arrival time of the last completed transaction
+
     // Protected Members
 
     // Open/Close sockets functions
     LONG OpenSockets(char * pchIpAddressArg, long nPort, long nOpenTimeOutMS);
+    LONG CheckOpenDone(BOOL bWait);
     LONG CloseSockets();
 
+    // Functions for the adaptive timeout
+    LONGLONG TransactionTimeOut();
+    void UpdateRoundTripTime(LONGLONG nRttNS);
+
+    // Functions for waiting on the socket until an absolute deadline on the O22GetTimeNS() clock
+    LONGLONG TransactionDeadline();
+    LONG WaitForSocket(BOOL bWrite, LONGLONG nDeadlineNS);
+
+    // Queue the request of a transaction, and send every queued request with gather sends
+    LONG QueueTransactionRequest(SIOMM_Transaction * pTransaction);
+    LONG SendQueuedRequests();
+
+    // Functions for assembling responses in m_byResponseFrame from partial reads
+    long BufferedFrameLength();
+    long ExpectedResponseBytes();
+    LONG RecvResponseFrame(long * pnFrameLength, LONGLONG nDeadlineNS);
+    void DiscardResponseFrame(long nFrameLength);
+    void DrainStaleResponses();
+
+    // Helpers for BeginTransact() and ContinueTransact(): begin transactions, and complete, 
+    // try again or time out outstanding ones.  Transact() runs them to completion.
+    LONG QueueTransactions(SIOMM_Transaction * pTransactions, long nCount);
+    LONG QueueTransactionAttempt(SIOMM_Transaction * pTransaction);
+    LONG PollTransactions(LONGLONG nWaitDeadlineNS, BOOL bDrain);
+    LONG RunTransact(SIOMM_Transaction * pTransactions, long nCount, long nWindow);
+    LONG CompleteTransaction(SIOMM_Transaction * pTransaction, long nFrameLength);
+    BOOL IsReadTransaction(SIOMM_Transaction * pTransaction);
+    BOOL IsLabelOutstanding(BYTE byTransactionLabel);
+    void RemoveOutstanding(long nIndex);
+    void FailOutstanding(LONG nResult);
+
     // Generic functions for getting/setting 64-bit bitmasks
     LONG GetBitmask64(DWORD dwDestOffset, long *pnPts63to32, long *pnPts31to0);
     LONG SetBitmask64(DWORD dwDestOffset, long nPts63to32, long nPts31to0);
@@ -511,6 +850,112 @@ class O22SnapIoMemMap {
 };
 
 
+template <class Field>
+LONG O22SnapIoMemMap::Read(long nPoint, typename Field::Type * pValue)
+//-------------------------------------------------------------------------------------------------
+// Read a field of a point
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_READ, "field can't be read");
+
+  LONG  nResult;   // for checking the return values of functions
+  DWORD dwQuadlet; // the quadlet read
+
+  if ((nPoint < 0) || (nPoint >= Field::Points))
+    return SIOMM_ERROR;
+
+  nResult = ReadQuad(Field::Address(nPoint), &dwQuadlet);
+  if (SIOMM_OK == nResult)
+    *pValue = Field::Codec::FromQuad(dwQuadlet);
+
+  return nResult;
+}
+
+
+template <class Field>
+LONG O22SnapIoMemMap::Write(long nPoint, typename Field::Type Value)
+//-------------------------------------------------------------------------------------------------
+// Write a field of a point
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_WRITE, "field can't be written");
+
+  if ((nPoint < 0) || (nPoint >= Field::Points))
+    return SIOMM_ERROR;
+
+  return WriteQuad(Field::Address(nPoint), Field::Codec::ToQuad(Value));
+}
+
+
+template <class Field, long nPoint>
+LONG O22SnapIoMemMap::Read(typename Field::Type * pValue)
+//-------------------------------------------------------------------------------------------------
+// Read a field of a point known when compiled
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_READ, "field can't be read");
+
+  LONG  nResult;   // for checking the return values of functions
+  DWORD dwQuadlet; // the quadlet read
+
+  nResult = ReadQuad(O22MemMapPoint<Field, nPoint>::Address, &dwQuadlet);
+  if (SIOMM_OK == nResult)
+    *pValue = Field::Codec::FromQuad(dwQuadlet);
+
+  return nResult;
+}
+
+
+template <class Field, long nPoint>
+LONG O22SnapIoMemMap::Write(typename Field::Type Value)
+//-------------------------------------------------------------------------------------------------
+// Write a field of a point known when compiled
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_WRITE, "field can't be written");
+
+  return WriteQuad(O22MemMapPoint<Field, nPoint>::Address, Field::Codec::ToQuad(Value));
+}
+
+
+template <class Field, long nFirst, long nCount>
+LONG O22SnapIoMemMap::ReadRange(typename Field::Type * pValues)
+//-------------------------------------------------------------------------------------------------
+// Read a range of points of a packed field with one block
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_READ, "field can't be read");
+
+  typedef O22MemMapRange<Field, nFirst, nCount> Range;
+
+  LONG nResult;                   // for checking the return values of functions
+  BYTE arrbyData[Range::Length];  // buffer for the data to be read
+
+  nResult = ReadBlock(Range::Address, Range::Length, arrbyData);
+  if (SIOMM_OK == nResult)
+    Field::Codec::Unpack(arrbyData, pValues, nCount);
+
+  return nResult;
+}
+
+
+template <class Field, long nFirst, long nCount>
+LONG O22SnapIoMemMap::WriteRange(const typename Field::Type * pValues)
+//-------------------------------------------------------------------------------------------------
+// Write a range of points of a packed field with one block
+//-------------------------------------------------------------------------------------------------
+{
+  static_assert(Field::Access & SIOMM_FIELD_WRITE, "field can't be written");
+
+  typedef O22MemMapRange<Field, nFirst, nCount> Range;
+
+  BYTE arrbyData[Range::Length];  // buffer for the data to be written
+
+  Field::Codec::Pack(pValues, arrbyData, nCount);
+
+  return WriteBlock(Range::Address, Range::Length, arrbyData);
+}
+
 
 #endif // __O22SIOMM_H_
 
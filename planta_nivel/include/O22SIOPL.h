@@ -0,0 +1,182 @@
+//-------------------------------------------------------------------------------------------------
+//
+// O22SIOPL.h
+//
+// Header for the O22SnapIoPlan C++ class.
+//
+// The O22SnapIoPlan C++ class decides how to reach a set of point fields of an Opto 22 SNAP
+// Ethernet I/O unit with as little cost as it can. Most fields can be reached either through
+// the point areas of the memory map, where each point has its own SIOMM_APOINT_READ_BOUNDARY or
+// SIOMM_DPOINT_READ_BOUNDARY bytes, or through the bank areas, where the field of every point
+// is packed next to the others. The plan picks the area of each field and groups the quadlets
+// into blocks: a read block may take in quadlets nobody asked for when that is cheaper than
+// another transaction, a write block never does.
+//
+// The basic procedure for using this class is:
+//
+//   1. Create an instance of the O22SnapIoPlan class.
+//   2. Call AddRead() and AddWrite() for each point field used. Items are numbered from 0 in
+//      the order they are added.
+//   3. Optionally call SetCostModel() to describe the network.
+//   4. Call AddToShadow() to add the blocks of the plan as regions of an O22SnapIoShadow.
+//   5. Each cycle, call GetItemLocation() to find where an item is in the shadow. The plan is
+//      computed once and kept until items are added or the cost model changes.
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef __O22SIOPL_H_
+#define __O22SIOPL_H_
+
+
+#ifndef __O22SIOSH_H_
+#include "O22SIOSH.h"
+#endif
+
+
+// These fields are used in AddRead() and AddWrite()
+#define SIOMM_PLAN_ANA_VALUE           0 // float, read and write
+#define SIOMM_PLAN_ANA_COUNTS          1 // read and write
+#define SIOMM_PLAN_ANA_MIN_VALUE       2 // float, read only
+#define SIOMM_PLAN_ANA_MAX_VALUE       3 // float, read only
+#define SIOMM_PLAN_DIG_STATE           4 // read and write
+#define SIOMM_PLAN_DIG_ON_LATCH        5 // read only
+#define SIOMM_PLAN_DIG_OFF_LATCH       6 // read only
+#define SIOMM_PLAN_DIG_ACTIVE_COUNTER  7 // read only
+#define SIOMM_PLAN_DIG_COUNTER_DATA    8 // read only
+#define SIOMM_PLAN_FIELDS              9
+
+// The most items in one plan, and the most blocks it may be split into
+#define SIOMM_PLAN_MAX_ITEMS           256
+#define SIOMM_PLAN_MAX_BLOCKS          SIOMM_SHADOW_MAX_REGIONS
+
+// The default cost model: the time the I/O unit takes to handle one more transaction, and the
+// time one more byte takes on a 100 Mb/s network. All blocks are sent at once, so every plan
+// costs one round trip and only these costs tell plans apart.
+#define SIOMM_PLAN_TRANSACTION_NS      20000
+#define SIOMM_PLAN_BYTE_NS             80
+
+
+// A point field in a plan
+typedef struct SIOMM_PlanItem
+{
+  long    nPoint;     // Point number, 0 to 63
+  long    nField;     // SIOMM_PLAN_ANA_VALUE, etc.
+  BOOL    bWrite;     // TRUE if added with AddWrite()
+  DWORD   dwAddress;  // Memory map address of the quadlet holding it, set by the plan
+  long    nBit;       // Bit of the quadlet holding it, or -1 if it is the whole quadlet
+} O22_SIOMM_PlanItem;
+
+
+// A block of the memory map to be read or written as one transaction
+typedef struct SIOMM_PlanBlock
+{
+  DWORD   dwAddress;  // Memory map address of the block
+  WORD    wLength;    // Length in bytes
+  long    nFlags;     // SIOMM_SHADOW_READ or SIOMM_SHADOW_WRITE, maybe with SIOMM_SHADOW_ACTION
+} O22_SIOMM_PlanBlock;
+
+
+class O22SnapIoPlan {
+
+  public:
+  // Public data
+
+    // Public Construction/Destruction
+    O22SnapIoPlan();
+    ~O22SnapIoPlan();
+
+  // Public Members
+
+    LONG AddRead(long nPoint, long nField);
+    LONG AddWrite(long nPoint, long nField);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Adds a point field to be read or written.
+    //  Input  : nPoint - point number, 0 to 63.
+    //           nField - SIOMM_PLAN_ANA_VALUE, etc. Digital states are written through the
+    //                    digital bank turn on and off masks; see
+    //                    O22SnapIoShadow::SetDigBankPointStates().
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, SIOMM_ERROR if the field can't be read or written
+    //           or there are already SIOMM_PLAN_MAX_ITEMS items.
+    //---------------------------------------------------------------------------------------------
+
+    void SetCostModel(LONGLONG nTransactionNS, LONGLONG nByteNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Sets the cost of one more transaction and of one more byte in a plan. A read
+    //           block takes in a gap between two quadlets when the gap costs less than a
+    //           transaction.
+    //  Input  : nTransactionNS - the cost of a transaction, in nanoseconds.
+    //                            Default is SIOMM_PLAN_TRANSACTION_NS.
+    //           nByteNS - the cost of a byte, in nanoseconds. Default is SIOMM_PLAN_BYTE_NS.
+    //  Output : none
+    //  Returns: none
+    //---------------------------------------------------------------------------------------------
+
+    LONG Compute();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Computes the plan, if it isn't computed yet. The other functions call it when
+    //           needed.
+    //  Input  : none
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, SIOMM_ERROR if the plan needs more than
+    //           SIOMM_PLAN_MAX_BLOCKS blocks.
+    //---------------------------------------------------------------------------------------------
+
+    LONG GetItemLocation(long nItem, DWORD * pdwAddress, long * pnBit);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets where an item is in the memory map, according to the plan.
+    //  Input  : nItem - item number, in the order the items were added.
+    //  Output : pdwAddress - memory map address of the quadlet holding the item.
+    //           pnBit - bit of the quadlet holding the item, or -1 if it is the whole quadlet.
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    LONG GetBlocks(SIOMM_PlanBlock * pBlocks, long nMaxBlocks, long * pnBlocks);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets the blocks of the plan.
+    //  Input  : nMaxBlocks - number of items in pBlocks.
+    //  Output : pBlocks - the blocks, by address.
+    //           pnBlocks - number of blocks in the plan.
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    LONG GetCostNS(LONGLONG * pnCostNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets the cost of the plan under the cost model, not counting the round trip.
+    //  Input  : none
+    //  Output : pnCostNS - the cost, in nanoseconds.
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    LONG AddToShadow(O22SnapIoShadow * pShadow);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Adds every block of the plan as a region of a shadow, so that its Refresh()
+    //           reads the read items and its Flush() writes the write items.
+    //  Input  : pShadow - the shadow. Its other regions must not overlap the blocks.
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+
+  protected:
+    // Protected data
+
+    SIOMM_PlanItem  m_arrItems[SIOMM_PLAN_MAX_ITEMS];
+    long            m_nItems;
+
+    SIOMM_PlanBlock m_arrBlocks[SIOMM_PLAN_MAX_BLOCKS];
+    long            m_nBlocks;
+
+    LONGLONG        m_nTransactionNS;  // The cost model
+    LONGLONG        m_nByteNS;
+    LONGLONG        m_nCostNS;         // The cost of the plan
+    BOOL            m_bComputed;       // Cleared when the plan must be computed again
+
+
+    // Protected Members
+    LONG AddItem(long nPoint, long nField, BOOL bWrite);
+    LONGLONG PlanItems(BOOL bWrite, BOOL * pbUseBank, BOOL bKeep);
+};
+
+
+#endif // __O22SIOPL_H_
@@ -0,0 +1,199 @@
+//-------------------------------------------------------------------------------------------------
+//
+// O22SIORG.h
+//
+// Header for the O22SnapIoRing C++ class.
+//
+// The O22SnapIoRing C++ class sends and receives on a socket through a Linux io_uring, so that
+// the requests of a batch and the receives of all their responses go to the kernel with a
+// single system call, which also waits for them. O22SnapIoMemMap uses it when SetIoBackend()
+// selects SIOMM_IO_URING; it isn't meant to be used on its own.
+//
+// Over UDP a receive is armed for each response expected, each into a datagram buffer of the
+// ring's own, and the datagrams are then handed out one at a time without entering the kernel.
+// Over TCP one receive waits for all the bytes expected; on kernels older than 6.1, which lose
+// the bytes of such a receive when it is cancelled, it only waits for the first segment.
+//
+// The class is only built with the ring when _LINUX and _IO_URING are defined; otherwise Open()
+// always fails and O22SnapIoMemMap keeps using the sockets directly. It talks to the kernel
+// through the raw io_uring system calls, so liburing isn't needed.
+//
+// Nothing is left in flight between calls: every function waits until the kernel is done with
+// the buffers it was given, so the same socket can also be used directly.
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef __O22SIORG_H_
+#define __O22SIORG_H_
+
+
+#ifndef __O22SIOUT_H_
+#include "O22SIOUT.h"
+#endif
+
+
+// Size of the submission queue: a send and a receive for each request of a full window, and
+// room for cancelling them
+#define SIOMM_RING_ENTRIES           256
+
+// The most sends queued between two submissions
+#define SIOMM_RING_MAX_SENDS         64
+
+// The most receives in flight, and the size of each datagram buffer: a read block response
+// of SIOMM_MAX_BLOCK_LENGTH bytes
+#define SIOMM_RING_MAX_RECVS         64
+#define SIOMM_RING_DATAGRAM_SIZE     (16 + 2048)
+
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+
+class O22SnapIoRing {
+
+  public:
+  // Public data
+
+    // Public Construction/Destruction
+    O22SnapIoRing();
+    ~O22SnapIoRing();
+
+  // Public Members
+
+    LONG Open();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Sets up the ring.
+    //  Input  : none
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, SIOMM_ERROR if the ring wasn't built in or the
+    //           kernel can't provide it.
+    //---------------------------------------------------------------------------------------------
+
+    void Close();
+    BOOL IsOpen();
+
+    LONG QueueSend(SOCKET Socket, SIOMM_SendBuffer * pBuffers, long nBuffers);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Queues the buffers to be sent as one message, by the next Recv() or Submit().
+    //           The buffers must stay valid until then.
+    //  Input  : Socket - the socket to send on.
+    //           pBuffers - the data, in order. Over UDP it is one datagram.
+    //           nBuffers - number of items in pBuffers, at most SIOMM_SEND_MAX_BUFFERS.
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+    LONG Recv(SOCKET Socket, BYTE * pbyBuffer, long nLength, long nWaitLength,
+              LONGLONG nDeadlineNS, long * pnReceived, LONGLONG * pnRecvTimeNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Submits the queued sends and a receive on a stream socket, and waits for all of
+    //           them, with one system call unless the deadline passes.
+    //  Input  : Socket - the socket to receive on.
+    //           pbyBuffer, nLength - where to put the data received.
+    //           nWaitLength - bytes the responses outstanding should bring, at most nLength.
+    //                         The receive waits for all of them, so a response shorter than
+    //                         expected, such as a rejected block read, waits for the deadline.
+    //           nDeadlineNS - when to give up, on the O22GetTimeNS() clock.
+    //  Output : pnReceived - bytes received, like the result of recv(). 0 means the other end
+    //                        closed the connection.
+    //           pnRecvTimeNS - when the data arrived, on the O22GetTimeNS() clock.
+    //  Returns: SIOMM_OK if everything is OK, SIOMM_TIME_OUT if nothing arrived in time,
+    //           SIOMM_ERROR if a send or the receive failed.
+    //---------------------------------------------------------------------------------------------
+
+    LONG RecvDatagram(SOCKET Socket, BYTE * pbyBuffer, long nLength, long nDatagrams,
+                      LONGLONG nDeadlineNS, long * pnReceived, LONGLONG * pnRecvTimeNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets a datagram received by an earlier call, without a system call. If there
+    //           is none, submits the queued sends and a receive for each datagram expected, and
+    //           waits for all of them, with one system call unless the deadline passes.
+    //  Input  : Socket - the socket to receive on.
+    //           pbyBuffer, nLength - where to put the datagram, at most
+    //                                SIOMM_RING_DATAGRAM_SIZE bytes of it.
+    //           nDatagrams - responses outstanding, at most SIOMM_RING_MAX_RECVS.
+    //           nDeadlineNS - when to give up, on the O22GetTimeNS() clock.
+    //  Output : pnReceived - length of the datagram.
+    //           pnRecvTimeNS - when the datagram arrived, on the O22GetTimeNS() clock.
+    //  Returns: SIOMM_OK if everything is OK, SIOMM_TIME_OUT if nothing arrived in time,
+    //           SIOMM_ERROR if a send or a receive failed.
+    //---------------------------------------------------------------------------------------------
+
+    void DiscardDatagrams();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Drops the datagrams received but not yet taken by RecvDatagram(), such as
+    //           late responses, or those of a socket that was closed.
+    //  Input  : none
+    //  Output : none
+    //  Returns: none
+    //---------------------------------------------------------------------------------------------
+
+    LONG Submit(LONGLONG nDeadlineNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Submits the queued sends, if any, and waits for them.
+    //  Input  : nDeadlineNS - when to give up, on the O22GetTimeNS() clock.
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+
+  protected:
+    // Protected data
+
+    int             m_nRingFd;       // The io_uring, or -1 if it isn't open
+    BYTE          * m_pbyRing;       // The submission and completion rings, mapped together
+    long            m_nRingSize;
+    io_uring_sqe  * m_pSqes;         // The submission queue entries
+    long            m_nSqesSize;
+
+    unsigned int  * m_pnSqHead;      // Submission ring
+    unsigned int  * m_pnSqTail;
+    unsigned int  * m_pnSqArray;
+    unsigned int    m_nSqMask;
+    unsigned int    m_nSqEntries;
+    unsigned int    m_nSqLocalTail;  // Tail including the entries not yet published
+
+    unsigned int  * m_pnCqHead;      // Completion ring
+    unsigned int  * m_pnCqTail;
+    unsigned int    m_nCqMask;
+    io_uring_cqe  * m_pCqes;
+
+    long            m_nToSubmit;     // Entries published but not yet submitted
+    long            m_nInFlight;     // Entries submitted and not yet completed
+
+#ifdef _LINUX
+    // The sends queued since the last submission, and the first error of the ones completed
+    long            m_nSends;
+    long            m_nSendVectors;
+    long            m_arrnSendLength[SIOMM_RING_MAX_SENDS];
+    struct msghdr   m_arrSendMessages[SIOMM_RING_MAX_SENDS];
+    struct iovec    m_arrSendVectors[SIOMM_SEND_MAX_BUFFERS];
+    LONG            m_nSendResult;
+
+    // The receives of the last submission, and their outcomes in the order they completed.
+    // Each datagram receive has its own buffer in m_pbyDatagrams.
+    BYTE          * m_pbyDatagrams;
+    BOOL            m_bWaitAll;      // whether a cancelled receive keeps what it got (Linux 6.1)
+    long            m_nRecvs;
+    struct msghdr   m_arrRecvMessages[SIOMM_RING_MAX_RECVS];
+    struct iovec    m_arrRecvVectors[SIOMM_RING_MAX_RECVS];
+    char            m_arrchRecvControl[SIOMM_RING_MAX_RECVS][CMSG_SPACE(sizeof(struct timespec))];
+    long            m_arrnRecvResult[SIOMM_RING_MAX_RECVS];
+    BOOL            m_arrbRecvDone[SIOMM_RING_MAX_RECVS];
+    long            m_arrnDoneRecvs[SIOMM_RING_MAX_RECVS];
+    long            m_nDoneRecvs;
+    long            m_nTakenRecvs;   // completed receives already handed out
+#endif
+
+
+    // Protected Members
+    io_uring_sqe * GetSqe();
+    void PublishSqes();
+    LONG Wait(LONGLONG nDeadlineNS);
+    void ReapCompletions();
+    void CancelInFlight();
+    LONG QueueRecv(SOCKET Socket, BYTE * pbyBuffer, long nLength, BOOL bWaitAll);
+    LONG SubmitRecvs(LONGLONG nDeadlineNS);
+};
+
+
+#endif // __O22SIORG_H_
@@ -0,0 +1,157 @@
+//-------------------------------------------------------------------------------------------------
+//
+// O22SIOSH.h
+//
+// Header for the O22SnapIoShadow C++ class.
+//
+// The O22SnapIoShadow C++ class keeps a copy of parts of the memory map of an Opto 22 SNAP
+// Ethernet I/O unit on the computer, so that a control loop can read and write points without
+// a transaction for each one. Setters only change the copy and mark the quadlets they touch as
+// dirty. Flush() then writes every dirty range with as few transactions as it can and sends
+// them all at once, and Refresh() reads every read region at once.
+//
+// The basic procedure for using this class is:
+//
+//   1. Create and open an instance of the O22SnapIoMemMap class.
+//   2. Create an instance of the O22SnapIoShadow class for it.
+//   3. Call AddRegion() for each area of the memory map to be kept, for example the analog
+//      bank read area and the analog bank write area.
+//   4. Each cycle, call Refresh() and then the Get functions to read inputs.
+//   5. Call the Set functions to change outputs, then Flush() to write them.
+//
+// Writes that fail stay dirty and are tried again by the next Flush(). The class isn't thread
+// safe; use it from the same thread as its O22SnapIoMemMap.
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef __O22SIOSH_H_
+#define __O22SIOSH_H_
+
+
+#ifndef __O22SIOMM_H_
+#include "O22SIOMM.h"
+#endif
+
+
+// These flags are used in AddRegion()
+#define SIOMM_SHADOW_READ           0x01 // Refresh() reads the region
+#define SIOMM_SHADOW_WRITE          0x02 // Set functions may change it and Flush() writes it
+#define SIOMM_SHADOW_ACTION         0x04 // Write area of masks that act once, like the digital
+                                         // bank turn on and off masks. Flush() clears the copy
+                                         // after writing, and may write clean quadlets between
+                                         // dirty ones since zero masks do nothing.
+
+// The most regions in one O22SnapIoShadow. Each region is at most SIOMM_MAX_BLOCK_LENGTH bytes,
+// so that Refresh() reads it with one transaction, and there are no more regions than 
+// transaction labels, so that Refresh() sends all the reads at once.
+#define SIOMM_SHADOW_MAX_REGIONS    SIOMM_MAX_TRANSACTION_LABELS
+#define SIOMM_SHADOW_MAX_QUADS      (SIOMM_MAX_BLOCK_LENGTH / 4)
+
+
+// A region of the memory map kept by an O22SnapIoShadow
+typedef struct SIOMM_ShadowRegion
+{
+  DWORD   dwBase;     // Memory map address of the region, quadlet aligned
+  WORD    wLength;    // Length in bytes, a multiple of 4
+  long    nFlags;     // SIOMM_SHADOW_READ, SIOMM_SHADOW_WRITE and SIOMM_SHADOW_ACTION
+  BYTE  * pbyImage;   // The copy, in the byte order of the I/O unit
+  BYTE  * pbyRead;    // Buffer for Refresh(), so that dirty quadlets aren't overwritten
+  BOOL    bValid;     // Set once Refresh() has read the region
+  DWORD   arrdwDirty[SIOMM_SHADOW_MAX_QUADS / 32]; // One bit for each quadlet
+} O22_SIOMM_ShadowRegion;
+
+
+class O22SnapIoShadow {
+
+  public:
+  // Public data
+
+    // Public Construction/Destruction
+    O22SnapIoShadow(O22SnapIoMemMap * pMemMap);
+    ~O22SnapIoShadow();
+
+  // Public Members
+
+    LONG AddRegion(DWORD dwBase, WORD wLength, long nFlags);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Adds an area of the memory map to be kept. Regions must not overlap.
+    //  Input  : dwBase - memory map address of the area. Must be quadlet aligned.
+    //           wLength - length of the area in bytes. Must be a multiple of 4 and at most
+    //                     SIOMM_MAX_BLOCK_LENGTH.
+    //           nFlags - SIOMM_SHADOW_READ, SIOMM_SHADOW_WRITE or both, optionally with
+    //                    SIOMM_SHADOW_ACTION.
+    //  Output : none
+    //  Returns: SIOMM_OK if everything is OK, SIOMM_ERROR if the area isn't valid or there
+    //           are already SIOMM_SHADOW_MAX_REGIONS regions.
+    //---------------------------------------------------------------------------------------------
+
+    LONG Refresh();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Reads every SIOMM_SHADOW_READ region with one transaction each, all sent at
+    //           once. Dirty quadlets keep the value that was set until they are flushed.
+    //  Input  : none
+    //  Output : none
+    //  Returns: SIOMM_OK if every region was read, otherwise the first error found. The regions
+    //           that were read are updated anyway.
+    //---------------------------------------------------------------------------------------------
+
+    LONG Flush();
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Writes every dirty range. Contiguous dirty quadlets are written with one
+    //           transaction, and all the transactions are sent at once.
+    //  Input  : none
+    //  Output : none
+    //  Returns: SIOMM_OK if everything was written, otherwise the first error found. Ranges
+    //           that failed stay dirty; see IsDirty().
+    //---------------------------------------------------------------------------------------------
+
+    BOOL IsDirty(DWORD dwAddress, WORD wLength);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Checks whether any quadlet in a range is waiting to be written.
+    //  Input  : dwAddress - memory map address of the range.
+    //           wLength - length of the range in bytes.
+    //  Output : none
+    //  Returns: TRUE if some quadlet of the range is dirty.
+    //---------------------------------------------------------------------------------------------
+
+    // Access to the copy. The Get functions return SIOMM_ERROR_NOT_CONNECTED_YET for a read
+    // region that Refresh() hasn't read yet, and the Set functions return SIOMM_ERROR for an
+    // address outside the SIOMM_SHADOW_WRITE regions.
+    LONG GetQuad(DWORD dwAddress, DWORD * pdwQuadlet);
+    LONG SetQuad(DWORD dwAddress, DWORD dwQuadlet);
+    LONG GetFloat(DWORD dwAddress, float * pfValue);
+    LONG SetFloat(DWORD dwAddress, float fValue);
+    LONG GetBlock(DWORD dwAddress, WORD wLength, BYTE * pbyData);
+    LONG SetBlock(DWORD dwAddress, WORD wLength, BYTE * pbyData);
+
+    // Points, through the bank areas. These need regions on SIOMM_ABANK_READ_POINT_VALUES,
+    // SIOMM_ABANK_WRITE_POINT_VALUES, SIOMM_DBANK_READ_POINT_STATES and
+    // SIOMM_DBANK_WRITE_TURN_ON_MASK (with SIOMM_SHADOW_ACTION) respectively.
+    LONG GetAnaPtValue(long nPoint, float *pfValue);
+    LONG SetAnaPtValue(long nPoint, float fValue);
+    LONG GetDigBankPointStates(long *pnPts63to32, long *pnPts31to0);
+    LONG SetDigBankPointStates(long nPts63to32, long nPts31to0, long nMask63to32, long nMask31to0);
+
+
+  protected:
+    // Protected data
+
+    O22SnapIoMemMap *  m_pMemMap;  // The I/O unit
+
+    SIOMM_ShadowRegion m_arrRegions[SIOMM_SHADOW_MAX_REGIONS];
+    long               m_nRegions;
+
+    // The transactions of a Refresh() or Flush(), with the region and quadlets of each one
+    SIOMM_Transaction  m_arrTransactions[SIOMM_MAX_TRANSACTION_LABELS];
+    long               m_arrnRegion[SIOMM_MAX_TRANSACTION_LABELS];
+    long               m_arrnFirstQuad[SIOMM_MAX_TRANSACTION_LABELS];
+    long               m_arrnQuads[SIOMM_MAX_TRANSACTION_LABELS];
+
+
+    // Protected Members
+    SIOMM_ShadowRegion * FindRegion(DWORD dwAddress, WORD wLength);
+    LONG FlushTransactions(long nCount);
+};
+
+
+#endif // __O22SIOSH_H_
@@ -20,7 +20,8 @@
 //      packet from a registered I/O unit is received. Every time this callback
 //      is called, the function GetLastStreamStandardBlockEx() or 
 //      GetLastStreamCustomBlockEx() should be called, depending on the type set
-//      in step #3.
+//      in step #3. Alternatively, ReadStreamBlocks() can be called at any time
+//      to get every packet queued since the last call.
 //   6. StopStreamListening() may be called at any time to stop listening
 //      for a specified I/O unit.
 //   7. StartStreamListening() may be called at any time to add I/O units.
@@ -54,21 +55,68 @@
 // These type #defines are used in OpenStreaming()
 #define SIOMM_STREAM_TYPE_STANDARD           1
 #define SIOMM_STREAM_TYPE_CUSTOM             2
+
+// Stream packets start with a header quadlet. Custom stream packets follow it with the
+// memory map address of the data. Standard stream packets carry the stream read area
+// (SIOMM_STREAM_READ_AREA_SIZE bytes).
+#define SIOMM_STREAM_HEADER_SIZE             4
+#define SIOMM_STREAM_CUSTOM_HEADER_SIZE      8
+#define SIOMM_STREAM_STANDARD_DATA_SIZE      0x220
+#define SIOMM_STREAM_CUSTOM_MAX_DATA_SIZE    2034
+
+// How often, in milliseconds, the listening thread wakes up to check for timeouts and
+// for StopStreamListening() or CloseStreaming() when no packets arrive.
+#define SIOMM_STREAM_POLL_MS                 50
+
+// The number of received packets queued for each I/O unit. Must be a power of two.
+// When the queue is full, new packets aren't queued and are counted as overruns; the newest
+// packet is still kept for GetLastStreamStandardBlockEx() and GetLastStreamCustomBlockEx().
+#define SIOMM_STREAM_RING_SIZE               16
+
+// The most I/O units that can be listened to by one O22SnapIoStream. The lookup table has 
+// twice as many slots so that it never gets more than half full.
+#define SIOMM_STREAM_MAX_UNITS               256
+#define SIOMM_STREAM_TABLE_BITS              9
+#define SIOMM_STREAM_TABLE_SIZE              (1 << SIOMM_STREAM_TABLE_BITS)
   
 // These callback functions definitions are used in StartStreamListening()
 typedef LONG (* STREAM_CALLBACK_PROC)(void * pUserParam);
 typedef LONG (* STREAM_EVENT_CALLBACK_PROC)(LONG nTCPIPAddress, void * pUserParam, LONG nResult);
 
 
-// The O22StreamItem is used to create a linked list of I/O units that 
-// will be listened to.
+// A received stream packet and when it arrived, as queued for ReadStreamBlocks().
+typedef struct SIOMM_StreamTimedBlock
+{
+  SIOMM_StreamCustomBlock Block;       // The packet. Standard stream data is in Block.byData.
+  LONGLONG                nRecvTimeNS; // When it arrived, in nanoseconds on the O22GetTimeNS()
+                                       // clock. On Linux this is the kernel's arrival time.
+} O22_SIOMM_StreamTimedBlock;
+
+
+// The O22StreamItem keeps the packets of an I/O unit that is or was listened to.
+//
+// Items are only added and are not freed until CloseStreaming(), so the listening thread and
+// the user can look them up without taking the lock. Each item holds a single-producer, 
+// single-consumer ring of packets: only the listening thread advances nRingHead and only the
+// user advances nRingTail. The newest packet is also kept in Latest, which the listening thread
+// always overwrites, under the sequence lock nLatestSeq. Timeout tracking is kept out of the item, in arrays indexed by 
+// nIndex, so that CheckStreamTimeouts() scans contiguous memory.
 struct O22StreamItem 
 {
   DWORD           nIpAddress;           // IP address of brain
-  DWORD           nTimeout;             // timeout duration
-  DWORD           nLastPacketTickCount; // for tracking timeouts
-  BOOL            bTimeoutSent;         // flag for if a timeout error was sent already
-  O22StreamItem * pNext;                // next in the list
+  long            nIndex;               // index into the timeout arrays
+  volatile BOOL   bListening;           // cleared by StopStreamListening()
+
+  volatile DWORD  nRingHead;            // number of packets queued so far
+  volatile DWORD  nRingTail;            // number of packets taken by the user so far
+  volatile DWORD  nPackets;             // number of packets received
+  volatile DWORD  nOverruns;            // number of packets dropped because the ring was full
+  SIOMM_StreamTimedBlock arrRing[SIOMM_STREAM_RING_SIZE];
+
+  volatile DWORD  nLatestSeq;           // odd while Latest is written, 0 until the first packet
+  SIOMM_StreamTimedBlock Latest;        // the newest packet received
+
+  SIOMM_StreamTimedBlock LastBlock;     // the user's copy of Latest
 };
 
 
@@ -176,7 +224,11 @@ class O22SnapIoStream {
     //           Should only be called if the standard type was set in the OpenStreaming() method.
     //  Input  : none
     //  Output : pStreamData - Structure to receive the data from the last stream packet received.
-    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //  Returns: SIOMM_OK if everything is OK.
+    //           SIOMM_ERROR_NOT_CONNECTED_YET if no packet has been received yet.
+    //           SIOMM_TIME_OUT if the I/O unit that sent the last packet has timed out. 
+    //             pStreamData still receives the last packet.
+    //           Or possibly any other error
     //---------------------------------------------------------------------------------------------
 
 
@@ -190,6 +242,59 @@ class O22SnapIoStream {
     //           Should only be called if the custom type was set in the OpenStreaming() method.
     //  Input  : none
     //  Output : pStreamData - Structure to receive the data from the last stream packet received.
+    //  Returns: Same as GetLastStreamStandardBlockEx()
+    //---------------------------------------------------------------------------------------------
+
+    LONG GetLastStreamRecvTimeNS(LONGLONG * pnRecvTimeNS);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets when the packet last returned by GetLastStreamStandardBlockEx() or 
+    //           GetLastStreamCustomBlockEx() arrived.
+    //  Input  : none
+    //  Output : pnRecvTimeNS - The arrival time in nanoseconds on the monotonic O22GetTimeNS() 
+    //                          clock. On Linux this is the time the kernel received the packet.
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+
+    LONG ReadStreamBlocks(char * pchIpAddressArg, SIOMM_StreamTimedBlock * pBlocks, 
+                          long nMaxBlocks, long * pnBlocks);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Takes the packets queued for an I/O unit, oldest first. Up to 
+    //           SIOMM_STREAM_RING_SIZE packets are queued for each I/O unit; when the user falls
+    //           further behind, new packets are dropped and counted as overruns.
+    //           GetLastStreamStandardBlockEx() and GetLastStreamCustomBlockEx() always get the
+    //           newest packet, and drop the queued ones.
+    //
+    //           The queue has a single reader: call this function, GetLastStreamStandardBlockEx()
+    //           and GetLastStreamCustomBlockEx() from only one thread at a time, which may be the
+    //           listening thread through the stream event callback.
+    //  Input  : pchIpAddressArg - IP address of I/O unit in "X.X.X.X" form.
+    //           nMaxBlocks - The number of elements in pBlocks.
+    //  Output : pBlocks - The packets taken.  Standard stream packets can be converted with
+    //                     UnpackStreamStandardBlock().
+    //           pnBlocks - The number of packets taken. Zero if none were queued.
+    //  Returns: SIOMM_OK if everything is OK, an error otherwise.
+    //---------------------------------------------------------------------------------------------
+
+
+    LONG UnpackStreamStandardBlock(SIOMM_StreamCustomBlock * pBlock, 
+                                   SIOMM_StreamStandardBlock * pStreamData);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Converts a standard stream packet taken by ReadStreamBlocks().
+    //  Input  : pBlock - The packet.
+    //  Output : pStreamData - The unpacked standard stream data.
+    //  Returns: SIOMM_OK
+    //---------------------------------------------------------------------------------------------
+
+
+    LONG GetStreamCounters(char * pchIpAddressArg, long * pnPackets, long * pnOverruns);
+    //---------------------------------------------------------------------------------------------
+    //  Usage  : Gets the packet counters for an I/O unit since StartStreamListening() was first
+    //           called for it.
+    //  Input  : pchIpAddressArg - IP address of I/O unit in "X.X.X.X" form.
+    //  Output : pnPackets - The number of packets received.
+    //           pnOverruns - The number of packets dropped because the user didn't take the
+    //                        queued packets in time.
     //  Returns: SIOMM_OK if everything is OK, an error otherwise.
     //---------------------------------------------------------------------------------------------
 
@@ -216,15 +321,17 @@ class O22SnapIoStream {
     // The following members should be in the protected area. They're public so that
     // the StreamThread() function can get to them.
 
-      BOOL m_bListenToStreaming; // A flag used in StreamThread() to know when to stop listening
+      volatile BOOL m_bListenToStreaming; // A flag used in StreamThread() to know when to stop
+                                          // listening
 
       BYTE                       * m_pbyLastStreamBlock; // Byte array containing the last 
                                                          // block received
 
-      SIOMM_StreamCustomBlock      m_LastStreamBlock;    // Structure containing the last stream
-                                                         // block received. It can be converted to
-                                                         // a SIOMM_StreamStandardBlock structure
-                                                         // in GetLastStreamStandardBlockEx()
+      volatile DWORD               m_nLastStreamIpAddress; // Sender of the last packet queued.
+                                                           // Zero until a packet is queued.
+
+      LONGLONG                     m_nLastStreamRecvTimeNS; // Arrival time of the packet last
+                                                            // returned by GetLastStream*BlockEx()
 
       // The following members are used to store the callback functions and user parameters
       // set in the SetCallbackFuntions() function.
@@ -246,7 +353,7 @@ class O22SnapIoStream {
     long        m_nStreamLength; // The length set in OpenStreaming()
 
 #ifdef _WIN32
-    DWORD            m_hStreamThread; // Handle to the stream listening thread
+    HANDLE           m_hStreamThread; // Handle to the stream listening thread
     CRITICAL_SECTION m_StreamCriticalSection;
 #endif
 #ifdef _LINUX
@@ -255,14 +362,30 @@ class O22SnapIoStream {
 #endif
 
 
-    // This class keeps a linked list of I/O units to listen for. 
-    // The O22StreamItem structure keeps information on each I/O unit and has a pNext
-    // pointer to let use make the list structure. 
-    O22StreamItem * pStreamList;      // The head of the list
-    long            nStreamListCount; // The number of items in the list
+    // This class keeps a table of I/O units to listen for, keyed by IP address with open 
+    // addressing and linear probing. Slots are filled under the lock and never emptied until 
+    // CloseStreaming(), so lookups don't need the lock.
+    O22StreamItem * volatile m_arrStreamTable[SIOMM_STREAM_TABLE_SIZE];
+    O22StreamItem *          m_arrStreamItems[SIOMM_STREAM_MAX_UNITS]; // by nIndex
+    volatile long            m_nStreamItems;     // The number of items in the table
+    long                     nStreamListCount;   // The number of items being listened to
+
+    // Timeout tracking for each item, by nIndex. An item is armed while it is listened to and
+    // its timeout event hasn't been sent; it times out once the tick count passes its deadline.
+    // They aren't volatile so that the scan can be vectorized.
+    DWORD                    m_arrStreamTimeout[SIOMM_STREAM_MAX_UNITS];
+    DWORD                    m_arrStreamDeadline[SIOMM_STREAM_MAX_UNITS];
+    DWORD                    m_arrStreamArmed[SIOMM_STREAM_MAX_UNITS];
 
     
     // Protected Members
+    void LockStream();
+    void UnlockStream();
+    LONG StartStreamThread();
+    void StopStreamThread();
+    O22StreamItem * FindStreamItem(DWORD nIpAddress);
+    O22StreamItem * FindStreamItem(char * pchIpAddressArg);
+    LONG TakeLastStreamBlock(SIOMM_StreamCustomBlock ** ppBlock);
 
 
   private:
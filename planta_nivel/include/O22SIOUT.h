@@ -30,14 +30,18 @@
 #include <sys/times.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <poll.h>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <fcntl.h>
 #include <arpa/inet.h>
 #include <string.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <errno.h>
+#include <time.h>
 
 // The following socket items are taken from Windows
 typedef int SOCKET;
@@ -49,6 +53,9 @@ typedef int    BOOL;
 #define FALSE  0
 #define TRUE   1
 
+// The following integer type is taken from Windows
+typedef long long LONGLONG;
+
 #endif // _LINUX
 
 
@@ -186,5 +193,45 @@ extern float O22MAKEFLOAT2(BYTE * a, long o);
 #define SIOMM_TCP   SOCK_STREAM
 #define SIOMM_UDP   SOCK_DGRAM
 
+
+// Arrival timestamps.  O22GetTimeNS() is a monotonic clock in nanoseconds.  Sockets set up
+// with O22EnableRecvTimeStamps() have the kernel stamp incoming packets, and 
+// O22RecvTimeStamped() reports when the received data arrived on the O22GetTimeNS() clock.
+// Where the kernel can't stamp packets, the time of the receive call is reported instead.
+extern LONGLONG O22GetTimeNS();
+extern void     O22EnableRecvTimeStamps(SOCKET Socket);
+extern long     O22RecvTimeStamped(SOCKET Socket, char * pchBuffer, long nLength,
+                                   sockaddr_in * pSourceAddress, LONGLONG * pnRecvTimeNS);
+#ifdef _LINUX
+// For messages received some other way: moves *pnRecvTimeNS, taken when the receive finished,
+// back to the kernel's stamp in the control data of the message, if there is one.
+extern void     O22MessageTimeStamp(struct msghdr * pMessage, LONGLONG * pnRecvTimeNS);
+#endif
+
+// Bulk conversion between the big-endian quadlets of the memory map and host values, for
+// banks and blocks.  O22UnpackFloats() and O22PackFloats() do what O22MAKELONG2() and
+// O22FILL_ARRAY_FROM_LONG() do to each quadlet, and O22UnpackLongs() zero extends each quadlet
+// like O22MAKELONG2() does.  Where the processor has SSSE3 or AVX2 they swap many quadlets
+// with each instruction; the choice is made once, at the first call.
+extern void O22UnpackFloats(const BYTE * pbyData, float * pfValues, long nCount);
+extern void O22PackFloats(const float * pfValues, BYTE * pbyData, long nCount);
+extern void O22UnpackLongs(const BYTE * pbyData, long * pnValues, long nCount);
+
+// Gather sends.  O22SendGather() sends a list of buffers with one system call, as send() would
+// send them one after the other, and returns the number of bytes sent or SOCKET_ERROR.
+// O22SendDatagrams() sends datagrams made of two buffers each, the second maybe empty, with as
+// few system calls as the platform allows, and returns the number of datagrams sent or 
+// SOCKET_ERROR.  Both take at most SIOMM_SEND_MAX_BUFFERS buffers per call.
+#define SIOMM_SEND_MAX_BUFFERS 128
+
+typedef struct SIOMM_SendBuffer
+{
+  BYTE * pbyData;
+  long   nLength;
+} O22_SIOMM_SendBuffer;
+
+extern long O22SendGather(SOCKET Socket, SIOMM_SendBuffer * pBuffers, long nBuffers);
+extern long O22SendDatagrams(SOCKET Socket, SIOMM_SendBuffer * pBuffers, long nDatagrams);
+
 #endif // __O22SIOUT_H_
 
@@ -0,0 +1,353 @@
+#ifndef _LINUX
+#error "RTBlock.cpp es solo para Linux; en Windows se usa RTBlock.mexw64"
+#endif
+
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/prctl.h>
+
+extern "C" {
+
+#define S_FUNCTION_NAME  RTBlock
+#define S_FUNCTION_LEVEL 2
+
+#include "simstruc.h"
+
+/* Parametros del bloque, los mismos de RTBlock.mexw64 y de su mascara en RT.mdl */
+#define NPARAMETROS			3
+#define PARAM_PASO			0		// [ms]
+#define PARAM_PRIORIDAD		1		// Clase de prioridad: IDLE, NORMAL, HIGH, REAL-TIME
+#define PARAM_PRIORIDAD_HILO	2	// IDLE, LOWEST, NORMAL, HIGHEST, TIME CRITICAL
+
+/* Opciones del popup de la clase de prioridad */
+#define PRIORIDAD_IDLE		1		// nice 19
+#define PRIORIDAD_NORMAL	2		// Sin cambios
+#define PRIORIDAD_HIGH		3		// nice -10
+#define PRIORIDAD_REAL_TIME	4		// SCHED_FIFO con la prioridad del hilo
+
+#define NICE_IDLE			19
+#define NICE_HIGH			-10
+
+/* Prioridad SCHED_FIFO de cada opcion del popup de prioridad del hilo. Quedan bajo 50, la de
+   los hilos de interrupciones del kernel, para no dejar sin atender a la tarjeta de red. Un
+   valor fuera del popup se usa directamente como prioridad SCHED_FIFO */
+#define NPRIORIDADES_HILO	5
+static const int prioridadFifo[NPRIORIDADES_HILO] = { 1, 10, 20, 30, 49 };
+
+/* Salida del bloque: retraso del paso, sobrepasos, peor retraso e histograma del retraso */
+#define SALIDA_RETRASO		0		// [s] despertar menos el instante ideal del paso
+#define SALIDA_SOBREPASOS	1		// Pasos que empezaron despues de su instante ideal
+#define SALIDA_PEOR_RETRASO	2		// [s]
+#define SALIDA_HISTOGRAMA	3		// NHISTOGRAMA cuentas
+#define NHISTOGRAMA			8
+#define NSALIDAS			(SALIDA_HISTOGRAMA+NHISTOGRAMA)
+
+/* Limites superiores de las clases del histograma, en % del paso; la ultima no tiene limite */
+static const double limiteHistograma[NHISTOGRAMA-1] = { 1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0 };
+
+/* Holgura del temporizador del hilo durante la simulacion: sin SCHED_FIFO el kernel puede
+   atrasar cada despertar hasta 50 us para agrupar temporizadores */
+#define HOLGURA_NS			1000
+
+/* Elementos del vector de punteros (PWork) */
+#define PWORK_RITMO			0
+#define NPWORK				1
+
+typedef struct {
+	long long periodoNS;
+	long long proximoNS;			// Instante ideal del proximo paso, CLOCK_MONOTONIC
+	long long pasos;
+	long long sobrepasos;
+	long long peorRetrasoNS;
+	long long histograma[NHISTOGRAMA];
+	int cambioPolitica;				// Hay que restaurar la politica original
+	int politicaOriginal;
+	struct sched_param paramOriginal;
+	int cambioNice;
+	int niceOriginal;
+	int holguraOriginal;
+} RitmoRT;
+
+/* Function: ahoraNS ==========================================================
+ * Abstract:
+ *    Entrega el reloj monotonico en nanosegundos.
+ */
+static long long ahoraNS(void)
+{
+	struct timespec tsAhora;
+
+	clock_gettime(CLOCK_MONOTONIC, &tsAhora);
+	return (long long)tsAhora.tv_sec*1000000000 + tsAhora.tv_nsec;
+}
+
+/* Function: esperarHasta =====================================================
+ * Abstract:
+ *    Duerme hasta el instante absoluto indicado del reloj monotonico. Al
+ *    ser absoluto, una senal que interrumpe la espera no alarga el paso.
+ */
+static void esperarHasta(long long instanteNS)
+{
+	struct timespec tsInstante;
+
+	tsInstante.tv_sec  = (time_t)(instanteNS/1000000000);
+	tsInstante.tv_nsec = (long)(instanteNS%1000000000);
+	while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tsInstante, NULL) == EINTR )
+		;
+}
+
+/* Function: claseHistograma ==================================================
+ * Abstract:
+ *    Entrega la clase del histograma de un retraso, segun su fraccion del
+ *    paso.
+ */
+static int claseHistograma(long long retrasoNS, long long periodoNS)
+{
+	double porcentaje = 100.0*(double)retrasoNS/(double)periodoNS;
+	int k;
+
+	for( k=0; k<NHISTOGRAMA-1; k++ )
+	{
+		if ( porcentaje < limiteHistograma[k] )
+			return k;
+	}
+	return NHISTOGRAMA-1;
+}
+
+/* Function: fijarPrioridad ===================================================
+ * Abstract:
+ *    Aplica la clase de prioridad y la prioridad del hilo al hilo de la
+ *    simulacion, guardando la configuracion original para mdlTerminate.
+ *    Sin permisos (CAP_SYS_NICE o RLIMIT_RTPRIO) solo se avisa: la
+ *    simulacion sigue al ritmo del reloj, con mas jitter.
+ */
+static void fijarPrioridad(SimStruct *S, RitmoRT *Ritmo)
+{
+	struct sched_param param;
+	int clase,hilo,minimo,maximo;
+
+	clase = (int) mxGetScalar(ssGetSFcnParam(S, PARAM_PRIORIDAD));
+	hilo  = (int) mxGetScalar(ssGetSFcnParam(S, PARAM_PRIORIDAD_HILO));
+
+	if ( clase == PRIORIDAD_REAL_TIME )
+	{
+		if ( hilo >= 1 && hilo <= NPRIORIDADES_HILO )
+			param.sched_priority = prioridadFifo[hilo-1];
+		else
+			param.sched_priority = hilo;
+		minimo = sched_get_priority_min(SCHED_FIFO);
+		maximo = sched_get_priority_max(SCHED_FIFO);
+		if ( param.sched_priority < minimo )
+			param.sched_priority = minimo;
+		if ( param.sched_priority > maximo )
+			param.sched_priority = maximo;
+
+		pthread_getschedparam(pthread_self(), &Ritmo->politicaOriginal, &Ritmo->paramOriginal);
+		if ( pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0 )
+			Ritmo->cambioPolitica = 1;
+		else
+			ssWarning(S,"No se pudo usar SCHED_FIFO (falta CAP_SYS_NICE o RLIMIT_RTPRIO). "
+						"La simulacion sigue con la prioridad normal.");
+	}
+	else if ( clase == PRIORIDAD_IDLE || clase == PRIORIDAD_HIGH )
+	{
+		// En Linux setpriority() con el proceso 0 cambia solo al hilo que la llama
+		errno = 0;
+		Ritmo->niceOriginal = getpriority(PRIO_PROCESS, 0);
+		if ( errno == 0 &&
+			 setpriority(PRIO_PROCESS, 0, clase == PRIORIDAD_IDLE ? NICE_IDLE : NICE_HIGH) == 0 )
+			Ritmo->cambioNice = 1;
+		else
+			ssWarning(S,"No se pudo cambiar la prioridad del hilo de la simulacion.");
+	}
+
+	// SCHED_FIFO no tiene holgura; a los demas hilos se les reduce durante la simulacion
+	Ritmo->holguraOriginal = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+	if ( Ritmo->holguraOriginal > 0 )
+		prctl(PR_SET_TIMERSLACK, HOLGURA_NS, 0, 0, 0);
+}
+
+/* Function: restaurarPrioridad ===============================================
+ * Abstract:
+ *    Devuelve al hilo de la simulacion la prioridad que tenia antes de
+ *    mdlStart; el hilo sigue siendo el de MATLAB despues de la simulacion.
+ */
+static void restaurarPrioridad(RitmoRT *Ritmo)
+{
+	if ( Ritmo->cambioPolitica )
+		pthread_setschedparam(pthread_self(), Ritmo->politicaOriginal, &Ritmo->paramOriginal);
+	if ( Ritmo->cambioNice )
+		setpriority(PRIO_PROCESS, 0, Ritmo->niceOriginal);
+	if ( Ritmo->holguraOriginal > 0 )
+		prctl(PR_SET_TIMERSLACK, Ritmo->holguraOriginal, 0, 0, 0);
+}
+
+/*====================*
+ * S-function methods *
+ *====================*/
+
+
+/* Function: mdlInitializeSizes ===============================================
+ * Abstract:
+ *    The sizes information is used by Simulink to determine the S-function
+ *    block's characteristics (number of inputs, outputs, states, etc.).
+ */
+static void mdlInitializeSizes(SimStruct *S)
+{
+    ssSetNumSFcnParams(S, NPARAMETROS);	// paso, clase de prioridad, prioridad del hilo
+
+    if (ssGetSFcnParamsCount(S) != NPARAMETROS) {
+        ssSetErrorStatus(S,"Numero de parametros incorrecto.");
+        return;
+    }
+    if (mxGetScalar(ssGetSFcnParam(S, PARAM_PASO)) <= 0.0) {
+        ssSetErrorStatus(S,"El paso debe ser positivo.");
+        return;
+    }
+
+    ssSetNumContStates(S, 0);
+    ssSetNumDiscStates(S, 0);
+
+    if (!ssSetNumInputPorts(S,0)) return;
+
+    if (!ssSetNumOutputPorts(S,1)) return;
+	ssSetOutputPortWidth( S, 0, NSALIDAS );
+
+    ssSetNumSampleTimes(S, 1);
+    ssSetNumRWork(S, 0);
+    ssSetNumIWork(S, 0);
+    ssSetNumPWork(S, NPWORK);		// reserve element in the pointers vector
+    ssSetNumModes(S, 0);
+    ssSetNumNonsampledZCs(S, 0);
+
+    ssSetOptions(S, 0);
+}
+
+
+/* Function: mdlInitializeSampleTimes =========================================
+ * Abstract:
+ *    El bloque corre con el paso indicado, en milisegundos.
+ */
+static void mdlInitializeSampleTimes(SimStruct *S)
+{
+    ssSetSampleTime(S, 0, mxGetScalar(ssGetSFcnParam(S, PARAM_PASO))/1000.0);
+    ssSetOffsetTime(S, 0, 0.0);
+}
+
+/* Function: mdlStart =======================================================
+ * Abstract:
+ *    Fija la prioridad del hilo de la simulacion. El reloj parte en el
+ *    primer mdlOutputs, para no contar el tiempo de inicio del modelo.
+ */
+#define MDL_START
+#if defined(MDL_START)
+static void mdlStart(SimStruct *S)
+{
+	RitmoRT *Ritmo;
+
+	Ritmo = new RitmoRT();
+	Ritmo->periodoNS = (long long)(mxGetScalar(ssGetSFcnParam(S, PARAM_PASO))*1e6);
+	ssGetPWork(S)[PWORK_RITMO] = (void *) Ritmo;
+
+	fijarPrioridad(S, Ritmo);
+}
+#endif /*  MDL_START */
+
+/* Function: mdlOutputs =======================================================
+ * Abstract:
+ *    Duerme hasta el instante ideal del paso, medido desde el primer paso
+ *    con el reloj monotonico, y entrega las estadisticas del ritmo. Si el
+ *    paso ya esta atrasado no se duerme y se cuenta un sobrepaso; los pasos
+ *    siguientes se miden desde ese instante, sin recuperar el atraso con
+ *    pasos seguidos.
+ */
+static void mdlOutputs(SimStruct *S, int_T tid)
+{
+	/********************************************
+	* Salidas :
+	*	0:	Retraso del paso [s]
+	*	1:	Sobrepasos
+	*	2:	Peor retraso [s]
+	*	3-10:	Histograma del retraso, en % del paso:
+	*		<1, <2, <5, <10, <20, <50, <100, >=100
+	********************************************/
+
+	RitmoRT *Ritmo = (RitmoRT *) ssGetPWork(S)[PWORK_RITMO];
+	real_T *y = ssGetOutputPortRealSignal(S,0);
+	long long ahora,retraso;
+	int k;
+
+	ahora = ahoraNS();
+	if ( Ritmo->pasos == 0 )
+		Ritmo->proximoNS = ahora;
+
+	if ( ahora > Ritmo->proximoNS )
+	{
+		Ritmo->sobrepasos++;
+		retraso = ahora - Ritmo->proximoNS;
+		Ritmo->proximoNS = ahora;
+	}
+	else
+	{
+		esperarHasta(Ritmo->proximoNS);
+		retraso = ahoraNS() - Ritmo->proximoNS;
+	}
+
+	Ritmo->pasos++;
+	Ritmo->proximoNS += Ritmo->periodoNS;
+	if ( retraso > Ritmo->peorRetrasoNS )
+		Ritmo->peorRetrasoNS = retraso;
+	Ritmo->histograma[claseHistograma(retraso, Ritmo->periodoNS)]++;
+
+	y[SALIDA_RETRASO] = (real_T)retraso*1e-9;
+	y[SALIDA_SOBREPASOS] = (real_T)Ritmo->sobrepasos;
+	y[SALIDA_PEOR_RETRASO] = (real_T)Ritmo->peorRetrasoNS*1e-9;
+	for( k=0; k<NHISTOGRAMA; k++ )
+		y[SALIDA_HISTOGRAMA+k] = (real_T)Ritmo->histograma[k];
+}
+
+/* Function: mdlTerminate =====================================================
+ * Abstract:
+ *    Restaura la prioridad del hilo y muestra un resumen del ritmo de la
+ *    simulacion.
+ */
+static void mdlTerminate(SimStruct *S)
+{
+	RitmoRT *Ritmo = (RitmoRT *) ssGetPWork(S)[PWORK_RITMO];
+	int k;
+
+	if ( Ritmo == NULL )
+		return;
+
+	restaurarPrioridad(Ritmo);
+
+	ssPrintf("RTBlock: %lld pasos, %lld sobrepasos, peor retraso %.3f ms\n",
+			 Ritmo->pasos, Ritmo->sobrepasos, (double)Ritmo->peorRetrasoNS*1e-6);
+	for( k=0; k<NHISTOGRAMA; k++ )
+	{
+		if ( k < NHISTOGRAMA-1 )
+			ssPrintf("  retraso < %5.1f%% del paso: %lld\n", limiteHistograma[k], Ritmo->histograma[k]);
+		else
+			ssPrintf("  retraso >= %4.1f%% del paso: %lld\n", limiteHistograma[k-1], Ritmo->histograma[k]);
+	}
+
+	delete Ritmo;
+	ssGetPWork(S)[PWORK_RITMO] = NULL;
+}
+
+/*=============================*
+ * Required S-function trailer *
+ *=============================*/
+
+#ifdef  MATLAB_MEX_FILE    /* Is this file being compiled as a MEX-file? */
+#include "simulink.c"      /* MEX-file interface mechanism */
+#else
+#include "cg_sfun.h"       /* Code generation registration function */
+#endif
+
+
+} // end of extern "C" scope
+
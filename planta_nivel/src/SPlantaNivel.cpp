@@ -1,14 +1,995 @@
+#include <math.h>
+
+// Las clases del brain son C++ y quedan fuera del bloque extern "C"
+#include "O22SIOMM.h"
+#include "O22SIOST.h"
+#include "O22SIOPL.h"
+
 extern "C" {
 
 #define S_FUNCTION_NAME  SPlantaNivel
 #define S_FUNCTION_LEVEL 2
 
 #include "simstruc.h"
-#include "O22SIOMM.h"
 
 #define NENTRADAS	10
 #define NSALIDAS	9
 
+/* Segundo puerto de salida: instante de llegada de las mediciones */
+#define PUERTO_LLEGADA	1
+/* Tercer puerto de salida: 1 si las mediciones son de este paso, 0 si se retienen */
+#define PUERTO_VALIDO	2
+/* Cuarto puerto de salida: edad de las mediciones al entregarlas al modelo */
+#define PUERTO_EDAD		3
+/* Con lazo interno, quinto puerto de salida: accion del lazo [%] */
+#define PUERTO_ACCION	4
+/* Con lazo interno, segundo puerto de entrada: referencia y ganancias */
+#define PUERTO_CONSIGNA	1
+
+/* Parametros del bloque: Ts es obligatorio, el resto es opcional */
+#define NPARAMETROS			6
+#define PARAM_TS			0
+#define PARAM_MODO_LECTURA	1
+#define PARAM_BANDA_MUERTA	2		// [%] por salida analogica, escalar o vector de 3
+#define PARAM_REFRESCO		3		// [s] periodo de reescritura forzada, 0 la desactiva
+#define PARAM_PERIODO_HILO	4		// [s] periodo del hilo de E/S, 0 lo desactiva
+#define PARAM_LAZO_INTERNO	5		// [sensor actuador] del lazo interno, [] lo desactiva
+
+/* Modos de adquisicion de los sensores en mdlOutputs */
+#define LECTURA_POR_PUNTO	0		// Una transaccion por sensor
+#define LECTURA_POR_BANCO	1		// Un solo ReadBlock del banco analogico
+#define LECTURA_POR_STREAM	2		// El brain transmite el banco por UDP, sin peticiones
+
+/* Conexion con el brain */
+#define IP_BRAIN			"192.168.6.100"
+#define PUERTO_BRAIN		2001
+#define FRACCION_PASO		0.8		// Fraccion del periodo del hilo de E/S que pueden tomar sus transacciones
+#define FRACCION_CALLBACK	0.4		// Fraccion de Ts para las lecturas de mdlOutputs, y otra igual para las escrituras de mdlUpdate
+#define TIMEOUT_MAXIMO_MS	1000	// Timeout de una transaccion antes de medir la red
+#define TIMEOUT_MINIMO_MS	5		// Cota inferior del timeout adaptativo
+#define REINTENTOS_LECTURA	2		// Reintentos de una lectura con timeout o brain ocupado
+
+/* Reconexion con el brain sin detener la simulacion */
+#define FALLAS_RECONEXION	3		// Pasos seguidos con timeout para dar la conexion por perdida
+#define TIMEOUT_RECONEXION_MS	1000	// Timeout de cada intento de reconexion
+#define ESPERA_INICIAL_S	0.1		// Espera antes de repetir un intento fallido...
+#define ESPERA_MAXIMA_S		5.0		// ...que se duplica con cada intento hasta este valor
+#define TIMEOUT_CIERRE_MS	2000	// Timeout para reconectar y apagar los actuadores al terminar
+
+/* Estados de la conexion (IWork) */
+#define CONEXION_ACTIVA		0
+#define CONEXION_CAIDA		1		// Socket cerrado, esperando el proximo intento
+#define CONEXION_ABRIENDO	2		// Conexion en curso, se revisa sin bloquear en cada paso
+
+/* Stream UDP del brain (modo LECTURA_POR_STREAM) */
+#define PUERTO_STREAM		5001
+#define TIMEOUT_STREAM_MS	1000	// Sin paquetes durante este tiempo se considera perdido
+
+/* Elementos del vector de punteros (PWork) */
+#define PWORK_BRAIN			0
+#define PWORK_STREAM		1
+#define PWORK_COPIA			2		// Copia local del mapa de memoria del brain
+#define PWORK_PLAN			3		// Ubicacion de cada canal en la copia
+#define PWORK_HILO			4		// Hilo de E/S, NULL si no se usa
+#define NPWORK				5
+
+/* Items del plan de acceso: los sensores, las salidas analogicas y luego las digitales */
+#define ITEM_SALIDAS		0
+#define ITEM_ESCRITURAS		NSALIDAS
+
+/* Elementos del vector de enteros (IWork) */
+#define IWORK_MODO_LECTURA	0
+#define IWORK_CONEXION		1
+#define IWORK_FALLAS		2		// Pasos seguidos con fallas de comunicacion
+#define IWORK_ESCRIBIR_TODO	3		// Las escrituras anteriores no son confiables
+#define IWORK_INTERVALO_STREAM	4	// [ms] entre paquetes del stream
+#define NIWORK				5
+
+/* Elementos del vector de reales (RWork): ultimas mediciones validas y reconexion */
+#define RWORK_SALIDAS		0		// NSALIDAS valores
+#define RWORK_LLEGADA		NSALIDAS
+#define RWORK_PROXIMO_INTENTO	(NSALIDAS+1)	// [s], reloj de O22GetTimeNS()
+#define RWORK_ESPERA		(NSALIDAS+2)	// [s]
+#define RWORK_ESCRITO		(NSALIDAS+3)	// Ultimo valor escrito de cada canal (NESCRITURAS)
+#define RWORK_INSTANTE_ESCRITO	(RWORK_ESCRITO+NESCRITURAS)	// [s], reloj de O22GetTimeNS()
+#define RWORK_BANDA_MUERTA	(RWORK_INSTANTE_ESCRITO+NESCRITURAS)	// [mA] por salida analogica
+#define RWORK_REFRESCO		(RWORK_BANDA_MUERTA+NESCRITURAS_ANA)	// [s]
+#define NRWORK				(RWORK_REFRESCO+1)
+
+/* Lazo interno: un PID discreto que corre en el hilo de E/S, a su periodo, entre un sensor de
+   nivel y el variador o la valvula motorizada. Simulink solo entrega la consigna */
+#define LAZO_REFERENCIA		0		// En las unidades del sensor
+#define LAZO_KP				1		// [%/unidad]
+#define LAZO_KI				2		// [%/(unidad s)]
+#define LAZO_KD				3		// [% s/unidad]
+#define NLAZO				4
+#define SENSOR_LAZO_MAXIMO	2		// Salidas 0 a 2: presion conico, presion cuadrado, ultrasonico
+#define ACCION_MINIMA		0.0		// [%]
+#define ACCION_MAXIMA		100.0	// [%]
+#define FILTRO_DERIVADA_S	0.01	// [s] constante de tiempo del filtro de la derivada
+
+typedef struct {
+	int activo;
+	int sensor;						// Salida del bloque que se controla
+	int actuador;					// Entrada del bloque que se comanda (0 o 2)
+	int iniciado;					// Ya se calculo una accion desde el primer comando
+	real_T integral;				// [%], integral de Ki*error
+	real_T derivada;				// Derivada filtrada de la medicion
+	real_T medicionAnterior;
+	real_T llegadaAnterior;			// [s], reloj de O22GetTimeNS()
+	real_T accion;					// [%]
+} LazoInterno;
+
+/* Hilo de E/S: lee los sensores y escribe los actuadores con su propio periodo. Es dueno del
+   brain, de la copia y de RWork e IWork; con la S-function solo comparte la ultima muestra de
+   los sensores y los ultimos comandos, cada uno en un BufferSeq */
+#define MUESTRA_LLEGADA		NSALIDAS		// [s], reloj de O22GetTimeNS()
+#define MUESTRA_NUMERO		(NSALIDAS+1)	// Lecturas validas hasta esta muestra
+#define MUESTRA_ACCION		(NSALIDAS+2)	// [%] accion del lazo interno
+#define NMUESTRA			(NSALIDAS+3)
+#define COMANDO_NUMERO		NENTRADAS		// Comandos entregados por mdlUpdate
+#define COMANDO_LAZO		(NENTRADAS+1)	// Consigna del lazo interno (NLAZO)
+#define NCOMANDO			(COMANDO_LAZO+NLAZO)
+#define NDATOS_SEQ			(NMUESTRA > NCOMANDO ? NMUESTRA : NCOMANDO)
+
+typedef struct {
+	volatile DWORD secuencia;		// Impar mientras el escritor cambia los datos
+	volatile real_T datos[NDATOS_SEQ];
+} BufferSeq;
+
+typedef struct {
+	SimStruct *S;
+	real_T periodo;					// [s]
+	LazoInterno lazo;				// Solo lo usa el hilo, salvo activo, sensor y actuador
+	volatile BOOL ejecutando;		// Se borra en mdlTerminate para detener el hilo
+	BufferSeq muestra;				// Escrita por el hilo, leida en mdlOutputs
+	BufferSeq comandos;				// Escrita en mdlUpdate, leida por el hilo
+	const char * volatile aviso;	// Aviso del hilo pendiente para mdlOutputs
+	const char * volatile error;	// Error que detiene la simulacion; el hilo deja de operar
+	real_T numeroVisto;				// Numero de la muestra entregada en el paso anterior
+	real_T numeroComando;			// Comandos publicados por mdlUpdate
+#ifdef _WIN32
+	HANDLE hHilo;
+#endif
+#ifdef _LINUX
+	pthread_t hHilo;
+#endif
+} HiloIO;
+
+/* Puntos analogicos que se leen en mdlOutputs, en el orden de las salidas */
+static const long puntosSalida[NSALIDAS] = { 0, 1, 2, 8, 9, 6, 4, 5, 10 };
+
+static const char *errorSalida[NSALIDAS] = {
+	"Error al recibir el dato de presion (conico).",
+	"Error al recibir el dato de presion (recirculacion).",
+	"Error al recibir el dato de presion (ultrasonico).",
+	"Error al recibir el dato de flujo.",
+	"Error al recibir el dato de presion bomba 1.",
+	"Error al recibir el dato de temperatura (cuadrado).",
+	"Error al recibir el dato de temperatura (conico).",
+	"Error al recibir el dato de temperatura (recirculacion).",
+	"Error al recibir el dato de velocidad."
+};
+
+/* Puntos digitales comandados por las entradas u[3..9] */
+#define PRIMERA_ENTRADA_DIG	3
+#define NENTRADAS_DIG		7
+static const long puntosEntradaDig[NENTRADAS_DIG] = { 20, 22, 21, 23, 24, 25, 26 };
+#define PUNTO_DIG_MINIMO	20
+#define PUNTO_DIG_MAXIMO	26
+
+static const char *errorConfiguracionDig[NENTRADAS_DIG] = {
+	"No se pudo configurar al calefactor 1.",
+	"No se pudo configurar al calefactor 2.",
+	"No se pudo configurar al calefactor 3.",
+	"No se pudo configurar al agitador.",
+	"No se pudo configurar la valvula solenoide 1.",
+	"No se pudo configurar la valvula solenoide 2.",
+	"No se pudo configurar a las luces del laboratorio."
+};
+
+/* Transacciones de mdlUpdate: tres salidas analogicas y el banco digital */
+#define NESCRITURAS			4
+#define NESCRITURAS_ANA		3
+#define ESCRITURA_DIG		3
+static const long puntosEscrituraAna[NESCRITURAS_ANA] = { 16, 13, 12 };
+
+static const char *errorEscritura[NESCRITURAS] = {
+	"Error al transmitir el dato del variador de frecuencia.",
+	"Error al transmitir el dato de la valvula solenoide.",
+	"Error al transmitir el dato de la valvula motorizada.",
+	"Error al transmitir los datos de los actuadores digitales."
+};
+
+/* Function: mascaraDigital ===================================================
+ * Abstract:
+ *    Arma las mascaras de estados y de puntos para SetDigBankPointStates() a
+ *    partir de las entradas digitales. Si u es NULL todos los puntos quedan
+ *    apagados. Todos los actuadores estan en los puntos 0 a 31 del banco.
+ */
+static void mascaraDigital(const real_T *u, long *pnPts31to0, long *pnMask31to0)
+{
+	int k;
+
+	*pnPts31to0  = 0;
+	*pnMask31to0 = 0;
+	for( k=0; k<NENTRADAS_DIG; k++ )
+	{
+		*pnMask31to0 |= 1L << puntosEntradaDig[k];
+		if( u != NULL && (float)u[PRIMERA_ENTRADA_DIG+k] > 0.5 )
+			*pnPts31to0 |= 1L << puntosEntradaDig[k];
+	}
+}
+
+/* Function: paramOpcional ====================================================
+ * Abstract:
+ *    Entrega el valor escalar del parametro k del bloque, o el valor por
+ *    defecto si el parametro no fue entregado.
+ */
+static real_T paramOpcional(SimStruct *S, int k, real_T defecto)
+{
+	if ( k >= ssGetSFcnParamsCount(S) )
+		return defecto;
+	return mxGetScalar(ssGetSFcnParam(S, k));
+}
+
+/* Function: configurarStream ================================================
+ * Abstract:
+ *    Indica al brain que transmita su area de stream a este computador cada
+ *    medio periodo de adquisicion, calculado en mdlStart.
+ */
+static long configurarStream(SimStruct *S, O22SnapIoMemMap *Brain)
+{
+	char ipLocal[16];
+	long nResult;
+
+	nResult = Brain->GetLocalIpAddress(ipLocal, sizeof(ipLocal));
+	if ( nResult == SIOMM_OK )
+		nResult = Brain->SetStreamTarget(0, ipLocal);
+	if ( nResult == SIOMM_OK )
+		nResult = Brain->SetStreamConfiguration(1, ssGetIWork(S)[IWORK_INTERVALO_STREAM],
+												PUERTO_STREAM, 0, 0, 0);
+
+	return nResult;
+}
+
+/* Function: paramOpcionalVector =============================================
+ * Abstract:
+ *    Entrega el elemento i del parametro k del bloque. Un parametro escalar
+ *    vale para todos los elementos; si no fue entregado, o es mas corto, se
+ *    usa el valor por defecto.
+ */
+static real_T paramOpcionalVector(SimStruct *S, int k, int i, real_T defecto)
+{
+	if ( k >= ssGetSFcnParamsCount(S) )
+		return defecto;
+	if ( mxGetNumberOfElements(ssGetSFcnParam(S, k)) == 1 )
+		return mxGetScalar(ssGetSFcnParam(S, k));
+	if ( i >= (int)mxGetNumberOfElements(ssGetSFcnParam(S, k)) )
+		return defecto;
+	return mxGetPr(ssGetSFcnParam(S, k))[i];
+}
+
+/* Function: lazoInterno =====================================================
+ * Abstract:
+ *    Indica si el bloque tiene lazo interno, es decir, si el parametro del
+ *    lazo entrega el sensor y el actuador.
+ */
+static int lazoInterno(SimStruct *S)
+{
+	if ( PARAM_LAZO_INTERNO >= ssGetSFcnParamsCount(S) )
+		return 0;
+	return mxGetNumberOfElements(ssGetSFcnParam(S, PARAM_LAZO_INTERNO)) >= 2;
+}
+
+/* Function: escrituraNecesaria ===============================================
+ * Abstract:
+ *    Decide si el canal k debe escribirse en este paso: cuando el nuevo valor
+ *    sale de la banda muerta en torno al ultimo valor escrito, o cuando se
+ *    cumple el periodo de refresco, para que el watchdog del brain siga
+ *    viendo trafico. Despues de iniciar o reconectar se escribe todo.
+ */
+static int escrituraNecesaria(SimStruct *S, int k, real_T valor, real_T ahora)
+{
+	real_T *rwork = ssGetRWork(S);
+	real_T banda = 0.0;
+
+	if ( ssGetIWork(S)[IWORK_ESCRIBIR_TODO] )
+		return 1;
+	if ( rwork[RWORK_REFRESCO] > 0.0 &&
+		 ahora - rwork[RWORK_INSTANTE_ESCRITO+k] >= rwork[RWORK_REFRESCO] )
+		return 1;
+	if ( k < NESCRITURAS_ANA )
+		banda = rwork[RWORK_BANDA_MUERTA+k];
+	return fabs(valor - rwork[RWORK_ESCRITO+k]) > banda;
+}
+
+/* Function: iniciarStream ===================================================
+ * Abstract:
+ *    Abre el puerto local del stream, empieza a escuchar al brain y lo
+ *    configura para transmitir. El hilo receptor queda en PWork para
+ *    mdlOutputs y mdlTerminate.
+ */
+static long iniciarStream(SimStruct *S, O22SnapIoMemMap *Brain)
+{
+	O22SnapIoStream *Stream;
+	long nResult;
+
+	Stream = new O22SnapIoStream();
+	ssGetPWork(S)[PWORK_STREAM] = (void *) Stream;
+
+	nResult = Stream->OpenStreaming(SIOMM_STREAM_TYPE_STANDARD, 0, PUERTO_STREAM);
+	if ( nResult == SIOMM_OK )
+		nResult = Stream->StartStreamListening(IP_BRAIN, TIMEOUT_STREAM_MS);
+	if ( nResult == SIOMM_OK )
+		nResult = configurarStream(S, Brain);
+
+	return nResult;
+}
+
+/* Function: configurarPuntos =================================================
+ * Abstract:
+ *    Configura los puntos digitales de los actuadores como salidas. Es
+ *    necesario al iniciar y despues de cada reconexion, por si el brain se
+ *    reinicio. Todos los puntos se configuran con un solo Flush() de la copia
+ *    del mapa de memoria. En caso de error entrega el mensaje correspondiente.
+ */
+static long configurarPuntos(O22SnapIoShadow *Copia, const char **pMensaje)
+{
+	long nResult;
+	int k;
+
+	for( k=0; k<NENTRADAS_DIG; k++ )
+	{
+		Copia->SetQuad(O22PtType::Address(puntosEntradaDig[k]), 0x0180);
+		Copia->SetQuad(O22PtFeature::Address(puntosEntradaDig[k]), 0x0000);
+	}
+
+	nResult = Copia->Flush();
+	if ( nResult != SIOMM_OK )
+	{
+		// Las configuraciones que no se escribieron quedan pendientes en la copia
+		*pMensaje = "No se pudo configurar los actuadores digitales.";
+		for( k=0; k<NENTRADAS_DIG; k++ )
+		{
+			if ( Copia->IsDirty(O22PtType::Address(puntosEntradaDig[k]), 8) )
+			{
+				*pMensaje = errorConfiguracionDig[k];
+				break;
+			}
+		}
+	}
+	return nResult;
+}
+
+/* Function: crearCopia =======================================================
+ * Abstract:
+ *    Crea la copia local del mapa de memoria del brain. El plan de acceso
+ *    decide en que zonas del mapa leer los sensores y escribir los
+ *    actuadores, y con cuantos bloques, segun los puntos de esta planta; la
+ *    copia guarda esos bloques y la configuracion de los puntos digitales.
+ *    El plan queda en PWork para ubicar cada canal en la copia.
+ */
+static O22SnapIoShadow *crearCopia(SimStruct *S, O22SnapIoMemMap *Brain)
+{
+	O22SnapIoShadow *Copia;
+	O22SnapIoPlan *Plan;
+	int k;
+
+	Plan = new O22SnapIoPlan();
+	ssGetPWork(S)[PWORK_PLAN] = (void *) Plan;
+	for( k=0; k<NSALIDAS; k++ )
+		Plan->AddRead(puntosSalida[k], SIOMM_PLAN_ANA_VALUE);
+	for( k=0; k<NESCRITURAS_ANA; k++ )
+		Plan->AddWrite(puntosEscrituraAna[k], SIOMM_PLAN_ANA_VALUE);
+	for( k=0; k<NENTRADAS_DIG; k++ )
+		Plan->AddWrite(puntosEntradaDig[k], SIOMM_PLAN_DIG_STATE);
+
+	Copia = new O22SnapIoShadow(Brain);
+	Plan->AddToShadow(Copia);
+	Copia->AddRegion(O22MemMapPoint<O22PtModuleType, PUNTO_DIG_MINIMO>::Address,
+					 O22MemMapPoint<O22PtModuleType, PUNTO_DIG_MAXIMO>::Address + O22PtModuleType::Stride
+					 - O22MemMapPoint<O22PtModuleType, PUNTO_DIG_MINIMO>::Address, SIOMM_SHADOW_WRITE);
+	return Copia;
+}
+
+/* Function: direccionItem ====================================================
+ * Abstract:
+ *    Entrega la direccion en el mapa de memoria del item k del plan de acceso.
+ */
+static DWORD direccionItem(SimStruct *S, int k)
+{
+	DWORD dwDireccion = 0;
+	long nBit;
+
+	((O22SnapIoPlan *) ssGetPWork(S)[PWORK_PLAN])->GetItemLocation(k, &dwDireccion, &nBit);
+	return dwDireccion;
+}
+
+/* Function: escrituraPendiente ===============================================
+ * Abstract:
+ *    Indica si el canal k de mdlUpdate sigue pendiente en la copia, es decir,
+ *    si su ultima escritura fallo.
+ */
+static int escrituraPendiente(SimStruct *S, int k)
+{
+	O22SnapIoShadow *Copia = (O22SnapIoShadow *) ssGetPWork(S)[PWORK_COPIA];
+
+	if ( k < NESCRITURAS_ANA )
+		return Copia->IsDirty(direccionItem(S, ITEM_ESCRITURAS+k), 4);
+	return Copia->IsDirty(SIOMM_DBANK_WRITE_TURN_ON_MASK, 16);
+}
+
+/* Function: barreraMemoria ==================================================
+ * Abstract:
+ *    Impide que el compilador y el procesador muevan accesos a memoria de un
+ *    lado al otro de la barrera.
+ */
+static void barreraMemoria(void)
+{
+#ifdef _WIN32
+	MemoryBarrier();
+#endif
+#ifdef _LINUX
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Function: escribirSeq ======================================================
+ * Abstract:
+ *    Publica n datos en el buffer. Cada buffer tiene un solo escritor, que
+ *    nunca espera: el contador queda impar mientras copia los datos, y el
+ *    lector repite su copia si lo vio impar o si cambio entretanto.
+ */
+static void escribirSeq(BufferSeq *Buffer, const real_T *datos, int n)
+{
+	DWORD secuencia = Buffer->secuencia;
+	int k;
+
+	Buffer->secuencia = secuencia + 1;
+	barreraMemoria();
+	for( k=0; k<n; k++ )
+		Buffer->datos[k] = datos[k];
+	barreraMemoria();
+	Buffer->secuencia = secuencia + 2;
+}
+
+/* Function: leerSeq ==========================================================
+ * Abstract:
+ *    Copia los n datos publicados mas recientes del buffer, sin bloquear al
+ *    escritor. La copia solo se repite si coincidio con una escritura.
+ */
+static void leerSeq(BufferSeq *Buffer, real_T *datos, int n)
+{
+	DWORD secuencia;
+	int k;
+
+	do
+	{
+		secuencia = Buffer->secuencia;
+		barreraMemoria();
+		for( k=0; k<n; k++ )
+			datos[k] = Buffer->datos[k];
+		barreraMemoria();
+	} while ( (secuencia & 1) || secuencia != Buffer->secuencia );
+}
+
+/* Function: tomarMensaje =====================================================
+ * Abstract:
+ *    Entrega el mensaje pendiente que dejo el hilo de E/S, o NULL, y lo
+ *    borra para no repetirlo.
+ */
+static const char *tomarMensaje(const char * volatile *pMensaje)
+{
+#ifdef _WIN32
+	return (const char *) InterlockedExchangePointer((void * volatile *) pMensaje, NULL);
+#endif
+#ifdef _LINUX
+	return __atomic_exchange_n(pMensaje, (const char *) NULL, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/* Function: avisar ===========================================================
+ * Abstract:
+ *    Muestra un aviso sin detener la simulacion. El hilo de E/S no puede
+ *    llamar a Simulink, asi que deja el aviso para el proximo mdlOutputs.
+ */
+static void avisar(SimStruct *S, const char *mensaje)
+{
+	HiloIO *Hilo = (HiloIO *) ssGetPWork(S)[PWORK_HILO];
+
+	if ( Hilo == NULL )
+		ssWarning(S,mensaje);
+	else
+		Hilo->aviso = mensaje;
+}
+
+/* Function: detener ==========================================================
+ * Abstract:
+ *    Detiene la simulacion con un error. Desde el hilo de E/S el error queda
+ *    para el proximo mdlOutputs y el hilo deja de operar el brain.
+ */
+static void detener(SimStruct *S, const char *mensaje)
+{
+	HiloIO *Hilo = (HiloIO *) ssGetPWork(S)[PWORK_HILO];
+
+	if ( Hilo == NULL )
+		ssSetErrorStatus(S,mensaje);
+	else
+		Hilo->error = mensaje;
+}
+
+/* Function: fallaComunicacion ================================================
+ * Abstract:
+ *    Decide que hacer ante una transaccion fallida. Si el brain rechazo la
+ *    peticion es un error del modelo y se detiene la simulacion. Un timeout
+ *    aislado solo invalida las mediciones del paso; un error del socket o
+ *    FALLAS_RECONEXION pasos seguidos con timeout cierran la conexion para
+ *    reconectar en segundo plano.
+ */
+static void fallaComunicacion(SimStruct *S, O22SnapIoMemMap *Brain, long nResult, const char *mensaje)
+{
+	if ( nResult > 0 && nResult != SIOMM_BRAIN_ERROR_BUSY )
+	{
+		detener(S,mensaje);
+		return;
+	}
+
+	ssGetIWork(S)[IWORK_FALLAS]++;
+	if ( (nResult == SIOMM_TIME_OUT || nResult == SIOMM_BRAIN_ERROR_BUSY) &&
+		 ssGetIWork(S)[IWORK_FALLAS] < FALLAS_RECONEXION )
+		return;
+
+	Brain->Close();
+	ssGetIWork(S)[IWORK_CONEXION] = CONEXION_CAIDA;
+	ssGetRWork(S)[RWORK_PROXIMO_INTENTO] = (real_T)O22GetTimeNS()*1e-9;
+	ssGetRWork(S)[RWORK_ESPERA] = ESPERA_INICIAL_S;
+	avisar(S,"Se perdio la conexion con el brain. Reconectando...");
+}
+
+/* Function: reconectar =======================================================
+ * Abstract:
+ *    Avanza la reconexion con el brain sin bloquear el paso: inicia un
+ *    intento cuando se cumple la espera, revisa el socket con IsOpenDone() y,
+ *    al conectar, vuelve a configurar los puntos y el stream. Cada intento
+ *    fallido duplica la espera hasta ESPERA_MAXIMA_S.
+ */
+static void reconectar(SimStruct *S, O22SnapIoMemMap *Brain)
+{
+	const char *mensaje = "No se pudo configurar el stream de datos del brain.";
+	O22SnapIoShadow *Copia = (O22SnapIoShadow *) ssGetPWork(S)[PWORK_COPIA];
+	real_T *rwork = ssGetRWork(S);
+	int_T *iwork = ssGetIWork(S);
+	real_T ahora = (real_T)O22GetTimeNS()*1e-9;
+	long nResult;
+
+	if ( iwork[IWORK_CONEXION] == CONEXION_CAIDA )
+	{
+		if ( ahora < rwork[RWORK_PROXIMO_INTENTO] )
+			return;
+		nResult = Brain->Reopen(TIMEOUT_RECONEXION_MS);
+		if ( nResult == SIOMM_OK )
+			iwork[IWORK_CONEXION] = CONEXION_ABRIENDO;
+	}
+
+	if ( iwork[IWORK_CONEXION] == CONEXION_ABRIENDO )
+	{
+		nResult = Brain->IsOpenDone();
+		if ( nResult == SIOMM_ERROR_NOT_CONNECTED_YET )
+			return;
+		if ( nResult == SIOMM_OK )
+			nResult = configurarPuntos(Copia, &mensaje);
+		if ( nResult == SIOMM_OK && iwork[IWORK_MODO_LECTURA] == LECTURA_POR_STREAM )
+			nResult = configurarStream(S, Brain);
+		if ( nResult == SIOMM_OK )
+		{
+			iwork[IWORK_CONEXION] = CONEXION_ACTIVA;
+			iwork[IWORK_FALLAS] = 0;
+			iwork[IWORK_ESCRIBIR_TODO] = 1;		// El brain pudo reiniciarse
+			avisar(S,"Conexion con el brain restablecida.");
+			return;
+		}
+		if ( nResult > 0 && nResult != SIOMM_BRAIN_ERROR_BUSY )
+		{
+			detener(S,mensaje);
+			return;
+		}
+	}
+
+	// Intento fallido: se cierra el socket y se espera mas antes del siguiente
+	Brain->Close();
+	iwork[IWORK_CONEXION] = CONEXION_CAIDA;
+	rwork[RWORK_PROXIMO_INTENTO] = ahora + rwork[RWORK_ESPERA];
+	rwork[RWORK_ESPERA] *= 2.0;
+	if ( rwork[RWORK_ESPERA] > ESPERA_MAXIMA_S )
+		rwork[RWORK_ESPERA] = ESPERA_MAXIMA_S;
+}
+
+/* Function: leerSensores =====================================================
+ * Abstract:
+ *    Lee los sensores segun el modo de lectura y guarda las mediciones y su
+ *    instante de llegada en RWork. En caso de error entrega el mensaje
+ *    correspondiente y RWork conserva las ultimas mediciones validas.
+ */
+static long leerSensores(SimStruct *S, O22SnapIoMemMap *Brain, const char **pMensaje)
+{
+	O22SnapIoStream *Stream;
+	O22SnapIoShadow *Copia;
+	SIOMM_StreamStandardBlock bloque;
+	LONGLONG llegadaNS;
+	float valores[NSALIDAS];
+	long nResult;
+	int k;
+
+	Stream = (O22SnapIoStream *) ssGetPWork(S)[PWORK_STREAM];
+	Copia = (O22SnapIoShadow *) ssGetPWork(S)[PWORK_COPIA];
+	real_T *rwork = ssGetRWork(S);
+
+	if ( ssGetIWork(S)[IWORK_MODO_LECTURA] == LECTURA_POR_STREAM )
+	{
+		// Ultimo paquete recibido por el hilo del stream, sin trafico en la red
+		nResult=Stream->GetLastStreamStandardBlockEx(&bloque);
+		if ( nResult == SIOMM_OK )
+		{
+			for( k=0; k<NSALIDAS; k++ )
+				rwork[RWORK_SALIDAS+k] = (real_T)bloque.fAnalogValue[puntosSalida[k]];
+			Stream->GetLastStreamRecvTimeNS(&llegadaNS);
+			rwork[RWORK_LLEGADA] = (real_T)llegadaNS*1e-9;
+			return SIOMM_OK;
+		}
+		if ( nResult != SIOMM_ERROR_NOT_CONNECTED_YET )
+		{
+			*pMensaje = "Se perdio el stream de datos del brain.";
+			return nResult;
+		}
+		// Aun no llega el primer paquete: se lee el banco como en LECTURA_POR_BANCO
+	}
+
+	if ( ssGetIWork(S)[IWORK_MODO_LECTURA] != LECTURA_POR_PUNTO )
+	{
+		// Todos los valores analogicos en un solo Refresh() de la copia
+		nResult=Copia->Refresh();
+		if ( nResult != SIOMM_OK )
+		{
+			*pMensaje = "Error al recibir los datos del banco analogico.";
+			return nResult;
+		}
+		for( k=0; k<NSALIDAS; k++ )
+			Copia->GetFloat(direccionItem(S, ITEM_SALIDAS+k),&valores[k]);
+	}
+	else
+	{
+		// Una transaccion por sensor
+		for( k=0; k<NSALIDAS; k++ )
+		{
+			nResult=Brain->Read<O22AnaPtValue>(puntosSalida[k],&valores[k]);
+			if ( nResult != SIOMM_OK )
+			{
+				//mexPrintf("getanaptvalue: %d\n",nResult);
+				*pMensaje = errorSalida[k];
+				return nResult;
+			}
+		}
+	}
+
+	// Solo se guardan mediciones completas del mismo paso
+	for( k=0; k<NSALIDAS; k++ )
+		rwork[RWORK_SALIDAS+k] = (real_T)valores[k];
+
+	// Instante en que el kernel recibio la ultima respuesta del brain
+	Brain->GetLastResponseTimeNS(&llegadaNS);
+	rwork[RWORK_LLEGADA] = (real_T)llegadaNS*1e-9;
+	return SIOMM_OK;
+}
+
+/* Function: adquirir =========================================================
+ * Abstract:
+ *    Avanza la reconexion si hace falta y lee los sensores. Entrega 1 si
+ *    RWork tiene mediciones nuevas y 0 si retiene las ultimas validas.
+ */
+static int adquirir(SimStruct *S, O22SnapIoMemMap *Brain)
+{
+	const char *mensaje;
+	long nResult;
+
+	if ( ssGetIWork(S)[IWORK_CONEXION] != CONEXION_ACTIVA )
+		reconectar(S, Brain);
+	if ( ssGetIWork(S)[IWORK_CONEXION] != CONEXION_ACTIVA )
+		return 0;
+
+	nResult = leerSensores(S, Brain, &mensaje);
+	if ( nResult != SIOMM_OK )
+	{
+		fallaComunicacion(S, Brain, nResult, mensaje);
+		return 0;
+	}
+	ssGetIWork(S)[IWORK_FALLAS] = 0;
+	return 1;
+}
+
+/* Function: escribirActuadores ===============================================
+ * Abstract:
+ *    Escribe en el brain los comandos u de los actuadores y cierra el plazo
+ *    abierto para ellos. Solo se escriben los canales que salen de la banda muerta o
+ *    deben refrescarse, todos con un solo Flush() de la copia.
+ */
+static void escribirActuadores(SimStruct *S, O22SnapIoMemMap *Brain, const real_T *u)
+{
+	O22SnapIoShadow *Copia;
+	int escrito[NESCRITURAS];		// canales cambiados en la copia en este paso
+	real_T valores[NESCRITURAS];	// valor comandado a cada canal
+	long nResult,nPts31to0,nMask31to0;
+	real_T ahora;
+	int k;
+
+	Copia = (O22SnapIoShadow *) ssGetPWork(S)[PWORK_COPIA];
+	real_T *rwork = ssGetRWork(S);
+
+	// Sin conexion no se escribe; los actuadores se actualizan al reconectar
+	if ( ssGetIWork(S)[IWORK_CONEXION] != CONEXION_ACTIVA )
+	{
+		Brain->EndStepBudget();
+		return;
+	}
+
+	// Variador de Frecuencia
+	if( u[0]<5 )
+		valores[0] = 4.0;
+	else
+		valores[0] = 4.0 + (float)u[0]*16.0/100.0;
+
+	// Valvula Solenoide
+	valores[1] = 4.0 + (float)u[1]*16.0/100.0;
+
+	// Valvula Motorizada
+	valores[2] = 4.0 + (float)u[2]*16.0/100.0;
+
+	// Calefactores, agitador, valvulas solenoide y luces: estados del banco digital
+	mascaraDigital(u, &nPts31to0, &nMask31to0);
+	valores[ESCRITURA_DIG] = (real_T)nPts31to0;
+
+	// Solo se cambian en la copia los canales que cambiaron o que deben refrescarse
+	ahora = (real_T)O22GetTimeNS()*1e-9;
+	for( k=0; k<NESCRITURAS; k++ )
+	{
+		escrito[k] = escrituraNecesaria(S, k, valores[k], ahora);
+		if ( !escrito[k] )
+			continue;
+		if ( k < NESCRITURAS_ANA )
+			Copia->SetFloat(direccionItem(S, ITEM_ESCRITURAS+k), (float)valores[k]);
+		else
+			Copia->SetDigBankPointStates(0, nPts31to0, 0, nMask31to0);
+	}
+
+	// Un solo Flush() escribe todo lo pendiente, incluidos los canales que fallaron antes, con
+	// una transaccion por zona contigua y todas en vuelo a la vez
+	nResult=Copia->Flush();
+	// Las escrituras cierran el plazo abierto para ellas
+	Brain->EndStepBudget();
+
+	// Copia de lo que quedo escrito en el brain; un canal fallido se reintenta en el proximo paso
+	for( k=0; k<NESCRITURAS; k++ )
+	{
+		if ( escrito[k] && !escrituraPendiente(S, k) )
+		{
+			rwork[RWORK_ESCRITO+k] = valores[k];
+			rwork[RWORK_INSTANTE_ESCRITO+k] = ahora;
+		}
+	}
+
+	if ( nResult != SIOMM_OK )
+	{
+		for( k=0; k<NESCRITURAS; k++ )
+		{
+			if ( escrituraPendiente(S, k) )
+			{
+				fallaComunicacion(S, Brain, nResult, errorEscritura[k]);
+				return;
+			}
+		}
+		fallaComunicacion(S, Brain, nResult, "No se pudo configurar los actuadores digitales.");
+		return;
+	}
+	ssGetIWork(S)[IWORK_ESCRIBIR_TODO] = 0;
+}
+
+/* Function: calcularLazo ====================================================
+ * Abstract:
+ *    Calcula la accion del lazo interno, en % del actuador, con la medicion
+ *    recien leida en RWork y la consigna del modelo. Es un PID con la
+ *    derivada sobre la medicion, para no saltar con los cambios de
+ *    referencia, y filtrada. La integral se detiene mientras la accion esta
+ *    saturada hacia el mismo lado. El paso de integracion es el tiempo real
+ *    entre las llegadas de las mediciones; una medicion repetida no cambia
+ *    la accion.
+ */
+static real_T calcularLazo(LazoInterno *Lazo, const real_T *rwork, const real_T *consigna)
+{
+	real_T medicion = rwork[RWORK_SALIDAS+Lazo->sensor];
+	real_T llegada = rwork[RWORK_LLEGADA];
+	real_T h,error,accion;
+
+	if ( !Lazo->iniciado )
+	{
+		Lazo->iniciado = 1;
+		Lazo->integral = 0.0;
+		Lazo->derivada = 0.0;
+		Lazo->medicionAnterior = medicion;
+		Lazo->llegadaAnterior = llegada;
+	}
+
+	h = llegada - Lazo->llegadaAnterior;
+	if ( h > 0.0 )
+	{
+		Lazo->derivada += h/(FILTRO_DERIVADA_S + h)*
+						  (-(medicion - Lazo->medicionAnterior)/h - Lazo->derivada);
+		Lazo->medicionAnterior = medicion;
+		Lazo->llegadaAnterior = llegada;
+	}
+
+	error = consigna[LAZO_REFERENCIA] - medicion;
+	accion = consigna[LAZO_KP]*error + Lazo->integral + consigna[LAZO_KD]*Lazo->derivada;
+
+	if ( (accion < ACCION_MAXIMA || consigna[LAZO_KI]*error < 0.0) &&
+		 (accion > ACCION_MINIMA || consigna[LAZO_KI]*error > 0.0) )
+		Lazo->integral += consigna[LAZO_KI]*error*h;
+
+	if ( accion > ACCION_MAXIMA )
+		accion = ACCION_MAXIMA;
+	if ( accion < ACCION_MINIMA )
+		accion = ACCION_MINIMA;
+	return accion;
+}
+
+/* Function: esperarHasta =====================================================
+ * Abstract:
+ *    Duerme hasta el instante indicado del reloj de O22GetTimeNS().
+ */
+static void esperarHasta(LONGLONG instanteNS)
+{
+#ifdef _WIN32
+	LONGLONG esperaNS = instanteNS - O22GetTimeNS();
+
+	if ( esperaNS > 0 )
+		Sleep((DWORD)(esperaNS/1000000));
+#endif
+#ifdef _LINUX
+	struct timespec tsInstante;
+
+	tsInstante.tv_sec  = (time_t)(instanteNS/1000000000);
+	tsInstante.tv_nsec = (long)(instanteNS%1000000000);
+	while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tsInstante, NULL) == EINTR )
+		;
+#endif
+}
+
+/* Function: cicloHilo ========================================================
+ * Abstract:
+ *    Hilo de E/S. En cada periodo lee los sensores, calcula el lazo interno
+ *    si lo hay, publica la muestra y escribe el ultimo comando publicado por
+ *    mdlUpdate, con la accion del lazo en lugar de la entrada del actuador.
+ *    Sigue hasta que mdlTerminate lo detiene o hasta un error que detiene la
+ *    simulacion.
+ */
+#ifdef _WIN32
+static unsigned __stdcall cicloHilo(void *pParam)
+#endif
+#ifdef _LINUX
+static void *cicloHilo(void *pParam)
+#endif
+{
+	HiloIO *Hilo = (HiloIO *) pParam;
+	SimStruct *S = Hilo->S;
+	O22SnapIoMemMap *Brain = (O22SnapIoMemMap *) ssGetPWork(S)[PWORK_BRAIN];
+	real_T *rwork = ssGetRWork(S);
+	real_T muestra[NMUESTRA];
+	real_T comandos[NCOMANDO];
+	LONGLONG periodoNS = (LONGLONG)(Hilo->periodo*1e9);
+	LONGLONG proximoNS = O22GetTimeNS();
+	int valida,k;
+
+	muestra[MUESTRA_NUMERO] = 0.0;
+	while ( Hilo->ejecutando && Hilo->error == NULL )
+	{
+		Brain->BeginStepBudget((LONGLONG)(periodoNS*FRACCION_PASO));
+		valida = adquirir(S, Brain);
+
+		// Los actuadores no se tocan hasta el primer comando del modelo; sin medicion nueva el
+		// lazo interno mantiene su accion
+		leerSeq(&Hilo->comandos, comandos, NCOMANDO);
+		if ( Hilo->lazo.activo && valida && comandos[COMANDO_NUMERO] > 0.0 )
+			Hilo->lazo.accion = calcularLazo(&Hilo->lazo, rwork, &comandos[COMANDO_LAZO]);
+
+		if ( valida )
+		{
+			for( k=0; k<NSALIDAS; k++ )
+				muestra[k] = rwork[RWORK_SALIDAS+k];
+			muestra[MUESTRA_LLEGADA] = rwork[RWORK_LLEGADA];
+			muestra[MUESTRA_NUMERO] += 1.0;
+			muestra[MUESTRA_ACCION] = Hilo->lazo.accion;
+			escribirSeq(&Hilo->muestra, muestra, NMUESTRA);
+		}
+
+		if ( comandos[COMANDO_NUMERO] > 0.0 && Hilo->error == NULL )
+		{
+			if ( Hilo->lazo.activo )
+				comandos[Hilo->lazo.actuador] = Hilo->lazo.accion;
+			escribirActuadores(S, Brain, comandos);
+		}
+		else
+			Brain->EndStepBudget();
+
+		// Un ciclo atrasado no se recupera con ciclos seguidos
+		proximoNS += periodoNS;
+		if ( proximoNS < O22GetTimeNS() )
+			proximoNS = O22GetTimeNS();
+		esperarHasta(proximoNS);
+	}
+
+	return 0;
+}
+
+/* Function: iniciarHilo ======================================================
+ * Abstract:
+ *    Crea el hilo de E/S con el periodo indicado y, si el bloque lo tiene,
+ *    su lazo interno. Desde ese momento el hilo es el unico que usa el
+ *    brain, la copia y los vectores RWork e IWork.
+ */
+static long iniciarHilo(SimStruct *S, real_T periodo)
+{
+	HiloIO *Hilo;
+
+	Hilo = new HiloIO();
+	Hilo->S = S;
+	Hilo->periodo = periodo;
+	Hilo->ejecutando = TRUE;
+	if ( lazoInterno(S) )
+	{
+		Hilo->lazo.activo = 1;
+		Hilo->lazo.sensor = (int) paramOpcionalVector(S, PARAM_LAZO_INTERNO, 0, 0.0);
+		Hilo->lazo.actuador = (int) paramOpcionalVector(S, PARAM_LAZO_INTERNO, 1, 0.0);
+	}
+	ssGetPWork(S)[PWORK_HILO] = (void *) Hilo;
+
+#ifdef _WIN32
+	Hilo->hHilo = (HANDLE)_beginthreadex(NULL, 0, cicloHilo, Hilo, 0, NULL);
+	if ( Hilo->hHilo == NULL )
+#endif
+#ifdef _LINUX
+	if ( pthread_create(&Hilo->hHilo, NULL, cicloHilo, Hilo) != 0 )
+#endif
+	{
+		delete Hilo;
+		ssGetPWork(S)[PWORK_HILO] = NULL;
+		return SIOMM_ERROR;
+	}
+	return SIOMM_OK;
+}
+
+/* Function: detenerHilo ======================================================
+ * Abstract:
+ *    Detiene el hilo de E/S, si existe, y espera a que termine su ciclo. El
+ *    brain y los vectores de trabajo vuelven a la S-function.
+ */
+static void detenerHilo(SimStruct *S)
+{
+	HiloIO *Hilo = (HiloIO *) ssGetPWork(S)[PWORK_HILO];
+
+	if ( Hilo == NULL )
+		return;
+
+	Hilo->ejecutando = FALSE;
+#ifdef _WIN32
+	WaitForSingleObject(Hilo->hHilo, INFINITE);
+	CloseHandle(Hilo->hHilo);
+#endif
+#ifdef _LINUX
+	pthread_join(Hilo->hHilo, NULL);
+#endif
+	delete Hilo;
+	ssGetPWork(S)[PWORK_HILO] = NULL;
+}
+
 /*====================*
  * S-function methods *
  *====================*/
@@ -21,18 +1002,24 @@ extern "C" {
  */
 static void mdlInitializeSizes(SimStruct *S)
 {
-    ssSetNumSFcnParams(S, 1);		// Number of expected parameters
+    ssSetNumSFcnParams(S, -1);		// Ts mas parametros opcionales
 
-    if (ssGetNumSFcnParams(S) != ssGetSFcnParamsCount(S)) {
-        return;						// Parameter mismatch will be reported by Simulink
+    if (ssGetSFcnParamsCount(S) < 1 || ssGetSFcnParamsCount(S) > NPARAMETROS) {
+        ssSetErrorStatus(S,"Numero de parametros incorrecto.");
+        return;
     }
 
     ssSetNumContStates(S, 0);
     ssSetNumDiscStates(S, 1);		// Usado para actualizar las entradas
 
-    if (!ssSetNumInputPorts(S,1)) return;
+    if (!ssSetNumInputPorts(S,lazoInterno(S) ? 2 : 1)) return;
 	ssSetInputPortWidth( S, 0, NENTRADAS );
 	ssSetInputPortRequiredContiguous( S, 0, 1 );
+	if ( lazoInterno(S) )
+	{
+		ssSetInputPortWidth( S, PUERTO_CONSIGNA, NLAZO );
+		ssSetInputPortRequiredContiguous( S, PUERTO_CONSIGNA, 1 );
+	}
 	//for( k=0; k<NENTRADAS; k++ )
 	//{
 	//	ssSetInputPortWidth(S,k,1);
@@ -40,17 +1027,22 @@ static void mdlInitializeSizes(SimStruct *S)
 	//	ssSetInputPortRequiredContiguous(S,k,1);	// sacado del ejemplo (?)
 	//}
     
-    if (!ssSetNumOutputPorts(S,1)) return;
+    if (!ssSetNumOutputPorts(S,lazoInterno(S) ? 5 : 4)) return;
 	ssSetOutputPortWidth( S, 0, NSALIDAS );
+	ssSetOutputPortWidth( S, PUERTO_LLEGADA, 1 );
+	ssSetOutputPortWidth( S, PUERTO_VALIDO, 1 );
+	ssSetOutputPortWidth( S, PUERTO_EDAD, 1 );
+	if ( lazoInterno(S) )
+		ssSetOutputPortWidth( S, PUERTO_ACCION, 1 );
 	//for( k=0; k<NSALIDAS; k++ )
 	//{
 	//    ssSetOutputPortWidth(S, k, 1);
 	//}
 
     ssSetNumSampleTimes(S, 1);
-    ssSetNumRWork(S, 0);			// reserve element in the float vector
-    ssSetNumIWork(S, 0);			// reserve element in the int vector
-    ssSetNumPWork(S, 1);			// reserve element in the pointers vector
+    ssSetNumRWork(S, NRWORK);		// reserve element in the float vector
+    ssSetNumIWork(S, NIWORK);		// reserve element in the int vector
+    ssSetNumPWork(S, NPWORK);		// reserve element in the pointers vector
     ssSetNumModes(S, 0);			// to store a C++ object
     ssSetNumNonsampledZCs(S, 0);	// number of states for which a block detects zero crossings
 
@@ -66,7 +1058,7 @@ static void mdlInitializeSizes(SimStruct *S)
  */
 static void mdlInitializeSampleTimes(SimStruct *S)
 {
-    ssSetSampleTime(S, 0, mxGetScalar(ssGetSFcnParam(S, 0)));	// tiempo de muestreo?
+    ssSetSampleTime(S, 0, mxGetScalar(ssGetSFcnParam(S, PARAM_TS)));	// tiempo de muestreo?
     ssSetOffsetTime(S, 0, 0.0);
 }
 
@@ -81,75 +1073,115 @@ static void mdlInitializeSampleTimes(SimStruct *S)
 static void mdlStart(SimStruct *S)
 {
 	O22SnapIoMemMap *Brain;
+	const char *mensaje;
+	real_T periodoHilo,periodo;
 	long nResult;
+	int k;
+
+	// Simulink llama a mdlTerminate aunque mdlStart falle, y este solo libera lo que se creo
+	for( k=0; k<NPWORK; k++ )
+		ssGetPWork(S)[k] = NULL;
+	ssGetIWork(S)[IWORK_CONEXION] = CONEXION_CAIDA;
+
+	// El lazo interno corre en el hilo de E/S, entre un sensor de nivel y el variador o la
+	// valvula motorizada
+	if ( lazoInterno(S) )
+	{
+		k = (int) paramOpcionalVector(S, PARAM_LAZO_INTERNO, 0, 0.0);
+		if ( k < 0 || k > SENSOR_LAZO_MAXIMO )
+		{
+			ssSetErrorStatus(S,"El lazo interno solo puede medir los sensores de nivel (salidas 0 a 2).");
+			return;
+		}
+		k = (int) paramOpcionalVector(S, PARAM_LAZO_INTERNO, 1, 0.0);
+		if ( k != 0 && k != 2 )
+		{
+			ssSetErrorStatus(S,"El lazo interno solo puede comandar el variador (0) o la valvula motorizada (2).");
+			return;
+		}
+		if ( paramOpcional(S, PARAM_PERIODO_HILO, 0.0) <= 0.0 )
+		{
+			ssSetErrorStatus(S,"El lazo interno requiere el hilo de E/S.");
+			return;
+		}
+	}
 
 	Brain = new O22SnapIoMemMap();
-	nResult = Brain->OpenEnet("192.168.6.100", 2001, 10000, 1);
+	ssGetPWork(S)[PWORK_BRAIN] = (void *) Brain;
+	nResult = Brain->OpenEnet(IP_BRAIN, PUERTO_BRAIN, 10000, 1);
 	//mexPrintf("openenet: %d\n",nResult);
 
 	if ( nResult == SIOMM_OK )
 	{
-		nResult = Brain->IsOpenDone();
-		//mexPrintf("	isopendone: %d\n",nResult);
-		while ( nResult == SIOMM_ERROR_NOT_CONNECTED_YET )
-		{
-			nResult = Brain->IsOpenDone();
-			//mexPrintf("  isopendone: %d\n",nResult);
-		} 
+		// Duerme sobre el socket hasta que la conexion se resuelva o expire el timeout
+		nResult = Brain->WaitForOpen();
+		//mexPrintf("	waitforopen: %d\n",nResult);
 	}
 
-	// Check for error on OpenEnet() and IsOpenDone()
+	// Check for error on OpenEnet() and WaitForOpen()
 	if ( nResult != SIOMM_OK )
 	{
 		ssSetErrorStatus(S,"No se pudo realizar la conexion con exito.");
 		return;
 	}
+	ssGetIWork(S)[IWORK_CONEXION] = CONEXION_ACTIVA;
+
+	// El timeout de cada transaccion se ajusta al tiempo de ida y vuelta medido en la red del
+	// laboratorio; las lecturas fallidas se repiten dentro del plazo del paso
+	Brain->SetCommOptions(TIMEOUT_MAXIMO_MS, REINTENTOS_LECTURA);
+	Brain->SetAdaptiveTimeOut((LONGLONG)TIMEOUT_MINIMO_MS*1000000);
+
+#ifdef _IO_URING
+	// Con io_uring cada paso hace menos llamadas al sistema; si el kernel no lo ofrece se
+	// siguen usando los sockets
+	if ( Brain->SetIoBackend(SIOMM_IO_URING) != SIOMM_OK )
+		ssWarning(S,"El kernel no ofrece io_uring. Se usan los sockets.");
+#endif
+
+	ssGetIWork(S)[IWORK_MODO_LECTURA] = (int_T) paramOpcional(S, PARAM_MODO_LECTURA, LECTURA_POR_BANCO);
+	ssGetPWork(S)[PWORK_COPIA] = (void *) crearCopia(S, Brain);
 
 	// Configuracion para puntos digitales (necesaria!!!!)
-	nResult = Brain->SetDigPtConfiguration(20,0x0180,0x0000);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"No se pudo configurar al calefactor 1.");
-		return;
-	}
-	nResult = Brain->SetDigPtConfiguration(21,0x0180,0x0000);
+	nResult = configurarPuntos((O22SnapIoShadow *) ssGetPWork(S)[PWORK_COPIA], &mensaje);
 	if ( nResult != SIOMM_OK )
 	{
-		ssSetErrorStatus(S,"No se pudo configurar al calefactor 3.");
+		ssSetErrorStatus(S,mensaje);
 		return;
 	}
-	nResult = Brain->SetDigPtConfiguration(22,0x0180,0x0000);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"No se pudo configurar al calefactor 2.");
-		return;
-	}
-	nResult = Brain->SetDigPtConfiguration(23,0x0180,0x0000);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"No se pudo configurar al agitador.");
-		return;
-	}
-	nResult = Brain->SetDigPtConfiguration(24,0x0180,0x0000);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"No se pudo configurar la valvula solenoide 1.");
-		return;
-	}
-	nResult = Brain->SetDigPtConfiguration(25,0x0180,0x0000);
-	if ( nResult != SIOMM_OK )
+	
+	ssGetIWork(S)[IWORK_FALLAS] = 0;
+	ssGetIWork(S)[IWORK_ESCRIBIR_TODO] = 1;
+	for( k=0; k<NRWORK; k++ )
+		ssGetRWork(S)[k] = 0.0;
+	// Banda muerta en mA: el rango de 4 a 20 mA corresponde a 0 a 100 %
+	for( k=0; k<NESCRITURAS_ANA; k++ )
+		ssGetRWork(S)[RWORK_BANDA_MUERTA+k] = paramOpcionalVector(S, PARAM_BANDA_MUERTA, k, 0.0)*16.0/100.0;
+	ssGetRWork(S)[RWORK_REFRESCO] = paramOpcional(S, PARAM_REFRESCO, 1.0);
+
+	// Los sensores se leen cada Ts, o con el periodo del hilo de E/S si se usa
+	periodoHilo = paramOpcional(S, PARAM_PERIODO_HILO, 0.0);
+	periodo = periodoHilo > 0.0 ? periodoHilo : mxGetScalar(ssGetSFcnParam(S, PARAM_TS));
+	ssGetIWork(S)[IWORK_INTERVALO_STREAM] = (int_T)(periodo*1000.0/2.0);
+	if ( ssGetIWork(S)[IWORK_INTERVALO_STREAM] < 1 )
+		ssGetIWork(S)[IWORK_INTERVALO_STREAM] = 1;
+
+	if ( ssGetIWork(S)[IWORK_MODO_LECTURA] == LECTURA_POR_STREAM )
 	{
-		ssSetErrorStatus(S,"No se pudo configurar la valvula solenoide 2.");
-		return;
+		if ( iniciarStream(S, Brain) != SIOMM_OK )
+		{
+			ssSetErrorStatus(S,"No se pudo configurar el stream de datos del brain.");
+			return;
+		}
 	}
-	nResult = Brain->SetDigPtConfiguration(26,0x0180,0x0000);
-	if ( nResult != SIOMM_OK )
+
+	if ( periodoHilo > 0.0 )
 	{
-		ssSetErrorStatus(S,"No se pudo configurar a las luces del laboratorio.");
-		return;
+		if ( iniciarHilo(S, periodoHilo) != SIOMM_OK )
+		{
+			ssSetErrorStatus(S,"No se pudo crear el hilo de E/S.");
+			return;
+		}
 	}
-	
-	ssGetPWork(S)[0] = (void *) Brain;
 }
 #endif /*  MDL_START */
 
@@ -173,130 +1205,39 @@ static void mdlUpdate(SimStruct *S, int_T tid)
 	*	7:	Valv. Solenoide 1	(24)
 	*	8:	Valv. Solenoide 2	(25)
 	*	9:	Luces Lab.      	(26)
+	*
+	* Segundo puerto (lazo interno) :
+	*	0:	Referencia del sensor controlado
+	*	1:	Kp	[%/unidad]
+	*	2:	Ki	[%/(unidad s)]
+	*	3:	Kd	[% s/unidad]
 	*********************************/
 
 	O22SnapIoMemMap *Brain;
-	long nResult,tempDig;
-	float tempAna;
-
-	Brain = (O22SnapIoMemMap *) ssGetPWork(S)[0];
+	HiloIO *Hilo;
+	real_T comandos[NCOMANDO];
+	int k;
 
+	Brain = (O22SnapIoMemMap *) ssGetPWork(S)[PWORK_BRAIN];
+	Hilo = (HiloIO *) ssGetPWork(S)[PWORK_HILO];
 	const real_T *u = ssGetInputPortRealSignal(S,0);
 
-	// Variador de Frecuencia
-	if( u[0]<5 )
-		tempAna = 4.0;
-	else
-		tempAna = 4.0 + (float)u[0]*16.0/100.0;
-
-	nResult=Brain->SetAnaPtValue(16,tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato del variador de frecuencia.");
-		return;
-	}
-
-	// Valvula Solenoide
-	tempAna = 4.0 + (float)u[1]*16.0/100.0;
-	nResult=Brain->SetAnaPtValue(13,tempAna);
-	if ( nResult != SIOMM_OK )
+	if ( Hilo != NULL )
 	{
-		ssSetErrorStatus(S,"Error al transmitir el dato de la valvula solenoide.");
+		// El hilo de E/S escribe el ultimo comando publicado en su proximo ciclo
+		for( k=0; k<NENTRADAS; k++ )
+			comandos[k] = u[k];
+		for( k=0; k<NLAZO; k++ )
+			comandos[COMANDO_LAZO+k] = Hilo->lazo.activo ? ssGetInputPortRealSignal(S,PUERTO_CONSIGNA)[k] : 0.0;
+		Hilo->numeroComando += 1.0;
+		comandos[COMANDO_NUMERO] = Hilo->numeroComando;
+		escribirSeq(&Hilo->comandos, comandos, NCOMANDO);
 		return;
 	}
 
-	// Valvula Motorizada
-	tempAna = 4.0 + (float)u[2]*16.0/100.0;
-	nResult=Brain->SetAnaPtValue(12,tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato de la valvula motorizada.");
-		return;
-	}
-
-	// Calefactor 1
-	if( (float)u[3] > 0.5 )
-		tempDig = 1;
-	else
-		tempDig = 0;
-	nResult=Brain->SetDigPtState(20,tempDig);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato del calefactor 1.");
-		return;
-	}
-
-	// Calefactor 2
-	if( (float)u[4] > 0.5 )
-		tempDig = 1;
-	else
-		tempDig = 0;
-	nResult=Brain->SetDigPtState(22,tempDig);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato del calefactor 2.");
-		return;
-	}
-
-	// Calefactor 3
-	if( (float)u[5] > 0.5 )
-		tempDig = 1;
-	else
-		tempDig = 0;
-	nResult=Brain->SetDigPtState(21,tempDig);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato del calefactor 3.");
-		return;
-	}
-
-	// Agitador
-	if( (float)u[6] > 0.5 )
-		tempDig = 1;
-	else
-		tempDig = 0;
-	nResult=Brain->SetDigPtState(23,tempDig);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato del agitador.");
-		return;
-	}
-
-	// Valv. Solenoide 1
-	if( (float)u[7] > 0.5 )
-		tempDig = 1;
-	else
-		tempDig = 0;
-	nResult=Brain->SetDigPtState(24,tempDig);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato de la valvula solenoide 1.");
-		return;
-	}
-
-	// Valv. Solenoide 2
-	if( (float)u[8] > 0.5 )
-		tempDig = 1;
-	else
-		tempDig = 0;
-	nResult=Brain->SetDigPtState(25,tempDig);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato de la valvula solenoide 2.");
-		return;
-	}
-	
-	// Luces Lab.
-	if( (float)u[9] > 0.5 )
-		tempDig = 1;
-	else
-		tempDig = 0;
-	nResult=Brain->SetDigPtState(26,tempDig);
-	if ( nResult != SIOMM_OK )
-	{
-		ssSetErrorStatus(S,"Error al transmitir el dato de las luces del laboratorio.");
-		return;
-	}
+	// Las escrituras tienen un plazo propio, que escribirActuadores() cierra
+	Brain->BeginStepBudget((LONGLONG)(ssGetSampleTime(S,0)*FRACCION_CALLBACK*1e9));
+	escribirActuadores(S, Brain, u);
 }
 
 
@@ -319,107 +1260,80 @@ static void mdlOutputs(SimStruct *S, int_T tid)
 	*	5:	Temp Estanque Cuadrado			(6)
 	*	6:	Temp Estanque Conico			(4)
 	*	7:	Temp Estanque Recirculacion		(5)
+	*
+	* Segundo puerto :
+	*	0:	Instante de llegada de las mediciones [s],
+	*		reloj monotonico del computador
+	*
+	* Tercer puerto :
+	*	0:	1 si las mediciones se leyeron en este paso,
+	*		0 si se retienen las ultimas validas
+	*		(con hilo de E/S: 1 si hay una muestra nueva)
+	*
+	* Cuarto puerto :
+	*	0:	Edad de las mediciones [s], tiempo desde su
+	*		llegada hasta este paso (0 mientras no llegue
+	*		ninguna)
+	*
+	* Quinto puerto (lazo interno) :
+	*	0:	Accion del lazo [%] en la ultima muestra
 	********************************************/
 
 	O22SnapIoMemMap *Brain;
-	float tempAna;
-	long nResult;
+	HiloIO *Hilo;
+	const char *mensaje;
+	real_T muestra[NMUESTRA];
 	int k;
 
-	Brain = (O22SnapIoMemMap *) ssGetPWork(S)[0];
+	Brain = (O22SnapIoMemMap *) ssGetPWork(S)[PWORK_BRAIN];
+	Hilo = (HiloIO *) ssGetPWork(S)[PWORK_HILO];
 	real_T *y = ssGetOutputPortRealSignal(S,0);
-	
-	// Nivel Presion 4 (Conico)
-	hola:
-	nResult=Brain->GetAnaPtValue(0,&tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de presion (conico).");
-		return;
-	}
-    y[0] = (real_T)tempAna;
-
-	// Nivel Presion 3 (Cuadrado)
-	nResult=Brain->GetAnaPtValue(1,&tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de presion (recirculacion).");
-		return;
-	}
-    y[1] = (real_T)tempAna;
-
-	// Nivel Ultrasonico (Cuadrado)
-	nResult=Brain->GetAnaPtValue(2,&tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de presion (ultrasonico).");
-		return;
-	}
-    y[2] = (real_T)tempAna;
-
-	// Flujo Descarga
-	nResult=Brain->GetAnaPtValue(8,&tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de flujo.");
-		return;
-	}
-    y[3] = (real_T)tempAna;
-
-	// Presion Bomba 1
-	nResult=Brain->GetAnaPtValue(9,&tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de presion bomba 1.");
-		return;
-	}
-    y[4] = (real_T)tempAna;
+	real_T *llegada = ssGetOutputPortRealSignal(S,PUERTO_LLEGADA);
+	real_T *valido = ssGetOutputPortRealSignal(S,PUERTO_VALIDO);
+	real_T *edad = ssGetOutputPortRealSignal(S,PUERTO_EDAD);
+	real_T *rwork = ssGetRWork(S);
 
-	// Temp Estanque Cuadrado
-	nResult=Brain->GetAnaPtValue(6,&tempAna);
-	if ( nResult != SIOMM_OK )
+	if ( Hilo != NULL )
 	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de temperatura (cuadrado).");
-		return;
-	}
-    y[5] = (real_T)tempAna;
+		// El hilo de E/S no puede llamar a Simulink; sus avisos y errores se entregan aqui
+		mensaje = tomarMensaje(&Hilo->aviso);
+		if ( mensaje != NULL )
+			ssWarning(S,mensaje);
+		if ( Hilo->error != NULL )
+		{
+			ssSetErrorStatus(S,Hilo->error);
+			return;
+		}
 
-	// Temp Estanque Conico
-	nResult=Brain->GetAnaPtValue(4,&tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de temperatura (conico).");
-		return;
+		// Solo se copia la ultima muestra del hilo, sin esperar a la red
+		leerSeq(&Hilo->muestra, muestra, NMUESTRA);
+		for( k=0; k<NSALIDAS; k++ )
+			y[k] = muestra[k];
+		llegada[0] = muestra[MUESTRA_LLEGADA];
+		valido[0] = muestra[MUESTRA_NUMERO] != Hilo->numeroVisto ? 1.0 : 0.0;
+		Hilo->numeroVisto = muestra[MUESTRA_NUMERO];
+		if ( Hilo->lazo.activo )
+			ssGetOutputPortRealSignal(S,PUERTO_ACCION)[0] = muestra[MUESTRA_ACCION];
 	}
-    y[6] = (real_T)tempAna;
-
-	// Temp Estanque Recirculacion
-	nResult=Brain->GetAnaPtValue(5,&tempAna);
-	if ( nResult != SIOMM_OK )
+	else
 	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de temperatura (recirculacion).");
-		return;
-	}
-    y[7] = (real_T)tempAna;
+		// Las lecturas tienen un plazo propio, asi un brain lento se detecta dentro del periodo
+		// de muestreo y no al cabo del timeout. Se cierra antes de que corran otros bloques.
+		Brain->BeginStepBudget((LONGLONG)(ssGetSampleTime(S,0)*FRACCION_CALLBACK*1e9));
+		valido[0] = (real_T) adquirir(S, Brain);
+		Brain->EndStepBudget();
 
-    // Presion Bomba 2
-	nResult=Brain->GetAnaPtValue(10,&tempAna);
-	if ( nResult != SIOMM_OK )
-	{
-		//mexPrintf("getanaptvalue: %d\n",nResult);
-		ssSetErrorStatus(S,"Error al recibir el dato de velocidad.");
-		return;
+		// Sin mediciones nuevas se retienen las ultimas validas
+		for( k=0; k<NSALIDAS; k++ )
+			y[k] = rwork[RWORK_SALIDAS+k];
+		llegada[0] = rwork[RWORK_LLEGADA];
 	}
-	y[8] = (real_T)tempAna;
 
+	// Antes de la primera medicion no hay llegada de la cual medir la edad
+	if ( llegada[0] > 0.0 )
+		edad[0] = (real_T)O22GetTimeNS()*1e-9 - llegada[0];
+	else
+		edad[0] = 0.0;
 }
 
 /* Function: mdlTerminate =====================================================
@@ -431,31 +1345,49 @@ static void mdlOutputs(SimStruct *S, int_T tid)
 static void mdlTerminate(SimStruct *S)
 {
 	O22SnapIoMemMap *Brain;
+	O22SnapIoStream *Stream;
+	long nPts31to0,nMask31to0;
+
+	// El hilo de E/S termina su ciclo y devuelve el brain antes del apagado
+	detenerHilo(S);
 
-	Brain = (O22SnapIoMemMap *) ssGetPWork(S)[0];
+	Brain = (O22SnapIoMemMap *) ssGetPWork(S)[PWORK_BRAIN];
+	Stream = (O22SnapIoStream *) ssGetPWork(S)[PWORK_STREAM];
+	// mdlStart fallo antes de crear el brain: no hay nada que apagar ni liberar
+	if ( Brain == NULL )
+		return;
+	// Un paso interrumpido por un error no debe acortar el apagado de los actuadores
+	Brain->EndStepBudget();
+	// Un ultimo intento de reconexion para dejar los actuadores apagados
+	if ( ssGetIWork(S)[IWORK_CONEXION] != CONEXION_ACTIVA )
+	{
+		if ( Brain->Reopen(TIMEOUT_CIERRE_MS) == SIOMM_OK )
+			Brain->WaitForOpen();
+	}
+	if ( Stream != NULL )
+	{
+		Brain->SetStreamConfiguration(0, 0, PUERTO_STREAM, 0, 0, 0);
+		Stream->CloseStreaming();
+		delete Stream;
+		ssGetPWork(S)[PWORK_STREAM] = NULL;
+	}
 	// Variador de Frecuencia
 	Brain->SetAnaPtValue(16,4.0);
 	// Valvula Solenoide
 	Brain->SetAnaPtValue(13,4.0);
 	// Valvula Motorizada
 	Brain->SetAnaPtValue(12,4.0);
-	// Calefactor 1
-	Brain->SetDigPtState(20,0);
-	// Calefactor 2
-	Brain->SetDigPtState(22,0);
-	// Calefactor 3
-	Brain->SetDigPtState(21,0);
-	// Agitador
-	Brain->SetDigPtState(23,0);
-	// Valv. Solenoide 1
-	Brain->SetDigPtState(24,0);
-	// Valv. Solenoide 2
-	Brain->SetDigPtState(25,0);
-	// Luces del Laboratorio
-	Brain->SetDigPtState(26,0);
+	// Calefactores, agitador, valvulas solenoide y luces del laboratorio
+	mascaraDigital(NULL, &nPts31to0, &nMask31to0);
+	Brain->SetDigBankPointStates(0, nPts31to0, 0, nMask31to0);
 	Brain->Close();
 
+	delete (O22SnapIoShadow *) ssGetPWork(S)[PWORK_COPIA];
+	ssGetPWork(S)[PWORK_COPIA] = NULL;
+	delete (O22SnapIoPlan *) ssGetPWork(S)[PWORK_PLAN];
+	ssGetPWork(S)[PWORK_PLAN] = NULL;
 	delete Brain;
+	ssGetPWork(S)[PWORK_BRAIN] = NULL;
 }
 
 /*=============================*
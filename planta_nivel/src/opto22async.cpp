@@ -0,0 +1,746 @@
+//-----------------------------------------------------------------------------
+//
+// O22SIOAS.cpp
+//
+// Source for the O22SnapIoEventLoop, O22SnapIoAsync and O22SnapIoTask C++
+// classes.
+//
+// These classes let C++20 coroutines read and write Opto 22 SNAP Ethernet I/O
+// units without blocking. See O22SIOAS.h for usage.
+//
+// The classes need C++20 coroutines. With an older compiler this file builds
+// to nothing, so it can stay in the same build as the rest of the toolkit.
+//
+// While this class was developed on Microsoft Windows 32-bit operating
+// systems, it is intended to be as generic as possible.  For Windows specific
+// code, search for "_WIN32" and "_WIN32_WCE".  For Linux specific code, search
+// for "_LINUX".
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOMM.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include "O22SIOAS.h"
+
+
+//-------------------------------------------------------------------------------------------------
+// O22SnapIoTask
+//-------------------------------------------------------------------------------------------------
+
+
+O22SnapIoTask O22SnapIoTask::promise_type::get_return_object()
+//-------------------------------------------------------------------------------------------------
+// Make the task for a coroutine that has just been called
+//-------------------------------------------------------------------------------------------------
+{
+  return O22SnapIoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+
+std::coroutine_handle<>
+O22SnapIoTask::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> Handle) noexcept
+//-------------------------------------------------------------------------------------------------
+// Go on with the coroutine waiting on the task, if any, once it is done.  The task's coroutine
+// stays suspended so that its result can be read, and is destroyed with the task.
+//-------------------------------------------------------------------------------------------------
+{
+  if (Handle.promise().m_Continuation)
+    return Handle.promise().m_Continuation;
+
+  return std::noop_coroutine();
+}
+
+
+O22SnapIoTask::O22SnapIoTask(std::coroutine_handle<promise_type> Handle)
+//-------------------------------------------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------------------------------------------
+{
+  m_Handle = Handle;
+}
+
+
+O22SnapIoTask::O22SnapIoTask(O22SnapIoTask && Other)
+//-------------------------------------------------------------------------------------------------
+// Move constructor
+//-------------------------------------------------------------------------------------------------
+{
+  m_Handle = Other.m_Handle;
+  Other.m_Handle = nullptr;
+}
+
+
+O22SnapIoTask::~O22SnapIoTask()
+//-------------------------------------------------------------------------------------------------
+// Destructor.  A task that isn't done yet is dropped, and its transactions are abandoned.
+//-------------------------------------------------------------------------------------------------
+{
+  if (m_Handle)
+    m_Handle.destroy();
+}
+
+
+BOOL O22SnapIoTask::IsDone()
+//-------------------------------------------------------------------------------------------------
+// Check whether the task is done
+//-------------------------------------------------------------------------------------------------
+{
+  return (!m_Handle) || m_Handle.done();
+}
+
+
+LONG O22SnapIoTask::GetResult()
+//-------------------------------------------------------------------------------------------------
+// Get the result of a task that is done
+//-------------------------------------------------------------------------------------------------
+{
+  if (!IsDone() || !m_Handle)
+    return SIOMM_ERROR;
+
+  return m_Handle.promise().m_nResult;
+}
+
+
+bool O22SnapIoTask::await_ready()
+//-------------------------------------------------------------------------------------------------
+// A task that is already done doesn't need waiting for
+//-------------------------------------------------------------------------------------------------
+{
+  return IsDone();
+}
+
+
+void O22SnapIoTask::await_suspend(std::coroutine_handle<> Continuation)
+//-------------------------------------------------------------------------------------------------
+// Have the task go on with the waiting coroutine when it is done
+//-------------------------------------------------------------------------------------------------
+{
+  m_Handle.promise().m_Continuation = Continuation;
+}
+
+
+LONG O22SnapIoTask::await_resume()
+//-------------------------------------------------------------------------------------------------
+// The result of co_await
+//-------------------------------------------------------------------------------------------------
+{
+  return GetResult();
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// O22SnapIoTransactAwaiter
+//-------------------------------------------------------------------------------------------------
+
+
+O22SnapIoTransactAwaiter::O22SnapIoTransactAwaiter(O22SnapIoEventLoop * pLoop,
+                                                   O22SnapIoMemMap * pMemMap,
+                                                   SIOMM_Transaction * pTransactions,
+                                                   long nCount)
+//-------------------------------------------------------------------------------------------------
+// Constructor.  The transactions to begin are marked as for BeginTransact().
+//-------------------------------------------------------------------------------------------------
+{
+  m_pLoop         = pLoop;
+  m_pMemMap       = pMemMap;
+  m_pTransactions = pTransactions;
+  m_nCount        = nCount;
+  m_nBegun        = 0;
+  m_pNext         = NULL;
+  m_pPrev         = NULL;
+  m_bWaiting      = FALSE;
+}
+
+
+O22SnapIoTransactAwaiter::~O22SnapIoTransactAwaiter()
+//-------------------------------------------------------------------------------------------------
+// Destructor.  Only reached while waiting when the task is dropped.
+//-------------------------------------------------------------------------------------------------
+{
+  if (m_bWaiting)
+  {
+    m_pLoop->RemoveWaiter(this);
+    m_pMemMap->AbandonTransact(m_pTransactions, m_nBegun);
+  }
+}
+
+
+bool O22SnapIoTransactAwaiter::await_ready()
+//-------------------------------------------------------------------------------------------------
+// An empty batch doesn't need waiting for
+//-------------------------------------------------------------------------------------------------
+{
+  return m_nCount <= 0;
+}
+
+
+void O22SnapIoTransactAwaiter::await_suspend(std::coroutine_handle<> Handle)
+//-------------------------------------------------------------------------------------------------
+// Give the batch to the loop, which resumes the coroutine when it is done
+//-------------------------------------------------------------------------------------------------
+{
+  m_Handle = Handle;
+  m_pLoop->AddWaiter(this);
+}
+
+
+LONG O22SnapIoTransactAwaiter::await_resume()
+//-------------------------------------------------------------------------------------------------
+// The result of co_await: the first error, or SIOMM_OK
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  for (i = 0 ; i < m_nCount ; i++)
+  {
+    if (SIOMM_OK != m_pTransactions[i].nResult)
+      return m_pTransactions[i].nResult;
+  }
+
+  return SIOMM_OK;
+}
+
+
+BOOL O22SnapIoTransactAwaiter::IsFinished()
+//-------------------------------------------------------------------------------------------------
+// Check whether every transaction of the batch is done
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  if (m_nBegun < m_nCount)
+    return FALSE;
+
+  for (i = 0 ; i < m_nCount ; i++)
+  {
+    if (SIOMM_TRANSACTION_PENDING == m_pTransactions[i].nResult)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// O22SnapIoEventLoop
+//-------------------------------------------------------------------------------------------------
+
+
+O22SnapIoEventLoop::O22SnapIoEventLoop()
+//-------------------------------------------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------------------------------------------
+{
+  m_pFirstWaiter = NULL;
+  m_pLastWaiter  = NULL;
+  m_nConnections = 0;
+}
+
+
+O22SnapIoEventLoop::~O22SnapIoEventLoop()
+//-------------------------------------------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------------------------------------------
+{
+}
+
+
+LONG O22SnapIoEventLoop::Run(O22SnapIoTask & Task)
+//-------------------------------------------------------------------------------------------------
+// Run the loop until the task is done
+//-------------------------------------------------------------------------------------------------
+{
+  while (!Task.IsDone())
+  {
+    BeginWaiters();
+
+    // Batches that failed to begin are done already
+    if (ResumeFinishedWaiter())
+      continue;
+
+    // Nothing that the loop waits on can finish the task
+    if (0 == m_nConnections)
+      return SIOMM_ERROR;
+
+    WaitForConnections();
+
+    while (ResumeFinishedWaiter())
+      ;
+  }
+
+  return Task.GetResult();
+}
+
+
+void O22SnapIoEventLoop::AddWaiter(O22SnapIoTransactAwaiter * pWaiter)
+//-------------------------------------------------------------------------------------------------
+// Add an awaiter at the end of the list
+//-------------------------------------------------------------------------------------------------
+{
+  pWaiter->m_pNext = NULL;
+  pWaiter->m_pPrev = m_pLastWaiter;
+
+  if (m_pLastWaiter)
+    m_pLastWaiter->m_pNext = pWaiter;
+  else
+    m_pFirstWaiter = pWaiter;
+
+  m_pLastWaiter = pWaiter;
+  pWaiter->m_bWaiting = TRUE;
+}
+
+
+void O22SnapIoEventLoop::RemoveWaiter(O22SnapIoTransactAwaiter * pWaiter)
+//-------------------------------------------------------------------------------------------------
+// Take an awaiter off the list
+//-------------------------------------------------------------------------------------------------
+{
+  if (pWaiter->m_pPrev)
+    pWaiter->m_pPrev->m_pNext = pWaiter->m_pNext;
+  else
+    m_pFirstWaiter = pWaiter->m_pNext;
+
+  if (pWaiter->m_pNext)
+    pWaiter->m_pNext->m_pPrev = pWaiter->m_pPrev;
+  else
+    m_pLastWaiter = pWaiter->m_pPrev;
+
+  pWaiter->m_pNext    = NULL;
+  pWaiter->m_pPrev    = NULL;
+  pWaiter->m_bWaiting = FALSE;
+}
+
+
+BOOL O22SnapIoEventLoop::AddConnection(O22SnapIoMemMap * pMemMap)
+//-------------------------------------------------------------------------------------------------
+// Add an I/O unit to those waited on, if it isn't already.  Returns FALSE if there's no room.
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  for (i = 0 ; i < m_nConnections ; i++)
+  {
+    if (pMemMap == m_arrpConnections[i])
+      return TRUE;
+  }
+
+  if (SIOMM_LOOP_MAX_CONNECTIONS == m_nConnections)
+    return FALSE;
+
+  m_arrpConnections[m_nConnections++] = pMemMap;
+
+  return TRUE;
+}
+
+
+void O22SnapIoEventLoop::BeginWaiters()
+//-------------------------------------------------------------------------------------------------
+// Send as many of the waiting transactions as the I/O units have labels for, oldest batches
+// first, and list the I/O units with transactions outstanding
+//-------------------------------------------------------------------------------------------------
+{
+  O22SnapIoTransactAwaiter * pWaiter;
+  O22SnapIoMemMap          * pMemMap;
+  long                       nCount;   // transactions to begin
+  LONG                       nResult;  // for checking the return values of functions
+  long                       i;
+
+  m_nConnections = 0;
+
+  for (pWaiter = m_pFirstWaiter ; pWaiter ; pWaiter = pWaiter->m_pNext)
+  {
+    pMemMap = pWaiter->m_pMemMap;
+
+    if (pWaiter->m_nBegun < pWaiter->m_nCount)
+    {
+      nCount = pWaiter->m_nCount - pWaiter->m_nBegun;
+      if (nCount > SIOMM_MAX_TRANSACTION_LABELS - pMemMap->GetOutstandingCount())
+        nCount = SIOMM_MAX_TRANSACTION_LABELS - pMemMap->GetOutstandingCount();
+
+      if ((nCount > 0) && AddConnection(pMemMap))
+      {
+        nResult = pMemMap->BeginTransact(pWaiter->m_pTransactions + pWaiter->m_nBegun, nCount);
+        pWaiter->m_nBegun += nCount;
+
+        // A batch that can't be sent is done, with the error in the rest of its transactions
+        if (SIOMM_OK != nResult)
+        {
+          for (i = 0 ; i < pWaiter->m_nCount ; i++)
+          {
+            if (SIOMM_TRANSACTION_PENDING == pWaiter->m_pTransactions[i].nResult)
+              pWaiter->m_pTransactions[i].nResult = nResult;
+          }
+          pWaiter->m_nBegun = pWaiter->m_nCount;
+        }
+      }
+    }
+
+    if (pMemMap->GetOutstandingCount() > 0)
+      AddConnection(pMemMap);
+  }
+}
+
+
+void O22SnapIoEventLoop::WaitForConnections()
+//-------------------------------------------------------------------------------------------------
+// Wait until a response arrives on any of the I/O units, or the earliest deadline of their
+// outstanding transactions passes, and complete what can be completed
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nDeadlineNS = 0;    // the earliest deadline
+  LONGLONG nConnectionDeadlineNS;
+  LONGLONG nWaitNS;            // time left until the deadline
+  LONGLONG nNowNS;
+  BOOL     arrbReady[SIOMM_LOOP_MAX_CONNECTIONS];
+  int      nReady;             // the sockets' state, from select() or ppoll()
+  long     i;
+#ifdef _WIN32
+  fd_set   fds;
+  timeval  tvTimeOut;
+#endif
+#ifdef _LINUX
+  pollfd   arrPollSockets[SIOMM_LOOP_MAX_CONNECTIONS];
+  timespec tsTimeOut;
+#endif
+
+  for (i = 0 ; i < m_nConnections ; i++)
+  {
+    nConnectionDeadlineNS = m_arrpConnections[i]->GetOutstandingDeadline();
+    if ((0 == nDeadlineNS) || (nConnectionDeadlineNS < nDeadlineNS))
+      nDeadlineNS = nConnectionDeadlineNS;
+  }
+
+  for (;;)
+  {
+    nWaitNS = nDeadlineNS - O22GetTimeNS();
+    if (nWaitNS < 0)
+      nWaitNS = 0;
+
+#ifdef _WIN32
+    FD_ZERO(&fds);
+    for (i = 0 ; i < m_nConnections ; i++)
+      FD_SET(m_arrpConnections[i]->GetSocket(), &fds);
+    tvTimeOut.tv_sec  = (long)(nWaitNS / 1000000000);
+    tvTimeOut.tv_usec = (long)((nWaitNS % 1000000000 + 999) / 1000);
+
+    nReady = select(0, &fds, NULL, NULL, &tvTimeOut);
+
+    for (i = 0 ; i < m_nConnections ; i++)
+      arrbReady[i] = (nReady > 0) && FD_ISSET(m_arrpConnections[i]->GetSocket(), &fds);
+#endif
+#ifdef _LINUX
+    for (i = 0 ; i < m_nConnections ; i++)
+    {
+      arrPollSockets[i].fd      = m_arrpConnections[i]->GetSocket();
+      arrPollSockets[i].events  = POLLIN;
+      arrPollSockets[i].revents = 0;
+    }
+    tsTimeOut.tv_sec  = nWaitNS / 1000000000;
+    tsTimeOut.tv_nsec = nWaitNS % 1000000000;
+
+    nReady = ppoll(arrPollSockets, m_nConnections, &tsTimeOut, NULL);
+    if ((nReady < 0) && (EINTR == errno))
+      continue;
+
+    for (i = 0 ; i < m_nConnections ; i++)
+      arrbReady[i] = (nReady > 0) && (0 != arrPollSockets[i].revents);
+#endif
+
+    break;
+  }
+
+  // An error on the socket shows up as ready, and the receive reports it
+  nNowNS = O22GetTimeNS();
+  for (i = 0 ; i < m_nConnections ; i++)
+  {
+    if (arrbReady[i] || (nReady < 0) ||
+        (m_arrpConnections[i]->GetOutstandingDeadline() <= nNowNS))
+    {
+      m_arrpConnections[i]->ContinueTransact();
+    }
+  }
+}
+
+
+BOOL O22SnapIoEventLoop::ResumeFinishedWaiter()
+//-------------------------------------------------------------------------------------------------
+// Resume the coroutine of the oldest batch that is done, if any.  The coroutine may start new
+// batches or drop others, so the list is searched again each time.
+//-------------------------------------------------------------------------------------------------
+{
+  O22SnapIoTransactAwaiter * pWaiter;
+
+  for (pWaiter = m_pFirstWaiter ; pWaiter ; pWaiter = pWaiter->m_pNext)
+  {
+    if (pWaiter->IsFinished())
+    {
+      RemoveWaiter(pWaiter);
+      pWaiter->m_Handle.resume();
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// O22SnapIoAsync
+//-------------------------------------------------------------------------------------------------
+
+
+O22SnapIoAsync::O22SnapIoAsync(O22SnapIoEventLoop * pLoop, O22SnapIoMemMap * pMemMap)
+//-------------------------------------------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------------------------------------------
+{
+  m_pLoop   = pLoop;
+  m_pMemMap = pMemMap;
+}
+
+
+O22SnapIoAsync::~O22SnapIoAsync()
+//-------------------------------------------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------------------------------------------
+{
+}
+
+
+O22SnapIoMemMap * O22SnapIoAsync::GetMemMap()
+//-------------------------------------------------------------------------------------------------
+// Get the I/O unit
+//-------------------------------------------------------------------------------------------------
+{
+  return m_pMemMap;
+}
+
+
+O22SnapIoTask O22SnapIoAsync::Transact(SIOMM_Transaction * pTransactions, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Perform several transactions, all outstanding at the same time
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Status;   // for reading the I/O unit's last error
+  LONG nLastErrorResult;
+  long i;
+
+  for (i = 0 ; i < nCount ; i++)
+    pTransactions[i].nResult = SIOMM_TRANSACTION_PENDING;
+
+  do
+  {
+    co_await O22SnapIoTransactAwaiter(m_pLoop, m_pMemMap, pTransactions, nCount);
+
+    // Get the I/O unit's error code for any request it rejected.  Nothing else of ours is
+    // outstanding on it now.
+    nLastErrorResult = SIOMM_OK;
+    for (i = 0 ; i < nCount ; i++)
+    {
+      if (SIOMM_TRANSACTION_NAK == pTransactions[i].nResult)
+      {
+        Status.byTransactionCode = SIOMM_TCODE_READ_QUAD_REQUEST;
+        Status.dwDestOffset      = SIOMM_STATUS_READ_LAST_ERROR;
+        Status.nResult           = SIOMM_TRANSACTION_PENDING;
+
+        nLastErrorResult = co_await O22SnapIoTransactAwaiter(m_pLoop, m_pMemMap, &Status, 1);
+        if (SIOMM_OK == nLastErrorResult)
+          nLastErrorResult = (long)Status.dwQuadlet;
+        break;
+      }
+    }
+  } while (m_pMemMap->ResolveNakResults(pTransactions, nCount, nLastErrorResult));
+
+  // Return the first error
+  for (i = 0 ; i < nCount ; i++)
+  {
+    if (SIOMM_OK != pTransactions[i].nResult)
+      co_return pTransactions[i].nResult;
+  }
+
+  co_return SIOMM_OK;
+}
+
+
+O22SnapIoTask O22SnapIoAsync::ReadQuad(DWORD dwDestOffset, DWORD * pdwQuadlet)
+//-------------------------------------------------------------------------------------------------
+// Read a quadlet of data from a location in the SNAP I/O memory map.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Transaction;
+  LONG              nResult;
+
+  Transaction.byTransactionCode = SIOMM_TCODE_READ_QUAD_REQUEST;
+  Transaction.dwDestOffset      = dwDestOffset;
+
+  nResult = co_await Transact(&Transaction, 1);
+
+  if (SIOMM_OK == nResult)
+    *pdwQuadlet = Transaction.dwQuadlet;
+
+  co_return nResult;
+}
+
+
+O22SnapIoTask O22SnapIoAsync::WriteQuad(DWORD dwDestOffset, DWORD dwQuadlet)
+//-------------------------------------------------------------------------------------------------
+// Write a quadlet of data to a location in the SNAP I/O memory map.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Transaction;
+
+  Transaction.byTransactionCode = SIOMM_TCODE_WRITE_QUAD_REQUEST;
+  Transaction.dwDestOffset      = dwDestOffset;
+  Transaction.dwQuadlet         = dwQuadlet;
+
+  co_return co_await Transact(&Transaction, 1);
+}
+
+
+O22SnapIoTask O22SnapIoAsync::ReadFloat(DWORD dwDestOffset, float * pfValue)
+//-------------------------------------------------------------------------------------------------
+// Read a float value from a location in the SNAP I/O memory map.
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD dwQuadlet; // A temp for getting the read value
+  LONG  nResult;   // for checking the return values of functions
+
+  nResult = co_await ReadQuad(dwDestOffset, &dwQuadlet);
+
+  if (SIOMM_OK == nResult)
+    memcpy(pfValue, &dwQuadlet, 4);
+
+  co_return nResult;
+}
+
+
+O22SnapIoTask O22SnapIoAsync::WriteFloat(DWORD dwDestOffset, float fValue)
+//-------------------------------------------------------------------------------------------------
+// Write a float value to a location in the SNAP I/O memory map.
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD dwQuadlet = 0; // A temp for setting the value
+
+  memcpy(&dwQuadlet, &fValue, 4);
+
+  co_return co_await WriteQuad(dwDestOffset, dwQuadlet);
+}
+
+
+O22SnapIoTask O22SnapIoAsync::ReadBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData)
+//-------------------------------------------------------------------------------------------------
+// Read a block of data from a location in the SNAP I/O memory map.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Transaction;
+
+  if (wDataLength > SIOMM_MAX_BLOCK_LENGTH)
+    co_return SIOMM_ERROR;
+
+  Transaction.byTransactionCode = SIOMM_TCODE_READ_BLOCK_REQUEST;
+  Transaction.dwDestOffset      = dwDestOffset;
+  Transaction.wDataLength       = wDataLength;
+  Transaction.pbyData           = pbyData;
+
+  co_return co_await Transact(&Transaction, 1);
+}
+
+
+O22SnapIoTask O22SnapIoAsync::WriteBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData)
+//-------------------------------------------------------------------------------------------------
+// Write a block of data to a location in the SNAP I/O memory map.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Transaction;
+
+  if (wDataLength > SIOMM_MAX_BLOCK_LENGTH)
+    co_return SIOMM_ERROR;
+
+  Transaction.byTransactionCode = SIOMM_TCODE_WRITE_BLOCK_REQUEST;
+  Transaction.dwDestOffset      = dwDestOffset;
+  Transaction.wDataLength       = wDataLength;
+  Transaction.pbyData           = pbyData;
+
+  co_return co_await Transact(&Transaction, 1);
+}
+
+
+O22SnapIoTask O22SnapIoAsync::GetAnaPtValue(long nPoint, float *pfValue)
+//-------------------------------------------------------------------------------------------------
+// Get the value of the specified analog point.
+//-------------------------------------------------------------------------------------------------
+{
+  co_return co_await ReadFloat(SIOMM_APOINT_READ_VALUE_BASE + (SIOMM_APOINT_READ_BOUNDARY * nPoint),
+                               pfValue);
+}
+
+
+O22SnapIoTask O22SnapIoAsync::SetAnaPtValue(long nPoint, float fValue)
+//-------------------------------------------------------------------------------------------------
+// Set the value for the specified analog point
+//-------------------------------------------------------------------------------------------------
+{
+  co_return co_await WriteFloat(SIOMM_APOINT_WRITE_VALUE_BASE + (SIOMM_APOINT_WRITE_BOUNDARY * nPoint),
+                                fValue);
+}
+
+
+O22SnapIoTask O22SnapIoAsync::GetAnaBankValuesEx(SIOMM_AnaBank * pBankData)
+//-------------------------------------------------------------------------------------------------
+// Get the analog point values in the analog bank
+//-------------------------------------------------------------------------------------------------
+{
+  co_return co_await ReadRange<O22AnaBankValues>(pBankData->fValue);
+}
+
+
+O22SnapIoTask O22SnapIoAsync::SetAnaBankValuesEx(SIOMM_AnaBank BankData)
+//-------------------------------------------------------------------------------------------------
+// Set the analog point values in the analog bank
+//-------------------------------------------------------------------------------------------------
+{
+  co_return co_await WriteRange<O22AnaBankWriteValues>(BankData.fValue);
+}
+
+
+O22SnapIoTask O22SnapIoAsync::GetDigBankPointStates(long *pnPts63to32, long *pnPts31to0)
+//-------------------------------------------------------------------------------------------------
+// Get the digital point states in the digital bank
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;      // for checking the return values of functions
+  BYTE arrbyData[8]; // buffer for the data to be read
+
+  nResult = co_await ReadBlock(SIOMM_DBANK_READ_POINT_STATES, 8, arrbyData);
+
+  if (SIOMM_OK == nResult)
+  {
+    *pnPts63to32 = O22MAKELONG2(arrbyData, 0);
+    *pnPts31to0  = O22MAKELONG2(arrbyData, 4);
+  }
+
+  co_return nResult;
+}
+
+
+O22SnapIoTask O22SnapIoAsync::SetDigBankPointStates(long nPts63to32, long nPts31to0,
+                                                    long nMask63to32, long nMask31to0)
+//-------------------------------------------------------------------------------------------------
+// Set the digital point states in the digital bank.  Only those points set in the mask parameters
+// are set.
+//-------------------------------------------------------------------------------------------------
+{
+  BYTE arrbyData[16]; // the turn on masks, then the turn off masks
+
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 0,  nPts63to32 & nMask63to32);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 4,  nPts31to0  & nMask31to0);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 8,  (nPts63to32 ^ 0xFFFFFFFF) & nMask63to32);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 12, (nPts31to0  ^ 0xFFFFFFFF) & nMask31to0);
+
+  co_return co_await WriteBlock(SIOMM_DBANK_WRITE_TURN_ON_MASK, 16, arrbyData);
+}
+
+
+#endif // __cpp_impl_coroutine
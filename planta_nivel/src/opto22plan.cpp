@@ -0,0 +1,528 @@
+//-----------------------------------------------------------------------------
+//
+// O22SIOPL.cpp
+//
+// Source for the O22SnapIoPlan C++ class.
+//
+// The O22SnapIoPlan C++ class decides how to reach a set of point fields of
+// an Opto 22 SNAP Ethernet I/O unit with the fewest transactions and bytes.
+// See O22SIOPL.h for usage.
+//
+// While this class was developed on Microsoft Windows 32-bit operating
+// systems, it is intended to be as generic as possible.  For Windows specific
+// code, search for "_WIN32" and "_WIN32_WCE".  For Linux specific code, search
+// for "_LINUX".
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOPL.h"
+#include <stdlib.h>
+
+
+// How a field is packed in its bank area
+#define PLAN_BANK_NONE    0 // No bank area
+#define PLAN_BANK_QUADS   1 // One quadlet for each point
+#define PLAN_BANK_BITS    2 // One bit for each point, points 63-32 first and then 31-0
+#define PLAN_BANK_MASKS   3 // Turn on and off masks laid out like PLAN_BANK_BITS
+
+// Where a field is in the memory map. Quadlets may be read together only when they are in the
+// same span: the defined part of one point area, or of one bank area.
+typedef struct PlanField
+{
+  DWORD dwPoint;            // Address of the field of point 0 in the point area, or 0 if none
+  DWORD dwPointSpan;        // Address of the point area of point 0
+  DWORD dwPointSpanLength;  // Defined length of a point area
+  DWORD dwPointBoundary;    // Distance between the point areas of two points
+  DWORD dwBank;             // Address of the field in the bank area
+  long  nBankKind;          // PLAN_BANK_NONE, PLAN_BANK_QUADS, etc.
+  DWORD dwBankSpan;         // Address and defined length of the bank area
+  DWORD dwBankSpanLength;
+} PlanField;
+
+static const PlanField s_arrReadFields[SIOMM_PLAN_FIELDS] =
+{
+  // SIOMM_PLAN_ANA_VALUE
+  { SIOMM_APOINT_READ_VALUE_BASE,     SIOMM_APOINT_READ_AREA_BASE, 0x10, SIOMM_APOINT_READ_BOUNDARY,
+    SIOMM_ABANK_READ_POINT_VALUES,     PLAN_BANK_QUADS, SIOMM_ABANK_READ_AREA_BASE, 4 * SIOMM_ABANK_MAX_BYTES },
+  // SIOMM_PLAN_ANA_COUNTS
+  { SIOMM_APOINT_READ_COUNTS_BASE,    SIOMM_APOINT_READ_AREA_BASE, 0x10, SIOMM_APOINT_READ_BOUNDARY,
+    SIOMM_ABANK_READ_POINT_COUNTS,     PLAN_BANK_QUADS, SIOMM_ABANK_READ_AREA_BASE, 4 * SIOMM_ABANK_MAX_BYTES },
+  // SIOMM_PLAN_ANA_MIN_VALUE
+  { SIOMM_APOINT_READ_MIN_VALUE_BASE, SIOMM_APOINT_READ_AREA_BASE, 0x10, SIOMM_APOINT_READ_BOUNDARY,
+    SIOMM_ABANK_READ_POINT_MIN_VALUES, PLAN_BANK_QUADS, SIOMM_ABANK_READ_AREA_BASE, 4 * SIOMM_ABANK_MAX_BYTES },
+  // SIOMM_PLAN_ANA_MAX_VALUE
+  { SIOMM_APOINT_READ_MAX_VALUE_BASE, SIOMM_APOINT_READ_AREA_BASE, 0x10, SIOMM_APOINT_READ_BOUNDARY,
+    SIOMM_ABANK_READ_POINT_MAX_VALUES, PLAN_BANK_QUADS, SIOMM_ABANK_READ_AREA_BASE, 4 * SIOMM_ABANK_MAX_BYTES },
+  // SIOMM_PLAN_DIG_STATE
+  { SIOMM_DPOINT_READ_STATE,          SIOMM_DPOINT_READ_AREA_BASE, 0x14, SIOMM_DPOINT_READ_BOUNDARY,
+    SIOMM_DBANK_READ_POINT_STATES,     PLAN_BANK_BITS,  SIOMM_DBANK_READ_AREA_BASE, 0x20 },
+  // SIOMM_PLAN_DIG_ON_LATCH
+  { SIOMM_DPOINT_READ_ONLATCH_STATE,  SIOMM_DPOINT_READ_AREA_BASE, 0x14, SIOMM_DPOINT_READ_BOUNDARY,
+    SIOMM_DBANK_READ_ON_LATCH_STATES,  PLAN_BANK_BITS,  SIOMM_DBANK_READ_AREA_BASE, 0x20 },
+  // SIOMM_PLAN_DIG_OFF_LATCH
+  { SIOMM_DPOINT_READ_OFFLATCH_STATE, SIOMM_DPOINT_READ_AREA_BASE, 0x14, SIOMM_DPOINT_READ_BOUNDARY,
+    SIOMM_DBANK_READ_OFF_LATCH_STATES, PLAN_BANK_BITS,  SIOMM_DBANK_READ_AREA_BASE, 0x20 },
+  // SIOMM_PLAN_DIG_ACTIVE_COUNTER
+  { SIOMM_DPOINT_READ_ACTIVE_COUNTER, SIOMM_DPOINT_READ_AREA_BASE, 0x14, SIOMM_DPOINT_READ_BOUNDARY,
+    SIOMM_DBANK_READ_ACTIVE_COUNTERS,  PLAN_BANK_BITS,  SIOMM_DBANK_READ_AREA_BASE, 0x20 },
+  // SIOMM_PLAN_DIG_COUNTER_DATA
+  { SIOMM_DPOINT_READ_COUNTER_DATA,   SIOMM_DPOINT_READ_AREA_BASE, 0x14, SIOMM_DPOINT_READ_BOUNDARY,
+    SIOMM_DBANK_READ_COUNTER_DATA_BASE, PLAN_BANK_QUADS, SIOMM_DBANK_READ_COUNTER_DATA_BASE,
+    SIOMM_DBANK_READ_COUNTER_DATA_BOUNDARY * SIOMM_DBANK_MAX_FEATURE_ELEMENTS }
+};
+
+static const PlanField s_arrWriteFields[SIOMM_PLAN_FIELDS] =
+{
+  // SIOMM_PLAN_ANA_VALUE
+  { SIOMM_APOINT_WRITE_VALUE_BASE,  SIOMM_APOINT_WRITE_VALUE_BASE, 0x10, SIOMM_APOINT_WRITE_BOUNDARY,
+    SIOMM_ABANK_WRITE_POINT_VALUES, PLAN_BANK_QUADS, SIOMM_ABANK_WRITE_AREA_BASE, 2 * SIOMM_ABANK_MAX_BYTES },
+  // SIOMM_PLAN_ANA_COUNTS
+  { SIOMM_APOINT_WRITE_COUNTS_BASE, SIOMM_APOINT_WRITE_VALUE_BASE, 0x10, SIOMM_APOINT_WRITE_BOUNDARY,
+    SIOMM_ABANK_WRITE_POINT_COUNTS, PLAN_BANK_QUADS, SIOMM_ABANK_WRITE_AREA_BASE, 2 * SIOMM_ABANK_MAX_BYTES },
+  // SIOMM_PLAN_ANA_MIN_VALUE and SIOMM_PLAN_ANA_MAX_VALUE can't be written
+  { 0, 0, 0, 0, 0, PLAN_BANK_NONE, 0, 0 },
+  { 0, 0, 0, 0, 0, PLAN_BANK_NONE, 0, 0 },
+  // SIOMM_PLAN_DIG_STATE
+  { 0, 0, 0, 0,
+    SIOMM_DBANK_WRITE_TURN_ON_MASK, PLAN_BANK_MASKS, SIOMM_DBANK_WRITE_AREA_BASE, 0x10 },
+  // The latches and counters are read only
+  { 0, 0, 0, 0, 0, PLAN_BANK_NONE, 0, 0 },
+  { 0, 0, 0, 0, 0, PLAN_BANK_NONE, 0, 0 },
+  { 0, 0, 0, 0, 0, PLAN_BANK_NONE, 0, 0 },
+  { 0, 0, 0, 0, 0, PLAN_BANK_NONE, 0, 0 }
+};
+
+
+// A quadlet the plan must read or write
+typedef struct PlanQuad
+{
+  DWORD dwAddress;
+  DWORD dwSpan;     // Address of the span holding it
+  long  nFlags;     // Flags of a block holding it
+} PlanQuad;
+
+
+static int PlanCompareQuads(const void * pA, const void * pB)
+{
+  DWORD dwA = ((const PlanQuad *)pA)->dwAddress;
+  DWORD dwB = ((const PlanQuad *)pB)->dwAddress;
+
+  return (dwA < dwB) ? -1 : (dwA > dwB) ? 1 : 0;
+}
+
+
+static int PlanCompareBlocks(const void * pA, const void * pB)
+{
+  DWORD dwA = ((const SIOMM_PlanBlock *)pA)->dwAddress;
+  DWORD dwB = ((const SIOMM_PlanBlock *)pB)->dwAddress;
+
+  return (dwA < dwB) ? -1 : (dwA > dwB) ? 1 : 0;
+}
+
+
+O22SnapIoPlan::O22SnapIoPlan()
+//-------------------------------------------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------------------------------------------
+{
+  m_nItems  = 0;
+  m_nBlocks = 0;
+
+  m_nTransactionNS = SIOMM_PLAN_TRANSACTION_NS;
+  m_nByteNS        = SIOMM_PLAN_BYTE_NS;
+  m_nCostNS        = 0;
+  m_bComputed      = FALSE;
+}
+
+
+O22SnapIoPlan::~O22SnapIoPlan()
+//-------------------------------------------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------------------------------------------
+{
+}
+
+
+LONG O22SnapIoPlan::AddRead(long nPoint, long nField)
+//-------------------------------------------------------------------------------------------------
+// Add a point field to be read
+//-------------------------------------------------------------------------------------------------
+{
+  return AddItem(nPoint, nField, FALSE);
+}
+
+
+LONG O22SnapIoPlan::AddWrite(long nPoint, long nField)
+//-------------------------------------------------------------------------------------------------
+// Add a point field to be written
+//-------------------------------------------------------------------------------------------------
+{
+  return AddItem(nPoint, nField, TRUE);
+}
+
+
+LONG O22SnapIoPlan::AddItem(long nPoint, long nField, BOOL bWrite)
+//-------------------------------------------------------------------------------------------------
+// Add a point field to the plan
+//-------------------------------------------------------------------------------------------------
+{
+  const PlanField * pField;
+
+  if ((m_nItems >= SIOMM_PLAN_MAX_ITEMS) ||
+      (nPoint < 0) || (nPoint >= SIOMM_ABANK_MAX_ELEMENTS) ||
+      (nField < 0) || (nField >= SIOMM_PLAN_FIELDS))
+  {
+    return SIOMM_ERROR;
+  }
+
+  pField = bWrite ? &s_arrWriteFields[nField] : &s_arrReadFields[nField];
+  if ((pField->dwPoint == 0) && (pField->nBankKind == PLAN_BANK_NONE))
+    return SIOMM_ERROR;
+
+  m_arrItems[m_nItems].nPoint    = nPoint;
+  m_arrItems[m_nItems].nField    = nField;
+  m_arrItems[m_nItems].bWrite    = bWrite;
+  m_arrItems[m_nItems].dwAddress = 0;
+  m_arrItems[m_nItems].nBit      = -1;
+  m_nItems++;
+
+  m_bComputed = FALSE;
+
+  return SIOMM_OK;
+}
+
+
+void O22SnapIoPlan::SetCostModel(LONGLONG nTransactionNS, LONGLONG nByteNS)
+//-------------------------------------------------------------------------------------------------
+// Set the cost of a transaction and of a byte
+//-------------------------------------------------------------------------------------------------
+{
+  m_nTransactionNS = nTransactionNS;
+  m_nByteNS        = nByteNS;
+  m_bComputed      = FALSE;
+}
+
+
+LONGLONG O22SnapIoPlan::PlanItems(BOOL bWrite, BOOL * pbUseBank, BOOL bKeep)
+//-------------------------------------------------------------------------------------------------
+// Find the cheapest blocks for the read or the write items, with the area of each field given
+// by pbUseBank. If bKeep is set the blocks are added to the plan and the items are located.
+// Returns the cost, or -1 if bKeep is set and there are too many blocks.
+//-------------------------------------------------------------------------------------------------
+{
+  const PlanField * pField;
+  PlanQuad   arrQuads[SIOMM_PLAN_MAX_ITEMS * 4];
+  LONGLONG   arrnCost[SIOMM_PLAN_MAX_ITEMS * 4 + 1]; // cheapest cost of the first j quadlets
+  long       arrnFrom[SIOMM_PLAN_MAX_ITEMS * 4 + 1]; // first quadlet of the last block
+  LONGLONG   nCost;
+  DWORD      dwLength;
+  long       nQuads;
+  long       nItem;
+  long       nPoint;
+  long       i;
+  long       j;
+
+  // The quadlets each item is in
+  nQuads = 0;
+  for (nItem = 0 ; nItem < m_nItems ; nItem++)
+  {
+    if (m_arrItems[nItem].bWrite != bWrite)
+      continue;
+
+    nPoint = m_arrItems[nItem].nPoint;
+    pField = bWrite ? &s_arrWriteFields[m_arrItems[nItem].nField] :
+                      &s_arrReadFields[m_arrItems[nItem].nField];
+
+    if (!pbUseBank[m_arrItems[nItem].nField])
+    {
+      arrQuads[nQuads].dwAddress = pField->dwPoint + pField->dwPointBoundary * nPoint;
+      arrQuads[nQuads].dwSpan    = pField->dwPointSpan + pField->dwPointBoundary * nPoint;
+      arrQuads[nQuads].nFlags    = bWrite ? SIOMM_SHADOW_WRITE : SIOMM_SHADOW_READ;
+      nQuads++;
+      if (bKeep)
+      {
+        m_arrItems[nItem].dwAddress = arrQuads[nQuads - 1].dwAddress;
+        m_arrItems[nItem].nBit      = -1;
+      }
+    }
+    else if (pField->nBankKind == PLAN_BANK_QUADS)
+    {
+      arrQuads[nQuads].dwAddress = pField->dwBank + 4 * nPoint;
+      arrQuads[nQuads].dwSpan    = pField->dwBankSpan;
+      arrQuads[nQuads].nFlags    = bWrite ? SIOMM_SHADOW_WRITE : SIOMM_SHADOW_READ;
+      nQuads++;
+      if (bKeep)
+      {
+        m_arrItems[nItem].dwAddress = arrQuads[nQuads - 1].dwAddress;
+        m_arrItems[nItem].nBit      = -1;
+      }
+    }
+    else if (pField->nBankKind == PLAN_BANK_BITS)
+    {
+      arrQuads[nQuads].dwAddress = pField->dwBank + ((nPoint < 32) ? 4 : 0);
+      arrQuads[nQuads].dwSpan    = pField->dwBankSpan;
+      arrQuads[nQuads].nFlags    = SIOMM_SHADOW_READ;
+      nQuads++;
+      if (bKeep)
+      {
+        m_arrItems[nItem].dwAddress = arrQuads[nQuads - 1].dwAddress;
+        m_arrItems[nItem].nBit      = nPoint & 31;
+      }
+    }
+    else // PLAN_BANK_MASKS
+    {
+      // Both masks are written together, so that a point can be turned on or off
+      for (i = 0 ; i < 4 ; i++)
+      {
+        arrQuads[nQuads].dwAddress = pField->dwBank + 4 * i;
+        arrQuads[nQuads].dwSpan    = pField->dwBankSpan;
+        arrQuads[nQuads].nFlags    = SIOMM_SHADOW_WRITE | SIOMM_SHADOW_ACTION;
+        nQuads++;
+      }
+      if (bKeep)
+      {
+        m_arrItems[nItem].dwAddress = pField->dwBank + ((nPoint < 32) ? 4 : 0);
+        m_arrItems[nItem].nBit      = nPoint & 31;
+      }
+    }
+  }
+
+  if (nQuads == 0)
+    return 0;
+
+  // By address, each quadlet once
+  qsort(arrQuads, nQuads, sizeof(PlanQuad), PlanCompareQuads);
+  j = 0;
+  for (i = 1 ; i < nQuads ; i++)
+  {
+    if (arrQuads[i].dwAddress != arrQuads[j].dwAddress)
+      arrQuads[++j] = arrQuads[i];
+  }
+  nQuads = j + 1;
+
+  // The cheapest way to cover the first j quadlets ends with a block from some quadlet i to
+  // quadlet j - 1. A read block may take in the gaps of its span; a write block may not, or it
+  // would write over values nobody set.
+  arrnCost[0] = 0;
+  for (j = 1 ; j <= nQuads ; j++)
+  {
+    arrnCost[j] = -1;
+    for (i = j - 1 ; i >= 0 ; i--)
+    {
+      if (i < j - 1)
+      {
+        if (arrQuads[i].nFlags != arrQuads[j - 1].nFlags)
+          break;
+        if (bWrite && (arrQuads[i].dwAddress + 4 != arrQuads[i + 1].dwAddress))
+          break;
+        if (!bWrite && (arrQuads[i].dwSpan != arrQuads[j - 1].dwSpan))
+          break;
+      }
+
+      dwLength = arrQuads[j - 1].dwAddress + 4 - arrQuads[i].dwAddress;
+      if (dwLength > SIOMM_MAX_BLOCK_LENGTH)
+        break;
+
+      nCost = arrnCost[i] + m_nTransactionNS + m_nByteNS * dwLength;
+      if ((arrnCost[j] < 0) || (nCost < arrnCost[j]))
+      {
+        arrnCost[j] = nCost;
+        arrnFrom[j] = i;
+      }
+    }
+  }
+
+  if (bKeep)
+  {
+    for (j = nQuads ; j > 0 ; j = arrnFrom[j])
+    {
+      if (m_nBlocks >= SIOMM_PLAN_MAX_BLOCKS)
+        return -1;
+
+      i = arrnFrom[j];
+      m_arrBlocks[m_nBlocks].dwAddress = arrQuads[i].dwAddress;
+      m_arrBlocks[m_nBlocks].wLength   = (WORD)(arrQuads[j - 1].dwAddress + 4 - arrQuads[i].dwAddress);
+      m_arrBlocks[m_nBlocks].nFlags    = arrQuads[i].nFlags;
+      m_nBlocks++;
+    }
+  }
+
+  return arrnCost[nQuads];
+}
+
+
+LONG O22SnapIoPlan::Compute()
+//-------------------------------------------------------------------------------------------------
+// Compute the plan, if it isn't computed yet
+//-------------------------------------------------------------------------------------------------
+{
+  const PlanField * arrFields;
+  BOOL     arrbUseBank[SIOMM_PLAN_FIELDS];
+  BOOL     arrbUsed[SIOMM_PLAN_FIELDS];
+  BOOL     arrbChosen[SIOMM_PLAN_FIELDS];
+  long     arrnFields[SIOMM_PLAN_FIELDS];
+  BOOL     bWrite;
+  long     nDirection;
+  LONGLONG nBestCost;
+  LONGLONG nCost;
+  long     nBestChoice;
+  long     nChoice;
+  long     nFields;
+  long     nGroup;
+  long     nField;
+  long     nItem;
+  long     i;
+
+  if (m_bComputed)
+    return SIOMM_OK;
+
+  m_nBlocks = 0;
+  m_nCostNS = 0;
+
+  // Reads first, then writes
+  for (nDirection = 0 ; nDirection < 2 ; nDirection++)
+  {
+    bWrite    = (nDirection == 1);
+    arrFields = bWrite ? s_arrWriteFields : s_arrReadFields;
+
+    for (nField = 0 ; nField < SIOMM_PLAN_FIELDS ; nField++)
+    {
+      arrbUseBank[nField] = (arrFields[nField].nBankKind != PLAN_BANK_NONE);
+      arrbUsed[nField]    = FALSE;
+      arrbChosen[nField]  = FALSE;
+    }
+    for (nItem = 0 ; nItem < m_nItems ; nItem++)
+    {
+      if (m_arrItems[nItem].bWrite == bWrite)
+        arrbUsed[m_arrItems[nItem].nField] = TRUE;
+    }
+
+    // Fields of the same points can be read as one block only from their point areas, so the
+    // areas of the fields that share point areas are chosen together, trying every choice.
+    // Fields of different point areas never share a block and are chosen apart.
+    for (nGroup = 0 ; nGroup < SIOMM_PLAN_FIELDS ; nGroup++)
+    {
+      nFields = 0;
+      for (nField = 0 ; nField < SIOMM_PLAN_FIELDS ; nField++)
+      {
+        if (arrbUsed[nField] && (arrFields[nField].dwPoint != 0) &&
+            (arrFields[nField].nBankKind != PLAN_BANK_NONE) &&
+            (arrFields[nField].dwPointSpan == arrFields[nGroup].dwPointSpan) &&
+            !arrbChosen[nField])
+        {
+          arrnFields[nFields++] = nField;
+          arrbChosen[nField] = TRUE;
+        }
+      }
+      if (nFields == 0)
+        continue;
+
+      nBestChoice = 0;
+      nBestCost   = -1;
+      for (nChoice = 0 ; nChoice < (1L << nFields) ; nChoice++)
+      {
+        for (i = 0 ; i < nFields ; i++)
+          arrbUseBank[arrnFields[i]] = !((nChoice >> i) & 1);
+
+        nCost = PlanItems(bWrite, arrbUseBank, FALSE);
+        if ((nBestCost < 0) || (nCost < nBestCost))
+        {
+          nBestCost   = nCost;
+          nBestChoice = nChoice;
+        }
+      }
+      for (i = 0 ; i < nFields ; i++)
+        arrbUseBank[arrnFields[i]] = !((nBestChoice >> i) & 1);
+    }
+
+    nCost = PlanItems(bWrite, arrbUseBank, TRUE);
+    if (nCost < 0)
+      return SIOMM_ERROR;
+
+    m_nCostNS += nCost;
+  }
+
+  qsort(m_arrBlocks, m_nBlocks, sizeof(SIOMM_PlanBlock), PlanCompareBlocks);
+  m_bComputed = TRUE;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoPlan::GetItemLocation(long nItem, DWORD * pdwAddress, long * pnBit)
+//-------------------------------------------------------------------------------------------------
+// Get where an item is in the memory map
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;  // for checking the return values of functions
+
+  if ((nItem < 0) || (nItem >= m_nItems))
+    return SIOMM_ERROR;
+
+  nResult = Compute();
+  if (SIOMM_OK != nResult)
+    return nResult;
+
+  *pdwAddress = m_arrItems[nItem].dwAddress;
+  *pnBit      = m_arrItems[nItem].nBit;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoPlan::GetBlocks(SIOMM_PlanBlock * pBlocks, long nMaxBlocks, long * pnBlocks)
+//-------------------------------------------------------------------------------------------------
+// Get the blocks of the plan
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;  // for checking the return values of functions
+  long nBlock;
+
+  nResult = Compute();
+  if (SIOMM_OK != nResult)
+    return nResult;
+
+  for (nBlock = 0 ; (nBlock < m_nBlocks) && (nBlock < nMaxBlocks) ; nBlock++)
+    pBlocks[nBlock] = m_arrBlocks[nBlock];
+
+  *pnBlocks = m_nBlocks;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoPlan::GetCostNS(LONGLONG * pnCostNS)
+//-------------------------------------------------------------------------------------------------
+// Get the cost of the plan
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;  // for checking the return values of functions
+
+  nResult = Compute();
+  if (SIOMM_OK != nResult)
+    return nResult;
+
+  *pnCostNS = m_nCostNS;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoPlan::AddToShadow(O22SnapIoShadow * pShadow)
+//-------------------------------------------------------------------------------------------------
+// Add every block of the plan as a region of a shadow
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;  // for checking the return values of functions
+  long nBlock;
+
+  nResult = Compute();
+
+  for (nBlock = 0 ; (SIOMM_OK == nResult) && (nBlock < m_nBlocks) ; nBlock++)
+  {
+    nResult = pShadow->AddRegion(m_arrBlocks[nBlock].dwAddress, m_arrBlocks[nBlock].wLength,
+                                 m_arrBlocks[nBlock].nFlags);
+  }
+
+  return nResult;
+}
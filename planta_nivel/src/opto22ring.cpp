@@ -0,0 +1,656 @@
+//-----------------------------------------------------------------------------
+//
+// O22SIORG.cpp
+//
+// Source for the O22SnapIoRing C++ class.
+//
+// The O22SnapIoRing C++ class sends and receives on the socket of an
+// O22SnapIoMemMap through a Linux io_uring. See O22SIORG.h for usage.
+//
+// The ring is Linux only and is built when _IO_URING is defined. Elsewhere
+// Open() fails and the memory map keeps using the sockets directly.
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIORG.h"
+
+
+#if defined(_LINUX) && defined(_IO_URING)
+#define O22_RING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#endif
+
+
+// What each submission queue entry is for, in its user_data
+#define RING_SEND    0x100  // plus the number of the send
+#define RING_RECV    0x200  // plus the number of the receive
+#define RING_CANCEL  0x300
+#define RING_KIND    0xF00
+
+
+O22SnapIoRing::O22SnapIoRing()
+//-------------------------------------------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------------------------------------------
+{
+  m_nRingFd      = -1;
+  m_pbyRing      = NULL;
+  m_nRingSize    = 0;
+  m_pSqes        = NULL;
+  m_nSqesSize    = 0;
+  m_nToSubmit    = 0;
+  m_nInFlight    = 0;
+#ifdef _LINUX
+  m_nSends       = 0;
+  m_nSendVectors = 0;
+  m_nSendResult  = SIOMM_OK;
+  m_pbyDatagrams = NULL;
+  m_bWaitAll     = FALSE;
+  m_nRecvs       = 0;
+  m_nDoneRecvs   = 0;
+  m_nTakenRecvs  = 0;
+#endif
+}
+
+
+O22SnapIoRing::~O22SnapIoRing()
+//-------------------------------------------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------------------------------------------
+{
+  Close();
+}
+
+
+LONG O22SnapIoRing::Open()
+//-------------------------------------------------------------------------------------------------
+// Set up the ring and map its queues
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef O22_RING
+  struct io_uring_params Params;
+  long                   nCqSize; // bytes of the completion ring
+  int                    nProbeFd;
+
+  if (IsOpen())
+    return SIOMM_OK;
+
+  memset(&Params, 0, sizeof(Params));
+  m_nRingFd = syscall(__NR_io_uring_setup, SIOMM_RING_ENTRIES, &Params);
+  if (m_nRingFd < 0)
+  {
+    m_nRingFd = -1;
+    return SIOMM_ERROR;
+  }
+
+  // The waits need a timeout (Linux 5.11), and both rings must be in one mapping
+  if (!(Params.features & IORING_FEAT_EXT_ARG) || !(Params.features & IORING_FEAT_SINGLE_MMAP))
+  {
+    Close();
+    return SIOMM_ERROR;
+  }
+
+  m_nRingSize = Params.sq_off.array + Params.sq_entries * sizeof(unsigned int);
+  nCqSize     = Params.cq_off.cqes + Params.cq_entries * sizeof(struct io_uring_cqe);
+  if (nCqSize > m_nRingSize)
+    m_nRingSize = nCqSize;
+
+  m_pbyRing = (BYTE*)mmap(NULL, m_nRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          m_nRingFd, IORING_OFF_SQ_RING);
+  if (MAP_FAILED == (void*)m_pbyRing)
+  {
+    m_pbyRing = NULL;
+    Close();
+    return SIOMM_ERROR;
+  }
+
+  m_nSqesSize = Params.sq_entries * sizeof(struct io_uring_sqe);
+  m_pSqes = (io_uring_sqe*)mmap(NULL, m_nSqesSize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, m_nRingFd, IORING_OFF_SQES);
+  if (MAP_FAILED == (void*)m_pSqes)
+  {
+    m_pSqes = NULL;
+    Close();
+    return SIOMM_ERROR;
+  }
+
+  m_pnSqHead     = (unsigned int*)(m_pbyRing + Params.sq_off.head);
+  m_pnSqTail     = (unsigned int*)(m_pbyRing + Params.sq_off.tail);
+  m_pnSqArray    = (unsigned int*)(m_pbyRing + Params.sq_off.array);
+  m_nSqMask      = *(unsigned int*)(m_pbyRing + Params.sq_off.ring_mask);
+  m_nSqEntries   = Params.sq_entries;
+  m_nSqLocalTail = *m_pnSqTail;
+
+  m_pnCqHead     = (unsigned int*)(m_pbyRing + Params.cq_off.head);
+  m_pnCqTail     = (unsigned int*)(m_pbyRing + Params.cq_off.tail);
+  m_nCqMask      = *(unsigned int*)(m_pbyRing + Params.cq_off.ring_mask);
+  m_pCqes        = (io_uring_cqe*)(m_pbyRing + Params.cq_off.cqes);
+
+  m_nToSubmit    = 0;
+  m_nInFlight    = 0;
+  m_nSends       = 0;
+  m_nSendVectors = 0;
+  m_nSendResult  = SIOMM_OK;
+  m_nRecvs       = 0;
+  m_nDoneRecvs   = 0;
+  m_nTakenRecvs  = 0;
+  m_pbyDatagrams = new BYTE[SIOMM_RING_MAX_RECVS * SIOMM_RING_DATAGRAM_SIZE];
+
+  // A stream receive can only wait for all the bytes it expects where cancelling it keeps the
+  // bytes it already got.  That came in Linux 6.1, as did deferred task running, which the
+  // kernel can be asked for.
+  m_bWaitAll = FALSE;
+#ifdef IORING_SETUP_DEFER_TASKRUN
+  memset(&Params, 0, sizeof(Params));
+  Params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+  nProbeFd = syscall(__NR_io_uring_setup, 1, &Params);
+  if (nProbeFd >= 0)
+  {
+    m_bWaitAll = TRUE;
+    close(nProbeFd);
+  }
+#endif
+
+  return SIOMM_OK;
+#else
+  return SIOMM_ERROR;
+#endif
+}
+
+
+void O22SnapIoRing::Close()
+//-------------------------------------------------------------------------------------------------
+// Unmap the queues and close the ring.  Nothing is in flight between calls, so nothing is lost.
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef O22_RING
+  if (m_pSqes)
+    munmap(m_pSqes, m_nSqesSize);
+  if (m_pbyRing)
+    munmap(m_pbyRing, m_nRingSize);
+  if (m_nRingFd >= 0)
+    close(m_nRingFd);
+
+  delete [] m_pbyDatagrams;
+  m_pbyDatagrams = NULL;
+  m_nDoneRecvs   = 0;
+  m_nTakenRecvs  = 0;
+#endif
+
+  m_pSqes   = NULL;
+  m_pbyRing = NULL;
+  m_nRingFd = -1;
+}
+
+
+BOOL O22SnapIoRing::IsOpen()
+//-------------------------------------------------------------------------------------------------
+// Check whether the ring is set up
+//-------------------------------------------------------------------------------------------------
+{
+  return m_nRingFd >= 0;
+}
+
+
+#ifdef O22_RING
+
+io_uring_sqe * O22SnapIoRing::GetSqe()
+//-------------------------------------------------------------------------------------------------
+// Get a cleared submission queue entry, or NULL if the queue is full
+//-------------------------------------------------------------------------------------------------
+{
+  io_uring_sqe * pSqe;
+  unsigned int   nHead = __atomic_load_n(m_pnSqHead, __ATOMIC_ACQUIRE);
+  unsigned int   nIndex;
+
+  if (m_nSqLocalTail - nHead >= m_nSqEntries)
+    return NULL;
+
+  nIndex = m_nSqLocalTail & m_nSqMask;
+  pSqe = &(m_pSqes[nIndex]);
+  memset(pSqe, 0, sizeof(*pSqe));
+  m_pnSqArray[nIndex] = nIndex;
+  m_nSqLocalTail++;
+
+  return pSqe;
+}
+
+
+void O22SnapIoRing::PublishSqes()
+//-------------------------------------------------------------------------------------------------
+// Let the kernel see the entries from GetSqe().  They are submitted by the next Wait().
+//-------------------------------------------------------------------------------------------------
+{
+  m_nToSubmit += m_nSqLocalTail - *m_pnSqTail;
+  __atomic_store_n(m_pnSqTail, m_nSqLocalTail, __ATOMIC_RELEASE);
+}
+
+
+void O22SnapIoRing::ReapCompletions()
+//-------------------------------------------------------------------------------------------------
+// Take the outcome of every completed entry
+//-------------------------------------------------------------------------------------------------
+{
+  io_uring_cqe * pCqe;
+  unsigned int   nHead = *m_pnCqHead;
+  unsigned int   nTail = __atomic_load_n(m_pnCqTail, __ATOMIC_ACQUIRE);
+  long           nSend;
+  long           nRecv;
+
+  for ( ; nHead != nTail ; nHead++)
+  {
+    pCqe = &(m_pCqes[nHead & m_nCqMask]);
+
+    switch (pCqe->user_data & RING_KIND)
+    {
+      case RING_SEND:
+        // A send that was cut short or cancelled fails the batch
+        nSend = (long)(pCqe->user_data & ~RING_KIND);
+        if ((pCqe->res != m_arrnSendLength[nSend]) && (SIOMM_OK == m_nSendResult))
+          m_nSendResult = (-ECANCELED == pCqe->res) ? SIOMM_TIME_OUT : SIOMM_ERROR;
+        m_arrnSendLength[nSend] = -1;
+        break;
+
+      case RING_RECV:
+        nRecv = (long)(pCqe->user_data & ~RING_KIND);
+        m_arrnRecvResult[nRecv] = pCqe->res;
+        m_arrbRecvDone[nRecv]   = TRUE;
+        m_arrnDoneRecvs[m_nDoneRecvs++] = nRecv;
+        break;
+    }
+
+    m_nInFlight--;
+  }
+
+  __atomic_store_n(m_pnCqHead, nHead, __ATOMIC_RELEASE);
+}
+
+
+LONG O22SnapIoRing::Wait(LONGLONG nDeadlineNS)
+//-------------------------------------------------------------------------------------------------
+// Submit the published entries and wait until every entry is complete or the deadline passes.
+// A deadline of 0 waits for as long as it takes.
+//-------------------------------------------------------------------------------------------------
+{
+  struct io_uring_getevents_arg Arg;
+  struct __kernel_timespec      tsWait;
+  LONGLONG                      nWaitNS;
+  long                          nResult;
+
+  while ((m_nToSubmit > 0) || (m_nInFlight > 0))
+  {
+    memset(&Arg, 0, sizeof(Arg));
+    Arg.sigmask_sz = _NSIG / 8;
+    if (nDeadlineNS)
+    {
+      nWaitNS = nDeadlineNS - O22GetTimeNS();
+      if (nWaitNS < 0)
+        nWaitNS = 0;
+      tsWait.tv_sec  = nWaitNS / 1000000000;
+      tsWait.tv_nsec = nWaitNS % 1000000000;
+      Arg.ts = (__u64)(unsigned long)&tsWait;
+    }
+
+    nResult = syscall(__NR_io_uring_enter, m_nRingFd, m_nToSubmit, m_nToSubmit + m_nInFlight,
+                      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &Arg, sizeof(Arg));
+    if (nResult >= 0)
+    {
+      m_nInFlight += nResult;
+      m_nToSubmit -= nResult;
+    }
+
+    ReapCompletions();
+
+    if ((nResult < 0) && (EINTR != errno) && ((m_nToSubmit > 0) || (m_nInFlight > 0)))
+      return (ETIME == errno) ? SIOMM_TIME_OUT : SIOMM_ERROR;
+  }
+
+  return SIOMM_OK;
+}
+
+
+void O22SnapIoRing::CancelInFlight()
+//-------------------------------------------------------------------------------------------------
+// Cancel whatever is still in flight and wait for it, so that the kernel is done with our
+// buffers
+//-------------------------------------------------------------------------------------------------
+{
+  io_uring_sqe * pSqe;
+  long           i;
+
+  for (i = 0 ; i < m_nSends ; i++)
+  {
+    if ((m_arrnSendLength[i] >= 0) && (NULL != (pSqe = GetSqe())))
+    {
+      pSqe->opcode    = IORING_OP_ASYNC_CANCEL;
+      pSqe->fd        = -1;
+      pSqe->addr      = RING_SEND + i;
+      pSqe->user_data = RING_CANCEL;
+    }
+  }
+
+  for (i = 0 ; i < m_nRecvs ; i++)
+  {
+    if ((!m_arrbRecvDone[i]) && (NULL != (pSqe = GetSqe())))
+    {
+      pSqe->opcode    = IORING_OP_ASYNC_CANCEL;
+      pSqe->fd        = -1;
+      pSqe->addr      = RING_RECV + i;
+      pSqe->user_data = RING_CANCEL;
+    }
+  }
+
+  PublishSqes();
+  Wait(0);
+}
+
+
+LONG O22SnapIoRing::QueueRecv(SOCKET Socket, BYTE * pbyBuffer, long nLength, BOOL bWaitAll)
+//-------------------------------------------------------------------------------------------------
+// Queue a receive, to be submitted by SubmitRecvs() with the queued sends
+//-------------------------------------------------------------------------------------------------
+{
+  io_uring_sqe  * pSqe;
+  struct msghdr * pMessage;
+
+  if (m_nRecvs >= SIOMM_RING_MAX_RECVS)
+    return SIOMM_ERROR;
+
+  pSqe = GetSqe();
+  if (NULL == pSqe)
+    return SIOMM_ERROR;
+
+  m_arrRecvVectors[m_nRecvs].iov_base = pbyBuffer;
+  m_arrRecvVectors[m_nRecvs].iov_len  = nLength;
+
+  pMessage = &(m_arrRecvMessages[m_nRecvs]);
+  memset(pMessage, 0, sizeof(*pMessage));
+  pMessage->msg_iov        = &(m_arrRecvVectors[m_nRecvs]);
+  pMessage->msg_iovlen     = 1;
+
+  // The kernel stops a receive at the first segment when it has a time stamp to give, so one
+  // that waits for everything goes without, and the data is stamped when the wait ends
+  if (!bWaitAll)
+  {
+    pMessage->msg_control    = m_arrchRecvControl[m_nRecvs];
+    pMessage->msg_controllen = sizeof(m_arrchRecvControl[m_nRecvs]);
+  }
+
+  pSqe->opcode    = IORING_OP_RECVMSG;
+  pSqe->fd        = Socket;
+  pSqe->addr      = (__u64)(unsigned long)pMessage;
+  pSqe->len       = 1;
+  pSqe->msg_flags = bWaitAll ? MSG_WAITALL : 0;
+  pSqe->user_data = RING_RECV + m_nRecvs;
+
+  m_arrbRecvDone[m_nRecvs] = FALSE;
+  m_nRecvs++;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoRing::SubmitRecvs(LONGLONG nDeadlineNS)
+//-------------------------------------------------------------------------------------------------
+// Submit the queued sends and receives, and wait for all of them until the deadline.  Returns
+// the outcome of the sends; the receives that completed are in m_arrnDoneRecvs.
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;
+
+  PublishSqes();
+
+  if (SIOMM_OK != Wait(nDeadlineNS))
+    CancelInFlight();
+
+  nResult = m_nSendResult;
+  m_nSends       = 0;
+  m_nSendVectors = 0;
+  m_nSendResult  = SIOMM_OK;
+
+  return nResult;
+}
+
+
+LONG O22SnapIoRing::QueueSend(SOCKET Socket, SIOMM_SendBuffer * pBuffers, long nBuffers)
+//-------------------------------------------------------------------------------------------------
+// Queue a message to be sent by the next Recv() or Submit()
+//-------------------------------------------------------------------------------------------------
+{
+  io_uring_sqe  * pSqe;
+  struct msghdr * pMessage;
+  long            nLength = 0; // bytes in the message
+  long            i;
+
+  if ((!IsOpen()) || (m_nSends >= SIOMM_RING_MAX_SENDS) ||
+      (m_nSendVectors + nBuffers > SIOMM_SEND_MAX_BUFFERS))
+  {
+    return SIOMM_ERROR;
+  }
+
+  pSqe = GetSqe();
+  if (NULL == pSqe)
+    return SIOMM_ERROR;
+
+  for (i = 0 ; i < nBuffers ; i++)
+  {
+    m_arrSendVectors[m_nSendVectors + i].iov_base = pBuffers[i].pbyData;
+    m_arrSendVectors[m_nSendVectors + i].iov_len  = pBuffers[i].nLength;
+    nLength += pBuffers[i].nLength;
+  }
+
+  pMessage = &(m_arrSendMessages[m_nSends]);
+  memset(pMessage, 0, sizeof(*pMessage));
+  pMessage->msg_iov    = &(m_arrSendVectors[m_nSendVectors]);
+  pMessage->msg_iovlen = nBuffers;
+
+  // MSG_WAITALL has the kernel finish a stream send that only went out in part.  Each send is
+  // linked to the entry after it, so the messages go out in order and the receive only starts
+  // once they're all sent.
+  pSqe->opcode    = IORING_OP_SENDMSG;
+  pSqe->flags     = IOSQE_IO_LINK;
+  pSqe->fd        = Socket;
+  pSqe->addr      = (__u64)(unsigned long)pMessage;
+  pSqe->len       = 1;
+  pSqe->msg_flags = MSG_WAITALL;
+  pSqe->user_data = RING_SEND + m_nSends;
+
+  m_arrnSendLength[m_nSends] = nLength;
+  m_nSends++;
+  m_nSendVectors += nBuffers;
+
+  PublishSqes();
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoRing::Submit(LONGLONG nDeadlineNS)
+//-------------------------------------------------------------------------------------------------
+// Submit the queued sends and wait for them
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;
+
+  if (!IsOpen())
+    return SIOMM_ERROR;
+
+  if (SIOMM_OK != Wait(nDeadlineNS))
+    CancelInFlight();
+
+  nResult = m_nSendResult;
+  m_nSends       = 0;
+  m_nSendVectors = 0;
+  m_nSendResult  = SIOMM_OK;
+
+  return nResult;
+}
+
+
+LONG O22SnapIoRing::Recv(SOCKET Socket, BYTE * pbyBuffer, long nLength, long nWaitLength,
+                         LONGLONG nDeadlineNS, long * pnReceived, LONGLONG * pnRecvTimeNS)
+//-------------------------------------------------------------------------------------------------
+// Submit the queued sends and a stream receive, and wait for all of them
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;
+
+  if (!IsOpen())
+    return SIOMM_ERROR;
+
+  m_nRecvs      = 0;
+  m_nDoneRecvs  = 0;
+  m_nTakenRecvs = 0;
+
+  // Wait for every byte expected where a cancelled receive keeps what it got.  Otherwise take
+  // whatever arrives first.
+  if (m_bWaitAll && (nWaitLength > 0) && (nWaitLength < nLength))
+    nResult = QueueRecv(Socket, pbyBuffer, nWaitLength, TRUE);
+  else
+    nResult = QueueRecv(Socket, pbyBuffer, nLength, m_bWaitAll && (nWaitLength >= nLength));
+
+  if (SIOMM_OK != nResult)
+    return nResult;
+
+  nResult = SubmitRecvs(nDeadlineNS);
+  *pnRecvTimeNS = O22GetTimeNS();
+
+  if (SIOMM_OK != nResult)
+    return nResult;
+
+  // Data that arrived just as the deadline passed is still good, as is part of what was waited
+  // for
+  if ((!m_arrbRecvDone[0]) || (-ECANCELED == m_arrnRecvResult[0]))
+    return SIOMM_TIME_OUT;
+
+  if (m_arrnRecvResult[0] < 0)
+  {
+    errno = -m_arrnRecvResult[0];
+    return SIOMM_ERROR;
+  }
+
+  *pnReceived = m_arrnRecvResult[0];
+  O22MessageTimeStamp(&(m_arrRecvMessages[0]), pnRecvTimeNS);
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoRing::RecvDatagram(SOCKET Socket, BYTE * pbyBuffer, long nLength, long nDatagrams,
+                                 LONGLONG nDeadlineNS, long * pnReceived, LONGLONG * pnRecvTimeNS)
+//-------------------------------------------------------------------------------------------------
+// Get a datagram already received, or submit the queued sends and a receive for each datagram
+// expected, and wait for all of them
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;
+  long nRecv;
+  long i;
+
+  if (!IsOpen())
+    return SIOMM_ERROR;
+
+  if (m_nTakenRecvs == m_nDoneRecvs)
+  {
+    m_nRecvs      = 0;
+    m_nDoneRecvs  = 0;
+    m_nTakenRecvs = 0;
+
+    if (nDatagrams < 1)
+      nDatagrams = 1;
+
+    for (i = 0 ; i < nDatagrams ; i++)
+    {
+      if (SIOMM_OK != QueueRecv(Socket, m_pbyDatagrams + i * SIOMM_RING_DATAGRAM_SIZE,
+                                SIOMM_RING_DATAGRAM_SIZE, FALSE))
+        break;
+    }
+
+    if (0 == m_nRecvs)
+      return SIOMM_ERROR;
+
+    nResult = SubmitRecvs(nDeadlineNS);
+    if (SIOMM_OK != nResult)
+      return nResult;
+  }
+
+  // Hand out the datagrams in the order they arrived.  A cancelled receive got nothing.
+  while (m_nTakenRecvs < m_nDoneRecvs)
+  {
+    nRecv = m_arrnDoneRecvs[m_nTakenRecvs++];
+    if (-ECANCELED == m_arrnRecvResult[nRecv])
+      continue;
+
+    if (m_arrnRecvResult[nRecv] < 0)
+    {
+      errno = -m_arrnRecvResult[nRecv];
+      return SIOMM_ERROR;
+    }
+
+    *pnReceived = (m_arrnRecvResult[nRecv] < nLength) ? m_arrnRecvResult[nRecv] : nLength;
+    memcpy(pbyBuffer, m_pbyDatagrams + nRecv * SIOMM_RING_DATAGRAM_SIZE, *pnReceived);
+
+    *pnRecvTimeNS = O22GetTimeNS();
+    O22MessageTimeStamp(&(m_arrRecvMessages[nRecv]), pnRecvTimeNS);
+
+    return SIOMM_OK;
+  }
+
+  return SIOMM_TIME_OUT;
+}
+
+
+#else
+
+// Without the ring Open() fails, so none of these is ever called
+
+LONG O22SnapIoRing::QueueSend(SOCKET, SIOMM_SendBuffer *, long)
+//-------------------------------------------------------------------------------------------------
+// The ring isn't built in
+//-------------------------------------------------------------------------------------------------
+{
+  return SIOMM_ERROR;
+}
+
+
+LONG O22SnapIoRing::Submit(LONGLONG)
+//-------------------------------------------------------------------------------------------------
+// The ring isn't built in
+//-------------------------------------------------------------------------------------------------
+{
+  return SIOMM_ERROR;
+}
+
+
+LONG O22SnapIoRing::Recv(SOCKET, BYTE *, long, long, LONGLONG, long *, LONGLONG *)
+//-------------------------------------------------------------------------------------------------
+// The ring isn't built in
+//-------------------------------------------------------------------------------------------------
+{
+  return SIOMM_ERROR;
+}
+
+
+LONG O22SnapIoRing::RecvDatagram(SOCKET, BYTE *, long, long, LONGLONG, long *, LONGLONG *)
+//-------------------------------------------------------------------------------------------------
+// The ring isn't built in
+//-------------------------------------------------------------------------------------------------
+{
+  return SIOMM_ERROR;
+}
+
+#endif // O22_RING
+
+
+void O22SnapIoRing::DiscardDatagrams()
+//-------------------------------------------------------------------------------------------------
+// Drop the datagrams received but not yet handed out
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef _LINUX
+  m_nTakenRecvs = m_nDoneRecvs;
+#endif
+}
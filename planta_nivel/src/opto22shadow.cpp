@@ -0,0 +1,490 @@
+//-----------------------------------------------------------------------------
+//
+// O22SIOSH.cpp
+//
+// Source for the O22SnapIoShadow C++ class.
+//
+// The O22SnapIoShadow C++ class keeps a copy of parts of the memory map of an
+// Opto 22 SNAP Ethernet I/O unit and writes and reads it in batches. See
+// O22SIOSH.h for usage.
+//
+// While this class was developed on Microsoft Windows 32-bit operating
+// systems, it is intended to be as generic as possible.  For Windows specific
+// code, search for "_WIN32" and "_WIN32_WCE".  For Linux specific code, search
+// for "_LINUX".
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOSH.h"
+
+
+static BOOL ShadowIsDirty(SIOMM_ShadowRegion * pRegion, long nQuad)
+{
+  return (pRegion->arrdwDirty[nQuad >> 5] >> (nQuad & 31)) & 1;
+}
+
+
+static void ShadowSetDirty(SIOMM_ShadowRegion * pRegion, long nFirstQuad, long nQuads, BOOL bDirty)
+{
+  long nQuad;
+
+  for (nQuad = nFirstQuad ; nQuad < nFirstQuad + nQuads ; nQuad++)
+  {
+    if (bDirty)
+      pRegion->arrdwDirty[nQuad >> 5] |= (DWORD)1 << (nQuad & 31);
+    else
+      pRegion->arrdwDirty[nQuad >> 5] &= ~((DWORD)1 << (nQuad & 31));
+  }
+}
+
+
+O22SnapIoShadow::O22SnapIoShadow(O22SnapIoMemMap * pMemMap)
+//-------------------------------------------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------------------------------------------
+{
+  m_pMemMap  = pMemMap;
+  m_nRegions = 0;
+
+  memset(m_arrRegions,      0, sizeof(m_arrRegions));
+  memset(m_arrTransactions, 0, sizeof(m_arrTransactions));
+}
+
+
+O22SnapIoShadow::~O22SnapIoShadow()
+//-------------------------------------------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------------------------------------------
+{
+  long nRegion;
+
+  for (nRegion = 0 ; nRegion < m_nRegions ; nRegion++)
+  {
+    delete [] m_arrRegions[nRegion].pbyImage;
+    if (m_arrRegions[nRegion].pbyRead)
+      delete [] m_arrRegions[nRegion].pbyRead;
+  }
+}
+
+
+LONG O22SnapIoShadow::AddRegion(DWORD dwBase, WORD wLength, long nFlags)
+//-------------------------------------------------------------------------------------------------
+// Add an area of the memory map to be kept
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_ShadowRegion * pRegion;
+  long nRegion;
+
+  if ((m_nRegions >= SIOMM_SHADOW_MAX_REGIONS) ||
+      (dwBase & 3) || (wLength == 0) || (wLength & 3) || (wLength > SIOMM_MAX_BLOCK_LENGTH) ||
+      !(nFlags & (SIOMM_SHADOW_READ | SIOMM_SHADOW_WRITE)))
+  {
+    return SIOMM_ERROR;
+  }
+
+  // Regions must not overlap, or a quadlet would have two copies
+  for (nRegion = 0 ; nRegion < m_nRegions ; nRegion++)
+  {
+    pRegion = &m_arrRegions[nRegion];
+    if ((dwBase < pRegion->dwBase + pRegion->wLength) && (pRegion->dwBase < dwBase + wLength))
+      return SIOMM_ERROR;
+  }
+
+  pRegion = &m_arrRegions[m_nRegions];
+  memset(pRegion, 0, sizeof(SIOMM_ShadowRegion));
+  pRegion->dwBase   = dwBase;
+  pRegion->wLength  = wLength;
+  pRegion->nFlags   = nFlags;
+  pRegion->pbyImage = new BYTE[wLength];
+  memset(pRegion->pbyImage, 0, wLength);
+  if (nFlags & SIOMM_SHADOW_READ)
+    pRegion->pbyRead = new BYTE[wLength];
+
+  m_nRegions++;
+
+  return SIOMM_OK;
+}
+
+
+SIOMM_ShadowRegion * O22SnapIoShadow::FindRegion(DWORD dwAddress, WORD wLength)
+//-------------------------------------------------------------------------------------------------
+// Find the region holding a range of the memory map, or NULL if no region holds all of it
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_ShadowRegion * pRegion;
+  long nRegion;
+
+  for (nRegion = 0 ; nRegion < m_nRegions ; nRegion++)
+  {
+    pRegion = &m_arrRegions[nRegion];
+    if ((dwAddress >= pRegion->dwBase) &&
+        ((dwAddress - pRegion->dwBase) + wLength <= pRegion->wLength))
+    {
+      return pRegion;
+    }
+  }
+
+  return NULL;
+}
+
+
+LONG O22SnapIoShadow::Refresh()
+//-------------------------------------------------------------------------------------------------
+// Read every read region, all at once
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_ShadowRegion * pRegion;
+  LONG nResult;  // for checking the return values of functions
+  long nCount;
+  long nRegion;
+  long nQuad;
+  long k;
+
+  // One block read for each region. There are no more regions than transaction labels.
+  nCount = 0;
+  for (nRegion = 0 ; nRegion < m_nRegions ; nRegion++)
+  {
+    pRegion = &m_arrRegions[nRegion];
+    if (!(pRegion->nFlags & SIOMM_SHADOW_READ))
+      continue;
+
+    m_arrTransactions[nCount].byTransactionCode = SIOMM_TCODE_READ_BLOCK_REQUEST;
+    m_arrTransactions[nCount].dwDestOffset      = pRegion->dwBase;
+    m_arrTransactions[nCount].wDataLength       = pRegion->wLength;
+    m_arrTransactions[nCount].pbyData           = pRegion->pbyRead;
+    m_arrnRegion[nCount] = nRegion;
+    nCount++;
+  }
+
+  if (nCount == 0)
+    return SIOMM_OK;
+
+  nResult = m_pMemMap->Transact(m_arrTransactions, nCount, nCount);
+
+  // Take what was read, except where a value set by the user is still waiting to be written
+  for (k = 0 ; k < nCount ; k++)
+  {
+    if (m_arrTransactions[k].nResult != SIOMM_OK)
+      continue;
+
+    pRegion = &m_arrRegions[m_arrnRegion[k]];
+    for (nQuad = 0 ; nQuad < pRegion->wLength / 4 ; nQuad++)
+    {
+      if (!ShadowIsDirty(pRegion, nQuad))
+        memcpy(pRegion->pbyImage + 4 * nQuad, pRegion->pbyRead + 4 * nQuad, 4);
+    }
+    pRegion->bValid = TRUE;
+  }
+
+  return nResult;
+}
+
+
+LONG O22SnapIoShadow::Flush()
+//-------------------------------------------------------------------------------------------------
+// Write every dirty range, with one transaction for each run of dirty quadlets
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_ShadowRegion * pRegion;
+  LONG nResult;       // for checking the return values of functions
+  LONG nFirstError;   // the first error found
+  long nCount;
+  long nRegion;
+  long nQuads;
+  long nQuad;
+  long nFirst;
+  long nLast;
+
+  nFirstError = SIOMM_OK;
+  nCount = 0;
+  for (nRegion = 0 ; nRegion < m_nRegions ; nRegion++)
+  {
+    pRegion = &m_arrRegions[nRegion];
+    if (!(pRegion->nFlags & SIOMM_SHADOW_WRITE))
+      continue;
+
+    nQuads = pRegion->wLength / 4;
+    nQuad  = 0;
+    while (nQuad < nQuads)
+    {
+      if (!ShadowIsDirty(pRegion, nQuad))
+      {
+        nQuad++;
+        continue;
+      }
+
+      // A run of dirty quadlets. Clean quadlets of an action region are zero masks, so the
+      // run may take them in and go on to the last dirty quadlet.
+      nFirst = nQuad;
+      nLast  = nQuad;
+      for (nQuad = nFirst + 1 ; nQuad < nQuads ; nQuad++)
+      {
+        if (ShadowIsDirty(pRegion, nQuad))
+          nLast = nQuad;
+        else if (!(pRegion->nFlags & SIOMM_SHADOW_ACTION))
+          break;
+      }
+      nQuad = nLast + 1;
+
+      if (nFirst == nLast)
+      {
+        m_arrTransactions[nCount].byTransactionCode = SIOMM_TCODE_WRITE_QUAD_REQUEST;
+        m_arrTransactions[nCount].dwQuadlet = O22MAKELONG2(pRegion->pbyImage, 4 * nFirst);
+      }
+      else
+      {
+        m_arrTransactions[nCount].byTransactionCode = SIOMM_TCODE_WRITE_BLOCK_REQUEST;
+        m_arrTransactions[nCount].wDataLength = (WORD)(4 * (nLast - nFirst + 1));
+        m_arrTransactions[nCount].pbyData     = pRegion->pbyImage + 4 * nFirst;
+      }
+      m_arrTransactions[nCount].dwDestOffset = pRegion->dwBase + 4 * nFirst;
+      m_arrnRegion[nCount]    = nRegion;
+      m_arrnFirstQuad[nCount] = nFirst;
+      m_arrnQuads[nCount]     = nLast - nFirst + 1;
+      nCount++;
+
+      // Send a full batch before going on
+      if (nCount == SIOMM_MAX_TRANSACTION_LABELS)
+      {
+        nResult = FlushTransactions(nCount);
+        if (nFirstError == SIOMM_OK)
+          nFirstError = nResult;
+        nCount = 0;
+      }
+    }
+  }
+
+  if (nCount > 0)
+  {
+    nResult = FlushTransactions(nCount);
+    if (nFirstError == SIOMM_OK)
+      nFirstError = nResult;
+  }
+
+  return nFirstError;
+}
+
+
+LONG O22SnapIoShadow::FlushTransactions(long nCount)
+//-------------------------------------------------------------------------------------------------
+// Send the writes built by Flush() and clean the ranges that were written
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_ShadowRegion * pRegion;
+  LONG nResult;  // for checking the return values of functions
+  long k;
+
+  nResult = m_pMemMap->Transact(m_arrTransactions, nCount, nCount);
+
+  for (k = 0 ; k < nCount ; k++)
+  {
+    if (m_arrTransactions[k].nResult != SIOMM_OK)
+      continue;
+
+    pRegion = &m_arrRegions[m_arrnRegion[k]];
+    ShadowSetDirty(pRegion, m_arrnFirstQuad[k], m_arrnQuads[k], FALSE);
+
+    // Masks act once; writing them again would repeat the action
+    if (pRegion->nFlags & SIOMM_SHADOW_ACTION)
+      memset(pRegion->pbyImage + 4 * m_arrnFirstQuad[k], 0, 4 * m_arrnQuads[k]);
+  }
+
+  return nResult;
+}
+
+
+BOOL O22SnapIoShadow::IsDirty(DWORD dwAddress, WORD wLength)
+//-------------------------------------------------------------------------------------------------
+// Check whether any quadlet in a range is waiting to be written
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_ShadowRegion * pRegion;
+  long nQuad;
+
+  pRegion = FindRegion(dwAddress, wLength);
+  if (pRegion == NULL)
+    return FALSE;
+
+  for (nQuad = (dwAddress - pRegion->dwBase) / 4 ;
+       nQuad < (long)((dwAddress - pRegion->dwBase + wLength + 3) / 4) ; nQuad++)
+  {
+    if (ShadowIsDirty(pRegion, nQuad))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+
+LONG O22SnapIoShadow::GetBlock(DWORD dwAddress, WORD wLength, BYTE * pbyData)
+//-------------------------------------------------------------------------------------------------
+// Get a range of the copy, in the byte order of the I/O unit
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_ShadowRegion * pRegion;
+
+  pRegion = FindRegion(dwAddress, wLength);
+  if (pRegion == NULL)
+    return SIOMM_ERROR;
+
+  if ((pRegion->nFlags & SIOMM_SHADOW_READ) && !pRegion->bValid)
+    return SIOMM_ERROR_NOT_CONNECTED_YET;
+
+  memcpy(pbyData, pRegion->pbyImage + (dwAddress - pRegion->dwBase), wLength);
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoShadow::SetBlock(DWORD dwAddress, WORD wLength, BYTE * pbyData)
+//-------------------------------------------------------------------------------------------------
+// Set a range of the copy, in the byte order of the I/O unit, and mark it dirty
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_ShadowRegion * pRegion;
+
+  // Dirty tracking is by quadlet
+  if ((dwAddress & 3) || (wLength & 3))
+    return SIOMM_ERROR;
+
+  pRegion = FindRegion(dwAddress, wLength);
+  if ((pRegion == NULL) || !(pRegion->nFlags & SIOMM_SHADOW_WRITE))
+    return SIOMM_ERROR;
+
+  memcpy(pRegion->pbyImage + (dwAddress - pRegion->dwBase), pbyData, wLength);
+  ShadowSetDirty(pRegion, (dwAddress - pRegion->dwBase) / 4, wLength / 4, TRUE);
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoShadow::GetQuad(DWORD dwAddress, DWORD * pdwQuadlet)
+//-------------------------------------------------------------------------------------------------
+// Get a quadlet of the copy
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;  // for checking the return values of functions
+  BYTE arrbyData[4];
+
+  nResult = GetBlock(dwAddress, 4, arrbyData);
+  if (nResult == SIOMM_OK)
+    *pdwQuadlet = O22MAKELONG2(arrbyData, 0);
+
+  return nResult;
+}
+
+
+LONG O22SnapIoShadow::SetQuad(DWORD dwAddress, DWORD dwQuadlet)
+//-------------------------------------------------------------------------------------------------
+// Set a quadlet of the copy
+//-------------------------------------------------------------------------------------------------
+{
+  BYTE arrbyData[4];
+
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 0, dwQuadlet);
+
+  return SetBlock(dwAddress, 4, arrbyData);
+}
+
+
+LONG O22SnapIoShadow::GetFloat(DWORD dwAddress, float * pfValue)
+//-------------------------------------------------------------------------------------------------
+// Get a float of the copy
+//-------------------------------------------------------------------------------------------------
+{
+  LONG  nResult;  // for checking the return values of functions
+  DWORD dwQuadlet;
+
+  nResult = GetQuad(dwAddress, &dwQuadlet);
+  if (nResult == SIOMM_OK)
+    memcpy(pfValue, &dwQuadlet, 4);
+
+  return nResult;
+}
+
+
+LONG O22SnapIoShadow::SetFloat(DWORD dwAddress, float fValue)
+//-------------------------------------------------------------------------------------------------
+// Set a float of the copy
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD dwQuadlet;
+
+  memcpy(&dwQuadlet, &fValue, 4);
+
+  return SetQuad(dwAddress, dwQuadlet);
+}
+
+
+LONG O22SnapIoShadow::GetAnaPtValue(long nPoint, float *pfValue)
+//-------------------------------------------------------------------------------------------------
+// Get the value of an analog point from the copy of the analog bank
+//-------------------------------------------------------------------------------------------------
+{
+  return GetFloat(SIOMM_ABANK_READ_POINT_VALUES + (4 * nPoint), pfValue);
+}
+
+
+LONG O22SnapIoShadow::SetAnaPtValue(long nPoint, float fValue)
+//-------------------------------------------------------------------------------------------------
+// Set the value of an analog point in the copy of the analog bank write area
+//-------------------------------------------------------------------------------------------------
+{
+  return SetFloat(SIOMM_ABANK_WRITE_POINT_VALUES + (4 * nPoint), fValue);
+}
+
+
+LONG O22SnapIoShadow::GetDigBankPointStates(long *pnPts63to32, long *pnPts31to0)
+//-------------------------------------------------------------------------------------------------
+// Get the states of the digital points from the copy of the digital bank
+//-------------------------------------------------------------------------------------------------
+{
+  LONG  nResult;  // for checking the return values of functions
+  BYTE  arrbyData[8];
+
+  nResult = GetBlock(SIOMM_DBANK_READ_POINT_STATES, 8, arrbyData);
+  if (nResult == SIOMM_OK)
+  {
+    *pnPts63to32 = O22MAKELONG2(arrbyData, 0);
+    *pnPts31to0  = O22MAKELONG2(arrbyData, 4);
+  }
+
+  return nResult;
+}
+
+
+LONG O22SnapIoShadow::SetDigBankPointStates(long nPts63to32, long nPts31to0,
+                                            long nMask63to32, long nMask31to0)
+//-------------------------------------------------------------------------------------------------
+// Turn digital points on and off through the copy of the digital bank turn on and off masks.
+// Masks set since the last Flush() are merged, the later state winning.
+//-------------------------------------------------------------------------------------------------
+{
+  LONG  nResult;  // for checking the return values of functions
+  BYTE  arrbyData[16];
+  DWORD dwOn63to32;
+  DWORD dwOn31to0;
+  DWORD dwOff63to32;
+  DWORD dwOff31to0;
+
+  nResult = GetBlock(SIOMM_DBANK_WRITE_TURN_ON_MASK, 16, arrbyData);
+  if (nResult != SIOMM_OK)
+    return nResult;
+
+  dwOn63to32  = O22MAKELONG2(arrbyData, 0);
+  dwOn31to0   = O22MAKELONG2(arrbyData, 4);
+  dwOff63to32 = O22MAKELONG2(arrbyData, 8);
+  dwOff31to0  = O22MAKELONG2(arrbyData, 12);
+
+  dwOn63to32  = (dwOn63to32  & ~nMask63to32) | ( nPts63to32 & nMask63to32);
+  dwOn31to0   = (dwOn31to0   & ~nMask31to0)  | ( nPts31to0  & nMask31to0);
+  dwOff63to32 = (dwOff63to32 & ~nMask63to32) | (~nPts63to32 & nMask63to32);
+  dwOff31to0  = (dwOff31to0  & ~nMask31to0)  | (~nPts31to0  & nMask31to0);
+
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 0,  dwOn63to32);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 4,  dwOn31to0);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 8,  dwOff63to32);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 12, dwOff31to0);
+
+  return SetBlock(SIOMM_DBANK_WRITE_TURN_ON_MASK, 16, arrbyData);
+}
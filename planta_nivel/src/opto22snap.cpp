@@ -14,7 +14,7 @@
 //-----------------------------------------------------------------------------
 
 
-#include "opto22snap.h"
+#include "O22SIOMM.h"
 
 
 #ifdef _WIN32
@@ -22,6 +22,444 @@
 #define WINSOCK_VERSION_REQUIRED_MIN 0
 #endif
 
+// Vector byte swapping for O22UnpackFloats() and friends.  The SSSE3 and AVX2 functions are
+// compiled for those instruction sets alone and only called once the processor is known to
+// have them, so no compiler flags are needed.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define O22_SWAP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define O22_TARGET_SSSE3
+#define O22_TARGET_AVX2
+#else
+#define O22_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define O22_TARGET_AVX2  __attribute__((target("avx2")))
+#endif
+#endif
+
+#define O22_SWAP_SCALAR 0
+#define O22_SWAP_SSSE3  1
+#define O22_SWAP_AVX2   2
+
+
+LONGLONG O22GetTimeNS()
+//-------------------------------------------------------------------------------------------------
+// The monotonic clock used for arrival timestamps, in nanoseconds
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef _WIN32
+  LARGE_INTEGER nCount;
+  LARGE_INTEGER nFrequency;
+
+  QueryPerformanceCounter(&nCount);
+  QueryPerformanceFrequency(&nFrequency);
+
+  return (nCount.QuadPart / nFrequency.QuadPart) * 1000000000 + 
+         (nCount.QuadPart % nFrequency.QuadPart) * 1000000000 / nFrequency.QuadPart;
+#endif
+#ifdef _LINUX
+  struct timespec tsNow;
+
+  clock_gettime(CLOCK_MONOTONIC, &tsNow);
+  return (LONGLONG)tsNow.tv_sec * 1000000000 + tsNow.tv_nsec;
+#endif
+}
+
+
+void O22EnableRecvTimeStamps(SOCKET Socket)
+//-------------------------------------------------------------------------------------------------
+// Ask the kernel to stamp the packets received on a socket
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef _LINUX
+  int nEnable = 1;
+
+  // Not fatal if it fails: O22RecvTimeStamped() falls back to the time of the recv
+  setsockopt(Socket, SOL_SOCKET, SO_TIMESTAMPNS, &nEnable, sizeof(nEnable));
+#endif
+}
+
+
+long O22RecvTimeStamped(SOCKET Socket, char * pchBuffer, long nLength,
+                        sockaddr_in * pSourceAddress, LONGLONG * pnRecvTimeNS)
+//-------------------------------------------------------------------------------------------------
+// Like recvfrom(), also returning when the data arrived on the O22GetTimeNS() clock.
+// pSourceAddress may be NULL for connected sockets.
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef _WIN32
+  int  nAddressSize = sizeof(sockaddr_in);
+  long nResult;
+
+  nResult = recvfrom(Socket, pchBuffer, nLength, 0, (sockaddr*)pSourceAddress, 
+                     pSourceAddress ? &nAddressSize : NULL);
+  *pnRecvTimeNS = O22GetTimeNS();
+
+  return nResult;
+#endif
+#ifdef _LINUX
+  struct msghdr    Message;
+  struct iovec     Vector;
+  char             arrchControl[CMSG_SPACE(sizeof(struct timespec))];
+  long             nResult;
+
+  Vector.iov_base = pchBuffer;
+  Vector.iov_len  = nLength;
+
+  memset(&Message, 0, sizeof(Message));
+  Message.msg_name       = pSourceAddress;
+  Message.msg_namelen    = pSourceAddress ? sizeof(sockaddr_in) : 0;
+  Message.msg_iov        = &Vector;
+  Message.msg_iovlen     = 1;
+  Message.msg_control    = arrchControl;
+  Message.msg_controllen = sizeof(arrchControl);
+
+  nResult = recvmsg(Socket, &Message, 0);
+  *pnRecvTimeNS = O22GetTimeNS();
+
+  if (nResult > 0)
+    O22MessageTimeStamp(&Message, pnRecvTimeNS);
+
+  return nResult;
+#endif
+}
+
+
+#ifdef _LINUX
+void O22MessageTimeStamp(struct msghdr * pMessage, LONGLONG * pnRecvTimeNS)
+//-------------------------------------------------------------------------------------------------
+// Move a receive time back to the kernel's arrival stamp in the control data of a message
+//-------------------------------------------------------------------------------------------------
+{
+  struct cmsghdr * pControl;
+  struct timespec  tsKernel;  // when the kernel received the data, on the real-time clock
+  struct timespec  tsNow;     // the real-time clock now
+  BOOL             bKernelTime = FALSE;
+
+  for (pControl = CMSG_FIRSTHDR(pMessage) ; pControl ; pControl = CMSG_NXTHDR(pMessage, pControl))
+  {
+    if ((SOL_SOCKET == pControl->cmsg_level) && (SCM_TIMESTAMPNS == pControl->cmsg_type))
+    {
+      memcpy(&tsKernel, CMSG_DATA(pControl), sizeof(tsKernel));
+      bKernelTime = TRUE;
+    }
+  }
+
+  // The kernel stamps packets on the real-time clock.  Move the stamp to the monotonic clock
+  // by how long ago it was.
+  if (bKernelTime)
+  {
+    clock_gettime(CLOCK_REALTIME, &tsNow);
+    *pnRecvTimeNS -= ((LONGLONG)tsNow.tv_sec - tsKernel.tv_sec) * 1000000000 + 
+                     (tsNow.tv_nsec - tsKernel.tv_nsec);
+  }
+}
+#endif
+
+
+long O22SendGather(SOCKET Socket, SIOMM_SendBuffer * pBuffers, long nBuffers)
+//-------------------------------------------------------------------------------------------------
+// Like send() of the buffers one after the other, with one system call
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  if (nBuffers > SIOMM_SEND_MAX_BUFFERS)
+    nBuffers = SIOMM_SEND_MAX_BUFFERS;
+
+#ifdef _WIN32
+  WSABUF arrVectors[SIOMM_SEND_MAX_BUFFERS];
+  DWORD  dwSent;
+
+  for (i = 0 ; i < nBuffers ; i++)
+  {
+    arrVectors[i].buf = (char*)pBuffers[i].pbyData;
+    arrVectors[i].len = pBuffers[i].nLength;
+  }
+
+  if (SOCKET_ERROR == WSASend(Socket, arrVectors, nBuffers, &dwSent, 0, NULL, NULL))
+    return SOCKET_ERROR;
+
+  return dwSent;
+#endif
+#ifdef _LINUX
+  struct iovec  arrVectors[SIOMM_SEND_MAX_BUFFERS];
+  struct msghdr Message;
+
+  for (i = 0 ; i < nBuffers ; i++)
+  {
+    arrVectors[i].iov_base = pBuffers[i].pbyData;
+    arrVectors[i].iov_len  = pBuffers[i].nLength;
+  }
+
+  memset(&Message, 0, sizeof(Message));
+  Message.msg_iov    = arrVectors;
+  Message.msg_iovlen = nBuffers;
+
+  return sendmsg(Socket, &Message, 0);
+#endif
+}
+
+
+long O22SendDatagrams(SOCKET Socket, SIOMM_SendBuffer * pBuffers, long nDatagrams)
+//-------------------------------------------------------------------------------------------------
+// Send datagrams of two buffers each.  Returns how many were sent, which may be fewer than
+// asked if the send buffer fills up.
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  if (nDatagrams > SIOMM_SEND_MAX_BUFFERS / 2)
+    nDatagrams = SIOMM_SEND_MAX_BUFFERS / 2;
+
+#ifdef _WIN32
+  // Windows has no call for several datagrams at once
+  for (i = 0 ; i < nDatagrams ; i++)
+  {
+    if (SOCKET_ERROR == O22SendGather(Socket, pBuffers + 2*i, 2))
+      return (i > 0) ? i : SOCKET_ERROR;
+  }
+
+  return nDatagrams;
+#endif
+#ifdef _LINUX
+  struct iovec   arrVectors[SIOMM_SEND_MAX_BUFFERS];
+  struct mmsghdr arrMessages[SIOMM_SEND_MAX_BUFFERS / 2];
+
+  memset(arrMessages, 0, nDatagrams * sizeof(struct mmsghdr));
+  for (i = 0 ; i < 2*nDatagrams ; i++)
+  {
+    arrVectors[i].iov_base = pBuffers[i].pbyData;
+    arrVectors[i].iov_len  = pBuffers[i].nLength;
+  }
+  for (i = 0 ; i < nDatagrams ; i++)
+  {
+    arrMessages[i].msg_hdr.msg_iov    = arrVectors + 2*i;
+    arrMessages[i].msg_hdr.msg_iovlen = 2;
+  }
+
+  return sendmmsg(Socket, arrMessages, nDatagrams, 0);
+#endif
+}
+
+
+static int O22GetSwapLevel()
+//-------------------------------------------------------------------------------------------------
+// The best way this processor has to swap quadlets: O22_SWAP_SCALAR, O22_SWAP_SSSE3 or
+// O22_SWAP_AVX2
+//-------------------------------------------------------------------------------------------------
+{
+  static int s_nLevel = -1; // -1 until the processor has been checked
+
+  if (s_nLevel < 0)
+  {
+    int nLevel = O22_SWAP_SCALAR;
+
+#ifdef O22_SWAP_X86
+#ifdef _MSC_VER
+    int arrnInfo[4];  // EAX, EBX, ECX and EDX from CPUID
+
+    __cpuid(arrnInfo, 1);
+    if (arrnInfo[2] & (1 << 9))
+      nLevel = O22_SWAP_SSSE3;
+
+    // AVX2 also needs the operating system to save the YMM registers
+    if ((arrnInfo[2] & (1 << 27)) && (arrnInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6))
+    {
+      __cpuidex(arrnInfo, 7, 0);
+      if (arrnInfo[1] & (1 << 5))
+        nLevel = O22_SWAP_AVX2;
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+      nLevel = O22_SWAP_SSSE3;
+    if (__builtin_cpu_supports("avx2"))
+      nLevel = O22_SWAP_AVX2;
+#endif
+#endif
+
+    s_nLevel = nLevel;
+  }
+
+  return s_nLevel;
+}
+
+
+#ifdef O22_SWAP_X86
+
+O22_TARGET_SSSE3 static long O22SwapQuadsSSSE3(const BYTE * pbySource, BYTE * pbyDest,
+                                               long nCount)
+//-------------------------------------------------------------------------------------------------
+// Reverse the bytes of each quadlet, four at a time. Returns how many quadlets were done.
+//-------------------------------------------------------------------------------------------------
+{
+  const __m128i vSwap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  long          i;
+
+  for (i = 0 ; i + 4 <= nCount ; i += 4)
+  {
+    __m128i vData = _mm_loadu_si128((const __m128i*)(pbySource + i*4));
+    _mm_storeu_si128((__m128i*)(pbyDest + i*4), _mm_shuffle_epi8(vData, vSwap));
+  }
+
+  return i;
+}
+
+
+O22_TARGET_AVX2 static long O22SwapQuadsAVX2(const BYTE * pbySource, BYTE * pbyDest,
+                                             long nCount)
+//-------------------------------------------------------------------------------------------------
+// Reverse the bytes of each quadlet, eight at a time. Returns how many quadlets were done.
+//-------------------------------------------------------------------------------------------------
+{
+  const __m256i vSwap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                         3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  long          i;
+
+  for (i = 0 ; i + 8 <= nCount ; i += 8)
+  {
+    __m256i vData = _mm256_loadu_si256((const __m256i*)(pbySource + i*4));
+    _mm256_storeu_si256((__m256i*)(pbyDest + i*4), _mm256_shuffle_epi8(vData, vSwap));
+  }
+
+  return i;
+}
+
+
+O22_TARGET_SSSE3 static long O22WidenQuadsSSSE3(const BYTE * pbySource, LONGLONG * pnDest,
+                                                long nCount)
+//-------------------------------------------------------------------------------------------------
+// Reverse the bytes of each quadlet and zero extend it to 64 bits, four at a time. Returns how
+// many quadlets were done.
+//-------------------------------------------------------------------------------------------------
+{
+  const __m128i vSwap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m128i vZero = _mm_setzero_si128();
+  long          i;
+
+  for (i = 0 ; i + 4 <= nCount ; i += 4)
+  {
+    __m128i vData = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pbySource + i*4)), vSwap);
+    _mm_storeu_si128((__m128i*)(pnDest + i),     _mm_unpacklo_epi32(vData, vZero));
+    _mm_storeu_si128((__m128i*)(pnDest + i + 2), _mm_unpackhi_epi32(vData, vZero));
+  }
+
+  return i;
+}
+
+
+O22_TARGET_AVX2 static long O22WidenQuadsAVX2(const BYTE * pbySource, LONGLONG * pnDest,
+                                              long nCount)
+//-------------------------------------------------------------------------------------------------
+// Reverse the bytes of each quadlet and zero extend it to 64 bits, eight at a time. Returns
+// how many quadlets were done.
+//-------------------------------------------------------------------------------------------------
+{
+  const __m256i vSwap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                         3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  long          i;
+
+  for (i = 0 ; i + 8 <= nCount ; i += 8)
+  {
+    __m256i vData = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(pbySource + i*4)),
+                                        vSwap);
+    _mm256_storeu_si256((__m256i*)(pnDest + i),
+                        _mm256_cvtepu32_epi64(_mm256_castsi256_si128(vData)));
+    _mm256_storeu_si256((__m256i*)(pnDest + i + 4),
+                        _mm256_cvtepu32_epi64(_mm256_extracti128_si256(vData, 1)));
+  }
+
+  return i;
+}
+
+#endif // O22_SWAP_X86
+
+
+static long O22SwapQuads(const BYTE * pbySource, BYTE * pbyDest, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Reverse the bytes of as many quadlets as the vector instructions can. Returns how many
+// quadlets were done; the caller does the rest.
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef O22_SWAP_X86
+  switch (O22GetSwapLevel())
+  {
+    case O22_SWAP_AVX2:
+      return O22SwapQuadsAVX2(pbySource, pbyDest, nCount);
+    case O22_SWAP_SSSE3:
+      return O22SwapQuadsSSSE3(pbySource, pbyDest, nCount);
+  }
+#endif
+
+  return 0;
+}
+
+
+void O22UnpackFloats(const BYTE * pbyData, float * pfValues, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Convert big-endian quadlets into floats
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD dwQuadlet; // A temp for the remaining quadlets
+  long  i;
+
+  for (i = O22SwapQuads(pbyData, (BYTE*)pfValues, nCount) ; i < nCount ; i++)
+  {
+    dwQuadlet = O22MAKELONG2(pbyData, i*4);
+    memcpy(&(pfValues[i]), &dwQuadlet, 4);
+  }
+}
+
+
+void O22PackFloats(const float * pfValues, BYTE * pbyData, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Convert floats into big-endian quadlets
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD dwQuadlet; // A temp for the remaining floats
+  long  i;
+
+  for (i = O22SwapQuads((const BYTE*)pfValues, pbyData, nCount) ; i < nCount ; i++)
+  {
+    memcpy(&dwQuadlet, &(pfValues[i]), 4);
+    O22FILL_ARRAY_FROM_LONG(pbyData, i*4, dwQuadlet);
+  }
+}
+
+
+void O22UnpackLongs(const BYTE * pbyData, long * pnValues, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Convert big-endian quadlets into longs, zero extended where longs have 64 bits
+//-------------------------------------------------------------------------------------------------
+{
+  long i = 0;
+
+  if (sizeof(long) == 4)
+  {
+    i = O22SwapQuads(pbyData, (BYTE*)pnValues, nCount);
+  }
+#ifdef O22_SWAP_X86
+  else if (sizeof(long) == sizeof(LONGLONG))
+  {
+    switch (O22GetSwapLevel())
+    {
+      case O22_SWAP_AVX2:
+        i = O22WidenQuadsAVX2(pbyData, (LONGLONG*)pnValues, nCount);
+        break;
+      case O22_SWAP_SSSE3:
+        i = O22WidenQuadsSSSE3(pbyData, (LONGLONG*)pnValues, nCount);
+        break;
+    }
+  }
+#endif
+
+  for ( ; i < nCount ; i++)
+    pnValues[i] = O22MAKELONG2(pbyData, i*4);
+}
+
+
 O22SnapIoMemMap::O22SnapIoMemMap()
 //-------------------------------------------------------------------------------------------------
 // Constructor
@@ -29,13 +467,30 @@ O22SnapIoMemMap::O22SnapIoMemMap()
 {
   // Set defaults
   m_Socket = INVALID_SOCKET;
+  m_bWinSockStarted = FALSE;
+  m_nConnectionType = SIOMM_TCP;
   m_byTransactionLabel = 0;
   m_nRetries = 0;
-  m_nOpenTime = 0;
+  m_nOpenDeadlineNS = 0;
   m_nOpenTimeOutMS = 0;
   m_nTimeOutMS = 1000;
+  m_chOpenIpAddress[0] = 0;
+  m_nOpenPort = 0;
+  m_nTimeOutNS = (LONGLONG)m_nTimeOutMS * 1000000;
+  m_nStepDeadlineNS = 0;
+  m_nMinTimeOutNS = 0;
+  m_nSmoothedRttNS = 0;
+  m_nRttVarNS = 0;
+  m_nTimeOutBackoff = 0;
+  m_nResponseBytes = 0;
+  m_bStaleResponses = FALSE;
+  m_nResponseTimeNS = 0;
+  m_nLastResponseTimeNS = 0;
+  m_nQueuedRequests = 0;
+  m_nQueueDeadlineNS = 0;
+  m_nOutstanding = 0;
   m_tvTimeOut.tv_sec  = m_nTimeOutMS / 1000;
-  m_tvTimeOut.tv_usec = m_nTimeOutMS % 1000;
+  m_tvTimeOut.tv_usec = (m_nTimeOutMS % 1000) * 1000;
 }
  
 
@@ -47,69 +502,117 @@ O22SnapIoMemMap::~O22SnapIoMemMap()
   CloseSockets();
 
 #ifdef _WIN32
-  WSACleanup();
+  if (m_bWinSockStarted)
+    WSACleanup();
 #endif
 }
 
 
 LONG O22SnapIoMemMap::OpenEnet(char * pchIpAddressArg, long nPort, long nOpenTimeOutMS, long nAutoPUC)
 //-------------------------------------------------------------------------------------------------
-// Open a connection to a SNAP Ethernet I/O unit
+// Open a TCP connection to a SNAP Ethernet I/O unit
 //-------------------------------------------------------------------------------------------------
 {
-  m_nAutoPUCFlag = nAutoPUC;
-
-  return OpenSockets(pchIpAddressArg, nPort, nOpenTimeOutMS);
+  return OpenEnet2(pchIpAddressArg, nPort, nOpenTimeOutMS, nAutoPUC, SIOMM_TCP);
 }
 
 
-LONG O22SnapIoMemMap::OpenSockets(char * pchIpAddressArg, long nPort, long nOpenTimeOutMS)
+LONG O22SnapIoMemMap::OpenEnet2(char * pchIpAddressArg, long nPort, long nOpenTimeOutMS, 
+                                long nAutoPUC, long nConnectionType)
 //-------------------------------------------------------------------------------------------------
-// Use sockets to open a connection to the SNAP I/O unit
+// Open a TCP or UDP connection to a SNAP Ethernet I/O unit
 //-------------------------------------------------------------------------------------------------
 {
-  int       nResult; // for checking the return values of functions
+  if ((SIOMM_TCP != nConnectionType) && (SIOMM_UDP != nConnectionType))
+  {
+    return SIOMM_ERROR;
+  }
 
 #ifdef _WIN32
-  // Initialize WinSock.dll
-  WSADATA   wsaData; // for checking WinSock
-
-  nResult = WSAStartup(  O22MAKEWORD( WINSOCK_VERSION_REQUIRED_MIN, 
-                                      WINSOCK_VERSION_REQUIRED_MAJ ), &wsaData );
-  if ( nResult != 0 ) 
+  // Initialize WinSock.dll, once for the life of the object.  Reopen() doesn't do it again, so
+  // it stays balanced with the WSACleanup() in the destructor.
+  if (!m_bWinSockStarted)
   {
-    // We couldn't find a socket interface. 
-    return SIOMM_ERROR_NO_SOCKETS;  
-  } 
+    int       nResult; // for checking the return values of functions
+    WSADATA   wsaData; // for checking WinSock
 
-  // Confirm that the WinSock DLL supports WINSOCK_VERSION 
-  if (( O22LOBYTE( wsaData.wVersion ) != WINSOCK_VERSION_REQUIRED_MAJ) || 
-      ( O22HIBYTE( wsaData.wVersion ) != WINSOCK_VERSION_REQUIRED_MIN)) 
-  {
-    // We couldn't find an acceptable socket interface. 
-    WSACleanup( );
-    return SIOMM_ERROR_NO_SOCKETS; 
-  } 
+    nResult = WSAStartup(  O22MAKEWORD( WINSOCK_VERSION_REQUIRED_MIN, 
+                                        WINSOCK_VERSION_REQUIRED_MAJ ), &wsaData );
+    if ( nResult != 0 ) 
+    {
+      // We couldn't find a socket interface. 
+      return SIOMM_ERROR_NO_SOCKETS;  
+    } 
+
+    // Confirm that the WinSock DLL supports WINSOCK_VERSION 
+    if (( O22LOBYTE( wsaData.wVersion ) != WINSOCK_VERSION_REQUIRED_MAJ) || 
+        ( O22HIBYTE( wsaData.wVersion ) != WINSOCK_VERSION_REQUIRED_MIN)) 
+    {
+      // We couldn't find an acceptable socket interface. 
+      WSACleanup( );
+      return SIOMM_ERROR_NO_SOCKETS; 
+    } 
+
+    m_bWinSockStarted = TRUE;
+  }
 #endif
 
+  m_nAutoPUCFlag    = nAutoPUC;
+  m_nConnectionType = nConnectionType;
+
+  // Remember the I/O unit for Reopen()
+  strncpy(m_chOpenIpAddress, pchIpAddressArg, sizeof(m_chOpenIpAddress) - 1);
+  m_chOpenIpAddress[sizeof(m_chOpenIpAddress) - 1] = 0;
+  m_nOpenPort = nPort;
+
+  return OpenSockets(pchIpAddressArg, nPort, nOpenTimeOutMS);
+}
+
+
+LONG O22SnapIoMemMap::Reopen(long nOpenTimeOutMS)
+//-------------------------------------------------------------------------------------------------
+// Start connecting again to the I/O unit of the last OpenEnet() or OpenEnet2()
+//-------------------------------------------------------------------------------------------------
+{
+  if (0 == m_nOpenPort)
+  {
+    return SIOMM_ERROR_NOT_CONNECTED;
+  }
+
+  return OpenSockets(m_chOpenIpAddress, m_nOpenPort, nOpenTimeOutMS);
+}
 
+
+LONG O22SnapIoMemMap::OpenSockets(char * pchIpAddressArg, long nPort, long nOpenTimeOutMS)
+//-------------------------------------------------------------------------------------------------
+// Use sockets to open a connection to the SNAP I/O unit
+//-------------------------------------------------------------------------------------------------
+{
   // If a socket is open, close it now.
   CloseSockets();
 
   m_nOpenTimeOutMS = nOpenTimeOutMS;
 
-  // Create the socket
-  m_Socket = socket(AF_INET, SOCK_STREAM, 0);
+  // Create the socket.  A UDP socket is connected too, so send() and recv() only talk to the 
+  // I/O unit.
+  m_Socket = socket(AF_INET, m_nConnectionType, 0);
   if (m_Socket == INVALID_SOCKET)
   {
     // Couldn't create the socket
-#ifdef _WIN32
-    WSACleanup( );
-#endif
-
     return SIOMM_ERROR_CREATING_SOCKET;
   }
 
+  // Have the kernel stamp each response with its arrival time
+  O22EnableRecvTimeStamps(m_Socket);
+
+  // Transact() sends several small requests in a row.  Don't let Nagle's algorithm hold them
+  // until the I/O unit acknowledges the first one.
+  if (SIOMM_TCP == m_nConnectionType)
+  {
+    int nNoDelay = 1;
+    setsockopt(m_Socket, IPPROTO_TCP, TCP_NODELAY, (char*)&nNoDelay, sizeof(nNoDelay));
+  }
+
   // Make the socket non-blocking
 #ifdef _WIN32
   // Windows uses ioctlsocket() to set the socket as non-blocking.
@@ -134,16 +637,8 @@ LONG O22SnapIoMemMap::OpenSockets(char * pchIpAddressArg, long nPort, long nOpen
   // attempt connection
   connect(m_Socket, (sockaddr*) &m_SocketAddress, sizeof(m_SocketAddress));
 
-  // Get the time for the timeout logic in IsOpenDone()
-#ifdef _WIN32
-  m_nOpenTime = GetTickCount(); // GetTickCount returns the number of milliseconds that have
-                                // elapsed since the system was started.
-#endif
-#ifdef _LINUX
-  tms DummyTime;
-  m_nOpenTime = times(&DummyTime); // times() returns the number of milliseconds that have
-                                   // elapsed since the system was started.
-#endif
+  // Set the deadline for the timeout logic in IsOpenDone() and WaitForOpen()
+  m_nOpenDeadlineNS = O22GetTimeNS() + (LONGLONG)nOpenTimeOutMS * 1000000;
 
   return SIOMM_OK;
 }
@@ -169,8 +664,20 @@ LONG O22SnapIoMemMap::CloseSockets()
   memset(&m_SocketAddress, 0, sizeof(m_SocketAddress));
   m_Socket = INVALID_SOCKET;
   m_nOpenTimeOutMS = 0;
-  m_nOpenTime = 0;
-  m_nRetries = 0;
+  m_nOpenDeadlineNS = 0;
+  m_nResponseBytes = 0;
+  m_bStaleResponses = FALSE;
+  m_nResponseTimeNS = 0;
+  m_nQueuedRequests = 0;
+  m_Ring.DiscardDatagrams();
+
+  // Nothing outstanding can complete now
+  FailOutstanding(SIOMM_ERROR_NOT_CONNECTED);
+
+  // A new connection may take a different path to the I/O unit
+  m_nSmoothedRttNS = 0;
+  m_nRttVarNS = 0;
+  m_nTimeOutBackoff = 0;
 
 
   return SIOMM_OK;
@@ -181,50 +688,111 @@ LONG O22SnapIoMemMap::IsOpenDone()
 // Called after an OpenEnet() function to determine if the open process is completed yet.
 //-------------------------------------------------------------------------------------------------
 {
-  fd_set  fds;
-  timeval tvTimeOut;
-  DWORD   nOpenTimeOutTemp;
-  DWORD   dwPUCFlag;   // a flag for checking the status of PowerUp Clear on the I/O unit
-  long    nResult;     // for checking the return values of functions
+  return CheckOpenDone(FALSE);
+}
+
+
+LONG O22SnapIoMemMap::WaitForOpen()
+//-------------------------------------------------------------------------------------------------
+// Called after an OpenEnet() function to wait until the open process is completed.
+//-------------------------------------------------------------------------------------------------
+{
+  return CheckOpenDone(TRUE);
+}
+
 
-  // Check the open timeout
+LONG O22SnapIoMemMap::CheckOpenDone(BOOL bWait)
+//-------------------------------------------------------------------------------------------------
+// Check whether the connection started by OpenSockets() has resolved.  If bWait is set, sleep on
+// the socket until it resolves or the open deadline passes; otherwise only look.
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nWaitNS;     // how long to wait for the connection
+  int      nReady;      // the socket's state, from select() or ppoll()
+  int      nError;      // the outcome of the connection
+  DWORD    dwPUCFlag;   // a flag for checking the status of PowerUp Clear on the I/O unit
+  long     nResult;     // for checking the return values of functions
 #ifdef _WIN32
-  nOpenTimeOutTemp = GetTickCount(); // GetTickCount returns the number of milliseconds that have
-                                     // elapsed since the system was started. 
+  fd_set   fdsWrite;
+  fd_set   fdsExcept;
+  timeval  tvTimeOut;
+  int      nErrorSize = sizeof(nError);
 #endif
 #ifdef _LINUX
-  tms DummyTime;
-  nOpenTimeOutTemp = times(&DummyTime); // times() returns the number of milliseconds that have
-                                        // elapsed since the system was started. 
+  pollfd   PollSocket;
+  timespec tsTimeOut;
+  socklen_t nErrorSize = sizeof(nError);
 #endif
-  
-  // Check for overflow of the system timer
-  if (m_nOpenTime > nOpenTimeOutTemp) 
-    m_nOpenTime = 0;
 
-  // Check for timeout
-  if (m_nOpenTimeOutMS < (nOpenTimeOutTemp - m_nOpenTime)) 
+  if (INVALID_SOCKET == m_Socket)
+    return SIOMM_ERROR_NOT_CONNECTED;
+
+  for (;;)
   {
-    // Timeout has occured.
-    CloseSockets();
-    return SIOMM_TIME_OUT;
-  }
+    nWaitNS = 0;
+    if (bWait)
+    {
+      nWaitNS = m_nOpenDeadlineNS - O22GetTimeNS();
+      if (nWaitNS < 0)
+        nWaitNS = 0;
+    }
+
+#ifdef _WIN32
+    // A connection that failed is reported in the exception set
+    FD_ZERO(&fdsWrite);
+    FD_SET(m_Socket, &fdsWrite);
+    FD_ZERO(&fdsExcept);
+    FD_SET(m_Socket, &fdsExcept);
+    tvTimeOut.tv_sec  = (long)(nWaitNS / 1000000000);
+    tvTimeOut.tv_usec = (long)((nWaitNS % 1000000000 + 999) / 1000);
+
+    nReady = select(m_Socket + 1, NULL, &fdsWrite, &fdsExcept, &tvTimeOut);
+#endif
+#ifdef _LINUX
+    PollSocket.fd      = m_Socket;
+    PollSocket.events  = POLLOUT;
+    PollSocket.revents = 0;
+    tsTimeOut.tv_sec   = nWaitNS / 1000000000;
+    tsTimeOut.tv_nsec  = nWaitNS % 1000000000;
+
+    nReady = ppoll(&PollSocket, 1, &tsTimeOut, NULL);
+    if ((nReady < 0) && (EINTR == errno))
+      continue;
+#endif
 
-  FD_ZERO(&fds);
-  FD_SET(m_Socket, &fds);
+    break;
+  }
 
-  // We want the select to return immediately, so set the timeout to zero
-  tvTimeOut.tv_sec  = 0;
-  tvTimeOut.tv_usec = 100;
+  if (nReady < 0)
+  {
+    CloseSockets();
+    return SIOMM_ERROR;
+  }
 
-  // Use select() to check if the socket is connect and ready
-  if (0 == select(m_Socket + 1, NULL, &fds, NULL, &tvTimeOut))
+  if (0 == nReady)
   {
+    // Check the open timeout against the monotonic clock
+    if (O22GetTimeNS() >= m_nOpenDeadlineNS)
+    {
+      // Timeout has occured.
+      CloseSockets();
+      return SIOMM_TIME_OUT;
+    }
+
     // we're not connected yet!
     return SIOMM_ERROR_NOT_CONNECTED_YET;
   }
 
-  // Okay, we must be connected if we get past the select() above.
+  // The connection has resolved.  Find out whether it was refused.
+  nError = 0;
+  if ((SOCKET_ERROR == getsockopt(m_Socket, SOL_SOCKET, SO_ERROR, (char*)&nError, &nErrorSize)) ||
+      (0 != nError))
+  {
+    CloseSockets();
+    return SIOMM_ERROR_CONNECTING_SOCKET;
+  }
+
+  // Okay, we're connected.
   
   if (m_nAutoPUCFlag)
   {
@@ -264,22 +832,160 @@ LONG O22SnapIoMemMap::IsOpenDone()
 }
 
 
-LONG O22SnapIoMemMap::SetCommOptions(LONG nTimeOutMS, LONG nReserved)
+LONG O22SnapIoMemMap::SetCommOptions(LONG nTimeOutMS, LONG nRetries)
 //-------------------------------------------------------------------------------------------------
 // Set communication options
 //-------------------------------------------------------------------------------------------------
 {
-  // m_nRetries   = nReserved;
-  m_nTimeOutMS = nTimeOutMS;
-  
+  if (nRetries < 0)
+    return SIOMM_ERROR;
+
+  m_nRetries   = nRetries;
+  return SetCommTimeOutNS((LONGLONG)nTimeOutMS * 1000000);
+}
+
+
+LONG O22SnapIoMemMap::SetCommTimeOutNS(LONGLONG nTimeOutNS)
+//-------------------------------------------------------------------------------------------------
+// Set the timeout for each transaction, in nanoseconds
+//-------------------------------------------------------------------------------------------------
+{
+  if (nTimeOutNS < 0)
+    return SIOMM_ERROR;
+
+  m_nTimeOutNS = nTimeOutNS;
+  m_nTimeOutMS = (LONG)(nTimeOutNS / 1000000);
+
   // Set the timeout that sockets will use
-  m_tvTimeOut.tv_sec  = m_nTimeOutMS / 1000;
-  m_tvTimeOut.tv_usec = m_nTimeOutMS % 1000;
+  m_tvTimeOut.tv_sec  = (long)(nTimeOutNS / 1000000000);
+  m_tvTimeOut.tv_usec = (long)((nTimeOutNS % 1000000000) / 1000);
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoMemMap::SetAdaptiveTimeOut(LONGLONG nMinTimeOutNS)
+//-------------------------------------------------------------------------------------------------
+// Derive each transaction's timeout from the measured round trip time, or turn that off with 0
+//-------------------------------------------------------------------------------------------------
+{
+  if (nMinTimeOutNS < 0)
+    return SIOMM_ERROR;
+
+  m_nMinTimeOutNS = nMinTimeOutNS;
 
   return SIOMM_OK;
 }
 
 
+LONG O22SnapIoMemMap::GetRoundTripTimeNS(LONGLONG * pnSmoothedRttNS, LONGLONG * pnRttVarNS)
+//-------------------------------------------------------------------------------------------------
+// Get the round trip time estimate used by the adaptive timeout
+//-------------------------------------------------------------------------------------------------
+{
+  *pnSmoothedRttNS = m_nSmoothedRttNS;
+  *pnRttVarNS      = m_nRttVarNS;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoMemMap::BeginStepBudget(LONGLONG nBudgetNS)
+//-------------------------------------------------------------------------------------------------
+// Start a budget of time shared by all the transactions until EndStepBudget()
+//-------------------------------------------------------------------------------------------------
+{
+  if (nBudgetNS <= 0)
+    return SIOMM_ERROR;
+
+  m_nStepDeadlineNS = O22GetTimeNS() + nBudgetNS;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoMemMap::EndStepBudget()
+//-------------------------------------------------------------------------------------------------
+// Go back to timing each transaction on its own
+//-------------------------------------------------------------------------------------------------
+{
+  m_nStepDeadlineNS = 0;
+
+  return SIOMM_OK;
+}
+
+
+LONGLONG O22SnapIoMemMap::TransactionTimeOut()
+//-------------------------------------------------------------------------------------------------
+// Get the timeout for the next request.  With the adaptive timeout on, it's the retransmission
+// timeout of TCP (RFC 6298): the smoothed round trip time plus four times its variation, doubled
+// for each timeout in a row.  It's never less than the minimum given to SetAdaptiveTimeOut() or
+// more than the timeout of SetCommTimeOutNS().
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nTimeOutNS;
+
+  // Until the first response there's nothing to go on
+  if ((0 == m_nMinTimeOutNS) || (0 == m_nSmoothedRttNS))
+    return m_nTimeOutNS;
+
+  nTimeOutNS = m_nSmoothedRttNS + 4 * m_nRttVarNS;
+  if (nTimeOutNS < m_nMinTimeOutNS)
+    nTimeOutNS = m_nMinTimeOutNS;
+
+  nTimeOutNS <<= m_nTimeOutBackoff;
+  if (nTimeOutNS > m_nTimeOutNS)
+    nTimeOutNS = m_nTimeOutNS;
+
+  return nTimeOutNS;
+}
+
+
+void O22SnapIoMemMap::UpdateRoundTripTime(LONGLONG nRttNS)
+//-------------------------------------------------------------------------------------------------
+// Add a round trip time measurement to the estimate, as in RFC 6298
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nErrorNS;
+
+  // The kernel's arrival time can be a little off from our clock
+  if (nRttNS < 1)
+    nRttNS = 1;
+
+  if (0 == m_nSmoothedRttNS)
+  {
+    m_nSmoothedRttNS = nRttNS;
+    m_nRttVarNS      = nRttNS / 2;
+  }
+  else
+  {
+    nErrorNS = m_nSmoothedRttNS - nRttNS;
+    if (nErrorNS < 0)
+      nErrorNS = -nErrorNS;
+
+    m_nRttVarNS      = (3 * m_nRttVarNS + nErrorNS) / 4;
+    m_nSmoothedRttNS = (7 * m_nSmoothedRttNS + nRttNS) / 8;
+  }
+
+  m_nTimeOutBackoff = 0;
+}
+
+
+LONGLONG O22SnapIoMemMap::TransactionDeadline()
+//-------------------------------------------------------------------------------------------------
+// Get the deadline for a request sent now: the timeout from now, but no later than the end of
+// the step's budget.
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nDeadlineNS = O22GetTimeNS() + TransactionTimeOut();
+
+  if ((0 != m_nStepDeadlineNS) && (m_nStepDeadlineNS < nDeadlineNS))
+    nDeadlineNS = m_nStepDeadlineNS;
+
+  return nDeadlineNS;
+}
+
+
 LONG O22SnapIoMemMap::BuildReadBlockRequest(BYTE * pbyReadBlockRequest,
                                             BYTE   byTransactionLabel, 
                                             DWORD  dwDestinationOffset,
@@ -352,7 +1058,8 @@ LONG O22SnapIoMemMap::BuildWriteBlockRequest(BYTE *  pbyWriteBlockRequest,
                                              WORD    wDataLength,
                                              BYTE  * pbyBlockData)
 //-------------------------------------------------------------------------------------------------
-// Build a write block request packet
+// Build a write block request packet.  If pbyBlockData is NULL only the header is built, for
+// sending the header and the data from separate buffers.
 //-------------------------------------------------------------------------------------------------
 {
   // Destination Id
@@ -386,7 +1093,8 @@ LONG O22SnapIoMemMap::BuildWriteBlockRequest(BYTE *  pbyWriteBlockRequest,
   pbyWriteBlockRequest[15] = 0x00;
 
   // Block data to write
-  memcpy(&(pbyWriteBlockRequest[16]), pbyBlockData, wDataLength);
+  if (pbyBlockData)
+    memcpy(&(pbyWriteBlockRequest[16]), pbyBlockData, wDataLength);
 
 
   return SIOMM_OK;
@@ -544,418 +1252,1184 @@ LONG O22SnapIoMemMap::WriteFloat(DWORD dwDestOffset, float fValue)
 }
 
 
-LONG O22SnapIoMemMap::ReadBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData)
+LONG O22SnapIoMemMap::ReadBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData)
+//-------------------------------------------------------------------------------------------------
+// Read a block of data from a location in the SNAP I/O memory map.  The data is received
+// straight into pbyData, without any memory allocation.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Transaction;
+
+  if (wDataLength > SIOMM_MAX_BLOCK_LENGTH)
+  {
+    return SIOMM_ERROR;
+  }
+
+  Transaction.byTransactionCode = SIOMM_TCODE_READ_BLOCK_REQUEST;
+  Transaction.dwDestOffset      = dwDestOffset;
+  Transaction.wDataLength       = wDataLength;
+  Transaction.pbyData           = pbyData;
+
+  return Transact(&Transaction, 1, 1);
+}
+
+
+    
+LONG O22SnapIoMemMap::ReadQuad(DWORD dwDestOffset, DWORD * pdwQuadlet)
+//-------------------------------------------------------------------------------------------------
+// Read a quadlet of data from a location in the SNAP I/O memory map.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Transaction;
+  LONG              nResult;
+
+  Transaction.byTransactionCode = SIOMM_TCODE_READ_QUAD_REQUEST;
+  Transaction.dwDestOffset      = dwDestOffset;
+
+  nResult = Transact(&Transaction, 1, 1);
+
+  // Check the result
+  if (nResult == SIOMM_OK)
+  {
+    // The response was good, so copy the quadlet
+    *pdwQuadlet = Transaction.dwQuadlet;
+  }
+
+  return nResult;
+}
+
+
+LONG O22SnapIoMemMap::WriteBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData)
+//-------------------------------------------------------------------------------------------------
+// Write a block of data to a location in the SNAP I/O memory map.  The request is built in the
+// connection's own buffer, without any memory allocation.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Transaction;
+
+  if (wDataLength > SIOMM_MAX_BLOCK_LENGTH)
+  {
+    return SIOMM_ERROR;
+  }
+
+  Transaction.byTransactionCode = SIOMM_TCODE_WRITE_BLOCK_REQUEST;
+  Transaction.dwDestOffset      = dwDestOffset;
+  Transaction.wDataLength       = wDataLength;
+  Transaction.pbyData           = pbyData;
+
+  return Transact(&Transaction, 1, 1);
+}
+
+
+LONG O22SnapIoMemMap::WriteQuad(DWORD dwDestOffset, DWORD dwQuadlet)
+//-------------------------------------------------------------------------------------------------
+// Write a quadlet of data to a location in the SNAP I/O memory map.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_Transaction Transaction;
+
+  Transaction.byTransactionCode = SIOMM_TCODE_WRITE_QUAD_REQUEST;
+  Transaction.dwDestOffset      = dwDestOffset;
+  Transaction.dwQuadlet         = dwQuadlet;
+
+  return Transact(&Transaction, 1, 1);
+}
+
+
+LONG O22SnapIoMemMap::WaitForSocket(BOOL bWrite, LONGLONG nDeadlineNS)
+//-------------------------------------------------------------------------------------------------
+// Wait until the socket can be read, or written if bWrite is set, or the monotonic deadline
+// passes.  A deadline that has already passed still checks the socket once.
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nWaitNS;     // time left until the deadline
+  int      nReady;      // the socket's state, from select() or ppoll()
+#ifdef _WIN32
+  fd_set   fds;
+  timeval  tvTimeOut;
+#endif
+#ifdef _LINUX
+  pollfd   PollSocket;
+  timespec tsTimeOut;
+#endif
+
+  for (;;)
+  {
+    nWaitNS = nDeadlineNS - O22GetTimeNS();
+    if (nWaitNS < 0)
+      nWaitNS = 0;
+
+#ifdef _WIN32
+    FD_ZERO(&fds);
+    FD_SET(m_Socket, &fds);
+    tvTimeOut.tv_sec  = (long)(nWaitNS / 1000000000);
+    tvTimeOut.tv_usec = (long)((nWaitNS % 1000000000 + 999) / 1000);
+
+    if (bWrite)
+      nReady = select(m_Socket + 1, NULL, &fds, NULL, &tvTimeOut);
+    else
+      nReady = select(m_Socket + 1, &fds, NULL, NULL, &tvTimeOut);
+#endif
+#ifdef _LINUX
+    PollSocket.fd      = m_Socket;
+    PollSocket.events  = bWrite ? POLLOUT : POLLIN;
+    PollSocket.revents = 0;
+    tsTimeOut.tv_sec   = nWaitNS / 1000000000;
+    tsTimeOut.tv_nsec  = nWaitNS % 1000000000;
+
+    nReady = ppoll(&PollSocket, 1, &tsTimeOut, NULL);
+    if ((nReady < 0) && (EINTR == errno))
+      continue;
+#endif
+
+    break;
+  }
+
+  if (nReady < 0)
+    return SIOMM_ERROR;
+
+  if (0 == nReady)
+    return SIOMM_TIME_OUT;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoMemMap::SendQueuedRequests()
+//-------------------------------------------------------------------------------------------------
+// Send every request queued by QueueTransactionRequest(), waiting for room in the socket's send
+// buffer until the earliest of their deadlines if needed.  Over TCP the requests are all one 
+// gather send; over UDP each one is a datagram of its own, sent together where possible.
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_SendBuffer * pBuffers = m_arrSendBuffers;       // the buffers not sent yet
+  long               nBuffers = 2 * m_nQueuedRequests;
+  long               nResult;   // for checking the return values of functions
+
+  m_nQueuedRequests = 0;
+
+  // The ring sends them with the receive of the next response, in the same system call.  Over
+  // UDP each request is a message of its own.  When the ring is full, what it holds goes first.
+  while ((nBuffers > 0) && m_Ring.IsOpen())
+  {
+    if (SIOMM_UDP == m_nConnectionType)
+      nResult = m_Ring.QueueSend(m_Socket, pBuffers, 2);
+    else
+      nResult = m_Ring.QueueSend(m_Socket, pBuffers, nBuffers);
+
+    if (SIOMM_OK == nResult)
+    {
+      nResult   = (SIOMM_UDP == m_nConnectionType) ? 2 : nBuffers;
+      pBuffers += nResult;
+      nBuffers -= nResult;
+    }
+    else
+    {
+      nResult = m_Ring.Submit(m_nQueueDeadlineNS);
+      if (SIOMM_OK != nResult)
+        return nResult;
+    }
+  }
+
+  while (nBuffers > 0)
+  {
+    if (SIOMM_UDP == m_nConnectionType)
+      nResult = O22SendDatagrams(m_Socket, pBuffers, nBuffers / 2);
+    else
+      nResult = O22SendGather(m_Socket, pBuffers, nBuffers);
+
+    if (SOCKET_ERROR == nResult)
+    {
+      // The socket is non-blocking, so a full send buffer isn't an error.
+#ifdef _WIN32
+      if (WSAEWOULDBLOCK != WSAGetLastError())
+#endif
+#ifdef _LINUX
+      if ((EWOULDBLOCK != errno) && (EAGAIN != errno))
+#endif
+      {
+        return SIOMM_ERROR; // This probably means we're not connected.
+      }
+
+      nResult = WaitForSocket(TRUE, m_nQueueDeadlineNS);
+      if (SIOMM_OK != nResult)
+        return nResult;
+    }
+    else if (SIOMM_UDP == m_nConnectionType)
+    {
+      pBuffers += 2 * nResult;
+      nBuffers -= 2 * nResult;
+    }
+    else
+    {
+      // Skip the bytes sent.  A buffer sent in part keeps the rest for the next send.
+      while ((nBuffers > 0) && (nResult >= pBuffers->nLength))
+      {
+        nResult -= pBuffers->nLength;
+        pBuffers++;
+        nBuffers--;
+      }
+      if (nBuffers > 0)
+      {
+        pBuffers->pbyData += nResult;
+        pBuffers->nLength -= nResult;
+      }
+    }
+  }
+
+  return SIOMM_OK;
+}
+
+
+long O22SnapIoMemMap::BufferedFrameLength()
+//-------------------------------------------------------------------------------------------------
+// Get the length of the response at the start of m_byResponseFrame from its header.  Returns 0
+// if not enough of the header has arrived yet, or SIOMM_ERROR_RESPONSE_BAD if the header isn't
+// a response.
+//-------------------------------------------------------------------------------------------------
+{
+  WORD wDataLength;
+
+  // Every response starts with the same header as a write response
+  if (m_nResponseBytes < SIOMM_SIZE_WRITE_RESPONSE)
+    return 0;
+
+  switch (m_byResponseFrame[3] >> 4)
+  {
+    case SIOMM_TCODE_WRITE_RESPONSE:
+      return SIOMM_SIZE_WRITE_RESPONSE;
+
+    case SIOMM_TCODE_READ_QUAD_RESPONSE:
+      return SIOMM_SIZE_READ_QUAD_RESPONSE;
+
+    case SIOMM_TCODE_READ_BLOCK_RESPONSE:
+      if (m_nResponseBytes < SIOMM_SIZE_READ_BLOCK_RESPONSE)
+        return 0;
+
+      // The data is padded to land on a quadlet boundary
+      wDataLength = O22MAKEWORD(m_byResponseFrame[12], m_byResponseFrame[13]);
+      while ((wDataLength % 4) != 0)
+        wDataLength++;
+
+      if (wDataLength > SIOMM_MAX_BLOCK_LENGTH)
+        return SIOMM_ERROR_RESPONSE_BAD;
+
+      return SIOMM_SIZE_READ_BLOCK_RESPONSE + wDataLength;
+
+    default:
+      return SIOMM_ERROR_RESPONSE_BAD;
+  }
+}
+
+
+LONG O22SnapIoMemMap::RecvResponseFrame(long * pnFrameLength, LONGLONG nDeadlineNS)
+//-------------------------------------------------------------------------------------------------
+// Receive until a whole response is at the start of m_byResponseFrame, or the monotonic deadline
+// passes.  A response may arrive in several segments, and bytes of the next response may arrive
+// with it.
+//-------------------------------------------------------------------------------------------------
+{
+  long     nFrameLength;
+  long     nResult;       // for checking the return values of functions
+  long     nReceived;     // bytes received through the ring
+  LONGLONG nRecvTimeNS;   // when the received bytes arrived
+
+  for (;;)
+  {
+    nFrameLength = BufferedFrameLength();
+    if (nFrameLength < 0)
+    {
+      // We've lost track of where responses start, so nothing buffered can be trusted
+      m_nResponseBytes = 0;
+      return SIOMM_ERROR_RESPONSE_BAD;
+    }
+
+    if ((nFrameLength > 0) && (m_nResponseBytes >= nFrameLength))
+    {
+      *pnFrameLength = nFrameLength;
+      return SIOMM_OK;
+    }
+
+    if (m_Ring.IsOpen())
+    {
+      // The ring also sends the queued requests, and waits for every outstanding response, in
+      // one system call.  Over UDP the other datagrams are then taken without one.
+      if (SIOMM_UDP == m_nConnectionType)
+        nResult = m_Ring.RecvDatagram(m_Socket, m_byResponseFrame + m_nResponseBytes, 
+                                      sizeof(m_byResponseFrame) - m_nResponseBytes, 
+                                      m_nOutstanding, nDeadlineNS, &nReceived, &nRecvTimeNS);
+      else
+        nResult = m_Ring.Recv(m_Socket, m_byResponseFrame + m_nResponseBytes, 
+                              sizeof(m_byResponseFrame) - m_nResponseBytes, 
+                              ExpectedResponseBytes(), nDeadlineNS, &nReceived, &nRecvTimeNS);
+      if (SIOMM_OK != nResult)
+      {
+        // If we timed-out, the response may still arrive later
+        if (SIOMM_TIME_OUT == nResult)
+          m_bStaleResponses = TRUE;
+        return nResult;
+      }
+
+      nResult = nReceived;
+    }
+    else
+    {
+      // Is the recv ready?
+      nResult = WaitForSocket(FALSE, nDeadlineNS);
+      if (SIOMM_OK != nResult)
+      {
+        // we timed-out.  The response may still arrive later.
+        m_bStaleResponses = TRUE;
+        return nResult;
+      }
+
+      nResult = O22RecvTimeStamped(m_Socket, (char*)m_byResponseFrame + m_nResponseBytes, 
+                                   sizeof(m_byResponseFrame) - m_nResponseBytes, NULL, 
+                                   &nRecvTimeNS);
+    }
+
+    if (0 == nResult)
+    {
+      // The I/O unit closed the connection
+      return SIOMM_ERROR;
+    }
+    else if (SOCKET_ERROR == nResult)
+    {
+#ifdef _WIN32
+      if (WSAEWOULDBLOCK != WSAGetLastError())
+#endif
+#ifdef _LINUX
+      if ((EWOULDBLOCK != errno) && (EAGAIN != errno))
+#endif
+      {
+        return SIOMM_ERROR;
+      }
+    }
+    else
+    {
+      m_nResponseBytes += nResult;
+      m_nResponseTimeNS = nRecvTimeNS;
+
+      // Each datagram holds exactly one response, so for UDP the buffer was empty before this
+      // recv().  Drop a datagram that doesn't match its own header.
+      if ((SIOMM_UDP == m_nConnectionType) && (BufferedFrameLength() != nResult))
+        m_nResponseBytes = 0;
+    }
+  }
+}
+
+
+long O22SnapIoMemMap::ExpectedResponseBytes()
+//-------------------------------------------------------------------------------------------------
+// Get how many more bytes the responses to the outstanding transactions should take, beyond
+// those already in m_byResponseFrame.
+//-------------------------------------------------------------------------------------------------
+{
+  long nBytes = 0;
+  long i;
+
+  for (i = 0 ; i < m_nOutstanding ; i++)
+  {
+    switch (m_arrpOutstanding[i]->byTransactionCode)
+    {
+      case SIOMM_TCODE_READ_QUAD_REQUEST:
+        nBytes += SIOMM_SIZE_READ_QUAD_RESPONSE;
+        break;
+
+      case SIOMM_TCODE_READ_BLOCK_REQUEST:
+        // The data is padded to land on a quadlet boundary
+        nBytes += SIOMM_SIZE_READ_BLOCK_RESPONSE + ((m_arrpOutstanding[i]->wDataLength + 3) & ~3);
+        break;
+
+      default:
+        nBytes += SIOMM_SIZE_WRITE_RESPONSE;
+        break;
+    }
+  }
+
+  return nBytes - m_nResponseBytes;
+}
+
+
+void O22SnapIoMemMap::DiscardResponseFrame(long nFrameLength)
+//-------------------------------------------------------------------------------------------------
+// Remove a response from the start of m_byResponseFrame, keeping anything received after it.
+//-------------------------------------------------------------------------------------------------
+{
+  m_nResponseBytes -= nFrameLength;
+  memmove(m_byResponseFrame, m_byResponseFrame + nFrameLength, m_nResponseBytes);
+}
+
+
+void O22SnapIoMemMap::DrainStaleResponses()
+//-------------------------------------------------------------------------------------------------
+// Throw away responses to requests that timed out.  Called when no requests are outstanding,
+// so every whole response received by now is stale.
+//-------------------------------------------------------------------------------------------------
+{
+  long nFrameLength;
+  long nResult;
+
+  for (;;)
+  {
+    // Discard the whole responses already buffered
+    nFrameLength = BufferedFrameLength();
+    while ((nFrameLength > 0) && (m_nResponseBytes >= nFrameLength))
+    {
+      DiscardResponseFrame(nFrameLength);
+      nFrameLength = BufferedFrameLength();
+    }
+
+    if (nFrameLength < 0)
+    {
+      m_nResponseBytes = 0;
+    }
+
+    // Take whatever else is waiting on the socket, without blocking
+    nResult = recv(m_Socket, (char*)m_byResponseFrame + m_nResponseBytes, 
+                   sizeof(m_byResponseFrame) - m_nResponseBytes, 0);
+    if (nResult <= 0)
+      break;
+
+    m_nResponseBytes += nResult;
+  }
+
+  // So are the datagrams the ring received and nobody took
+  m_Ring.DiscardDatagrams();
+
+  // A partial response is still on its way.  It's discarded by its label once it arrives.
+  if (0 == m_nResponseBytes)
+    m_bStaleResponses = FALSE;
+}
+
+
+LONG O22SnapIoMemMap::QueueTransactionRequest(SIOMM_Transaction * pTransaction)
+//-------------------------------------------------------------------------------------------------
+// Build the request packet for one transaction of Transact() and queue it for
+// SendQueuedRequests().  Also used to send a request again, with the same label, when a UDP
+// response is lost.  The data of a block write is sent straight from the caller's buffer.
+//-------------------------------------------------------------------------------------------------
+{
+  BYTE             * pbyHeader;   // where the request's header is built
+  SIOMM_SendBuffer * pBuffers;    // the request's header and data
+  BYTE               byTransactionLabel = pTransaction->byTransactionLabel;
+
+  if ((SIOMM_TCODE_WRITE_BLOCK_REQUEST == pTransaction->byTransactionCode) &&
+      (pTransaction->wDataLength > SIOMM_MAX_BLOCK_LENGTH))
+  {
+    return SIOMM_ERROR;
+  }
+
+  // There can't be more outstanding requests than labels, but be safe
+  if (SIOMM_MAX_TRANSACTION_LABELS == m_nQueuedRequests)
+  {
+    LONG nResult = SendQueuedRequests();
+    if (SIOMM_OK != nResult)
+      return nResult;
+  }
+
+  pbyHeader = m_byRequestHeaders[m_nQueuedRequests];
+  pBuffers  = &(m_arrSendBuffers[2 * m_nQueuedRequests]);
+
+  pBuffers[0].pbyData = pbyHeader;
+  pBuffers[1].pbyData = NULL;
+  pBuffers[1].nLength = 0;
+
+  switch (pTransaction->byTransactionCode)
+  {
+    case SIOMM_TCODE_READ_QUAD_REQUEST:
+      BuildReadQuadletRequest(pbyHeader, byTransactionLabel, pTransaction->dwDestOffset);
+      pBuffers[0].nLength = SIOMM_SIZE_READ_QUAD_REQUEST;
+      break;
+
+    case SIOMM_TCODE_WRITE_QUAD_REQUEST:
+      BuildWriteQuadletRequest(pbyHeader, byTransactionLabel, 1, 
+                               pTransaction->dwDestOffset, pTransaction->dwQuadlet);
+      pBuffers[0].nLength = SIOMM_SIZE_WRITE_QUAD_REQUEST;
+      break;
+
+    case SIOMM_TCODE_READ_BLOCK_REQUEST:
+      BuildReadBlockRequest(pbyHeader, byTransactionLabel, pTransaction->dwDestOffset, 
+                            pTransaction->wDataLength);
+      pBuffers[0].nLength = SIOMM_SIZE_READ_BLOCK_REQUEST;
+      break;
+
+    case SIOMM_TCODE_WRITE_BLOCK_REQUEST:
+      BuildWriteBlockRequest(pbyHeader, byTransactionLabel, pTransaction->dwDestOffset, 
+                             pTransaction->wDataLength, NULL);
+      pBuffers[0].nLength = SIOMM_SIZE_WRITE_BLOCK_REQUEST;
+      pBuffers[1].pbyData = pTransaction->pbyData;
+      pBuffers[1].nLength = pTransaction->wDataLength;
+      break;
+
+    default:
+      return SIOMM_ERROR;
+  }
+
+  if ((0 == m_nQueuedRequests) || (pTransaction->nDeadlineNS < m_nQueueDeadlineNS))
+    m_nQueueDeadlineNS = pTransaction->nDeadlineNS;
+  m_nQueuedRequests++;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoMemMap::CompleteTransaction(SIOMM_Transaction * pTransaction, long nFrameLength)
+//-------------------------------------------------------------------------------------------------
+// Complete a transaction with the response at the start of m_byResponseFrame, which has its
+// label, and discard the response.  Returns SIOMM_ERROR_RESPONSE_BAD, leaving the transaction
+// pending, if the response doesn't match the request.
+//-------------------------------------------------------------------------------------------------
+{
+  BYTE  byTransactionCode = m_byResponseFrame[3] >> 4;
+  BYTE  byResponseCode    = m_byResponseFrame[6] >> 4;
+  WORD  wDataLength;
+  LONG  nResult = SIOMM_OK;
+
+  switch (byTransactionCode)
+  {
+    case SIOMM_TCODE_WRITE_RESPONSE:
+      if ((SIOMM_TCODE_WRITE_QUAD_REQUEST  != pTransaction->byTransactionCode) &&
+          (SIOMM_TCODE_WRITE_BLOCK_REQUEST != pTransaction->byTransactionCode))
+        nResult = SIOMM_ERROR_RESPONSE_BAD;
+      break;
+
+    case SIOMM_TCODE_READ_QUAD_RESPONSE:
+      if (SIOMM_TCODE_READ_QUAD_REQUEST != pTransaction->byTransactionCode)
+        nResult = SIOMM_ERROR_RESPONSE_BAD;
+      else
+        pTransaction->dwQuadlet = O22MAKELONG(m_byResponseFrame[12], m_byResponseFrame[13],
+                                              m_byResponseFrame[14], m_byResponseFrame[15]);
+      break;
+
+    case SIOMM_TCODE_READ_BLOCK_RESPONSE:
+      wDataLength = O22MAKEWORD(m_byResponseFrame[12], m_byResponseFrame[13]);
+
+      if (SIOMM_TCODE_READ_BLOCK_REQUEST != pTransaction->byTransactionCode)
+        nResult = SIOMM_ERROR_RESPONSE_BAD;
+      else if (SIOMM_RESPONSE_CODE_ACK != byResponseCode)
+        ; // A rejected read has no data for us
+      else if (wDataLength != pTransaction->wDataLength)
+        nResult = SIOMM_ERROR_RESPONSE_BAD;
+      else
+        memcpy(pTransaction->pbyData, &(m_byResponseFrame[SIOMM_SIZE_READ_BLOCK_RESPONSE]), 
+               wDataLength);
+      break;
+  }
+
+  DiscardResponseFrame(nFrameLength);
+
+  if (SIOMM_OK != nResult)
+    return nResult;
+
+  // The response was completed by the most recent receive
+  pTransaction->nRecvTimeNS = m_nResponseTimeNS;
+  m_nLastResponseTimeNS = m_nResponseTimeNS;
+
+  // A response to a request that was sent more than once can't be timed (Karn's algorithm)
+  if (0 != pTransaction->nSendTimeNS)
+    UpdateRoundTripTime(m_nResponseTimeNS - pTransaction->nSendTimeNS);
+
+  if (SIOMM_RESPONSE_CODE_ACK == byResponseCode)
+    pTransaction->nResult = SIOMM_OK;
+  else if (SIOMM_RESPONSE_CODE_NAK == byResponseCode)
+    pTransaction->nResult = SIOMM_TRANSACTION_NAK;
+  else
+    pTransaction->nResult = SIOMM_ERROR_RESPONSE_BAD;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoMemMap::Transact(SIOMM_Transaction * pTransactions, long nCount, long nWindow)
+//-------------------------------------------------------------------------------------------------
+// Perform several transactions, keeping up to nWindow requests outstanding at the same time.
+// The transactions go through BeginTransact() and ContinueTransact(), waiting on the socket 
+// in between, so they're retried and sent again the same way.
+//-------------------------------------------------------------------------------------------------
+{
+  long nErrorCode; // the I/O unit's last error, for NAK responses
+  LONG nLastErrorResult;
+  long i;
+
+  for (i = 0 ; i < nCount ; i++)
+    pTransactions[i].nResult = SIOMM_TRANSACTION_PENDING;
+
+  do
+  {
+    RunTransact(pTransactions, nCount, nWindow);
+
+    // Get the I/O unit's error code for any request it rejected.  This has to wait until 
+    // there are no more requests outstanding.
+    nLastErrorResult = SIOMM_OK;
+    for (i = 0 ; i < nCount ; i++)
+    {
+      if (SIOMM_TRANSACTION_NAK == pTransactions[i].nResult)
+      {
+        nLastErrorResult = GetStatusLastError(&nErrorCode);
+        if (SIOMM_OK == nLastErrorResult)
+          nLastErrorResult = nErrorCode;
+        break;
+      }
+    }
+  } while (ResolveNakResults(pTransactions, nCount, nLastErrorResult));
+
+  // Return the first error
+  for (i = 0 ; i < nCount ; i++)
+  {
+    if (SIOMM_OK != pTransactions[i].nResult)
+      return pTransactions[i].nResult;
+  }
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoMemMap::BeginTransact(SIOMM_Transaction * pTransactions, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Send the requests of several transactions without waiting for their responses
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;
+  long nBegin = 0; // transactions to begin
+  long i;
+
+  // Check that we have a valid socket
+  if (INVALID_SOCKET == m_Socket)
+  {
+    return SIOMM_ERROR_NOT_CONNECTED;
+  }
+
+  for (i = 0 ; i < nCount ; i++)
+  {
+    if ((SIOMM_TRANSACTION_PENDING == pTransactions[i].nResult) ||
+        (SIOMM_TRANSACTION_RETRY   == pTransactions[i].nResult))
+      nBegin++;
+  }
+
+  if ((nCount < 0) || (m_nOutstanding + nBegin > SIOMM_MAX_TRANSACTION_LABELS))
+    return SIOMM_ERROR;
+
+  nResult = QueueTransactions(pTransactions, nCount);
+
+  // The ring would wait for a receive, so it sends them now
+  if ((SIOMM_OK == nResult) && m_Ring.IsOpen())
+  {
+    nResult = m_Ring.Submit(m_nQueueDeadlineNS);
+    if (SIOMM_OK != nResult)
+      FailOutstanding(nResult);
+  }
+
+  return nResult;
+}
+
+
+LONG O22SnapIoMemMap::ContinueTransact()
+//-------------------------------------------------------------------------------------------------
+// Complete the outstanding transactions whose responses have arrived, and retry or time out 
+// the ones whose deadline has passed
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;
+
+  nResult = PollTransactions(O22GetTimeNS(), TRUE);
+
+  // Requests sent again are still in the ring, which would wait for a receive
+  if ((SIOMM_OK == nResult) && m_Ring.IsOpen())
+  {
+    nResult = m_Ring.Submit(m_nQueueDeadlineNS);
+    if (SIOMM_OK != nResult)
+      FailOutstanding(nResult);
+  }
+
+  return nResult;
+}
+
+
+BOOL O22SnapIoMemMap::ResolveNakResults(SIOMM_Transaction * pTransactions, long nCount,
+                                        LONG nLastErrorResult)
+//-------------------------------------------------------------------------------------------------
+// Replace SIOMM_TRANSACTION_NAK with the I/O unit's last error, and mark the reads that found 
+// the I/O unit busy to be tried again
+//-------------------------------------------------------------------------------------------------
+{
+  BOOL bRetry = FALSE;
+  long i;
+
+  for (i = 0 ; i < nCount ; i++)
+  {
+    if (SIOMM_TRANSACTION_NAK != pTransactions[i].nResult)
+      continue;
+
+    pTransactions[i].nResult = nLastErrorResult;
+
+    // Reads can safely be done twice.  Writes are left failed.  There's no point once the 
+    // step's budget is spent.
+    if ((SIOMM_BRAIN_ERROR_BUSY == nLastErrorResult) && IsReadTransaction(&(pTransactions[i])) &&
+        (pTransactions[i].nRetries < m_nRetries) &&
+        ((0 == m_nStepDeadlineNS) || (O22GetTimeNS() < m_nStepDeadlineNS)))
+    {
+      pTransactions[i].nResult = SIOMM_TRANSACTION_RETRY;
+      pTransactions[i].nRetries++;
+      bRetry = TRUE;
+    }
+  }
+
+  return bRetry;
+}
+
+
+void O22SnapIoMemMap::AbandonTransact(SIOMM_Transaction * pTransactions, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Forget outstanding transactions
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  for (i = 0 ; i < m_nOutstanding ; )
+  {
+    if ((m_arrpOutstanding[i] >= pTransactions) && (m_arrpOutstanding[i] < pTransactions + nCount))
+    {
+      RemoveOutstanding(i);
+      m_bStaleResponses = TRUE;
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+
+
+long O22SnapIoMemMap::GetOutstandingCount()
+//-------------------------------------------------------------------------------------------------
+// Get the number of transactions begun by BeginTransact() and not yet completed
+//-------------------------------------------------------------------------------------------------
+{
+  return m_nOutstanding;
+}
+
+
+LONGLONG O22SnapIoMemMap::GetOutstandingDeadline()
+//-------------------------------------------------------------------------------------------------
+// Get the earliest deadline of the outstanding transactions, or 0 if there are none
+//-------------------------------------------------------------------------------------------------
+{
+  LONGLONG nDeadlineNS = 0;
+  long     i;
+
+  for (i = 0 ; i < m_nOutstanding ; i++)
+  {
+    if ((0 == nDeadlineNS) || (m_arrpOutstanding[i]->nDeadlineNS < nDeadlineNS))
+      nDeadlineNS = m_arrpOutstanding[i]->nDeadlineNS;
+  }
+
+  return nDeadlineNS;
+}
+
+
+SOCKET O22SnapIoMemMap::GetSocket()
+//-------------------------------------------------------------------------------------------------
+// Get the socket of the connection
+//-------------------------------------------------------------------------------------------------
+{
+  return m_Socket;
+}
+
+
+BOOL O22SnapIoMemMap::IsLabelOutstanding(BYTE byTransactionLabel)
+//-------------------------------------------------------------------------------------------------
+// Check whether an outstanding transaction has a label
+//-------------------------------------------------------------------------------------------------
+{
+  long i;
+
+  for (i = 0 ; i < m_nOutstanding ; i++)
+  {
+    if (byTransactionLabel == m_arrpOutstanding[i]->byTransactionLabel)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+
+void O22SnapIoMemMap::RemoveOutstanding(long nIndex)
+//-------------------------------------------------------------------------------------------------
+// Remove a transaction from the outstanding ones, keeping the rest in order
+//-------------------------------------------------------------------------------------------------
+{
+  m_nOutstanding--;
+  memmove(&(m_arrpOutstanding[nIndex]), &(m_arrpOutstanding[nIndex + 1]), 
+          (m_nOutstanding - nIndex) * sizeof(m_arrpOutstanding[0]));
+}
+
+
+void O22SnapIoMemMap::FailOutstanding(LONG nResult)
 //-------------------------------------------------------------------------------------------------
-// Read a block of data from a location in the SNAP I/O memory map.
+// Complete every outstanding transaction with an error
 //-------------------------------------------------------------------------------------------------
 {
-  BYTE  byReadBlockRequest[SIOMM_SIZE_READ_BLOCK_REQUEST];
-  BYTE *pbyReadBlockResponse;
-  BYTE  byTransactionLabel;
-  BYTE  byResponseCode;
-  WORD  wDataLengthTemp;
-  BYTE *pbyDataTemp;
-  LONG  nResult;
-  fd_set fds;
-
-
-  // Check that we have a valid socket
-  if (INVALID_SOCKET == m_Socket)
-  {
-    return SIOMM_ERROR_NOT_CONNECTED;
-  }
+  long i;
 
-  // Increment the transaction label
-  UpdateTransactionLabel();
+  for (i = 0 ; i < m_nOutstanding ; i++)
+    m_arrpOutstanding[i]->nResult = nResult;
 
-  // The response will be padded to land on a quadlet boundary;
-  wDataLengthTemp = wDataLength;
-  while ((wDataLengthTemp%4) != 0)
-    wDataLengthTemp++;
+  m_nOutstanding = 0;
+}
 
-  // Allocate the response buffer
-  pbyReadBlockResponse = new BYTE[wDataLengthTemp + SIOMM_SIZE_READ_BLOCK_RESPONSE];
-  if (pbyReadBlockResponse == NULL)
-    return SIOMM_ERROR_OUT_OF_MEMORY; // Couldn't allocate memory!
 
-  FD_ZERO(&fds);
-  FD_SET(m_Socket, &fds);
+BOOL O22SnapIoMemMap::IsReadTransaction(SIOMM_Transaction * pTransaction)
+//-------------------------------------------------------------------------------------------------
+// Check whether a transaction is a read, which can be tried again
+//-------------------------------------------------------------------------------------------------
+{
+  return (SIOMM_TCODE_READ_QUAD_REQUEST  == pTransaction->byTransactionCode) ||
+         (SIOMM_TCODE_READ_BLOCK_REQUEST == pTransaction->byTransactionCode);
+}
 
-  // Build the request packet
-  BuildReadBlockRequest(byReadBlockRequest, m_byTransactionLabel, dwDestOffset, wDataLength);
 
-  // Send the packet to the Snap I/O unit
-  nResult = send(m_Socket, (char*)byReadBlockRequest, SIOMM_SIZE_READ_BLOCK_REQUEST, 0 /*??*/ );
-  if (SOCKET_ERROR == nResult)
+LONG O22SnapIoMemMap::QueueTransactionAttempt(SIOMM_Transaction * pTransaction)
+//-------------------------------------------------------------------------------------------------
+// Give a transaction a new label and deadline, and queue its request.  Responses can be out 
+// of order after a timeout, so labels still in use are skipped.
+//-------------------------------------------------------------------------------------------------
+{
+  // The transaction's own old label may be the only one free
+  pTransaction->byTransactionLabel = SIOMM_MAX_TRANSACTION_LABELS;
+  do
   {
-#ifdef _WIN32
-    nResult = WSAGetLastError();  // for checking the specific error
-#endif
-    return SIOMM_ERROR; // This probably means we're not connected.
-  }
+    UpdateTransactionLabel();
+  } while (IsLabelOutstanding(m_byTransactionLabel));
 
-#ifdef _LINUX
-  // In the call to select, Linux modifies m_tvTimeOut.  It needs to be reset every time.
-  m_tvTimeOut.tv_sec  = m_nTimeOutMS / 1000;
-  m_tvTimeOut.tv_usec = m_nTimeOutMS % 1000;
-#endif
+  pTransaction->byTransactionLabel = m_byTransactionLabel;
+  pTransaction->nDeadlineNS = TransactionDeadline();
+  pTransaction->nSendTimeNS = O22GetTimeNS();
+  pTransaction->nRetransmits = 0;
 
-  // Is the recv ready?
-  if (0 == select(m_Socket + 1, &fds, NULL, NULL, &m_tvTimeOut)) // ?? Param#1 is ignored by Windows.  What should it be in other systems?
-  {
-    // we timed-out
-    return SIOMM_TIME_OUT;
-  }
+  return QueueTransactionRequest(pTransaction);
+}
 
 
-  // The response is ready, so recv it.
-  nResult = recv(m_Socket, (char*)pbyReadBlockResponse, 
-                 wDataLengthTemp + SIOMM_SIZE_READ_BLOCK_RESPONSE, 0 /*??*/);
+LONG O22SnapIoMemMap::QueueTransactions(SIOMM_Transaction * pTransactions, long nCount)
+//-------------------------------------------------------------------------------------------------
+// Make the transactions marked SIOMM_TRANSACTION_PENDING or SIOMM_TRANSACTION_RETRY
+// outstanding and send their requests together.  The others are skipped and keep their
+// results.  The ring only queues the requests, for the next receive.
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult = SIOMM_OK;
+  long i;
+
+  // Don't let late responses from an earlier timeout be taken for ours
+  if ((0 == m_nOutstanding) && m_bStaleResponses)
+    DrainStaleResponses();
 
-  if ((wDataLengthTemp + SIOMM_SIZE_READ_BLOCK_RESPONSE) != nResult)
+  for (i = 0 ; (i < nCount) && (SIOMM_OK == nResult) ; i++)
   {
-    // we got the wrong number of bytes back!
-    return SIOMM_ERROR_RESPONSE_BAD;
+    if (SIOMM_TRANSACTION_PENDING == pTransactions[i].nResult)
+      pTransactions[i].nRetries = 0;
+    else if (SIOMM_TRANSACTION_RETRY != pTransactions[i].nResult)
+      continue;
+
+    pTransactions[i].nResult = SIOMM_TRANSACTION_PENDING;
+    nResult = QueueTransactionAttempt(&(pTransactions[i]));
+    m_arrpOutstanding[m_nOutstanding++] = &(pTransactions[i]);
   }
 
-  // Allocate a temporary data buffer
-  pbyDataTemp = new BYTE[wDataLength];
-  if (pbyDataTemp == NULL)
-    return SIOMM_ERROR_OUT_OF_MEMORY; // Couldn't allocate memory!
-
-  // Unpack the response.
-  nResult = UnpackReadBlockResponse(pbyReadBlockResponse,
-                                    &byTransactionLabel, &byResponseCode, 
-                                    &wDataLengthTemp, pbyDataTemp);
-
-  // Clean up memory
-  delete pbyReadBlockResponse;
+  if (SIOMM_OK == nResult)
+    nResult = SendQueuedRequests();
+  else
+    m_nQueuedRequests = 0;
 
-  // Check that the response was okay
-  if ((SIOMM_OK == nResult) && 
-      (SIOMM_RESPONSE_CODE_ACK == byResponseCode) && 
-      (m_byTransactionLabel == byTransactionLabel))
-  {
-    // The response was good, so copy the data   
-    memcpy(pbyData, pbyDataTemp, wDataLengthTemp);
-    delete pbyDataTemp;
-    return SIOMM_OK;
-  }
-  else if ((SIOMM_OK == nResult) && (SIOMM_RESPONSE_CODE_NAK == byResponseCode))
+  // A request we can't send leaves the connection in an unknown state
+  if (SIOMM_OK != nResult)
   {
-    // Clean up memory
-    delete pbyDataTemp;
-
-    // If a bad response from the brain, get its last error code
-    long nErrorCode;
-    nResult = GetStatusLastError(&nErrorCode);
-    if (SIOMM_OK == nResult)
-    {
-      return nErrorCode;
-    }
-    else
+    for ( ; i < nCount ; i++)
     {
-      return nResult;
+      if ((SIOMM_TRANSACTION_PENDING == pTransactions[i].nResult) ||
+          (SIOMM_TRANSACTION_RETRY   == pTransactions[i].nResult))
+        pTransactions[i].nResult = nResult;
     }
+    FailOutstanding(nResult);
   }
-  else
-  {
-    delete pbyDataTemp;
-    return SIOMM_ERROR_RESPONSE_BAD;
-  }
+
+  return nResult;
 }
 
 
-    
-LONG O22SnapIoMemMap::ReadQuad(DWORD dwDestOffset, DWORD * pdwQuadlet)
+LONG O22SnapIoMemMap::PollTransactions(LONGLONG nWaitDeadlineNS, BOOL bDrain)
 //-------------------------------------------------------------------------------------------------
-// Read a quadlet of data from a location in the SNAP I/O memory map.
+// Complete the outstanding transactions whose responses have arrived, waiting for the first 
+// one until nWaitDeadlineNS, and deal with the ones whose deadline has passed.  A lost UDP
+// request is sent again, a read is tried again as set with SetCommOptions(), and anything 
+// else times out.  After the first response, only those already buffered are taken unless
+// bDrain is set, so that waiting callers don't spend a system call finding nothing.
 //-------------------------------------------------------------------------------------------------
 {
-  BYTE  byReadQuadletRequest[SIOMM_SIZE_READ_QUAD_REQUEST];
-  BYTE  byReadQuadletResponse[SIOMM_SIZE_READ_QUAD_RESPONSE];
-  BYTE  byTransactionLabel;
-  BYTE  byResponseCode;
-  DWORD dwQuadletTemp;
-  LONG  nResult;
-  fd_set fds;
-
+  SIOMM_Transaction * pTransaction;
+  BYTE     byTransactionLabel;
+  BOOL     bStaleResponses;
+  BOOL     bFirst;       // set while waiting for the first response
+  BOOL     bExpired = FALSE;
+  BOOL     bBudgetLeft;  // whether the step's budget has room for another try
+  long     nFrameLength;
+  LONG     nResult;
+  LONGLONG nNowNS;
+  long     i;
 
-  // Check that we have a valid socket
-  if (INVALID_SOCKET == m_Socket)
+  for (bFirst = TRUE ; m_nOutstanding > 0 ; bFirst = FALSE)
   {
-    return SIOMM_ERROR_NOT_CONNECTED;
-  }
-
-  // Increment the transaction label
-  UpdateTransactionLabel();
+    if (!bFirst && !bDrain)
+    {
+      nFrameLength = BufferedFrameLength();
+      if ((0 == nFrameLength) || (m_nResponseBytes < nFrameLength))
+        break;
+    }
 
-  FD_ZERO(&fds);
-  FD_SET(m_Socket, &fds);
+    // Running out of data isn't a timeout of ours; the deadlines are checked below
+    bStaleResponses = m_bStaleResponses;
+    nResult = RecvResponseFrame(&nFrameLength, nWaitDeadlineNS);
+    if (SIOMM_TIME_OUT == nResult)
+    {
+      m_bStaleResponses = bStaleResponses;
+      break;
+    }
 
-  // Build the request packet
-  BuildReadQuadletRequest(byReadQuadletRequest, m_byTransactionLabel, dwDestOffset);
+    if (SIOMM_OK != nResult)
+    {
+      FailOutstanding(nResult);
+      return nResult;
+    }
 
-  // Send the packet to the Snap I/O unit
-  nResult = send(m_Socket, (char*)byReadQuadletRequest, SIOMM_SIZE_READ_QUAD_REQUEST, 0 /*??*/ );
-  if (SOCKET_ERROR == nResult)
-  {
-#ifdef _WIN32
-    nResult = WSAGetLastError();  // for checking the specific error
-#endif
-    return SIOMM_ERROR; // This probably means we're not connected.
-  }
+    // Take the rest of what has arrived without waiting
+    nWaitDeadlineNS = O22GetTimeNS();
 
-#ifdef _LINUX
-  // In the call to select, Linux modifies m_tvTimeOut.  It needs to be reset every time.
-  m_tvTimeOut.tv_sec  = m_nTimeOutMS / 1000;
-  m_tvTimeOut.tv_usec = m_nTimeOutMS % 1000;
-#endif
+    // Find the outstanding request with this label.  Anything else is a late response to a 
+    // request that already timed out.
+    byTransactionLabel = m_byResponseFrame[2] >> 2;
+    for (i = 0 ; i < m_nOutstanding ; i++)
+    {
+      if (byTransactionLabel == m_arrpOutstanding[i]->byTransactionLabel)
+        break;
+    }
 
-  // Is the recv ready?
-  if (0 == select(m_Socket + 1, &fds, NULL, NULL, &m_tvTimeOut)) // ?? Param#1 is ignored by Windows.  What should it be in other systems?
-  {
-    // we timed-out
-    return SIOMM_TIME_OUT;
+    if (i == m_nOutstanding)
+    {
+      DiscardResponseFrame(nFrameLength);
+    }
+    else
+    {
+      nResult = CompleteTransaction(m_arrpOutstanding[i], nFrameLength);
+      if (SIOMM_OK != nResult)
+        m_arrpOutstanding[i]->nResult = nResult;
+      RemoveOutstanding(i);
+    }
   }
 
-  // The response is ready, so recv it.
-  nResult = recv(m_Socket, (char*)byReadQuadletResponse, SIOMM_SIZE_READ_QUAD_RESPONSE, 0 /*??*/);
-  if (SIOMM_SIZE_READ_QUAD_RESPONSE != nResult)
+  // Deal with the rest as their deadlines pass
+  nResult = SIOMM_OK;
+  nNowNS = O22GetTimeNS();
+  bBudgetLeft = (0 == m_nStepDeadlineNS) || (nNowNS < m_nStepDeadlineNS);
+  for (i = 0 ; (i < m_nOutstanding) && (SIOMM_OK == nResult) ; )
   {
-    // we got the wrong number of bytes back!
-    return SIOMM_ERROR_RESPONSE_BAD;
-  }
-
+    pTransaction = m_arrpOutstanding[i];
+    if (pTransaction->nDeadlineNS > nNowNS)
+    {
+      i++;
+      continue;
+    }
 
-  // Unpack the response.
-  nResult = UnpackReadQuadletResponse(byReadQuadletResponse,
-                                      &byTransactionLabel, 
-                                      &byResponseCode, &dwQuadletTemp);
+    // The responses may still arrive later, and the next requests get longer to answer
+    if (!bExpired)
+    {
+      bExpired = TRUE;
+      m_bStaleResponses = TRUE;
+      if (m_nTimeOutBackoff < SIOMM_MAX_TIMEOUT_BACKOFF)
+        m_nTimeOutBackoff++;
+    }
 
-  // Check that the response was okay
-  if ((SIOMM_OK == nResult) && 
-      (SIOMM_RESPONSE_CODE_ACK == byResponseCode) && 
-      (m_byTransactionLabel == byTransactionLabel))
-  {
-    // The response was good, so copy the quadlet
-    *pdwQuadlet = dwQuadletTemp;
-    return SIOMM_OK;
-  }
-  else if ((SIOMM_OK == nResult) && (SIOMM_RESPONSE_CODE_NAK == byResponseCode))
-  {
-    // If a bad response from the brain, get its last error code
-    long nErrorCode;
-    nResult = GetStatusLastError(&nErrorCode);
-    if (SIOMM_OK == nResult)
+    if (bBudgetLeft && (SIOMM_UDP == m_nConnectionType) && 
+        (pTransaction->nRetransmits < SIOMM_UDP_RETRANSMITS))
     {
-      return nErrorCode;
+      // A UDP request or response may have been lost.  Send the request again with the same 
+      // label; whichever copy is answered first completes the transaction and the other 
+      // answer is discarded as stale.
+      pTransaction->nRetransmits++;
+      pTransaction->nDeadlineNS = TransactionDeadline();
+      pTransaction->nSendTimeNS = 0;
+      nResult = QueueTransactionRequest(pTransaction);
+      i++;
+    }
+    else if (bBudgetLeft && IsReadTransaction(pTransaction) && 
+             (pTransaction->nRetries < m_nRetries))
+    {
+      // Reads can safely be done twice.  Writes are left failed.  A new label keeps a late
+      // answer to the first try from being taken for the second.
+      pTransaction->nRetries++;
+      nResult = QueueTransactionAttempt(pTransaction);
+      i++;
     }
     else
     {
-      return nResult;
+      pTransaction->nResult = SIOMM_TIME_OUT;
+      RemoveOutstanding(i);
     }
   }
+
+  if (SIOMM_OK == nResult)
+    nResult = SendQueuedRequests();
   else
-  {
-    return SIOMM_ERROR_RESPONSE_BAD;
-  }
+    m_nQueuedRequests = 0;
+
+  if (SIOMM_OK != nResult)
+    FailOutstanding(nResult);
+
+  return nResult;
 }
 
 
-LONG O22SnapIoMemMap::WriteBlock(DWORD dwDestOffset, WORD wDataLength, BYTE * pbyData)
+LONG O22SnapIoMemMap::RunTransact(SIOMM_Transaction * pTransactions, long nCount, long nWindow)
 //-------------------------------------------------------------------------------------------------
-// Write a block of data to a location in the SNAP I/O memory map.
+// Perform the transactions marked SIOMM_TRANSACTION_PENDING or SIOMM_TRANSACTION_RETRY, for
+// Transact(), keeping up to nWindow of them outstanding.  The others are skipped and keep 
+// their results.
 //-------------------------------------------------------------------------------------------------
 {
-  BYTE *pbyWriteBlockRequest;
-  BYTE  byWriteBlockResponse[SIOMM_SIZE_WRITE_RESPONSE];
-  BYTE  byTransactionLabel;
-  BYTE  byResponseCode;
-  LONG  nResult;
-  fd_set fds;
+  long nStart;      // first transaction of those begun together
+  long nNext = 0;   // transactions begun or skipped so far
+  long nBegin;      // transactions to begin now
+  long nInFlight;   // transactions of ours outstanding
+  LONG nResult = SIOMM_OK;
+  long i;
 
-    // Check that we have a valid socket
+  // Check that we have a valid socket
   if (INVALID_SOCKET == m_Socket)
-  {
-    return SIOMM_ERROR_NOT_CONNECTED;
-  }
-
-  // Increment the transaction label
-  UpdateTransactionLabel();
+    nResult = SIOMM_ERROR_NOT_CONNECTED;
 
-  FD_ZERO(&fds);
-  FD_SET(m_Socket, &fds);
+  // Every outstanding request needs its own transaction label
+  if (nWindow < 1)
+    nWindow = 1;
+  if (nWindow > SIOMM_MAX_TRANSACTION_LABELS)
+    nWindow = SIOMM_MAX_TRANSACTION_LABELS;
 
-  pbyWriteBlockRequest = new BYTE[SIOMM_SIZE_WRITE_BLOCK_REQUEST + wDataLength];
-  if (pbyWriteBlockRequest == NULL)
-    return SIOMM_ERROR_OUT_OF_MEMORY; // Couldn't allocate memory!
+  while (SIOMM_OK == nResult)
+  {
+    nInFlight = 0;
+    for (i = 0 ; i < nNext ; i++)
+    {
+      if (SIOMM_TRANSACTION_PENDING == pTransactions[i].nResult)
+        nInFlight++;
+    }
 
-  // Build the write request packet
-  BuildWriteBlockRequest(pbyWriteBlockRequest, m_byTransactionLabel, 
-                         dwDestOffset, wDataLength, pbyData);
+    // Fill the window with new requests, as far as the labels go
+    nStart = nNext;
+    nBegin = 0;
+    while ((nNext < nCount) && (nInFlight + nBegin < nWindow) && 
+           (m_nOutstanding + nBegin < SIOMM_MAX_TRANSACTION_LABELS))
+    {
+      if ((SIOMM_TRANSACTION_PENDING == pTransactions[nNext].nResult) ||
+          (SIOMM_TRANSACTION_RETRY   == pTransactions[nNext].nResult))
+        nBegin++;
+      nNext++;
+    }
 
-  // Send the packet to the Snap I/O unit
-  nResult = send(m_Socket, (char*)pbyWriteBlockRequest, SIOMM_SIZE_WRITE_BLOCK_REQUEST + wDataLength, 0 /*??*/ );
+    if (nBegin > 0)
+    {
+      nResult = QueueTransactions(&(pTransactions[nStart]), nNext - nStart);
+      nInFlight += nBegin;
+    }
 
-  // Cleanup memory
-  delete pbyWriteBlockRequest;
+    if ((SIOMM_OK != nResult) || ((0 == nInFlight) && (nNext == nCount)))
+      break;
 
-  // Check the result from send()
-  if (SOCKET_ERROR == nResult)
-  {
-    return SIOMM_ERROR; // oops!
+    // Wait for the next response, or the next deadline
+    nResult = PollTransactions(GetOutstandingDeadline(), FALSE);
   }
 
+  // Requests the ring still holds after an error go now, so that it holds none of our buffers
+  if (m_Ring.IsOpen())
+    m_Ring.Submit(m_nQueueDeadlineNS);
 
-#ifdef _LINUX
-  // In the call to select, Linux modifies m_tvTimeOut.  It needs to be reset every time.
-  m_tvTimeOut.tv_sec  = m_nTimeOutMS / 1000;
-  m_tvTimeOut.tv_usec = m_nTimeOutMS % 1000;
-#endif
-
-  // Is the recv ready?
-  if (0 == select(m_Socket + 1, &fds, NULL, NULL, &m_tvTimeOut)) // ?? Param#1 is ignored by Windows.  What should it be in other systems?
-  {
-    // we timed-out
-    return SIOMM_TIME_OUT;
-  }
-
-  // The response is ready, so recv it.
-  nResult = recv(m_Socket, (char*)byWriteBlockResponse, SIOMM_SIZE_WRITE_RESPONSE, 0 /*??*/);
-  if (SIOMM_SIZE_WRITE_RESPONSE != nResult)
+  // Anything not begun failed with the connection
+  for (i = nNext ; i < nCount ; i++)
   {
-    // we got the wrong number of bytes back!
-    return SIOMM_ERROR_RESPONSE_BAD;
+    if ((SIOMM_TRANSACTION_PENDING == pTransactions[i].nResult) ||
+        (SIOMM_TRANSACTION_RETRY   == pTransactions[i].nResult))
+      pTransactions[i].nResult = nResult;
   }
- 
-  // Unpack the response
-  nResult = UnpackWriteResponse(byWriteBlockResponse, &byTransactionLabel, 
-                                &byResponseCode);
 
-  // Check that the response was okay
-  if ((SIOMM_OK == nResult) && 
-      (SIOMM_RESPONSE_CODE_ACK == byResponseCode) && 
-      (m_byTransactionLabel == byTransactionLabel))
-  {
-    // The response was good!
-    return SIOMM_OK;
-  }
-  else if ((SIOMM_OK == nResult) && (SIOMM_RESPONSE_CODE_NAK == byResponseCode))
-  {
-    // If a bad response from the brain, get its last error code
-    long nErrorCode;
-    nResult = GetStatusLastError(&nErrorCode);
-    if (SIOMM_OK == nResult)
-    {
-      return nErrorCode;
-    }
-    else
-    {
-      return nResult;
-    }
-  }
-  else
-  {
-    return SIOMM_ERROR_RESPONSE_BAD;
-  }
+  return nResult;
 }
 
 
-LONG O22SnapIoMemMap::WriteQuad(DWORD dwDestOffset, DWORD dwQuadlet)
+LONG O22SnapIoMemMap::Close()
 //-------------------------------------------------------------------------------------------------
-// Write a quadlet of data to a location in the SNAP I/O memory map.
+// Close the connection to the I/O unit
 //-------------------------------------------------------------------------------------------------
 {
-  BYTE  byWriteQuadletRequest[SIOMM_SIZE_WRITE_QUAD_REQUEST];
-  BYTE  byWriteQuadletResponse[SIOMM_SIZE_WRITE_RESPONSE];
-  BYTE  byTransactionLabel;
-  BYTE  byResponseCode;
-  LONG  nResult;
-  fd_set fds;
-
-  // Check that we have a valid socket
-  if (INVALID_SOCKET == m_Socket)
-  {
-    return SIOMM_ERROR_NOT_CONNECTED;
-  }
-
-  // Increment the transaction label
-  UpdateTransactionLabel();
+  return CloseSockets();
+}
 
-  FD_ZERO(&fds);
-  FD_SET(m_Socket, &fds);
 
-  // Build the write request packet
-  BuildWriteQuadletRequest(byWriteQuadletRequest, m_byTransactionLabel, 1, 
-                           dwDestOffset, dwQuadlet);
+LONG O22SnapIoMemMap::GetLastResponseTimeNS(LONGLONG * pnRecvTimeNS)
+//-------------------------------------------------------------------------------------------------
+// Get when the response to the last completed transaction arrived
+//-------------------------------------------------------------------------------------------------
+{
+  *pnRecvTimeNS = m_nLastResponseTimeNS;
 
-  // Send the packet to the Snap I/O unit
-  nResult = send(m_Socket, (char*)byWriteQuadletRequest, SIOMM_SIZE_WRITE_QUAD_REQUEST, 0 /*??*/ );
-  if (SOCKET_ERROR == nResult)
-  {
-    return SIOMM_ERROR; // oops!
-  }
+  return SIOMM_OK;
+}
 
-#ifdef _LINUX
-  // In the call to select, Linux modifies m_tvTimeOut.  It needs to be reset every time.
-  m_tvTimeOut.tv_sec  = m_nTimeOutMS / 1000;
-  m_tvTimeOut.tv_usec = m_nTimeOutMS % 1000;
-#endif
 
-  // Is the recv ready?
-  if (0 == select(m_Socket + 1, &fds, NULL, NULL, &m_tvTimeOut)) // ?? Param#1 is ignored by Windows.  What should it be in other systems?
+LONG O22SnapIoMemMap::SetIoBackend(long nBackend)
+//-------------------------------------------------------------------------------------------------
+// Choose between the sockets and the io_uring for sending and receiving
+//-------------------------------------------------------------------------------------------------
+{
+  switch (nBackend)
   {
-    // we timed-out
-    return SIOMM_TIME_OUT;
-  }
+    case SIOMM_IO_SOCKETS:
+      m_Ring.Close();
+      return SIOMM_OK;
 
-  // The response is ready, so recv it.
-  nResult = recv(m_Socket, (char*)byWriteQuadletResponse, SIOMM_SIZE_WRITE_RESPONSE, 0 /*??*/);
-  if (SIOMM_SIZE_WRITE_RESPONSE != nResult)
-  {
-    // we got the wrong number of bytes back!
-    return SIOMM_ERROR_RESPONSE_BAD;
-  }
- 
-  // Unpack the response
-  nResult = UnpackWriteResponse(byWriteQuadletResponse, &byTransactionLabel, &byResponseCode);
+    case SIOMM_IO_URING:
+      return m_Ring.Open();
 
-  // Check that the response was okay
-  if ((SIOMM_OK == nResult) && 
-      (SIOMM_RESPONSE_CODE_ACK == byResponseCode) && 
-      (m_byTransactionLabel == byTransactionLabel))
-  {
-    // The response was good!
-    return SIOMM_OK;
-  }
-  else if ((SIOMM_OK == nResult) && (SIOMM_RESPONSE_CODE_NAK == byResponseCode))
-  {
-    // If a bad response from the brain, get its last error code
-    long nErrorCode;
-    nResult = GetStatusLastError(&nErrorCode);
-    if (SIOMM_OK == nResult)
-    {
-      return nErrorCode;
-    }
-    else
-    {
-      return nResult;
-    }
-  }
-  else
-  {
-    return SIOMM_ERROR_RESPONSE_BAD;
+    default:
+      return SIOMM_ERROR;
   }
 }
 
 
-LONG O22SnapIoMemMap::Close()
+LONG O22SnapIoMemMap::GetLocalIpAddress(char * pchIpAddressArg, long nLength)
 //-------------------------------------------------------------------------------------------------
-// Close the connection to the I/O unit
+// Get the local address of the connection to the I/O unit
 //-------------------------------------------------------------------------------------------------
 {
-  return CloseSockets();
+  sockaddr_in LocalAddress; // The local end of the socket
+  char      * pchAddress;   // The address in "X.X.X.X" form
+#ifdef _WIN32
+  int         nAddressSize = sizeof(LocalAddress);
+#endif
+#ifdef _LINUX
+  socklen_t   nAddressSize = sizeof(LocalAddress);
+#endif
+
+  if (m_Socket == INVALID_SOCKET)
+    return SIOMM_ERROR_NOT_CONNECTED;
+
+  if (getsockname(m_Socket, (sockaddr*)&LocalAddress, &nAddressSize) == SOCKET_ERROR)
+    return SIOMM_ERROR;
+
+  pchAddress = inet_ntoa(LocalAddress.sin_addr);
+  if ((long)strlen(pchAddress) >= nLength)
+    return SIOMM_ERROR;
+
+  strcpy(pchIpAddressArg, pchAddress);
+
+  return SIOMM_OK;
 }
 
 
@@ -1017,6 +2491,7 @@ LONG O22SnapIoMemMap::GetDigPtReadAreaEx(long nPoint, SIOMM_DigPointReadArea * p
 
   LONG nResult;      // for checking the return values of functions
   BYTE arrbyData[20]; // buffer for the data to be read
+  long arrnValues[5]; // the values, in the order of the structure
 
   // Read the data
   nResult = ReadBlock(SIOMM_DPOINT_READ_AREA_BASE + (SIOMM_DPOINT_READ_BOUNDARY * nPoint), 20, (BYTE*)arrbyData);
@@ -1025,16 +2500,13 @@ LONG O22SnapIoMemMap::GetDigPtReadAreaEx(long nPoint, SIOMM_DigPointReadArea * p
   if (SIOMM_OK == nResult)
   {
     // If everything is okay, go ahead and fill the structure
-    pData->nState        = O22MAKELONG(arrbyData[0],  arrbyData[1],
-                                       arrbyData[2],  arrbyData[3]);
-    pData->nOnLatch      = O22MAKELONG(arrbyData[4],  arrbyData[5],
-                                       arrbyData[6],  arrbyData[7]);
-    pData->nOffLatch     = O22MAKELONG(arrbyData[8],  arrbyData[9],
-                                       arrbyData[10], arrbyData[11]);
-    pData->nCounterState = O22MAKELONG(arrbyData[12], arrbyData[13],
-                                       arrbyData[14], arrbyData[15]);
-    pData->nCounts       = O22MAKELONG(arrbyData[16], arrbyData[17],
-                                       arrbyData[18], arrbyData[19]);
+    O22UnpackLongs(arrbyData, arrnValues, 5);
+
+    pData->nState        = arrnValues[0];
+    pData->nOnLatch      = arrnValues[1];
+    pData->nOffLatch     = arrnValues[2];
+    pData->nCounterState = arrnValues[3];
+    pData->nCounts       = arrnValues[4];
 
   }
 
@@ -1242,6 +2714,7 @@ LONG O22SnapIoMemMap::GetDigBankReadAreaEx(SIOMM_DigBankReadArea * pData)
 {
   LONG nResult;       // for checking the return values of functions
   BYTE arrbyData[32]; // buffer for the data to be read
+  long arrnValues[8]; // the values, in the order of the structure
 
   // Read the data
   nResult = ReadBlock(SIOMM_DBANK_READ_AREA_BASE, 32, (BYTE*)arrbyData);
@@ -1250,25 +2723,19 @@ LONG O22SnapIoMemMap::GetDigBankReadAreaEx(SIOMM_DigBankReadArea * pData)
   if (SIOMM_OK == nResult)
   {
     // If everything is okay, go ahead and fill the structure
-    pData->nStatePts63to32          = O22MAKELONG(arrbyData[0],  arrbyData[1],
-                                                  arrbyData[2],  arrbyData[3]);
-    pData->nStatePts31to0           = O22MAKELONG(arrbyData[4],  arrbyData[5],
-                                                  arrbyData[6],  arrbyData[7]);
+    O22UnpackLongs(arrbyData, arrnValues, 8);
+
+    pData->nStatePts63to32          = arrnValues[0];
+    pData->nStatePts31to0           = arrnValues[1];
 
-    pData->nOnLatchStatePts63to32   = O22MAKELONG(arrbyData[8],  arrbyData[9],
-                                                  arrbyData[10], arrbyData[11]);
-    pData->nOnLatchStatePts31to0    = O22MAKELONG(arrbyData[12], arrbyData[13],
-                                                  arrbyData[14], arrbyData[15]);
+    pData->nOnLatchStatePts63to32   = arrnValues[2];
+    pData->nOnLatchStatePts31to0    = arrnValues[3];
 
-    pData->nOffLatchStatePts63to32  = O22MAKELONG(arrbyData[16], arrbyData[17], 
-                                                  arrbyData[18], arrbyData[19]);
-    pData->nOffLatchStatePts31to0   = O22MAKELONG(arrbyData[20], arrbyData[21], 
-                                                  arrbyData[22], arrbyData[23]);
+    pData->nOffLatchStatePts63to32  = arrnValues[4];
+    pData->nOffLatchStatePts31to0   = arrnValues[5];
 
-    pData->nActiveCountersPts63to32 = O22MAKELONG(arrbyData[24], arrbyData[25],
-                                                  arrbyData[26], arrbyData[27]);
-    pData->nActiveCountersPts31to0  = O22MAKELONG(arrbyData[28], arrbyData[29],
-                                                  arrbyData[30], arrbyData[31]);
+    pData->nActiveCountersPts63to32 = arrnValues[6];
+    pData->nActiveCountersPts31to0  = arrnValues[7];
   }
 
   return nResult;
@@ -1351,9 +2818,9 @@ LONG O22SnapIoMemMap::GetAnaPtReadAreaEx(long nPoint, SIOMM_AnaPointReadArea * p
 // Get the read area for the specified analog point
 //-------------------------------------------------------------------------------------------------
 {
-  LONG  nResult;       // for checking the return values of functions
-  BYTE  arrbyData[16]; // buffer for the data to be read
-  DWORD dwTemp;
+  LONG  nResult;        // for checking the return values of functions
+  BYTE  arrbyData[16];  // buffer for the data to be read
+  float arrfValues[4];  // the values, in the order of the structure
 
   // Read the data
   nResult = ReadBlock(SIOMM_APOINT_READ_AREA_BASE + (SIOMM_APOINT_READ_BOUNDARY * nPoint), 
@@ -1363,17 +2830,12 @@ LONG O22SnapIoMemMap::GetAnaPtReadAreaEx(long nPoint, SIOMM_AnaPointReadArea * p
   if (SIOMM_OK == nResult)
   {
     // If everything is okay, go ahead and fill the structure
-    dwTemp = O22MAKELONG(arrbyData[0],  arrbyData[1],  arrbyData[2],  arrbyData[3]);
-    memcpy(&(pData->fValue), &dwTemp, 4);
-
-    dwTemp = O22MAKELONG(arrbyData[4],  arrbyData[5],  arrbyData[6],  arrbyData[7]);
-    memcpy(&(pData->fCounts), &dwTemp, 4);
-
-    dwTemp = O22MAKELONG(arrbyData[8],  arrbyData[9],  arrbyData[10], arrbyData[11]);
-    memcpy(&(pData->fMinValue), &dwTemp, 4);
+    O22UnpackFloats(arrbyData, arrfValues, 4);
 
-    dwTemp = O22MAKELONG(arrbyData[12], arrbyData[13], arrbyData[14], arrbyData[15]);
-    memcpy(&(pData->fMaxValue), &dwTemp, 4);
+    pData->fValue    = arrfValues[0];
+    pData->fCounts   = arrfValues[1];
+    pData->fMinValue = arrfValues[2];
+    pData->fMaxValue = arrfValues[3];
   }
 
   return nResult;
@@ -1846,8 +3308,6 @@ LONG O22SnapIoMemMap::GetAnaBank(DWORD dwDestOffset, SIOMM_AnaBank * pBankData)
 {
   LONG nResult;        // for checking the return values of functions
   BYTE arrbyData[256]; // buffer for the data to be read
-  DWORD dwQuadlet;     // A temp for getting the read value
-  LONG  nArrayOffset;  // for stepping through the array
 
   // Read the data
   nResult = ReadBlock(dwDestOffset, 256, (BYTE*)arrbyData);
@@ -1856,15 +3316,7 @@ LONG O22SnapIoMemMap::GetAnaBank(DWORD dwDestOffset, SIOMM_AnaBank * pBankData)
   if (SIOMM_OK == nResult)
   {
     // Unpack the data packet
-    for (int i = 0 ; i < 64 ; i++)
-    {
-      nArrayOffset = i*4;
-      dwQuadlet = O22MAKELONG(arrbyData[nArrayOffset],     arrbyData[nArrayOffset + 1],
-                              arrbyData[nArrayOffset + 2], arrbyData[nArrayOffset + 3]);
-
-      // Copy the data
-      memcpy(&(pBankData->fValue[i]), &dwQuadlet, 4);
-    }
+    O22UnpackFloats(arrbyData, pBankData->fValue, 64);
   }
 
   return nResult;
@@ -1877,23 +3329,10 @@ LONG O22SnapIoMemMap::SetAnaBank(DWORD dwDestOffset, SIOMM_AnaBank BankData)
 //-------------------------------------------------------------------------------------------------
 {
   LONG nResult;        // for checking the return values of functions
-  BYTE arrbyData[256]; // buffer for the data to be read
-  DWORD dwQuadlet;     // A temp for getting the read value
-  LONG  nArrayOffset;  // for stepping through the array
+  BYTE arrbyData[256]; // buffer for the data to be written
 
   // Pack the data packet
-  for (int i = 0 ; i < 64 ; i++)
-  {
-    // Copy the float into a DWORD for easy manipulation
-    memcpy(&dwQuadlet, &(BankData.fValue[i]), 4);
-
-    nArrayOffset = i*4;
-
-    arrbyData[nArrayOffset]     = O22BYTE0(dwQuadlet);
-    arrbyData[nArrayOffset + 1] = O22BYTE1(dwQuadlet);
-    arrbyData[nArrayOffset + 2] = O22BYTE2(dwQuadlet);
-    arrbyData[nArrayOffset + 3] = O22BYTE3(dwQuadlet);
-  }
+  O22PackFloats(BankData.fValue, arrbyData, 64);
 
   // Read the data
   nResult = WriteBlock(dwDestOffset, 256, (BYTE*)&arrbyData);
@@ -1956,3 +3395,75 @@ LONG O22SnapIoMemMap::SetAnaBankCountsEx(SIOMM_AnaBank BankData)
 }
 
 
+
+
+LONG O22SnapIoMemMap::GetStreamConfiguration(long * pnOnFlag, long * pnIntervalMS, long * pnPort,
+                                             long * pnIoMirroringEnabled, long * pnStartAddress, 
+                                             long * pnDataSize)
+//-------------------------------------------------------------------------------------------------
+// Get the stream configuration
+//-------------------------------------------------------------------------------------------------
+{
+  LONG nResult;       // for checking the return values of functions
+  BYTE arrbyData[24]; // buffer for the data to be read
+
+  nResult = ReadBlock(SIOMM_STREAM_CONFIG_BASE, 24, (BYTE*)arrbyData);
+
+  // Check for error
+  if (SIOMM_OK == nResult)
+  {
+    *pnIoMirroringEnabled = O22MAKELONG2(arrbyData,  0);
+    *pnStartAddress       = O22MAKELONG2(arrbyData,  4);
+    *pnDataSize           = O22MAKELONG2(arrbyData,  8);
+    *pnOnFlag             = O22MAKELONG2(arrbyData, 12);
+    *pnIntervalMS         = O22MAKELONG2(arrbyData, 16);
+    *pnPort               = O22MAKELONG2(arrbyData, 20);
+  }
+
+  return nResult;
+}
+
+
+LONG O22SnapIoMemMap::SetStreamConfiguration(long nOnFlag, long nIntervalMS, long nPort,
+                                             long nIoMirroringEnabled, long nStartAddress, 
+                                             long nDataSize)
+//-------------------------------------------------------------------------------------------------
+// Set the stream configuration
+//-------------------------------------------------------------------------------------------------
+{
+  BYTE arrbyData[24]; // buffer for the data to be written
+
+  O22FILL_ARRAY_FROM_LONG(arrbyData,  0, nIoMirroringEnabled);
+  O22FILL_ARRAY_FROM_LONG(arrbyData,  4, nStartAddress);
+  O22FILL_ARRAY_FROM_LONG(arrbyData,  8, nDataSize);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 12, nOnFlag);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 16, nIntervalMS);
+  O22FILL_ARRAY_FROM_LONG(arrbyData, 20, nPort);
+
+  return WriteBlock(SIOMM_STREAM_CONFIG_BASE, 24, (BYTE*)arrbyData);
+}
+
+
+LONG O22SnapIoMemMap::GetStreamTarget(long nTarget, long * pnIpAddressArg)
+//-------------------------------------------------------------------------------------------------
+// Get one of the stream targets as a 32-bit IP address
+//-------------------------------------------------------------------------------------------------
+{
+  return ReadQuad(SIOMM_STREAM_TARGET_BASE + (SIOMM_STREAM_TARGET_BOUNDARY * nTarget), 
+                  (DWORD*)pnIpAddressArg);
+}
+
+
+LONG O22SnapIoMemMap::SetStreamTarget(long nTarget, char * pchIpAddressArg)
+//-------------------------------------------------------------------------------------------------
+// Set one of the stream targets from an "X.X.X.X" IP address
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD dwIpAddress = inet_addr(pchIpAddressArg);
+
+  if (INADDR_NONE == dwIpAddress)
+    return SIOMM_ERROR;
+
+  return WriteQuad(SIOMM_STREAM_TARGET_BASE + (SIOMM_STREAM_TARGET_BOUNDARY * nTarget), 
+                   ntohl(dwIpAddress));
+}
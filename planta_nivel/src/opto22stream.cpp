@@ -0,0 +1,855 @@
+//-----------------------------------------------------------------------------
+//
+// O22SIOST.cpp
+// Copyright (c) 2000-2002 by Opto 22
+//
+// Source for the O22SnapIoStream C++ class.
+//
+// The O22SnapIoStream C++ class is used to listen to UDP stream packets
+// from multiple Opto 22 SNAP Ethernet I/O units streaming to the same port on
+// the computer running this code. See O22SIOST.h for usage.
+//
+// While this class was developed on Microsoft Windows 32-bit operating
+// systems, it is intended to be as generic as possible.  For Windows specific
+// code, search for "_WIN32" and "_WIN32_WCE".  For Linux specific code, search
+// for "_LINUX".
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOST.h"
+
+#ifdef _LINUX
+#include <time.h>
+#endif
+
+
+#ifdef _WIN32
+#define WINSOCK_VERSION_REQUIRED_MAJ 2
+#define WINSOCK_VERSION_REQUIRED_MIN 0
+#endif
+
+
+static DWORD StreamTickCount()
+//-------------------------------------------------------------------------------------------------
+// A millisecond tick count for tracking stream timeouts
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef _WIN32
+  return GetTickCount();
+#endif
+#ifdef _LINUX
+  struct timespec tsNow;
+
+  clock_gettime(CLOCK_MONOTONIC, &tsNow);
+  return (DWORD)tsNow.tv_sec * 1000 + tsNow.tv_nsec / 1000000;
+#endif
+}
+
+
+// The stream table and the packet rings are shared by the listening thread and the user without
+// a lock. These load with acquire and store with release semantics, so that a packet or list 
+// item is completely written before the index or pointer that publishes it. The fence keeps the
+// copies of the newest packet between the two updates of its sequence number.
+
+static DWORD StreamLoad(volatile DWORD * pnValue)
+{
+#ifdef _WIN32
+  // Visual C++ gives volatile accesses acquire and release semantics
+  return *pnValue;
+#endif
+#ifdef _LINUX
+  return __atomic_load_n(pnValue, __ATOMIC_ACQUIRE);
+#endif
+}
+
+
+static void StreamStore(volatile DWORD * pnValue, DWORD nValue)
+{
+#ifdef _WIN32
+  *pnValue = nValue;
+#endif
+#ifdef _LINUX
+  __atomic_store_n(pnValue, nValue, __ATOMIC_RELEASE);
+#endif
+}
+
+
+static void StreamFence()
+{
+#ifdef _WIN32
+  MemoryBarrier();
+#endif
+#ifdef _LINUX
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+
+static O22StreamItem * StreamLoadItem(O22StreamItem * volatile * ppItem)
+{
+#ifdef _WIN32
+  return *ppItem;
+#endif
+#ifdef _LINUX
+  return __atomic_load_n(ppItem, __ATOMIC_ACQUIRE);
+#endif
+}
+
+
+static void StreamStoreItem(O22StreamItem * volatile * ppItem, O22StreamItem * pItem)
+{
+#ifdef _WIN32
+  *ppItem = pItem;
+#endif
+#ifdef _LINUX
+  __atomic_store_n(ppItem, pItem, __ATOMIC_RELEASE);
+#endif
+}
+
+
+static long StreamHash(DWORD nIpAddress)
+//-------------------------------------------------------------------------------------------------
+// The home slot of an I/O unit in the lookup table. Fibonacci hashing spreads out addresses
+// that only differ in the last byte, such as a rack of I/O units on one subnet.
+//-------------------------------------------------------------------------------------------------
+{
+  return (long)((((nIpAddress & 0xFFFFFFFF) * 2654435761UL) & 0xFFFFFFFF) >> 
+                (32 - SIOMM_STREAM_TABLE_BITS));
+}
+
+
+#ifdef _WIN32
+static unsigned __stdcall StreamThread(void * pParam)
+#endif
+#ifdef _LINUX
+static void * StreamThread(void * pParam)
+#endif
+//-------------------------------------------------------------------------------------------------
+// The stream listening thread. Runs until m_bListenToStreaming is cleared.
+//-------------------------------------------------------------------------------------------------
+{
+  O22SnapIoStream * pStream = (O22SnapIoStream *)pParam;
+
+  if (pStream->m_pStartThreadCallbackFunc)
+    pStream->m_pStartThreadCallbackFunc(pStream->m_pStartThreadParam);
+
+  while (pStream->m_bListenToStreaming)
+  {
+    pStream->StreamHandler();
+    pStream->CheckStreamTimeouts();
+  }
+
+  if (pStream->m_pStopThreadCallbackFunc)
+    pStream->m_pStopThreadCallbackFunc(pStream->m_pStopThreadParam);
+
+  return 0;
+}
+
+
+O22SnapIoStream::O22SnapIoStream()
+//-------------------------------------------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------------------------------------------
+{
+  // Set defaults
+  m_bListenToStreaming = FALSE;
+  m_pbyLastStreamBlock = NULL;
+  m_nLastStreamIpAddress = 0;
+  m_nLastStreamRecvTimeNS = 0;
+
+  m_pStartThreadCallbackFunc = NULL;
+  m_pStreamEventCallbackFunc = NULL;
+  m_pStopThreadCallbackFunc  = NULL;
+  m_pStartThreadParam = NULL;
+  m_pStreamEventParam = NULL;
+  m_pStopThreadParam  = NULL;
+
+  m_StreamSocket  = INVALID_SOCKET;
+  m_nStreamType   = SIOMM_STREAM_TYPE_STANDARD;
+  m_nStreamLength = 0;
+
+  memset((void*)m_arrStreamTable, 0, sizeof(m_arrStreamTable));
+  m_nStreamItems   = 0;
+  nStreamListCount = 0;
+
+#ifdef _WIN32
+  m_hStreamThread = NULL;
+  InitializeCriticalSection(&m_StreamCriticalSection);
+#endif
+#ifdef _LINUX
+  pthread_mutex_init(&m_StreamCriticalSection, NULL);
+#endif
+}
+
+
+O22SnapIoStream::~O22SnapIoStream()
+//-------------------------------------------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------------------------------------------
+{
+  CloseStreaming();
+
+#ifdef _WIN32
+  DeleteCriticalSection(&m_StreamCriticalSection);
+#endif
+#ifdef _LINUX
+  pthread_mutex_destroy(&m_StreamCriticalSection);
+#endif
+}
+
+
+void O22SnapIoStream::LockStream()
+//-------------------------------------------------------------------------------------------------
+// Lock out other changes to the stream list and the callbacks. The listening thread never
+// takes the lock.
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef _WIN32
+  EnterCriticalSection(&m_StreamCriticalSection);
+#endif
+#ifdef _LINUX
+  pthread_mutex_lock(&m_StreamCriticalSection);
+#endif
+}
+
+
+void O22SnapIoStream::UnlockStream()
+//-------------------------------------------------------------------------------------------------
+// Allow changes to the stream list and the callbacks again
+//-------------------------------------------------------------------------------------------------
+{
+#ifdef _WIN32
+  LeaveCriticalSection(&m_StreamCriticalSection);
+#endif
+#ifdef _LINUX
+  pthread_mutex_unlock(&m_StreamCriticalSection);
+#endif
+}
+
+
+LONG O22SnapIoStream::OpenStreaming(long nType, long nLength, long nPort)
+//-------------------------------------------------------------------------------------------------
+// Open the UDP port that the I/O units stream to
+//-------------------------------------------------------------------------------------------------
+{
+  sockaddr_in LocalAddress; // The port to listen on
+
+  // Figure out the size of the packets
+  if (SIOMM_STREAM_TYPE_STANDARD == nType)
+  {
+    nLength = SIOMM_STREAM_HEADER_SIZE + SIOMM_STREAM_STANDARD_DATA_SIZE;
+  }
+  else if (SIOMM_STREAM_TYPE_CUSTOM == nType)
+  {
+    if ((nLength <= 0) || (nLength > SIOMM_STREAM_CUSTOM_MAX_DATA_SIZE))
+      return SIOMM_ERROR;
+
+    nLength += SIOMM_STREAM_CUSTOM_HEADER_SIZE;
+  }
+  else
+  {
+    return SIOMM_ERROR_STREAM_TYPE_BAD;
+  }
+
+#ifdef _WIN32
+  // Initialize WinSock.dll
+  WSADATA   wsaData; // for checking WinSock
+
+  if (WSAStartup(O22MAKEWORD(WINSOCK_VERSION_REQUIRED_MIN, WINSOCK_VERSION_REQUIRED_MAJ),
+                 &wsaData) != 0)
+  {
+    // We couldn't find a socket interface.
+    return SIOMM_ERROR_NO_SOCKETS;
+  }
+#endif
+
+  // If the port is open, close it now.
+  CloseStreaming();
+
+  m_StreamSocket = socket(AF_INET, SOCK_DGRAM, 0);
+  if (m_StreamSocket == INVALID_SOCKET)
+  {
+#ifdef _WIN32
+    WSACleanup( );
+#endif
+    return SIOMM_ERROR_CREATING_SOCKET;
+  }
+
+  memset(&LocalAddress, 0, sizeof(LocalAddress));
+  LocalAddress.sin_family      = AF_INET;
+  LocalAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+  LocalAddress.sin_port        = htons((WORD)nPort);
+
+  if (bind(m_StreamSocket, (sockaddr*)&LocalAddress, sizeof(LocalAddress)) == SOCKET_ERROR)
+  {
+    CloseStreaming();
+    return SIOMM_ERROR_CREATING_SOCKET;
+  }
+
+  // Have the kernel stamp each packet with its arrival time
+  O22EnableRecvTimeStamps(m_StreamSocket);
+
+  m_nStreamType   = nType;
+  m_nStreamLength = nLength;
+
+  // The receive buffer is one byte longer than a packet so that longer packets can be
+  // recognized and dropped.
+  m_pbyLastStreamBlock = new BYTE[m_nStreamLength + 1];
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::CloseStreaming()
+//-------------------------------------------------------------------------------------------------
+// Stop listening to all I/O units and close the port
+//-------------------------------------------------------------------------------------------------
+{
+  StopStreamThread();
+
+  // Empty the table. Now that the listening thread is stopped, nobody else is using it.
+  for (long i = 0 ; i < m_nStreamItems ; i++)
+    delete m_arrStreamItems[i];
+  memset((void*)m_arrStreamTable, 0, sizeof(m_arrStreamTable));
+  m_nStreamItems   = 0;
+  nStreamListCount = 0;
+  m_nLastStreamIpAddress = 0;
+
+  if (m_StreamSocket != INVALID_SOCKET)
+  {
+#ifdef _WIN32
+    closesocket(m_StreamSocket);
+    WSACleanup();
+#endif
+#ifdef _LINUX
+    close(m_StreamSocket);
+#endif
+  }
+  m_StreamSocket = INVALID_SOCKET;
+
+  delete [] m_pbyLastStreamBlock;
+  m_pbyLastStreamBlock = NULL;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::SetCallbackFunctions(STREAM_CALLBACK_PROC pStartThreadCallbackFunc,
+                                           void * pStartThreadParam,
+                                           STREAM_EVENT_CALLBACK_PROC pStreamEventCallbackFunc,
+                                           void * pStreamEventParam,
+                                           STREAM_CALLBACK_PROC pStopThreadCallbackFunc,
+                                           void * pStopThreadParam)
+//-------------------------------------------------------------------------------------------------
+// Set the callback functions used by the listening thread
+//-------------------------------------------------------------------------------------------------
+{
+  LockStream();
+
+  m_pStartThreadCallbackFunc = pStartThreadCallbackFunc;
+  m_pStartThreadParam        = pStartThreadParam;
+  m_pStreamEventCallbackFunc = pStreamEventCallbackFunc;
+  m_pStreamEventParam        = pStreamEventParam;
+  m_pStopThreadCallbackFunc  = pStopThreadCallbackFunc;
+  m_pStopThreadParam         = pStopThreadParam;
+
+  UnlockStream();
+
+  return SIOMM_OK;
+}
+
+
+O22StreamItem * O22SnapIoStream::FindStreamItem(DWORD nIpAddress)
+//-------------------------------------------------------------------------------------------------
+// Find the item for an I/O unit, whether or not it's still being listened to
+//-------------------------------------------------------------------------------------------------
+{
+  O22StreamItem * pItem;                        // the item in the current slot
+  long            nSlot = StreamHash(nIpAddress); // the current slot
+
+  // The table is never more than half full, so an empty slot ends the search
+  while ((pItem = StreamLoadItem(&m_arrStreamTable[nSlot])) != NULL)
+  {
+    if (pItem->nIpAddress == nIpAddress)
+      return pItem;
+
+    nSlot = (nSlot + 1) & (SIOMM_STREAM_TABLE_SIZE - 1);
+  }
+
+  return NULL;
+}
+
+
+O22StreamItem * O22SnapIoStream::FindStreamItem(char * pchIpAddressArg)
+//-------------------------------------------------------------------------------------------------
+// Find the item for an I/O unit from its "X.X.X.X" address
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD nIpAddress = inet_addr(pchIpAddressArg);
+
+  if (INADDR_NONE == nIpAddress)
+    return NULL;
+
+  return FindStreamItem((DWORD)ntohl(nIpAddress));
+}
+
+
+LONG O22SnapIoStream::StartStreamListening(char * pchIpAddressArg, long nTimeoutMS)
+//-------------------------------------------------------------------------------------------------
+// Start listening for packets from an I/O unit
+//-------------------------------------------------------------------------------------------------
+{
+  O22StreamItem * pItem;      // The I/O unit's item
+  DWORD           nIpAddress; // The I/O unit's address, in host order
+  long            nSlot;      // The item's slot in the table
+
+  if (m_StreamSocket == INVALID_SOCKET)
+    return SIOMM_ERROR_NOT_CONNECTED;
+
+  nIpAddress = inet_addr(pchIpAddressArg);
+  if (INADDR_NONE == nIpAddress)
+    return SIOMM_ERROR;
+  nIpAddress = ntohl(nIpAddress);
+
+  LockStream();
+
+  // An I/O unit that is already in the table keeps its item and its queued packets
+  pItem = FindStreamItem(nIpAddress);
+  if (pItem == NULL)
+  {
+    if (m_nStreamItems >= SIOMM_STREAM_MAX_UNITS)
+    {
+      UnlockStream();
+      return SIOMM_ERROR;
+    }
+
+    pItem = new O22StreamItem;
+    memset((void*)pItem, 0, sizeof(O22StreamItem));
+    pItem->nIpAddress = nIpAddress;
+    pItem->nIndex     = m_nStreamItems;
+    m_arrStreamItems[pItem->nIndex] = pItem;
+    m_arrStreamArmed[pItem->nIndex] = 0;
+
+    // Publish the item only once it is filled in
+    nSlot = StreamHash(nIpAddress);
+    while (m_arrStreamTable[nSlot] != NULL)
+      nSlot = (nSlot + 1) & (SIOMM_STREAM_TABLE_SIZE - 1);
+    StreamStoreItem(&m_arrStreamTable[nSlot], pItem);
+    m_nStreamItems = m_nStreamItems + 1;
+  }
+
+  m_arrStreamTimeout[pItem->nIndex]  = nTimeoutMS;
+  m_arrStreamDeadline[pItem->nIndex] = StreamTickCount() + nTimeoutMS;
+  m_arrStreamArmed[pItem->nIndex]    = 1;
+
+  if (!pItem->bListening)
+  {
+    pItem->bListening = TRUE;
+    nStreamListCount++;
+  }
+
+  UnlockStream();
+
+  // The first I/O unit starts the listening thread
+  if (!m_bListenToStreaming)
+    return StartStreamThread();
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::StopStreamListening(char * pchIpAddressArg)
+//-------------------------------------------------------------------------------------------------
+// Stop listening for packets from an I/O unit. Its item stays in the table, with any queued
+// packets, until CloseStreaming().
+//-------------------------------------------------------------------------------------------------
+{
+  O22StreamItem  * pItem;      // The I/O unit's item
+  long             nCount;     // Items still being listened to
+
+  LockStream();
+
+  pItem = FindStreamItem(pchIpAddressArg);
+  if ((pItem == NULL) || !pItem->bListening)
+  {
+    UnlockStream();
+    return SIOMM_ERROR;
+  }
+
+  pItem->bListening = FALSE;
+  m_arrStreamArmed[pItem->nIndex] = 0;
+  nCount = --nStreamListCount;
+
+  UnlockStream();
+
+  // The last I/O unit stops the listening thread
+  if (nCount == 0)
+    StopStreamThread();
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::StartStreamThread()
+//-------------------------------------------------------------------------------------------------
+// Start the listening thread
+//-------------------------------------------------------------------------------------------------
+{
+  m_bListenToStreaming = TRUE;
+
+#ifdef _WIN32
+  m_hStreamThread = (HANDLE)_beginthreadex(NULL, 0, StreamThread, this, 0, NULL);
+  if (m_hStreamThread == NULL)
+#endif
+#ifdef _LINUX
+  if (pthread_create(&m_hStreamThread, NULL, StreamThread, this) != 0)
+#endif
+  {
+    m_bListenToStreaming = FALSE;
+    return SIOMM_ERROR;
+  }
+
+  return SIOMM_OK;
+}
+
+
+void O22SnapIoStream::StopStreamThread()
+//-------------------------------------------------------------------------------------------------
+// Stop the listening thread and wait for it to finish. It wakes up at least every
+// SIOMM_STREAM_POLL_MS to see the flag.
+//-------------------------------------------------------------------------------------------------
+{
+  if (!m_bListenToStreaming)
+    return;
+
+  m_bListenToStreaming = FALSE;
+
+#ifdef _WIN32
+  WaitForSingleObject(m_hStreamThread, INFINITE);
+  CloseHandle(m_hStreamThread);
+  m_hStreamThread = NULL;
+#endif
+#ifdef _LINUX
+  pthread_join(m_hStreamThread, NULL);
+#endif
+}
+
+
+LONG O22SnapIoStream::StreamHandler()
+//-------------------------------------------------------------------------------------------------
+// Wait for one stream packet and queue it if it comes from an I/O unit being listened to
+//-------------------------------------------------------------------------------------------------
+{
+  fd_set                   fds;            // for checking the socket
+  timeval                  tvTimeOut;      // how long to wait for a packet
+  sockaddr_in              SourceAddress;  // who sent the packet
+  O22StreamItem          * pItem;          // the sender's item
+  SIOMM_StreamTimedBlock * pLatest;        // where the newest packet is kept
+  DWORD                    nIpAddress;     // the sender's address, in host order
+  DWORD                    nHead;          // the sender's ring head
+  DWORD                    nSeq;           // the sequence number of the newest packet
+  DWORD                    nNow;           // the current tick count
+  LONGLONG                 nRecvTimeNS;    // when the packet arrived
+  long                     nResult;        // for checking the return values of functions
+
+  FD_ZERO(&fds);
+  FD_SET(m_StreamSocket, &fds);
+  tvTimeOut.tv_sec  = 0;
+  tvTimeOut.tv_usec = SIOMM_STREAM_POLL_MS * 1000;
+
+  nResult = select(m_StreamSocket + 1, &fds, NULL, NULL, &tvTimeOut);
+  if (nResult <= 0)
+    return (nResult == 0) ? SIOMM_TIME_OUT : SIOMM_ERROR;
+
+  nResult = O22RecvTimeStamped(m_StreamSocket, (char*)m_pbyLastStreamBlock, m_nStreamLength + 1,
+                               &SourceAddress, &nRecvTimeNS);
+
+  // Drop anything that isn't a whole stream packet
+  if (nResult != m_nStreamLength)
+    return SIOMM_ERROR_RESPONSE_BAD;
+
+  nIpAddress = ntohl(SourceAddress.sin_addr.s_addr);
+
+  pItem = FindStreamItem(nIpAddress);
+  if ((pItem == NULL) || !pItem->bListening)
+  {
+    // Not an I/O unit we're listening to
+    return SIOMM_OK;
+  }
+
+  nNow = StreamTickCount();
+  m_arrStreamDeadline[pItem->nIndex] = nNow + m_arrStreamTimeout[pItem->nIndex];
+  m_arrStreamArmed[pItem->nIndex]    = 1;
+  pItem->nPackets = pItem->nPackets + 1;
+
+  // The newest packet is always kept, even when the queue is full, for GetLastStream*BlockEx().
+  // The sequence number is odd while it is being written, so a reader can tell that its copy
+  // was torn and take it again.
+  nSeq = pItem->nLatestSeq;
+  StreamStore(&pItem->nLatestSeq, nSeq + 1);
+  StreamFence();
+
+  pLatest = &(pItem->Latest);
+  pLatest->Block.nHeader = O22MAKELONG2(m_pbyLastStreamBlock, 0);
+  if (SIOMM_STREAM_TYPE_CUSTOM == m_nStreamType)
+  {
+    pLatest->Block.nMemMapAddress = O22MAKELONG2(m_pbyLastStreamBlock, 4);
+    memcpy(pLatest->Block.byData, m_pbyLastStreamBlock + SIOMM_STREAM_CUSTOM_HEADER_SIZE,
+           m_nStreamLength - SIOMM_STREAM_CUSTOM_HEADER_SIZE);
+  }
+  else
+  {
+    pLatest->Block.nMemMapAddress = 0;
+    memcpy(pLatest->Block.byData, m_pbyLastStreamBlock + SIOMM_STREAM_HEADER_SIZE,
+           SIOMM_STREAM_STANDARD_DATA_SIZE);
+  }
+  pLatest->Block.nTCPIPAddress = nIpAddress;
+  pLatest->nRecvTimeNS = nRecvTimeNS;
+
+  StreamStore(&pItem->nLatestSeq, nSeq + 2);
+  StreamStore(&m_nLastStreamIpAddress, nIpAddress);
+
+  // This thread is the only one that moves the head. If the user hasn't made room, the 
+  // packet isn't queued rather than overwriting one the user may be copying.
+  nHead = pItem->nRingHead;
+  if (nHead - StreamLoad(&pItem->nRingTail) >= SIOMM_STREAM_RING_SIZE)
+  {
+    pItem->nOverruns = pItem->nOverruns + 1;
+  }
+  else
+  {
+    // Hand a copy to the user
+    memcpy(&(pItem->arrRing[nHead & (SIOMM_STREAM_RING_SIZE - 1)]), pLatest, 
+           sizeof(SIOMM_StreamTimedBlock));
+    StreamStore(&pItem->nRingHead, nHead + 1);
+  }
+
+  // Tell the user
+  if (m_pStreamEventCallbackFunc)
+    m_pStreamEventCallbackFunc(nIpAddress, m_pStreamEventParam, SIOMM_OK);
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::CheckStreamTimeouts()
+//-------------------------------------------------------------------------------------------------
+// Send one timeout event for each I/O unit that stopped streaming
+//-------------------------------------------------------------------------------------------------
+{
+  DWORD nNow;     // the current tick count
+  long  nCount;   // the number of items
+  DWORD nExpired; // non-zero if any armed item is past its deadline
+  long  i;        // for stepping through the items
+
+  nNow   = StreamTickCount();
+  nCount = m_nStreamItems;
+
+  // Usually nothing has timed out, so first check all items in one branch-free pass
+  nExpired = 0;
+  for (i = 0 ; i < nCount ; i++)
+    nExpired |= m_arrStreamArmed[i] & (DWORD)((LONG)(nNow - m_arrStreamDeadline[i]) > 0);
+
+  if (nExpired == 0)
+    return SIOMM_OK;
+
+  for (i = 0 ; i < nCount ; i++)
+  {
+    if (m_arrStreamArmed[i] && ((LONG)(nNow - m_arrStreamDeadline[i]) > 0))
+    {
+      m_arrStreamArmed[i] = 0;
+
+      if (m_pStreamEventCallbackFunc)
+        m_pStreamEventCallbackFunc(m_arrStreamItems[i]->nIpAddress, m_pStreamEventParam, 
+                                   SIOMM_TIME_OUT);
+    }
+  }
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::GetLastStreamRecvTimeNS(LONGLONG * pnRecvTimeNS)
+//-------------------------------------------------------------------------------------------------
+// Get when the packet last returned by GetLastStream*BlockEx() arrived
+//-------------------------------------------------------------------------------------------------
+{
+  if (0 == m_nLastStreamRecvTimeNS)
+    return SIOMM_ERROR_NOT_CONNECTED_YET;
+
+  *pnRecvTimeNS = m_nLastStreamRecvTimeNS;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::ReadStreamBlocks(char * pchIpAddressArg, SIOMM_StreamTimedBlock * pBlocks,
+                                       long nMaxBlocks, long * pnBlocks)
+//-------------------------------------------------------------------------------------------------
+// Take the packets queued for an I/O unit
+//-------------------------------------------------------------------------------------------------
+{
+  O22StreamItem * pItem;  // the I/O unit's item
+  DWORD           nHead;  // the ring head, as published by the listening thread
+  DWORD           nTail;  // the ring tail, which only the user moves
+  long            nCount; // the number of packets taken
+
+  *pnBlocks = 0;
+
+  pItem = FindStreamItem(pchIpAddressArg);
+  if (pItem == NULL)
+    return SIOMM_ERROR;
+
+  nHead  = StreamLoad(&pItem->nRingHead);
+  nTail  = pItem->nRingTail;
+  nCount = 0;
+
+  while ((nTail != nHead) && (nCount < nMaxBlocks))
+  {
+    memcpy(&(pBlocks[nCount]), &(pItem->arrRing[nTail & (SIOMM_STREAM_RING_SIZE - 1)]),
+           sizeof(SIOMM_StreamTimedBlock));
+    nCount++;
+    nTail++;
+  }
+
+  // Give the slots back to the listening thread
+  if (nCount > 0)
+    StreamStore(&pItem->nRingTail, nTail);
+
+  *pnBlocks = nCount;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::GetStreamCounters(char * pchIpAddressArg, long * pnPackets, 
+                                        long * pnOverruns)
+//-------------------------------------------------------------------------------------------------
+// Get the packet counters for an I/O unit
+//-------------------------------------------------------------------------------------------------
+{
+  O22StreamItem * pItem = FindStreamItem(pchIpAddressArg);
+
+  if (pItem == NULL)
+    return SIOMM_ERROR;
+
+  *pnPackets  = pItem->nPackets;
+  *pnOverruns = pItem->nOverruns;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::TakeLastStreamBlock(SIOMM_StreamCustomBlock ** ppBlock)
+//-------------------------------------------------------------------------------------------------
+// Copy the newest packet from the last I/O unit heard from, and drop the queued ones
+//-------------------------------------------------------------------------------------------------
+{
+  O22StreamItem * pItem;      // the sender's item
+  DWORD           nIpAddress; // the sender's address
+  DWORD           nSeq;       // the sequence number of the newest packet
+
+  nIpAddress = StreamLoad(&m_nLastStreamIpAddress);
+  if (nIpAddress == 0)
+    return SIOMM_ERROR_NOT_CONNECTED_YET;
+
+  pItem = FindStreamItem(nIpAddress);
+  if (pItem == NULL)
+    return SIOMM_ERROR_NOT_CONNECTED_YET;
+
+  // Copy again if the listening thread wrote a packet meanwhile.  It takes a new packet to do
+  // that, so this doesn't go round for long.
+  for (;;)
+  {
+    nSeq = StreamLoad(&pItem->nLatestSeq);
+    if (nSeq & 1)
+      continue;
+
+    memcpy(&(pItem->LastBlock), &(pItem->Latest), sizeof(SIOMM_StreamTimedBlock));
+    StreamFence();
+
+    if (nSeq == pItem->nLatestSeq)
+      break;
+  }
+
+  if (0 == nSeq)
+    return SIOMM_ERROR_NOT_CONNECTED_YET;
+
+  // The queued packets are older, so they're of no use to a reader of the newest one
+  StreamStore(&pItem->nRingTail, StreamLoad(&pItem->nRingHead));
+
+  *ppBlock = &(pItem->LastBlock.Block);
+  m_nLastStreamRecvTimeNS = pItem->LastBlock.nRecvTimeNS;
+
+  if (!pItem->bListening || !m_arrStreamArmed[pItem->nIndex])
+    return SIOMM_TIME_OUT;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::UnpackStreamStandardBlock(SIOMM_StreamCustomBlock * pBlock,
+                                                SIOMM_StreamStandardBlock * pStreamData)
+//-------------------------------------------------------------------------------------------------
+// Unpack a standard stream packet
+//-------------------------------------------------------------------------------------------------
+{
+  BYTE * pbyData = pBlock->byData;  // the stream data
+  long   arrnStates[8];             // the digital bank states, in the order of the structure
+
+  pStreamData->nHeader = pBlock->nHeader;
+  O22UnpackFloats(pbyData,       pStreamData->fAnalogValue,     64);
+  O22UnpackLongs(pbyData + 256,  pStreamData->nDigPointFeature, 64);
+  O22UnpackLongs(pbyData + 512,  arrnStates,                    8);
+
+  pStreamData->nStatePts63to32          = arrnStates[0];
+  pStreamData->nStatePts31to0           = arrnStates[1];
+  pStreamData->nOnLatchStatePts63to32   = arrnStates[2];
+  pStreamData->nOnLatchStatePts31to0    = arrnStates[3];
+  pStreamData->nOffLatchStatePts63to32  = arrnStates[4];
+  pStreamData->nOffLatchStatePts31to0   = arrnStates[5];
+  pStreamData->nActiveCountersPts63to32 = arrnStates[6];
+  pStreamData->nActiveCountersPts31to0  = arrnStates[7];
+  memset(pStreamData->byReserved, 0, sizeof(pStreamData->byReserved));
+  pStreamData->nTCPIPAddress = pBlock->nTCPIPAddress;
+
+  return SIOMM_OK;
+}
+
+
+LONG O22SnapIoStream::GetLastStreamStandardBlockEx(SIOMM_StreamStandardBlock *pStreamData)
+//-------------------------------------------------------------------------------------------------
+// Unpack the last standard stream packet received
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_StreamCustomBlock * pBlock; // the last packet
+  LONG                      nResult;
+
+  if (SIOMM_STREAM_TYPE_STANDARD != m_nStreamType)
+    return SIOMM_ERROR_STREAM_TYPE_BAD;
+
+  nResult = TakeLastStreamBlock(&pBlock);
+  if ((SIOMM_OK == nResult) || (SIOMM_TIME_OUT == nResult))
+    UnpackStreamStandardBlock(pBlock, pStreamData);
+
+  return nResult;
+}
+
+
+LONG O22SnapIoStream::GetLastStreamCustomBlockEx(SIOMM_StreamCustomBlock *pStreamData)
+//-------------------------------------------------------------------------------------------------
+// Copy the last custom stream packet received
+//-------------------------------------------------------------------------------------------------
+{
+  SIOMM_StreamCustomBlock * pBlock; // the last packet
+  LONG                      nResult;
+
+  if (SIOMM_STREAM_TYPE_CUSTOM != m_nStreamType)
+    return SIOMM_ERROR_STREAM_TYPE_BAD;
+
+  nResult = TakeLastStreamBlock(&pBlock);
+  if ((SIOMM_OK == nResult) || (SIOMM_TIME_OUT == nResult))
+    memcpy(pStreamData, pBlock, sizeof(SIOMM_StreamCustomBlock));
+
+  return nResult;
+}
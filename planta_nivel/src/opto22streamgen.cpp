@@ -0,0 +1,281 @@
+//-----------------------------------------------------------------------------
+//
+// opto22streamgen.cpp
+//
+// Stream packet generator, to test and benchmark O22SnapIoStream without an
+// I/O unit.
+//
+// Sends standard or custom stream packets over UDP, as SNAP Ethernet brains
+// streaming to this computer would, at a fixed rate. Each packet period
+// sends one packet from every source. With more than one source, each
+// source has its own socket bound to 127.1.x.y, so the listener sees them as
+// different I/O units; listen to 127.1.0.1, 127.1.0.2 and so on.
+//
+// Standard packets carry the stream read area: analog point k reads k*1.5
+// plus the packet number, the feature data of every digital point and the
+// point states are the packet number, and the latches and counters are
+// zero. Custom packets carry quadlets that read the same way, k being the
+// quadlet number.
+//
+//   opto22streamgen [-p port] [-r packets_per_s] [-n packets] [-s sources]
+//                   [-c custom_length [-a address]] [-t target_ip]
+//
+// Linux only, and only needs the headers:
+//
+//   g++ -D_LINUX -Iinclude -o opto22streamgen src/opto22streamgen.cpp
+//-----------------------------------------------------------------------------
+
+
+#include "O22SIOMM.h"
+#include "O22SIOST.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <signal.h>
+
+
+#define STREAMGEN_FIRST_SOURCE  0x7F010001  // 127.1.0.1
+#define STREAMGEN_MAX_SOURCES   SIOMM_STREAM_MAX_UNITS
+
+
+static volatile sig_atomic_t g_bStop = 0;
+
+
+static void StopHandler(int)
+//-------------------------------------------------------------------------------------------------
+// Stop after the current period on Ctrl-C
+//-------------------------------------------------------------------------------------------------
+{
+  g_bStop = 1;
+}
+
+
+static LONGLONG GetTimeNS()
+//-------------------------------------------------------------------------------------------------
+// The monotonic clock, in nanoseconds
+//-------------------------------------------------------------------------------------------------
+{
+  struct timespec tsNow;
+
+  clock_gettime(CLOCK_MONOTONIC, &tsNow);
+  return (LONGLONG)tsNow.tv_sec * 1000000000 + tsNow.tv_nsec;
+}
+
+
+static void FillQuads(BYTE * pbyData, long nLength, DWORD dwPacket, BOOL bFloats)
+//-------------------------------------------------------------------------------------------------
+// Big-endian quadlets: floats k*1.5 plus the packet number, or the packet number itself
+//-------------------------------------------------------------------------------------------------
+{
+  BYTE  byQuad[4];
+  DWORD dwQuadlet;
+  float fValue;
+  long  k;
+
+  for (k = 0 ; k*4 < nLength ; k++)
+  {
+    dwQuadlet = dwPacket;
+    if (bFloats)
+    {
+      fValue = (float)(k * 1.5 + dwPacket);
+      memcpy(&dwQuadlet, &fValue, 4);
+    }
+
+    O22FILL_ARRAY_FROM_LONG(byQuad, 0, dwQuadlet);
+    memcpy(pbyData + k*4, byQuad, (nLength - k*4 < 4) ? nLength - k*4 : 4);
+  }
+}
+
+
+static long BuildPacket(BYTE * pbyPacket, DWORD dwPacket, long nCustomLength, DWORD dwAddress)
+//-------------------------------------------------------------------------------------------------
+// A whole stream packet, header included. Returns its length.
+//-------------------------------------------------------------------------------------------------
+{
+  BYTE * pbyData;
+  DWORD  dwHeader;
+  long   nDataLength;
+
+  if (nCustomLength)
+  {
+    nDataLength = nCustomLength;
+    pbyData     = pbyPacket + SIOMM_STREAM_CUSTOM_HEADER_SIZE;
+
+    O22FILL_ARRAY_FROM_LONG(pbyPacket, 4, dwAddress);
+    FillQuads(pbyData, nDataLength, dwPacket, TRUE);
+  }
+  else
+  {
+    nDataLength = SIOMM_STREAM_STANDARD_DATA_SIZE;
+    pbyData     = pbyPacket + SIOMM_STREAM_HEADER_SIZE;
+
+    // 64 analog values, 64 digital feature quadlets, then the 8 quadlets of the digital
+    // bank states, latches and counters
+    memset(pbyData, 0, nDataLength);
+    FillQuads(pbyData,       256, dwPacket, TRUE);
+    FillQuads(pbyData + 256, 256, dwPacket, FALSE);
+    FillQuads(pbyData + 516, 4,   dwPacket, FALSE);
+  }
+
+  // See SIOMM_StreamStandardBlock::nHeader
+  dwHeader = ((DWORD)SIOMM_TCODE_WRITE_BLOCK_REQUEST << 24) | (DWORD)nDataLength;
+  O22FILL_ARRAY_FROM_LONG(pbyPacket, 0, dwHeader);
+
+  return (pbyData - pbyPacket) + nDataLength;
+}
+
+
+static void Usage()
+{
+  printf("usage: opto22streamgen [-p port] [-r packets_per_s] [-n packets] [-s sources]\n"
+         "                       [-c custom_length [-a address]] [-t target_ip]\n"
+         "  -p  UDP port to send to (default 5001)\n"
+         "  -r  packets per second from each source (default 100)\n"
+         "  -n  packets from each source, 0 for no end (default 0)\n"
+         "  -s  number of sources, from 127.1.0.1 on (default 1, from 127.0.0.1)\n"
+         "  -c  send custom packets with this much data, 1 to %d bytes\n"
+         "  -a  memory map address of the custom data (default 0x%08X)\n"
+         "  -t  address to send to (default 127.0.0.1)\n",
+         SIOMM_STREAM_CUSTOM_MAX_DATA_SIZE, (unsigned)SIOMM_ABANK_READ_POINT_VALUES);
+}
+
+
+int main(int argc, char * argv[])
+//-------------------------------------------------------------------------------------------------
+// Send the packets
+//-------------------------------------------------------------------------------------------------
+{
+  SOCKET      arrSockets[STREAMGEN_MAX_SOURCES];
+  BYTE        byPacket[SIOMM_STREAM_CUSTOM_HEADER_SIZE + SIOMM_STREAM_CUSTOM_MAX_DATA_SIZE];
+  sockaddr_in Target;
+  sockaddr_in Source;
+  timespec    tsWake;
+  const char* pchTarget     = "127.0.0.1";
+  long        nPort         = 5001;
+  double      dRate         = 100;
+  long        nPackets      = 0;
+  long        nSources      = 1;
+  long        nCustomLength = 0;
+  DWORD       dwAddress     = SIOMM_ABANK_READ_POINT_VALUES;
+  LONGLONG    nPeriodNS;
+  LONGLONG    nNextNS;
+  LONGLONG    nStartNS;
+  LONGLONG    nNowNS;
+  DWORD       dwPacket;
+  long        nLength;
+  long        nSent   = 0;
+  long        nErrors = 0;
+  long        nLate   = 0;
+  long        s;
+  int         nOption;
+
+  while ((nOption = getopt(argc, argv, "p:r:n:s:c:a:t:h")) != -1)
+  {
+    switch (nOption)
+    {
+      case 'p': nPort         = atol(optarg); break;
+      case 'r': dRate         = atof(optarg); break;
+      case 'n': nPackets      = atol(optarg); break;
+      case 's': nSources      = atol(optarg); break;
+      case 'c': nCustomLength = atol(optarg); break;
+      case 'a': dwAddress     = (DWORD)strtoul(optarg, NULL, 0); break;
+      case 't': pchTarget     = optarg; break;
+      default:
+        Usage();
+        return 1;
+    }
+  }
+
+  if ((dRate <= 0) || (nSources < 1) || (nSources > STREAMGEN_MAX_SOURCES) ||
+      (nCustomLength < 0) || (nCustomLength > SIOMM_STREAM_CUSTOM_MAX_DATA_SIZE))
+  {
+    Usage();
+    return 1;
+  }
+
+  memset(&Target, 0, sizeof(Target));
+  Target.sin_family = AF_INET;
+  Target.sin_port   = htons((WORD)nPort);
+  if (inet_pton(AF_INET, pchTarget, &Target.sin_addr) != 1)
+  {
+    printf("Bad target address %s\n", pchTarget);
+    return 1;
+  }
+
+  // One socket for each source, bound to its own loopback address when there are several
+  for (s = 0 ; s < nSources ; s++)
+  {
+    arrSockets[s] = socket(AF_INET, SOCK_DGRAM, 0);
+    if (arrSockets[s] < 0)
+    {
+      printf("Can't create a socket: %s\n", strerror(errno));
+      return 1;
+    }
+
+    if (nSources > 1)
+    {
+      memset(&Source, 0, sizeof(Source));
+      Source.sin_family      = AF_INET;
+      Source.sin_addr.s_addr = htonl(STREAMGEN_FIRST_SOURCE + s);
+
+      if (bind(arrSockets[s], (sockaddr*)&Source, sizeof(Source)) != 0)
+      {
+        printf("Can't bind source %ld: %s\n", s, strerror(errno));
+        return 1;
+      }
+    }
+  }
+
+  signal(SIGINT, StopHandler);
+  signal(SIGTERM, StopHandler);
+
+  printf("Sending %s packets of %ld bytes to %s:%ld, %g per second from %ld source%s\n",
+         nCustomLength ? "custom" : "standard",
+         BuildPacket(byPacket, 0, nCustomLength, dwAddress), pchTarget, nPort, dRate,
+         nSources, (nSources > 1) ? "s from 127.1.0.1" : "");
+
+  nPeriodNS = (LONGLONG)(1e9 / dRate);
+  nStartNS  = GetTimeNS();
+  nNextNS   = nStartNS;
+
+  for (dwPacket = 0 ; !g_bStop && ((nPackets == 0) || ((long)dwPacket < nPackets)) ; dwPacket++)
+  {
+    nLength = BuildPacket(byPacket, dwPacket, nCustomLength, dwAddress);
+
+    for (s = 0 ; s < nSources ; s++)
+    {
+      if (sendto(arrSockets[s], byPacket, nLength, 0, (sockaddr*)&Target, sizeof(Target)) ==
+          nLength)
+        nSent++;
+      else
+        nErrors++;
+    }
+
+    // Sleep until the next period. A late period isn't made up for; the next ones are
+    // measured from it, as RTBlock does.
+    nNextNS += nPeriodNS;
+    nNowNS   = GetTimeNS();
+    if (nNowNS > nNextNS)
+    {
+      nLate++;
+      nNextNS = nNowNS;
+      continue;
+    }
+
+    tsWake.tv_sec  = nNextNS / 1000000000;
+    tsWake.tv_nsec = nNextNS % 1000000000;
+    while (!g_bStop && (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tsWake, NULL) == EINTR))
+      ;
+  }
+
+  nNowNS = GetTimeNS();
+
+  printf("%ld packets sent in %.3f s (%.0f per second), %ld send errors, %ld late periods\n",
+         nSent, (nNowNS - nStartNS) / 1e9, nSent * 1e9 / (nNowNS - nStartNS + 1), nErrors,
+         nLate);
+
+  for (s = 0 ; s < nSources ; s++)
+    close(arrSockets[s]);
+
+  return nErrors ? 1 : 0;
+}